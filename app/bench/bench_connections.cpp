@@ -0,0 +1,125 @@
+// Memory cost of idle TCP connections.
+// Usage: bench_connections [num-connections]   (default 10000)
+// Opens the connections from one simulated host to another through a router, leaves them idle, and
+// reports the resident memory they take per connection (both ends) and per socket.
+// The connections are spread over several server ports, as one (address, port) pair can only tell apart
+// as many connections as there are ephemeral ports on the client.
+
+#include <host_node.hpp>
+#include <sim/simulator.hpp>
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace tns;
+
+namespace {
+
+// nets/linear-r1h2.json
+constexpr auto LINEAR_R1H2 = R"({
+    "nodes": [
+        {"name": "r1", "type": "router"},
+        {"name": "h1", "type": "host"},
+        {"name": "h2", "type": "host"}
+    ],
+    "networks": [
+        {"name": "r1-left", "links": ["h1", "r1"]},
+        {"name": "r1-right", "links": ["r1", "h2"]}
+    ]
+})";
+
+constexpr in_port_t PORT = 9000;
+constexpr std::size_t CONNECTIONS_PER_PORT = 20'000;
+
+// Resident set size of the process, in bytes
+std::size_t residentBytes()
+{
+    std::size_t size = 0, resident = 0;
+    std::ifstream("/proc/self/statm") >> size >> resident;
+    return resident * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::size_t n = argc > 1 ? std::stoul(argv[1]) : 10'000;
+
+    const auto topology = sim::parseTopology(LINEAR_R1H2);
+    if (!topology) {
+        std::cerr << "bench_connections: " << topology.error() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    // The stack logs every connection: keep the report readable
+    auto *const coutBuf = std::cout.rdbuf(nullptr);
+
+    sim::Simulator sim{*topology};
+    auto &client = sim.host("h1");
+    auto &server = sim.host("h2");
+
+    // Connection i goes to port PORT + i % nPorts
+    const auto nPorts = std::max<std::size_t>(1, (n + CONNECTIONS_PER_PORT - 1) / CONNECTIONS_PER_PORT);
+    std::vector<tcp::ListenSocketRef> listenSocks;
+    std::vector<std::future<std::size_t>> accepted;
+    for (std::size_t i = 0; i < nPorts; i++) {
+        auto listenSock = server.tcpListen(static_cast<in_port_t>(PORT + i));
+        if (!listenSock) {
+            std::cout.rdbuf(coutBuf);
+            std::cerr << "bench_connections: listen failed: " << listenSock.error() << "\n";
+            return EXIT_FAILURE;
+        }
+        listenSocks.push_back(*listenSock);
+
+        const auto expected = n / nPorts + (i < n % nPorts ? 1 : 0);
+        accepted.push_back(std::async(std::launch::async, [listenSock = *listenSock, expected] {
+            std::size_t count = 0;
+            for (; count < expected && listenSock.get().vAccept(); count++) {}
+            return count;
+        }));
+    }
+
+    const auto before = residentBytes();
+    const auto start = std::chrono::steady_clock::now();
+
+    std::size_t opened = 0;
+    for (; opened < n; opened++) {
+        const auto port = static_cast<in_port_t>(PORT + opened % nPorts);
+        if (auto sock = client.tcpConnect(sim.address("h2"), port); !sock) {
+            std::cout.rdbuf(coutBuf);
+            std::cerr << "bench_connections: connection " << opened << " failed: " << sock.error() << "\n";
+            break;
+        }
+    }
+    std::size_t nAccepted = 0;
+    for (auto &count : accepted) {
+        if (count.wait_for(std::chrono::seconds(30)) == std::future_status::ready)
+            nAccepted += count.get();
+    }
+
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    const auto after = residentBytes();
+    std::cout.rdbuf(coutBuf);
+
+    const auto pass = opened == n && nAccepted == n;
+    const auto perConnection = pass && n > 0 ? static_cast<double>(after - before) / static_cast<double>(n) : 0.0;
+    std::cout << "\nbench_connections: " << opened << " connections opened, " << nAccepted << " accepted"
+              << " in " << elapsed.count() << " ms\n"
+              << "  resident memory: " << before / 1024 << " KiB -> " << after / 1024 << " KiB\n"
+              << "  per idle connection: " << perConnection << " bytes\n"
+              << "  per socket:          " << perConnection / 2 << " bytes\n"
+              << (pass ? "PASS" : "FAIL") << "\n";
+
+    // The connections are torn down with the simulator; stop accepting first
+    std::cout.rdbuf(nullptr);
+    for (auto listenSock : listenSocks)
+        listenSock.get().vClose();
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
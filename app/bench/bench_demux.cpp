@@ -0,0 +1,97 @@
+// Cost of demultiplexing an incoming segment to its connection (`tcp::FlowTable::find`).
+// Usage: bench_demux [num-flows]   (default 100000)
+// All flows are between the same two hosts. Reports the lookup time with 1k, 10k and num-flows flows,
+// for segments of random flows and for bursts of one flow, each alone and while another thread opens
+// and closes connections.
+
+#include <tcp/flow_table.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace tns;
+using tcp::FlowTable, tcp::SessionTuple;
+
+namespace {
+
+constexpr std::size_t LOOKUPS = 2'000'000;
+constexpr std::size_t BURST = 16;  // Segments of one flow in a row
+
+SessionTuple makeTuple(std::uint32_t i)
+{
+    return {
+        /*  local= */ {ip::Ipv4Address{"10.0.0.1"}, util::hton(static_cast<in_port_t>(9000 + i % 16))},
+        /* remote= */ {ip::Ipv4Address{"10.2.0.2"}, util::hton(static_cast<in_port_t>(1024 + i / 16))}
+    };
+}
+
+// Nanoseconds per lookup of the flows in `order`, each looked up `burst` times in a row
+double timeLookups(const FlowTable<std::uint32_t> &table, const std::vector<SessionTuple> &order, std::size_t burst)
+{
+    std::size_t found = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (std::size_t n = 0; n < LOOKUPS; n++)
+        found += table.find(order[(n / burst) % order.size()]) != nullptr;
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    if (found != LOOKUPS) {
+        std::cerr << "bench_demux: " << LOOKUPS - found << " lookups missed\n";
+        std::exit(EXIT_FAILURE);
+    }
+    return elapsed.count() / LOOKUPS;
+}
+
+void run(std::uint32_t nFlows)
+{
+    FlowTable<std::uint32_t> table;
+    std::vector<std::uint32_t> values(nFlows);
+    std::vector<SessionTuple> order(nFlows);
+    for (std::uint32_t i = 0; i < nFlows; i++) {
+        values[i] = i;
+        order[i] = makeTuple(i);
+        table.insert(order[i], values[i]);
+    }
+    std::shuffle(order.begin(), order.end(), std::mt19937{42});
+
+    const auto random = timeLookups(table, order, 1);
+    const auto bursts = timeLookups(table, order, BURST);
+
+    // Connections to other ports come and go meanwhile
+    std::atomic<bool> done{false};
+    std::vector<std::uint32_t> churnValues(1024);
+    std::jthread churn([&] {
+        while (!done) {
+            for (std::uint32_t i = 0; i < churnValues.size(); i++)
+                table.insert(makeTuple(nFlows + i), churnValues[i]);
+            for (std::uint32_t i = 0; i < churnValues.size(); i++)
+                table.erase(makeTuple(nFlows + i));
+        }
+    });
+    const auto randomChurn = timeLookups(table, order, 1);
+    const auto burstsChurn = timeLookups(table, order, BURST);
+    done = true;
+
+    std::cout << "  " << std::setw(7) << nFlows << " flows: "
+              << std::fixed << std::setprecision(1)
+              << std::setw(6) << random << " ns random, " << std::setw(6) << bursts << " ns bursts | churn: "
+              << std::setw(6) << randomChurn << " ns random, " << std::setw(6) << burstsChurn << " ns bursts\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const auto n = argc > 1 ? static_cast<std::uint32_t>(std::stoul(argv[1])) : 100'000U;
+
+    std::cout << "bench_demux: " << LOOKUPS << " lookups per run, bursts of " << BURST << "\n";
+    for (const auto nFlows : {1'000U, 10'000U, n})
+        run(nFlows);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,134 @@
+// Goodput of a bulk TCP transfer as the link loses more packets.
+// Usage: bench_loss [size-KiB]   (default 2048)
+// Sends `size` KiB from one simulated host to another through a router, with both hosts dropping a share of
+// their outgoing datagrams and delaying them by 5 ms, for each congestion control algorithm. Reports the goodput
+// and the losses recovered by fast retransmits and by retransmission timeouts.
+
+#include <host_node.hpp>
+#include <sim/impairment.hpp>
+#include <sim/simulator.hpp>
+
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace tns;
+
+namespace {
+
+// nets/linear-r1h2.json
+constexpr auto LINEAR_R1H2 = R"({
+    "nodes": [
+        {"name": "r1", "type": "router"},
+        {"name": "h1", "type": "host"},
+        {"name": "h2", "type": "host"}
+    ],
+    "networks": [
+        {"name": "r1-left", "links": ["h1", "r1"]},
+        {"name": "r1-right", "links": ["r1", "h2"]}
+    ]
+})";
+
+constexpr in_port_t PORT = 9000;
+constexpr auto TIMEOUT = std::chrono::seconds(120);
+
+struct Result {
+    bool ok = false;
+    double seconds = 0;
+    std::size_t fastRetransmits = 0;
+    std::size_t timeouts = 0;
+};
+
+Result transfer(const sim::Topology &topology, std::size_t size, double lossPercent, tcp::CongestionAlgorithm algorithm)
+{
+    sim::Simulator sim{topology};
+    auto &sender = sim.host("h1");
+    auto &receiver = sim.host("h2");
+
+    std::stringstream settings;
+    settings << "loss " << lossPercent << "% delay 5ms seed 7";
+    const auto impairment = sim::parseImpairment(settings.str());
+    if (!impairment || !sender.setImpairment("if0", *impairment) || !receiver.setImpairment("if0", *impairment))
+        return {};
+    sender.tcpSetCongestionAlgorithm(algorithm);
+
+    auto listenSock = receiver.tcpListen(PORT);
+    if (!listenSock)
+        return {};
+
+    auto received = std::async(std::launch::async, [&listenSock, size] {
+        std::vector<std::byte> buffer(size);
+        std::size_t total = 0;
+        if (auto sock = listenSock->get().vAccept()) {
+            while (total < size) {
+                const auto n = sock->get().vRecv(std::span{buffer}.subspan(total), size - total);
+                if (!n)
+                    break;
+                total += *n;
+            }
+            sock->get().vClose();
+        }
+        return total;
+    });
+
+    const std::vector<std::byte> data(size, std::byte{0x5a});
+    const auto start = std::chrono::steady_clock::now();
+    auto sock = sender.tcpConnect(sim.address("h2"), PORT);
+    if (!sock || !sock->get().vSend(std::span<const std::byte>{data})) {
+        listenSock->get().vClose();
+        return {};
+    }
+
+    Result result;
+    result.ok = received.wait_for(TIMEOUT) == std::future_status::ready && received.get() == size;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.fastRetransmits = sock->get().getFastRetransmits();
+    result.timeouts = sock->get().getRetransmitTimeouts();
+
+    sock->get().vClose();
+    listenSock->get().vClose();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::size_t size = (argc > 1 ? std::stoul(argv[1]) : 2048) * 1024;
+
+    const auto topology = sim::parseTopology(LINEAR_R1H2);
+    if (!topology) {
+        std::cerr << "bench_loss: " << topology.error() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "bench_loss: " << size / 1024 << " KiB per transfer, 10 ms RTT\n"
+              << "   cc    loss   goodput (KiB/s)   fast rtx   timeouts\n";
+
+    bool pass = true;
+    for (const auto algorithm : {tcp::CongestionAlgorithm::NEW_RENO, tcp::CongestionAlgorithm::CUBIC}) {
+        for (const auto loss : {0.0, 0.5, 1.0, 2.0, 5.0, 10.0}) {
+            // The stack logs every retransmission: keep the report readable
+            auto *const coutBuf = std::cout.rdbuf(nullptr);
+            const auto result = transfer(*topology, size, loss, algorithm);
+            std::cout.rdbuf(coutBuf);
+
+            pass = pass && result.ok;
+            std::ostringstream algorithmName;
+            algorithmName << algorithm;
+            std::cout << std::setw(6) << algorithmName.str() << std::setw(7) << std::fixed << std::setprecision(1)
+                      << loss << "%" << std::setw(18);
+            if (result.ok)
+                std::cout << static_cast<double>(size) / 1024 / result.seconds;
+            else
+                std::cout << "FAIL";
+            std::cout << std::setw(11) << result.fastRetransmits << std::setw(11) << result.timeouts << "\n";
+        }
+    }
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
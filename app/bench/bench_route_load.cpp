@@ -0,0 +1,98 @@
+// Startup cost of bulk-loading a large static routing table (`vhost/vrouter --routes <file>`).
+// Usage: bench_route_load [num-routes]   (default 100000)
+// Writes the routes as a text and a binary route file, loads each into a fresh host node, and fails
+// if either takes a second or more.
+
+#include <host_node.hpp>
+#include <ip/route_snapshot.hpp>
+
+#include <unistd.h>
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+using namespace tns;
+
+namespace {
+
+constexpr auto BUDGET = std::chrono::seconds(1);
+
+std::filesystem::path tempPath(const std::string &name)
+{
+    return std::filesystem::temp_directory_path() / (name + "." + std::to_string(::getpid()));
+}
+
+std::vector<ip::SnapshotRoute> makeRoutes(std::uint32_t n)
+{
+    std::vector<ip::SnapshotRoute> routes;
+    routes.reserve(n);
+    const ip::Ipv4Address gateway{"10.0.0.2"};
+    for (std::uint32_t i = 0; i < n; i++)
+        routes.push_back({0x0B000000 + (i << 8), 0xFFFFFF00, gateway, 0});  // 11.0.0.0/24, 11.0.1.0/24, ...
+    return routes;
+}
+
+void writeText(const std::filesystem::path &path, const std::vector<ip::SnapshotRoute> &routes)
+{
+    std::ofstream file(path);
+    file << "# bench_route_load\n";
+    for (const auto &route : routes) {
+        file << ip::Ipv4Address{ util::hton(route.address) }.toStringAddr() << "/24 via "
+             << route.gateway.toStringAddr() << "\n";
+    }
+}
+
+// Load the route file into a fresh one-interface host on loopback, returning the elapsed time
+std::chrono::duration<double, std::milli> timeLoad(int port, const std::filesystem::path &routeFile,
+                                                   std::size_t expected)
+{
+    const auto lnx = tempPath("bench_route_load.lnx");
+    std::ofstream(lnx) << "interface if0 10.0.0.1/24 127.0.0.1:" << port << "\n"
+                       << "neighbor 10.0.0.2 at 127.0.0.1:" << port + 1 << " via if0\n"
+                       << "routing static\n";
+    HostNode node{lnx.string()};
+    std::filesystem::remove(lnx);
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto loaded = node.loadStaticRoutes(routeFile.string());
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (!loaded || *loaded != expected) {
+        std::cerr << "bench_route_load: loading " << routeFile << " failed: "
+                  << (loaded ? std::to_string(*loaded) + " routes loaded" : loaded.error()) << "\n";
+        std::exit(EXIT_FAILURE);
+    }
+    return elapsed;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const std::uint32_t n = argc > 1 ? static_cast<std::uint32_t>(std::stoul(argv[1])) : 100'000;
+
+    const auto routes = makeRoutes(n);
+    const auto textFile = tempPath("bench_route_load.txt");
+    const auto binaryFile = tempPath("bench_route_load.bin");
+    writeText(textFile, routes);
+    if (const auto saved = ip::saveRouteSnapshot(binaryFile.string(), routes); !saved) {
+        std::cerr << "bench_route_load: " << saved.error() << "\n";
+        return EXIT_FAILURE;
+    }
+
+    const auto port = 40000 + ::getpid() % 20000;  // A fresh port per node
+    const auto text = timeLoad(port, textFile, n);
+    const auto binary = timeLoad(port + 2, binaryFile, n);
+
+    std::filesystem::remove(textFile);
+    std::filesystem::remove(binaryFile);
+
+    const auto pass = text < BUDGET && binary < BUDGET;
+    std::cout << "\nbench_route_load: " << n << " routes\n"
+              << "  text file:   " << text.count() << " ms\n"
+              << "  binary file: " << binary.count() << " ms\n"
+              << (pass ? "PASS" : "FAIL") << " (budget " << BUDGET.count() << " s each)\n";
+    return pass ? EXIT_SUCCESS : EXIT_FAILURE;
+}
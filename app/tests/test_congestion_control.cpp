@@ -0,0 +1,263 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/congestion_control.hpp>
+#include <tcp/buffers.hpp>
+#include <tcp/retransmission_queue.hpp>
+#include <util/scheduler.hpp>
+
+#include <chrono>
+#include <vector>
+
+using namespace tns;
+using namespace std::chrono_literals;
+using tcp::CongestionAlgorithm, tcp::NewReno, tcp::Cubic;
+
+namespace {
+
+constexpr std::size_t MSS = 1000;
+
+// Acknowledge a whole window, one segment per ACK
+void ackWindow(tcp::CongestionControl &cc, util::Clock::duration srtt = 100ms)
+{
+    for (auto left = cc.cwnd(); left >= MSS; left -= MSS)
+        cc.onAck(MSS, srtt);
+}
+
+} // namespace
+
+TEST_CASE("tcp::CongestionControl - Parse algorithm names") {
+    REQUIRE(tcp::parseCongestionAlgorithm("reno") == CongestionAlgorithm::NEW_RENO);
+    REQUIRE(tcp::parseCongestionAlgorithm("newreno") == CongestionAlgorithm::NEW_RENO);
+    REQUIRE(tcp::parseCongestionAlgorithm("cubic") == CongestionAlgorithm::CUBIC);
+    REQUIRE( !tcp::parseCongestionAlgorithm("bbr") );
+    REQUIRE(tcp::makeCongestionControl(CongestionAlgorithm::CUBIC, MSS)->algorithm() == CongestionAlgorithm::CUBIC);
+}
+
+TEST_CASE("tcp::NewReno - Slow start, AIMD and timeouts") {
+    NewReno reno{MSS};
+    REQUIRE(reno.cwnd() == 4 * MSS);
+    REQUIRE(reno.inSlowStart());
+
+    // Slow start doubles the window every round trip
+    ackWindow(reno);
+    REQUIRE(reno.cwnd() == 8 * MSS);
+    ackWindow(reno);
+    REQUIRE(reno.cwnd() == 16 * MSS);
+
+    // Multiplicative decrease, then one segment per round trip
+    reno.onLoss(16 * MSS);
+    REQUIRE(reno.ssthresh() == 8 * MSS);
+    REQUIRE(reno.cwnd() == 8 * MSS);
+    REQUIRE( !reno.inSlowStart() );
+    ackWindow(reno);
+    REQUIRE(reno.cwnd() == 9 * MSS);
+    ackWindow(reno);
+    REQUIRE(reno.cwnd() == 10 * MSS);
+
+    // A timeout restarts from one segment; a repeated one keeps the threshold
+    reno.onRetransmitTimeout(10 * MSS, false);
+    REQUIRE(reno.cwnd() == MSS);
+    REQUIRE(reno.ssthresh() == 5 * MSS);
+    reno.onRetransmitTimeout(MSS, true);
+    REQUIRE(reno.ssthresh() == 5 * MSS);
+
+    // The threshold never goes below 2 segments
+    reno.onLoss(MSS);
+    REQUIRE(reno.ssthresh() == 2 * MSS);
+}
+
+TEST_CASE("tcp::Cubic - Reduction and regrowth toward the last maximum") {
+    util::Scheduler scheduler;  // Cubic growth depends on the time since the reduction
+    Cubic cubic{MSS};
+
+    while (cubic.cwnd() < 100 * MSS)
+        ackWindow(cubic);
+    const auto wMax = cubic.cwnd();
+
+    cubic.onLoss(wMax);
+    REQUIRE(cubic.cwnd() == static_cast<std::size_t>(static_cast<double>(wMax) * Cubic::BETA));
+    REQUIRE( !cubic.inSlowStart() );
+
+    // Concave region: fast growth first, slowing down near the last maximum
+    std::vector<std::size_t> perRtt;
+    for (int rtt = 0; rtt < 60 && cubic.cwnd() < wMax; rtt++) {
+        const auto before = cubic.cwnd();
+        ackWindow(cubic);
+        scheduler.runFor(100ms);
+        perRtt.push_back(cubic.cwnd() - before);
+    }
+    REQUIRE(cubic.cwnd() >= wMax);
+    REQUIRE(perRtt.size() >= 3);
+    REQUIRE(perRtt[1] > perRtt[perRtt.size() - 2]);
+
+    // Convex region: probing past it speeds up again
+    const auto plateau = cubic.cwnd();
+    for (int rtt = 0; rtt < 40; rtt++) {
+        ackWindow(cubic);
+        scheduler.runFor(100ms);
+    }
+    REQUIRE(cubic.cwnd() > plateau + 10 * MSS);
+
+    // A loss below the last maximum gives way to other flows (fast convergence)
+    cubic.onRetransmitTimeout(cubic.cwnd(), false);
+    REQUIRE(cubic.cwnd() == MSS);
+    REQUIRE(cubic.ssthresh() >= 2 * MSS);
+}
+
+TEST_CASE("tcp::SendBuffer - Congestion window limits the data in flight") {
+    tcp::SendBuffer<1 << 16> sendBuffer{1000, 1 << 20, CongestionAlgorithm::NEW_RENO};
+    REQUIRE(sendBuffer.getCongestionAlgorithm() == CongestionAlgorithm::NEW_RENO);
+    REQUIRE(sendBuffer.getWndEndExclusive() == 1000 + (1 << 20));
+    REQUIRE(sendBuffer.getSendWndEndExclusive() == 1000 + sendBuffer.getCwnd());
+
+    sendBuffer.setCongestionAlgorithm(CongestionAlgorithm::CUBIC);
+    REQUIRE(sendBuffer.getCongestionAlgorithm() == CongestionAlgorithm::CUBIC);
+    REQUIRE(sendBuffer.getSendWndEndExclusive() == 1000 + sendBuffer.getCwnd());
+}
+
+TEST_CASE("tcp::SendBuffer - Fast retransmit and fast recovery") {
+    constexpr std::uint32_t WND = 1 << 15;
+    constexpr auto SEG = tcp::MAX_TCP_PAYLOAD_SIZE;
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    const std::vector<std::byte> data(WND);
+    REQUIRE(sendBuffer.write(std::span<const std::byte>{data}) == data.size());
+
+    // Sends what the window allows, returns the number of segments
+    const auto sendAll = [&sendBuffer] {
+        std::size_t n = 0;
+        for (; sendBuffer.takeReadyData(SEG); n++) {}
+        return n;
+    };
+    const auto dupAck = [&sendBuffer](std::uint32_t ack) { sendBuffer.onAck(ack, WND, /* pureAck= */ true); };
+
+    REQUIRE(sendAll() > 0);
+    sendBuffer.onAck(SEG, WND, true);
+    REQUIRE(sendAll() > 0);
+
+    // Limited transmit: one new segment for each of the first duplicate ACKs, the window is left alone
+    const auto cwnd = sendBuffer.getCwnd();
+    dupAck(SEG);
+    REQUIRE(sendAll() == 1);
+    dupAck(SEG);
+    REQUIRE(sendAll() == 1);
+    REQUIRE(sendBuffer.getCwnd() == cwnd);
+    REQUIRE( !sendBuffer.takeFastRetransmit() );
+
+    // Data segments and window updates are no duplicate ACKs
+    sendBuffer.onAck(SEG, WND, /* pureAck= */ false);
+    sendBuffer.onAck(SEG, WND - 1, true);
+    sendBuffer.onAck(SEG, WND, true);
+    REQUIRE( !sendBuffer.isInFastRecovery() );
+
+    // The third one: resend the first unacknowledged segment once, halve the window
+    const auto flight = sendBuffer.getSizeUnacked();
+    const auto recover = sendBuffer.getNxt();
+    dupAck(SEG);
+    REQUIRE(sendBuffer.isInFastRecovery());
+    REQUIRE(sendBuffer.takeFastRetransmit() == SEG);
+    REQUIRE( !sendBuffer.takeFastRetransmit() );
+    REQUIRE(sendBuffer.getSsthresh() == flight / 2);
+    REQUIRE(sendBuffer.getCwnd() == flight / 2);
+
+    // Further duplicate ACKs inflate the window until new data can go out
+    std::size_t sent = 0;
+    for (int i = 0; i < 20 && sent == 0; i++) {
+        dupAck(SEG);
+        sent = sendAll();
+    }
+    REQUIRE(sent > 0);
+
+    // A partial ACK resends the next hole at once, a full ACK ends the recovery
+    sendBuffer.onAck(3 * SEG, WND, true);
+    REQUIRE(sendBuffer.isInFastRecovery());
+    REQUIRE(sendBuffer.takeFastRetransmit() == 3 * SEG);
+    sendBuffer.onAck(recover, WND, true);
+    REQUIRE( !sendBuffer.isInFastRecovery() );
+    REQUIRE(sendBuffer.getCwnd() == flight / 2);
+    REQUIRE(sendBuffer.getFastRetransmits() == 2);
+
+    // After a timeout, the duplicate ACKs drawn by the resent segments do not trigger another reduction
+    REQUIRE(sendAll() > 0);
+    sendBuffer.onRetransmitTimeout();
+    const auto ssthresh = sendBuffer.getSsthresh();
+    for (std::size_t i = 0; i < tcp::DUPACK_THRESHOLD; i++)
+        dupAck(recover);
+    REQUIRE( !sendBuffer.isInFastRecovery() );
+    REQUIRE(sendBuffer.getSsthresh() == ssthresh);
+    REQUIRE(sendBuffer.getRetransmitTimeouts() == 1);
+}
+
+TEST_CASE("tcp::RtoEstimator - RFC 6298 estimates, minimum and backoff") {
+    using Rto = tcp::RetransmissionQueue::RtoEstimator;
+    Rto rto;
+    REQUIRE(rto.get() == Rto::INIT_RTO);
+
+    // The first sample sets SRTT = R and RTTVAR = R / 2, the next ones are smoothed
+    rto.addRttSample(100ms);
+    REQUIRE(rto.getSrtt() == 100ms);
+    REQUIRE(rto.getRttVar() == 50ms);
+    REQUIRE(rto.get() == 300ms);
+    rto.addRttSample(100ms);
+    REQUIRE(rto.getSrtt() == 100ms);
+    REQUIRE(rto.getRttVar() == 37500us);
+    REQUIRE(rto.get() == 250ms);
+
+    // A sample expected among many others weighs less
+    rto.addRttSample(200ms, 8);
+    REQUIRE(rto.getSrtt() > 100ms);
+    REQUIRE(rto.getSrtt() < 101600us);
+
+    // The RTO never goes below the minimum, nor above MAX_RTO when backing off
+    Rto fast;
+    fast.addRttSample(1ms);
+    REQUIRE(fast.get() == Rto::DEFAULT_MIN_RTO);
+    fast.setMinRto(5ms);
+    fast.addRttSample(1ms);
+    REQUIRE(fast.get() == 5ms);
+    fast.backoff();
+    REQUIRE(fast.get() == 10ms);
+    for (int i = 0; i < 20; i++)
+        fast.backoff();
+    REQUIRE(fast.get() == Rto::MAX_RTO);
+
+    // The next sample ends the backoff
+    fast.addRttSample(1ms);
+    REQUIRE(fast.get() == 5ms);
+}
+
+TEST_CASE("tcp::SendBuffer - A timeout backs off and resends everything in flight") {
+    constexpr std::uint32_t WND = 1 << 15;
+    constexpr auto SEG = tcp::MAX_TCP_PAYLOAD_SIZE;
+    const tcp::SessionTuple tuple{{ip::Ipv4Address{"10.0.0.1"}, tns::util::hton<in_port_t>(1234)},
+                                  {ip::Ipv4Address{"10.0.0.2"}, tns::util::hton<in_port_t>(80)}};
+    util::Scheduler scheduler;  // Entries expire in virtual time
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    const std::vector<std::byte> data(4 * SEG);
+    REQUIRE(sendBuffer.write(std::span<const std::byte>{data}) == data.size());
+
+    const auto send = [&](std::size_t n) {
+        for (std::size_t i = 0; i < n; i++) {
+            const auto ready = sendBuffer.takeReadyData(SEG);
+            REQUIRE(ready.has_value());
+            (void)sendBuffer.retransmitQueue.enqueue(
+                tcp::Packet::makeAckPacket(tuple, ready->seq, 0, 0, std::make_unique<Payload>(ready->payload.size())));
+        }
+    };
+    const auto expired = [&sendBuffer] {
+        auto entries = sendBuffer.retransmitQueue.getExpiredEntries(WND);
+        REQUIRE(entries.has_value());
+        return entries->second.size();
+    };
+
+    // Two segments sent before the others: only they expire
+    send(2);
+    scheduler.runFor(600ms);
+    send(2);
+    scheduler.runFor(500ms);
+    const auto rto = sendBuffer.retransmitQueue.rto.get();
+
+    // The timeout doubles the RTO and resends the newer segments too, without waiting for them to expire
+    sendBuffer.onRetransmitTimeout();
+    REQUIRE(sendBuffer.retransmitQueue.rto.get() == 2 * rto);
+    REQUIRE(expired() == 4);
+    REQUIRE(expired() == 0);
+}
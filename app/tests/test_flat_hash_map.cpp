@@ -0,0 +1,76 @@
+#include "catch_amalgamated.hpp"
+#include <util/flat_hash_map.hpp>
+#include <tcp/session_tuple.hpp>
+
+#include <string>
+#include <unordered_map>
+
+using namespace tns;
+using tns::util::FlatHashMap;
+
+TEST_CASE("util::FlatHashMap - Insert, find, erase") {
+    FlatHashMap<int, std::string> map;
+    REQUIRE(map.empty());
+    REQUIRE(map.find(1) == map.end());
+
+    REQUIRE(map.try_emplace(1, "one").second);
+    REQUIRE(map.emplace(2, std::string{"two"}).second);
+    REQUIRE_FALSE(map.try_emplace(1, "uno").second);  // Existing key is kept
+    REQUIRE(map.size() == 2);
+    REQUIRE(map.find(1)->second == "one");
+    REQUIRE(map.contains(2));
+
+    REQUIRE(map.erase(1) == 1);
+    REQUIRE(map.erase(1) == 0);
+    REQUIRE_FALSE(map.contains(1));
+    REQUIRE(map.size() == 1);
+}
+
+TEST_CASE("util::FlatHashMap - Matches std::unordered_map under churn") {
+    FlatHashMap<std::uint32_t, std::uint32_t> map;
+    std::unordered_map<std::uint32_t, std::uint32_t> ref;
+
+    // Insert and erase overlapping key ranges so tombstones and rehashes are exercised
+    for (std::uint32_t round = 0; round < 20; ++round) {
+        for (std::uint32_t k = round * 50; k < round * 50 + 200; ++k) {
+            map.try_emplace(k, k * 3);
+            ref.try_emplace(k, k * 3);
+        }
+        for (std::uint32_t k = round * 50; k < round * 50 + 150; k += 2) {
+            REQUIRE(map.erase(k) == ref.erase(k));
+        }
+        REQUIRE(map.size() == ref.size());
+    }
+
+    std::size_t n = 0;
+    for (const auto &[k, v] : map) {
+        REQUIRE(ref.at(k) == v);
+        ++n;
+    }
+    REQUIRE(n == ref.size());
+
+    for (auto it = map.begin(); it != map.end(); )
+        it = (it->first % 3 == 0) ? map.erase(it) : std::next(it);
+    for (const auto &[k, _] : ref)
+        REQUIRE(map.contains(k) == (k % 3 != 0));
+}
+
+TEST_CASE("tcp::SessionTuple - Packed flow key") {
+    using tns::util::hton;
+    const tcp::SessionTuple a{{ip::Ipv4Address{"10.0.0.1"}, hton<in_port_t>(1000)},
+                              {ip::Ipv4Address{"10.0.0.2"}, hton<in_port_t>(80)}};
+    auto b = a;
+    b.localPort = hton<in_port_t>(1001);  // Differs only in a port
+
+    STATIC_REQUIRE(sizeof(tcp::SessionTuple) == 12);
+    REQUIRE(a.local().getPortHost() == 1000);
+    REQUIRE(a.remote().toString() == "10.0.0.2:80");
+    REQUIRE(a != b);
+    REQUIRE(std::hash<tcp::SessionTuple>{}(a) != std::hash<tcp::SessionTuple>{}(b));
+
+    FlatHashMap<tcp::SessionTuple, int> sessions;
+    sessions.try_emplace(a, 1);
+    sessions.try_emplace(b, 2);
+    REQUIRE(sessions.find(a)->second == 1);
+    REQUIRE(sessions.find(b)->second == 2);
+}
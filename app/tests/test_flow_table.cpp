@@ -0,0 +1,96 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/flow_table.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace tns;
+using tcp::FlowTable, tcp::SessionTuple;
+
+namespace {
+
+// Flows between one pair of hosts, told apart by their ports only
+SessionTuple makeTuple(std::uint32_t i)
+{
+    return {
+        /*  local= */ {ip::Ipv4Address{"10.0.0.1"}, util::hton(static_cast<in_port_t>(9000 + i % 8))},
+        /* remote= */ {ip::Ipv4Address{"10.2.0.2"}, util::hton(static_cast<in_port_t>(20000 + i / 8))}
+    };
+}
+
+} // namespace
+
+TEST_CASE("tcp::FlowTable - Insert, find and erase") {
+    FlowTable<int> table;
+    std::vector<int> values(1000);
+    for (std::uint32_t i = 0; i < values.size(); i++) {
+        values[i] = static_cast<int>(i);
+        REQUIRE(table.insert(makeTuple(i), values[i]));
+    }
+    REQUIRE( !table.insert(makeTuple(7), values[0]) );
+    REQUIRE(table.size() == 1000);
+
+    for (std::uint32_t i = 0; i < values.size(); i++)
+        REQUIRE(table.find(makeTuple(i)) == &values[i]);
+    REQUIRE(table.find(makeTuple(5000)) == nullptr);
+
+    // The last hit of this thread is dropped with its flow
+    REQUIRE(table.find(makeTuple(42)) == &values[42]);
+    REQUIRE(table.find(makeTuple(42)) == &values[42]);
+    table.erase(makeTuple(42));
+    REQUIRE(table.find(makeTuple(42)) == nullptr);
+    REQUIRE(table.size() == 999);
+
+    int other = -1;
+    REQUIRE(table.insert(makeTuple(42), other));
+    REQUIRE(table.find(makeTuple(42)) == &other);
+}
+
+TEST_CASE("tcp::FlowTable - Tables do not share their last hits") {
+    FlowTable<int> a, b;
+    int x = 1, y = 2;
+    REQUIRE(a.insert(makeTuple(0), x));
+    REQUIRE(a.find(makeTuple(0)) == &x);
+    REQUIRE(b.find(makeTuple(0)) == nullptr);
+    REQUIRE(b.insert(makeTuple(0), y));
+    REQUIRE(b.find(makeTuple(0)) == &y);
+    REQUIRE(a.find(makeTuple(0)) == &x);
+}
+
+TEST_CASE("tcp::FlowTable - Lookups under connection churn") {
+    constexpr std::uint32_t STABLE = 512, CHURN = 512;
+    FlowTable<std::uint32_t> table;
+    std::vector<std::uint32_t> values(STABLE + CHURN);
+    for (std::uint32_t i = 0; i < values.size(); i++)
+        values[i] = i;
+    for (std::uint32_t i = 0; i < STABLE; i++)
+        table.insert(makeTuple(i), values[i]);
+
+    std::atomic<bool> done{false};
+    std::atomic<int> errors{0};
+    std::vector<std::jthread> readers;
+    for (int r = 0; r < 4; r++) {
+        readers.emplace_back([&, r] {
+            for (std::uint32_t n = 0; !done; n++) {
+                const auto i = (n / 4 + static_cast<std::uint32_t>(r) * 97) % STABLE;  // A few hits in a row each
+                const auto *value = table.find(makeTuple(i));
+                if (!value || *value != i)
+                    errors++;
+            }
+        });
+    }
+
+    // Connections come and go on the same shards as the stable ones
+    for (int round = 0; round < 50; round++) {
+        for (std::uint32_t i = STABLE; i < STABLE + CHURN; i++)
+            REQUIRE(table.insert(makeTuple(i), values[i]));
+        for (std::uint32_t i = STABLE; i < STABLE + CHURN; i++)
+            table.erase(makeTuple(i));
+    }
+    done = true;
+    readers.clear();
+
+    REQUIRE(errors == 0);
+    REQUIRE(table.size() == STABLE);
+}
@@ -0,0 +1,198 @@
+#include "catch_amalgamated.hpp"
+#include <sim/impairment.hpp>
+#include <ip/datagram.hpp>
+#include <util/scheduler.hpp>
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+using namespace tns;
+using namespace tns::sim;
+using namespace std::chrono_literals;
+using util::Clock;
+
+namespace {
+
+DatagramPtr makeDatagram(std::uint8_t tag, std::size_t payloadSize = 80)
+{
+    auto payload = std::make_unique<Payload>(payloadSize, std::byte{tag});
+    return std::make_unique<ip::Datagram>(ip::Ipv4Address{"10.0.0.1"}, ip::Ipv4Address{"10.0.0.2"},
+                                          std::move(payload), ip::Protocol::TEST);
+}
+
+const ip::Ipv4Address NEXT_HOP{"10.0.0.2"};
+
+// Records what the impairment lets through, with the (virtual) time it did
+struct Wire {
+    struct Sent {
+        std::uint8_t tag;
+        Clock::time_point time;
+    };
+
+    LinkImpairment::Transmit transmit()
+    {
+        return [this](const ip::Datagram &datagram, const ip::Ipv4Address &) {
+            std::lock_guard lock(mutex);
+            sent.push_back({std::to_integer<std::uint8_t>(datagram.getPayloadView()[0]), Clock::now()});
+        };
+    }
+
+    std::mutex mutex;
+    std::vector<Sent> sent;
+};
+
+Impairment parse(std::string_view settings)
+{
+    auto impairment = parseImpairment(settings);
+    REQUIRE(impairment.has_value());
+    return *impairment;
+}
+
+} // namespace
+
+TEST_CASE("sim::parseImpairment") {
+    const auto impairment = parse("loss 2.5% burst 3 delay 40ms jitter 500us reorder 0.1 duplicate 1% rate 8mbit limit 50 seed 7");
+    REQUIRE(impairment.loss == Catch::Approx(0.025));
+    REQUIRE(impairment.burst == 3);
+    REQUIRE(impairment.delay == 40ms);
+    REQUIRE(impairment.jitter == 500us);
+    REQUIRE(impairment.reorder == Catch::Approx(0.1));
+    REQUIRE(impairment.duplicate == Catch::Approx(0.01));
+    REQUIRE(impairment.rate == 1'000'000);
+    REQUIRE(impairment.limit == 50);
+    REQUIRE(impairment.seed == 7);
+    REQUIRE(impairment.isActive());
+
+    REQUIRE(parse("rate 2kbps").rate == 2000);
+    REQUIRE( !parse("off").isActive() );
+
+    REQUIRE( !parseImpairment("") );
+    REQUIRE( !parseImpairment("loss") );
+    REQUIRE( !parseImpairment("loss 150%") );
+    REQUIRE( !parseImpairment("delay 40") );
+    REQUIRE( !parseImpairment("rate 10furlongs") );
+    REQUIRE( !parseImpairment("color blue") );
+}
+
+TEST_CASE("sim::LinkImpairment - In virtual time") {
+    util::Scheduler scheduler;
+    Wire wire;
+    LinkImpairment impairment{wire.transmit()};
+    REQUIRE( !impairment.isActive() );
+
+    const auto sendAll = [&](int n) {
+        for (int i = 0; i < n; i++)
+            impairment.send(makeDatagram(static_cast<std::uint8_t>(i)), NEXT_HOP);
+        scheduler.runFor(10s);
+    };
+
+    SECTION("Random loss is reproducible") {
+        impairment.configure(parse("loss 30% seed 42"));
+        sendAll(10000);
+        REQUIRE(wire.sent.size() == Catch::Approx(7000).margin(300));
+        REQUIRE(impairment.getStats().dropped + wire.sent.size() == 10000);
+
+        std::vector<std::uint8_t> first;
+        for (const auto &sent : wire.sent)
+            first.push_back(sent.tag);
+
+        wire.sent.clear();
+        impairment.configure(parse("loss 30% seed 42"));
+        sendAll(10000);
+        std::vector<std::uint8_t> second;
+        for (const auto &sent : wire.sent)
+            second.push_back(sent.tag);
+        REQUIRE(first == second);
+    }
+
+    SECTION("Bursty loss keeps the loss rate") {
+        impairment.configure(parse("loss 10% burst 5"));
+        std::vector<bool> lost;
+        for (int i = 0; i < 20000; i++) {
+            const auto before = impairment.getStats().dropped.load();
+            impairment.send(makeDatagram(0), NEXT_HOP);
+            lost.push_back(impairment.getStats().dropped > before);
+        }
+        std::size_t losses = 0, bursts = 0;
+        for (std::size_t i = 0; i < lost.size(); i++) {
+            losses += lost[i];
+            bursts += lost[i] && (i == 0 || !lost[i - 1]);
+        }
+        REQUIRE(static_cast<double>(losses) / 20000 == Catch::Approx(0.1).margin(0.02));
+        REQUIRE(static_cast<double>(losses) / static_cast<double>(bursts) == Catch::Approx(5).margin(1));
+    }
+
+    SECTION("Delay and jitter") {
+        const auto start = Clock::now();
+        impairment.configure(parse("delay 40ms jitter 10ms"));
+        sendAll(100);
+        REQUIRE(wire.sent.size() == 100);
+        for (const auto &sent : wire.sent) {
+            REQUIRE(sent.time - start >= 30ms);
+            REQUIRE(sent.time - start <= 50ms);
+        }
+    }
+
+    SECTION("Reordering sends some datagrams ahead") {
+        impairment.configure(parse("delay 40ms reorder 25%"));
+        sendAll(400);
+        REQUIRE(wire.sent.size() == 400);
+        const auto reordered = impairment.getStats().reordered.load();
+        REQUIRE(reordered == Catch::Approx(100).margin(40));
+        // The ones sent right away come first
+        REQUIRE(wire.sent[reordered - 1].time < wire.sent[reordered].time);
+    }
+
+    SECTION("Rate limit serializes datagrams") {
+        impairment.configure(parse("rate 1000bps"));  // 100-byte datagrams: one every 100ms
+        const auto start = Clock::now();
+        sendAll(5);
+        REQUIRE(wire.sent.size() == 5);
+        for (std::size_t i = 0; i < 5; i++)
+            REQUIRE(wire.sent[i].time - start == std::chrono::milliseconds(100 * (i + 1)));
+    }
+
+    SECTION("An overloaded rate limit keeps its rate") {
+        impairment.configure(parse("rate 1000bps limit 5"));  // One 100-byte datagram every 100ms
+        const auto start = Clock::now();
+        for (int i = 0; i < 1000; i++) {  // Ten times what the link carries
+            impairment.send(makeDatagram(0), NEXT_HOP);
+            scheduler.runFor(10ms);
+        }
+        std::size_t carried = 0;
+        for (const auto &sent : wire.sent)
+            carried += sent.time - start <= 10s;
+        REQUIRE(carried == Catch::Approx(100).margin(2));
+        REQUIRE(impairment.getStats().overLimit >= 890);
+    }
+
+    SECTION("Duplication and the queue limit") {
+        impairment.configure(parse("duplicate 100%"));
+        sendAll(10);
+        REQUIRE(wire.sent.size() == 20);
+        REQUIRE(impairment.getStats().duplicated == 10);
+
+        wire.sent.clear();
+        impairment.configure(parse("delay 1s limit 4"));
+        sendAll(10);
+        REQUIRE(wire.sent.size() == 4);
+        REQUIRE(impairment.getStats().overLimit == 6);
+    }
+}
+
+TEST_CASE("sim::LinkImpairment - Delay in real time") {
+    Wire wire;
+    std::promise<void> arrived;
+    LinkImpairment impairment{[&](const ip::Datagram &datagram, const ip::Ipv4Address &nextHop) {
+        wire.transmit()(datagram, nextHop);
+        arrived.set_value();
+    }};
+    impairment.configure(parse("delay 30ms"));
+
+    const auto start = Clock::now();
+    impairment.send(makeDatagram(1), NEXT_HOP);
+    REQUIRE(arrived.get_future().wait_for(5s) == std::future_status::ready);
+    REQUIRE(wire.sent.at(0).time - start >= 30ms);
+}
@@ -0,0 +1,138 @@
+#include "catch_amalgamated.hpp"
+#include <ip/link_state.hpp>
+
+#include <map>
+#include <random>
+
+using namespace tns;
+using namespace tns::ip;
+
+namespace {
+
+// A topology of routers 1..n, each advertising its own /24, that pushes LSAs into a database rooted at router 1
+class Topology {
+public:
+    explicit Topology(RouterId n) : lsdb_(1)
+    {
+        for (RouterId id = 1; id <= n; id++)
+            links_[id];
+    }
+
+    void setLink(RouterId a, RouterId b, std::uint32_t cost)
+    {
+        links_[a][b] = cost;
+        links_[b][a] = cost;
+        advertise(a);
+        advertise(b);
+    }
+
+    void removeLink(RouterId a, RouterId b)
+    {
+        links_[a].erase(b);
+        links_[b].erase(a);
+        advertise(a);
+        advertise(b);
+    }
+
+    void advertise(RouterId id)
+    {
+        Lsa lsa{id, ++seqs_[id], {}, {prefix(id)}};
+        for (const auto &[neighbor, cost] : links_[id])
+            lsa.links.push_back({neighbor, cost});
+        lsdb_.install(std::move(lsa), changes_);
+    }
+
+    void withdraw(RouterId id) { lsdb_.remove(id, changes_); }
+
+    static LsaPrefix prefix(RouterId id) { return {0x0A000000 | (id << 8), 0xFFFFFF00}; }
+
+    LinkStateDatabase &lsdb() { return lsdb_; }
+    LinkStateDatabase::RouteChanges &changes() { return changes_; }
+
+private:
+    std::map<RouterId, std::map<RouterId, std::uint32_t>> links_;
+    std::map<RouterId, std::uint32_t> seqs_;
+    LinkStateDatabase lsdb_;
+    LinkStateDatabase::RouteChanges changes_;
+};
+
+// Costs must match a from-scratch SPF. (First hops may differ between equal-cost paths.)
+void requireSameCosts(const LinkStateDatabase::Routes &incremental, const LinkStateDatabase::Routes &full)
+{
+    REQUIRE(incremental.size() == full.size());
+    for (const auto &[prefix, route] : full) {
+        const auto it = incremental.find(prefix);
+        REQUIRE(it != incremental.end());
+        REQUIRE(it->second.cost == route.cost);
+    }
+}
+
+} // namespace
+
+TEST_CASE("ip::LinkStateDatabase - Line") {
+    Topology topo{4};
+    topo.setLink(1, 2, 1);
+    topo.setLink(2, 3, 1);
+    topo.setLink(3, 4, 1);
+
+    auto routes = topo.lsdb().getRoutes();
+    REQUIRE(routes.size() == 3);  // Own prefix is a local route
+    REQUIRE(routes.at(Topology::prefix(4)) == LinkStateDatabase::Route{2, 3});
+
+    SECTION("Cheaper shortcut") {
+        topo.setLink(1, 4, 1);
+        REQUIRE(topo.lsdb().getRoutes().at(Topology::prefix(4)) == LinkStateDatabase::Route{4, 1});
+        REQUIRE(topo.lsdb().getRoutes().at(Topology::prefix(3)).cost == 2);
+    }
+
+    SECTION("Broken link withdraws routes behind it") {
+        topo.changes().clear();
+        topo.removeLink(2, 3);
+        REQUIRE(topo.lsdb().getRoutes().size() == 1);
+        REQUIRE(topo.changes().size() == 2);
+        for (const auto &change : topo.changes())
+            REQUIRE( !change.route );
+    }
+
+    SECTION("One-way link is not used") {
+        topo.setLink(1, 4, 1);
+        topo.withdraw(4);
+        REQUIRE( !topo.lsdb().getRoutes().contains(Topology::prefix(4)) );
+        REQUIRE(topo.lsdb().getRoutes().at(Topology::prefix(3)).cost == 2);
+    }
+
+    SECTION("Prefix-only change does not run SPF") {
+        const auto runs = topo.lsdb().getStats().incrementalRuns;
+        topo.advertise(3);
+        REQUIRE(topo.lsdb().getStats().incrementalRuns == runs);
+        REQUIRE(topo.lsdb().getStats().prefixOnlyUpdates == 1);
+    }
+}
+
+TEST_CASE("ip::LinkStateDatabase - Incremental SPF matches full SPF") {
+    constexpr RouterId N = 30;
+    std::mt19937 rng{168};
+    std::uniform_int_distribution<RouterId> router{1, N};
+    std::uniform_int_distribution<std::uint32_t> cost{1, 5};
+
+    Topology topo{N};
+    for (RouterId id = 1; id < N; id++)
+        topo.setLink(id, id + 1, cost(rng));
+    requireSameCosts(topo.lsdb().getRoutes(), topo.lsdb().computeRoutesFromScratch());
+
+    for (int step = 0; step < 500; step++) {
+        const auto a = router(rng), b = router(rng);
+        if (a == b)
+            continue;
+        switch (rng() % 4) {
+            case 0: topo.removeLink(a, b); break;
+            case 1: topo.withdraw(a); break;
+            default: topo.setLink(a, b, cost(rng)); break;
+        }
+        requireSameCosts(topo.lsdb().getRoutes(), topo.lsdb().computeRoutesFromScratch());
+    }
+
+    // Changes far from the root should not re-settle the whole tree every time
+    const auto &stats = topo.lsdb().getStats();
+    REQUIRE(stats.nodesRelaxed < stats.incrementalRuns * N);
+}
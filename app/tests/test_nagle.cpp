@@ -0,0 +1,94 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/buffers.hpp>
+
+#include <vector>
+
+using namespace tns;
+
+namespace {
+
+constexpr std::uint32_t SEG = tcp::MAX_TCP_PAYLOAD_SIZE;
+constexpr std::uint32_t WND = 1 << 15;
+
+// Bytes of the next segment sent, 0 if none is
+std::size_t sendOne(tcp::SendBuffer<1 << 16> &sendBuffer)
+{
+    const auto ready = sendBuffer.takeReadyData(SEG);
+    return ready ? ready->payload.size() : 0;
+}
+
+void write(tcp::SendBuffer<1 << 16> &sendBuffer, std::size_t size)
+{
+    const std::vector<std::byte> data(size, std::byte{0x5a});
+    REQUIRE(sendBuffer.write(std::span<const std::byte>{data}) == size);
+}
+
+} // namespace
+
+TEST_CASE("tcp::SendBuffer - Nagle's algorithm") {
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    sendBuffer.onAck(0, WND);
+    REQUIRE( !sendBuffer.isNoDelay() );
+
+    // Nothing in flight: a small write goes at once
+    write(sendBuffer, 100);
+    REQUIRE(sendOne(sendBuffer) == 100);
+
+    // The next small writes wait for its ACK, unless they add up to a full segment
+    write(sendBuffer, 100);
+    write(sendBuffer, 100);
+    REQUIRE( !sendBuffer.hasReadyData(SEG) );
+    REQUIRE(sendOne(sendBuffer) == 0);
+    write(sendBuffer, SEG);
+    REQUIRE(sendOne(sendBuffer) == SEG);
+    REQUIRE(sendOne(sendBuffer) == 0);
+
+    // The ACK of everything in flight sends the rest together
+    sendBuffer.onAck(100 + SEG, WND);
+    REQUIRE(sendOne(sendBuffer) == 200);
+
+    // Without it, small writes go at once
+    sendBuffer.setNoDelay(true);
+    write(sendBuffer, 10);
+    REQUIRE(sendOne(sendBuffer) == 10);
+    write(sendBuffer, 10);
+    REQUIRE(sendOne(sendBuffer) == 10);
+}
+
+TEST_CASE("tcp::SendBuffer - Cork") {
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    sendBuffer.onAck(0, WND);
+    sendBuffer.setNoDelay(true);
+    sendBuffer.setCork(true);
+
+    // Corked: only full segments, even with nothing in flight
+    write(sendBuffer, 1000);
+    REQUIRE(sendOne(sendBuffer) == 0);
+    write(sendBuffer, 1000);
+    REQUIRE(sendOne(sendBuffer) == SEG);
+    REQUIRE(sendOne(sendBuffer) == 0);
+
+    // Uncorking sends the rest
+    sendBuffer.setCork(false);
+    REQUIRE(sendOne(sendBuffer) == 2000 - SEG);
+}
+
+TEST_CASE("tcp::SendBuffer - Silly window syndrome avoidance") {
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    sendBuffer.onAck(0, 1000);  // A receiver with a small buffer
+    sendBuffer.setNoDelay(true);
+    write(sendBuffer, 4 * SEG);
+    REQUIRE(sendOne(sendBuffer) == 1000);
+
+    // Half the largest window offered is worth a segment while data is in flight...
+    sendBuffer.onAck(500, 1000);
+    REQUIRE(sendOne(sendBuffer) == 500);
+
+    // ... a sliver of it is not
+    sendBuffer.onAck(600, 1000);
+    REQUIRE(sendOne(sendBuffer) == 0);
+
+    // With nothing in flight, whatever fits goes, as no ACK would come to send the rest
+    sendBuffer.onAck(1500, 100);
+    REQUIRE(sendOne(sendBuffer) == 100);
+}
@@ -0,0 +1,76 @@
+// Included before Catch2, whose <cmath> defines an INFINITY macro that clashes with RipMessage::INFINITY
+#include <ip/rip_message.hpp>
+
+namespace {
+constexpr auto RIP_INFINITY = tns::ip::RipMessage::INFINITY;
+} // namespace
+
+#include "catch_amalgamated.hpp"
+
+using namespace tns;
+using namespace tns::ip;
+
+namespace {
+
+RipMessage makeTable(std::size_t n, const Ipv4Address &neighbor)
+{
+    RipMessage::Entries entries;
+    RipMessage::OptionalAddresses learnedFrom;
+    for (std::uint32_t i = 0; i < n; i++) {
+        entries.push_back({.cost = i % 15, .address = 0x0A000000 | (i << 8), .mask = 0xFFFFFF00});
+        learnedFrom.push_back(i % 3 == 0 ? std::optional{neighbor} : std::nullopt);  // Every 3rd learned from neighbor
+    }
+    return RipMessage::makeResponse(std::move(entries), std::move(learnedFrom));
+}
+
+} // namespace
+
+TEST_CASE("ip::RipEncoding - Request") {
+    const RipEncoding encoding{RipMessage::makeRequest()};
+    REQUIRE(encoding.getNumMessages() == 1);
+
+    const auto payloads = encoding.makePayloads(Ipv4Address{"10.0.0.1"});
+    const auto view = RipMessageView::parse(*payloads.front());
+    REQUIRE(view.has_value());
+    REQUIRE(view->getCommand() == RipMessage::Command::REQUEST);
+    REQUIRE(view->getNumEntries() == 0);
+}
+
+TEST_CASE("ip::RipEncoding - Split and poisoned reverse") {
+    const Ipv4Address neighbor{"10.1.0.2"};
+    const Ipv4Address other{"10.3.0.2"};
+    const auto table = makeTable(150, neighbor);
+    const RipEncoding encoding{table};
+
+    REQUIRE(encoding.getNumMessages() == 3);  // 64 + 64 + 22
+    REQUIRE(encoding.getNumEntries() == 150);
+
+    for (const auto &dest : {neighbor, other}) {
+        std::size_t i = 0;
+        for (const auto &payload : encoding.makePayloads(dest)) {
+            const auto view = RipMessageView::parse(*payload);
+            REQUIRE(view.has_value());
+            REQUIRE(view->getCommand() == RipMessage::Command::RESPONSE);
+            REQUIRE(view->getNumEntries() <= RipMessage::MAX_ENTRIES_PER_MESSAGE);
+
+            for (const auto entry : *view) {
+                const auto &expected = table.getEntries()[i];
+                const bool poisoned = dest == neighbor && table.getLearnedFrom()[i].has_value();
+                REQUIRE(entry.cost == (poisoned ? RIP_INFINITY : expected.cost));
+                REQUIRE(entry.address == expected.address);
+                REQUIRE(entry.mask == expected.mask);
+                i++;
+            }
+        }
+        REQUIRE(i == 150);
+    }
+}
+
+TEST_CASE("ip::RipMessageView - Malformed payloads") {
+    const auto payloads = RipEncoding{makeTable(10, Ipv4Address{"10.1.0.2"})}.makePayloads(Ipv4Address{});
+    const auto &payload = *payloads.front();
+
+    REQUIRE( RipMessageView::parse(payload) );
+    REQUIRE( !RipMessageView::parse(PayloadView{payload}.first(3)) );                    // Truncated header
+    REQUIRE( !RipMessageView::parse(PayloadView{payload}.first(payload.size() - 1)) );   // Truncated entry
+}
@@ -0,0 +1,42 @@
+#include "catch_amalgamated.hpp"
+#include <ip/route_file.hpp>
+
+#include <filesystem>
+
+using namespace tns;
+using namespace tns::ip;
+
+TEST_CASE("ip::parseRouteText") {
+    SECTION("Routes, comments and blank lines") {
+        const auto routes = parseRouteText("# static routes\n"
+                                           "10.2.0.0/16 via 10.0.0.2\n"
+                                           "\n"
+                                           "  192.168.7.9/24\t10.0.0.3   # host bits are cleared\r\n"
+                                           "0.0.0.0/0 via 10.0.0.1", "routes.txt");
+        REQUIRE(routes.has_value());
+        REQUIRE(routes->size() == 3);
+        REQUIRE((*routes)[0] == SnapshotRoute{0x0A020000, 0xFFFF0000, Ipv4Address{"10.0.0.2"}, 0});
+        REQUIRE((*routes)[1] == SnapshotRoute{0xC0A80700, 0xFFFFFF00, Ipv4Address{"10.0.0.3"}, 0});
+        REQUIRE((*routes)[2] == SnapshotRoute{0, 0, Ipv4Address{"10.0.0.1"}, 0});
+    }
+
+    SECTION("Errors name the line") {
+        for (const auto *text : {"10.0.0.0/33 via 10.0.0.1", "10.0.0/24 via 10.0.0.1",
+                                 "10.0.0.0/24 via", "10.0.0.0/24 via 10.0.0.1 extra"}) {
+            const auto routes = parseRouteText(std::string("\n") + text, "routes.txt");
+            REQUIRE( !routes );
+            REQUIRE(routes.error().starts_with("routes.txt:2:"));
+        }
+    }
+}
+
+TEST_CASE("ip::loadRouteFile - Binary snapshot") {
+    const auto path = (std::filesystem::temp_directory_path() / "tns_test_route_file.bin").string();
+    const std::vector<SnapshotRoute> routes{{0x0A020000, 0xFFFF0000, Ipv4Address{"10.0.0.2"}, 3}};
+    REQUIRE(saveRouteSnapshot(path, routes).has_value());
+
+    const auto loaded = loadRouteFile(path);
+    REQUIRE(loaded.has_value());
+    REQUIRE(*loaded == routes);
+    std::filesystem::remove(path);
+}
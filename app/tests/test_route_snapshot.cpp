@@ -0,0 +1,54 @@
+#include "catch_amalgamated.hpp"
+#include <ip/route_snapshot.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace tns;
+using namespace tns::ip;
+
+namespace {
+
+std::string tempPath(const std::string &name)
+{
+    return (std::filesystem::temp_directory_path() / name).string();
+}
+
+} // namespace
+
+TEST_CASE("ip::RouteSnapshot - Round trip") {
+    const auto path = tempPath("tns_test_route_snapshot.bin");
+
+    std::vector<SnapshotRoute> routes;
+    for (std::uint32_t i = 0; i < 1000; i++)
+        routes.push_back({0x0A000000 | (i << 8), 0xFFFFFF00, Ipv4Address{"10.1.0.2"}, 1 + i % 15});
+
+    REQUIRE(saveRouteSnapshot(path, routes).has_value());
+    REQUIRE( !std::filesystem::exists(path + ".tmp") );
+    REQUIRE(std::filesystem::file_size(path) == 12 + routes.size() * 16);
+
+    const auto loaded = loadRouteSnapshot(path);
+    REQUIRE(loaded.has_value());
+    REQUIRE(*loaded == routes);
+
+    SECTION("Empty snapshot") {
+        REQUIRE(saveRouteSnapshot(path, {}).has_value());
+        REQUIRE(loadRouteSnapshot(path)->empty());
+    }
+
+    SECTION("Truncated snapshot is rejected") {
+        std::filesystem::resize_file(path, 12 + 10 * 16 + 3);
+        REQUIRE( !loadRouteSnapshot(path) );
+    }
+
+    SECTION("Foreign file is rejected") {
+        std::ofstream(path, std::ios::trunc) << "not a snapshot at all";
+        REQUIRE( !loadRouteSnapshot(path) );
+    }
+
+    std::filesystem::remove(path);
+}
+
+TEST_CASE("ip::RouteSnapshot - Missing file") {
+    REQUIRE( !loadRouteSnapshot(tempPath("tns_test_route_snapshot_missing.bin")) );
+}
@@ -0,0 +1,168 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/buffers.hpp>
+#include <tcp/retransmission_queue.hpp>
+#include <util/scheduler.hpp>
+
+#include <chrono>
+#include <vector>
+
+using namespace tns;
+using namespace std::chrono_literals;
+using tcp::SackBlock;
+
+namespace {
+
+constexpr std::uint32_t SEG = tcp::MAX_TCP_PAYLOAD_SIZE;
+
+const tcp::SessionTuple TUPLE{{ip::Ipv4Address{"10.0.0.1"}, tns::util::hton<in_port_t>(1234)},
+                         {ip::Ipv4Address{"10.0.0.2"}, tns::util::hton<in_port_t>(80)}};
+
+tcp::Packet makeSegment(std::uint32_t seq, std::size_t size = SEG)
+{
+    return tcp::Packet::makeAckPacket(TUPLE, seq, 0, 0, std::make_unique<Payload>(size));
+}
+
+std::optional<std::uint32_t> nextHole(tcp::RetransmissionQueue &queue, std::uint32_t una)
+{
+    if (auto hole = queue.retransmitNextHole(una))
+        return hole->second.get().packet.getSeqNumHost();
+    return std::nullopt;
+}
+
+} // namespace
+
+TEST_CASE("tcp::RecvBuffer - SACK blocks") {
+    tcp::RecvBuffer<1 << 16> recvBuffer{0};
+    const Payload data(100);
+    const auto sackBlocks = [&recvBuffer] {
+        tcp::TcpOptions options;
+        recvBuffer.addSackBlocks(options);
+        return std::vector<SackBlock>(options.sack().begin(), options.sack().end());
+    };
+
+    REQUIRE(sackBlocks().empty());
+
+    // The block holding the latest arrival comes first, then the others from the highest
+    recvBuffer.onRecv(1000, data);
+    recvBuffer.onRecv(3000, data);
+    recvBuffer.onRecv(2000, data);
+    recvBuffer.onRecv(1100, data);
+    REQUIRE(sackBlocks() == std::vector<SackBlock>{{1000, 1200}, {3000, 3100}, {2000, 2100}});
+
+    // Blocks below the cumulative ACK are not reported anymore
+    recvBuffer.onRecv(0, Payload(1000));
+    REQUIRE(recvBuffer.getNxt() == 1200);
+    REQUIRE(sackBlocks() == std::vector<SackBlock>{{3000, 3100}, {2000, 2100}});
+}
+
+TEST_CASE("tcp::RetransmissionQueue - SACK scoreboard") {
+    util::Scheduler scheduler;  // Entries expire in virtual time
+    tcp::RetransmissionQueue queue;
+    for (std::uint32_t i = 0; i < 8; i++)
+        (void)queue.enqueue(makeSegment(i * SEG));
+    queue.beginRecovery();
+
+    // The first segment is lost once a duplicate ACK says so, the others only below enough SACKed data
+    queue.onSack(std::vector<SackBlock>{{SEG, 2 * SEG}});
+    REQUIRE(nextHole(queue, 0) == 0);
+    REQUIRE( !queue.hasHole(0) );
+
+    queue.onSack(std::vector<SackBlock>{{SEG, 2 * SEG}, {3 * SEG, 6 * SEG}});
+    REQUIRE(queue.hasHole(0));
+    REQUIRE(nextHole(queue, 0) == 2 * SEG);
+    REQUIRE( !nextHole(queue, 0) );
+
+    // A new recovery may resend the same holes again
+    queue.beginRecovery();
+    REQUIRE(nextHole(queue, 0) == 0);
+
+    // SACKed segments are not resent on a timeout
+    scheduler.runFor(2s);
+    auto expired = queue.getExpiredEntries(8 * SEG);
+    REQUIRE(expired.has_value());
+    std::vector<std::uint32_t> seqs;
+    for (const auto &entry : expired->second)
+        seqs.push_back(entry.get().packet.getSeqNumHost());
+    REQUIRE(seqs == std::vector<std::uint32_t>{0, 2 * SEG, 6 * SEG, 7 * SEG});
+}
+
+TEST_CASE("tcp::RetransmissionQueue - Holes of a large window") {
+    constexpr std::uint32_t N = 1500;
+    tcp::RetransmissionQueue queue;
+    for (std::uint32_t i = 0; i < N; i++)
+        (void)queue.enqueue(makeSegment(i * SEG));
+    queue.beginRecovery();
+
+    // Every other segment is lost: each hole with more than two SACKed segments above it is resent, in order
+    std::vector<SackBlock> blocks;
+    for (std::uint32_t i = 1; i < N; i += 2)
+        blocks.push_back({i * SEG, (i + 1) * SEG});
+    queue.onSack(blocks);
+
+    std::vector<std::uint32_t> holes, expected;
+    while (const auto hole = nextHole(queue, 0))
+        holes.push_back(*hole);
+    for (std::uint32_t i = 0; i < N - 4; i += 2)
+        expected.push_back(i * SEG);
+    REQUIRE(holes == expected);
+
+    // Past the half of the window acknowledged, one more SACK above the last hole left makes it lost
+    queue.onAck(N / 2 * SEG);
+    REQUIRE( !queue.hasHole(N / 2 * SEG) );
+    queue.onSack(std::vector<SackBlock>{{(N - 2) * SEG, (N - 1) * SEG}});
+    REQUIRE(nextHole(queue, N / 2 * SEG) == (N - 4) * SEG);
+    REQUIRE( !nextHole(queue, N / 2 * SEG) );
+}
+
+TEST_CASE("tcp::SendBuffer - SACK recovery resends every hole") {
+    constexpr std::uint32_t WND = 1 << 15;
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    const std::vector<std::byte> data(WND);
+    REQUIRE(sendBuffer.write(std::span<const std::byte>{data}) == data.size());
+
+    // Sends what the window allows, keeping the segments for retransmission as the socket does
+    std::vector<std::uint32_t> sent;  // Sequence numbers of the segments sent
+    const auto sendAll = [&sendBuffer, &sent] {
+        while (auto ready = sendBuffer.takeReadyData(SEG)) {
+            sent.push_back(ready->seq);
+            (void)sendBuffer.retransmitQueue.enqueue(makeSegment(ready->seq, ready->payload.size()));
+        }
+    };
+    // The SACK block of segments [first, last]
+    const auto segments = [&](std::size_t first, std::size_t last) {
+        return SackBlock{sent[first], last + 1 < sent.size() ? sent[last + 1] : sendBuffer.getNxt()};
+    };
+
+    sendAll();
+    const auto una = sent[1];
+    sendBuffer.onAck(una, WND, true);
+    sendAll();
+    const auto dupAck = [&sendBuffer, una](std::vector<SackBlock> blocks) {
+        tcp::TcpOptions options;
+        for (const auto &block : blocks)
+            options.addSack(block);
+        sendBuffer.onAck(una, WND, /* pureAck= */ true, options);
+    };
+
+    // Segments 1 and 3 are lost: the third duplicate ACK resends the first one
+    dupAck({segments(2, 2)});
+    sendAll();
+    dupAck({segments(4, 4), segments(2, 2)});
+    sendAll();
+    dupAck({segments(4, 5), segments(2, 2)});
+    REQUIRE(sendBuffer.isInFastRecovery());
+    REQUIRE(sendBuffer.takeFastRetransmit() == una);
+    REQUIRE(nextHole(sendBuffer.retransmitQueue, una) == sent[1]);
+    REQUIRE( !sendBuffer.takeFastRetransmit() );
+
+    // Once enough data above it is SACKed, the next duplicate ACK resends the second one, without a partial ACK
+    dupAck({segments(4, sent.size() - 1), segments(2, 2)});
+    REQUIRE(sendBuffer.takeFastRetransmit());
+    REQUIRE(nextHole(sendBuffer.retransmitQueue, una) == sent[3]);
+    REQUIRE(sendBuffer.getFastRetransmits() == 2);
+
+    // No hole left: duplicate ACKs inflate the window again
+    dupAck({segments(4, sent.size() - 1), segments(2, 2)});
+    REQUIRE( !sendBuffer.takeFastRetransmit() );
+    REQUIRE(sendBuffer.getFastRetransmits() == 2);
+}
@@ -0,0 +1,90 @@
+#include "catch_amalgamated.hpp"
+#include <util/scheduler.hpp>
+#include <util/periodic_thread.hpp>
+#include <tcp/states.hpp>
+#include <tcp/retransmission_queue.hpp>
+
+#include <chrono>
+#include <vector>
+
+using namespace tns;
+using namespace std::chrono_literals;
+using util::Clock, util::Scheduler;
+
+TEST_CASE("util::Scheduler - Event order and virtual time") {
+    Scheduler scheduler;
+    const auto start = scheduler.now();
+    REQUIRE(Clock::scheduler() == &scheduler);
+    REQUIRE(Clock::now() == start);
+
+    std::vector<int> order;
+    scheduler.scheduleAfter(2s, [&] { order.push_back(3); });
+    scheduler.scheduleAfter(1s, [&] { order.push_back(1); REQUIRE(Clock::now() == start + 1s); });
+    scheduler.scheduleAfter(1s, [&] { order.push_back(2); });  // Same time: runs in scheduling order
+    const auto cancelled = scheduler.scheduleAfter(1500ms, [&] { order.push_back(-1); });
+    REQUIRE(scheduler.cancel(cancelled));
+    REQUIRE( !scheduler.cancel(cancelled) );
+
+    // Events scheduled by events run in the same pass if they are due
+    scheduler.scheduleAfter(2500ms, [&] { scheduler.scheduleAfter(100ms, [&] { order.push_back(4); }); });
+
+    REQUIRE(scheduler.runUntil(start + 1s) == 2);
+    REQUIRE(order == std::vector{1, 2});
+    REQUIRE(scheduler.runFor(9s) == 3);
+    REQUIRE(order == std::vector{1, 2, 3, 4});
+    REQUIRE(scheduler.now() == start + 10s);  // Left at the end of the interval
+    REQUIRE(scheduler.pending() == 0);
+    REQUIRE( !scheduler.runNext() );
+
+    // Only one scheduler may drive the clock
+    REQUIRE_THROWS_AS(Scheduler{}, std::runtime_error);
+}
+
+TEST_CASE("util::Scheduler - Clock goes back to real time") {
+    {
+        Scheduler scheduler;
+        scheduler.runFor(24h);
+    }
+    REQUIRE(Clock::scheduler() == nullptr);
+    const auto before = std::chrono::steady_clock::now();
+    const auto now = Clock::now();
+    REQUIRE(now >= before);
+    REQUIRE(now - before < 1h);
+}
+
+TEST_CASE("util::Scheduler - Timers run in virtual time") {
+    Scheduler scheduler;
+    const auto realStart = std::chrono::steady_clock::now();
+
+    SECTION("PeriodicThread runs as events") {
+        int runs = 0;
+        util::threading::PeriodicThread periodic{1s, [&] { runs++; }};
+        scheduler.runFor(10s);
+        REQUIRE(runs == 10);
+
+        periodic.stop();
+        scheduler.runFor(10s);
+        REQUIRE(runs == 10);
+        REQUIRE(scheduler.pending() == 0);
+    }
+
+    SECTION("TIME_WAIT expires") {
+        tcp::states::TimeWait timeWait;
+        scheduler.runFor(9s);
+        REQUIRE( !timeWait.isExpired() );
+        scheduler.runFor(2s);
+        REQUIRE(timeWait.isExpired());
+    }
+
+    SECTION("Retransmission timestamps") {
+        tcp::RetransmissionQueue::Entry entry{tcp::Packet{}, Clock::now()};
+        scheduler.runFor(300ms);
+        REQUIRE(entry.getRtt(Clock::now()) == 300ms);
+        REQUIRE( !entry.hasExpired(Clock::now(), 500ms) );
+        scheduler.runFor(300ms);
+        REQUIRE(entry.hasExpired(Clock::now(), 500ms));
+    }
+
+    // None of the above waited for real
+    REQUIRE(std::chrono::steady_clock::now() - realStart < 5s);
+}
@@ -0,0 +1,582 @@
+// Included before Catch2, whose <cmath> defines an INFINITY macro that clashes with RipMessage::INFINITY
+#include <router_node.hpp>
+#include <host_node.hpp>
+
+#include "catch_amalgamated.hpp"
+#include <sim/impairment.hpp>
+#include <sim/simulator.hpp>
+#include <sim/memory_link.hpp>
+#include <ip/route_snapshot.hpp>
+#include <ip/datagram.hpp>
+#include <util/scheduler.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <future>
+#include <sstream>
+#include <thread>
+
+using namespace tns;
+using namespace tns::sim;
+
+namespace {
+
+DatagramPtr makeDatagram(std::uint8_t tag)
+{
+    auto payload = std::make_unique<Payload>(1, std::byte{tag});
+    return std::make_unique<ip::Datagram>(ip::Ipv4Address{"10.0.0.1"}, ip::Ipv4Address{"10.0.0.2"},
+                                          std::move(payload), ip::Protocol::TEST);
+}
+
+// nets/linear-r2h2.json
+constexpr auto LINEAR_R2H2 = R"({
+    "nodes": [
+        {"name": "h1", "type": "host"},
+        {"name": "r1", "type": "router"},
+        {"name": "r2", "type": "router"},
+        {"name": "h2", "type": "host"}
+    ],
+    "networks": [
+        {"name": "h1-r1", "links": ["h1", "r1"]},
+        {"name": "r1-r2", "links": ["r1", "r2"]},
+        {"name": "r2-h2", "links": ["r2", "h2"]}
+    ]
+})";
+
+// Cost of a router's route to a prefix, from its JSON dump; -1 if it has none
+int routeCost(const RouterNode &router, const std::string &prefix)
+{
+    std::stringstream ss;
+    router.dumpJson(ss);
+    const auto json = ss.str();
+    const auto pos = json.find("\"prefix\":\"" + prefix + "\"");
+    if (pos == std::string::npos)
+        return -1;
+    const auto cost = json.find("\"cost\":", pos) + 7;
+    return json.compare(cost, 4, "null") == 0 ? 0 : std::stoi(json.substr(cost));
+}
+
+// Wait for RIP to teach a router the route to a prefix
+void waitForRoute(const RouterNode &router, const std::string &prefix)
+{
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        std::stringstream ss;
+        router.dumpJson(ss);
+        if (ss.str().find("\"" + prefix + "\"") != std::string::npos)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
+
+} // namespace
+
+TEST_CASE("sim::MemoryPort") {
+    SECTION("FIFO order") {
+        MemoryPort port;
+        for (std::uint8_t i = 0; i < 10; i++)
+            REQUIRE(port.push(makeDatagram(i)));
+        for (std::uint8_t i = 0; i < 10; i++)
+            REQUIRE(port.pop()->getPayloadView()[0] == std::byte{i});
+    }
+
+    SECTION("Many producers, one consumer") {
+        constexpr int PRODUCERS = 4, PER_PRODUCER = 2000;
+        MemoryPort port;
+        std::vector<std::jthread> producers;
+        for (int p = 0; p < PRODUCERS; p++) {
+            producers.emplace_back([&port, p] {
+                for (int i = 0; i < PER_PRODUCER; i++)
+                    port.push(makeDatagram(static_cast<std::uint8_t>(p)));
+            });
+        }
+
+        std::array<int, PRODUCERS> counts{};
+        for (int i = 0; i < PRODUCERS * PER_PRODUCER; i++)
+            counts[std::to_integer<std::size_t>(port.pop()->getPayloadView()[0])]++;
+        REQUIRE(counts == std::array<int, PRODUCERS>{PER_PRODUCER, PER_PRODUCER, PER_PRODUCER, PER_PRODUCER});
+    }
+
+    SECTION("Closing wakes a blocked consumer and drops later datagrams") {
+        MemoryPort port;
+        auto popped = std::async(std::launch::async, [&port] { return port.pop(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        port.close();
+        REQUIRE(popped.get() == nullptr);
+        REQUIRE( !port.push(makeDatagram(0)) );
+    }
+}
+
+TEST_CASE("sim::parseTopology") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    REQUIRE(topology->nodes.size() == 4);
+    REQUIRE(topology->nodes[1].name == "r1");
+    REQUIRE(topology->nodes[1].isRouter);
+    REQUIRE( !topology->nodes[0].isRouter );
+    REQUIRE(topology->networks.size() == 3);
+    REQUIRE(topology->networks[1].links == std::vector<std::string>{"r1", "r2"});
+
+    REQUIRE( !parseTopology(R"({"nodes": [], "networks": [)") );
+    REQUIRE( !parseTopology(R"({"nodes": [{"name": "x", "type": "switch"}], "networks": []})") );
+    REQUIRE( !parseTopology(R"({"nodes": [], "networks": [{"name": "n", "links": ["ghost"]}]})") );
+}
+
+TEST_CASE("sim::Simulator - TCP transfer over two routers") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    REQUIRE(sim.size() == 4);
+
+    // Addresses as vnet_generate assigns them
+    REQUIRE(sim.address("h1") == ip::Ipv4Address{"10.0.0.1"});
+    REQUIRE(sim.address("r1", 1) == ip::Ipv4Address{"10.1.0.1"});
+    REQUIRE(sim.address("h2") == ip::Ipv4Address{"10.2.0.2"});
+    REQUIRE_THROWS_AS(sim.router("h1"), std::out_of_range);
+
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+
+    constexpr std::size_t SIZE = 512 * 1024;
+    constexpr in_port_t PORT = 9000;
+    std::vector<std::byte> sent(SIZE);
+    for (std::size_t i = 0; i < SIZE; i++)
+        sent[i] = static_cast<std::byte>((i * 131) >> 3);
+
+    auto &receiver = sim.host("h2");
+    auto listenSock = receiver.tcpListen(PORT);
+    REQUIRE(listenSock.has_value());
+
+    auto received = std::async(std::launch::async, [&listenSock] {
+        std::vector<std::byte> buffer(SIZE);
+        auto sock = listenSock->get().vAccept();
+        if (!sock)
+            return buffer;
+        for (std::size_t total = 0; total < SIZE; ) {
+            const auto n = sock->get().vRecv(std::span{buffer}.subspan(total), SIZE - total);
+            if (!n)
+                break;
+            total += *n;
+        }
+        sock->get().vClose();
+        return buffer;
+    });
+
+    auto sock = sim.host("h1").tcpConnect(sim.address("h2"), PORT);
+    REQUIRE(sock.has_value());
+    const auto nSent = sock->get().vSend(std::span<const std::byte>{sent});
+    REQUIRE(nSent.has_value());
+    REQUIRE(*nSent == SIZE);
+
+    REQUIRE(received.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    REQUIRE(received.get() == sent);
+    REQUIRE(sock->get().isSackPermitted());
+    REQUIRE(sock->get().getRecvWndShift() == tcp::RECV_WINDOW_SHIFT);
+    REQUIRE(sock->get().getSendWndShift() == tcp::RECV_WINDOW_SHIFT);
+    REQUIRE(sock->get().hasTimestamps());
+    REQUIRE(sock->get().getRto() < tcp::RetransmissionQueue::RtoEstimator::INIT_RTO);  // Sampled from the ACKs
+    sock->get().vClose();
+    listenSock->get().vClose();
+}
+
+TEST_CASE("sim::Simulator - Closing sends the data left before the FIN") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+
+    // Full segments, then a tail that Nagle's algorithm holds back while they are in flight
+    constexpr std::size_t SIZE = 64 * tcp::MAX_TCP_PAYLOAD_SIZE + 100;
+    constexpr in_port_t PORT = 9006;
+    std::vector<std::byte> sent(SIZE);
+    for (std::size_t i = 0; i < SIZE; i++)
+        sent[i] = static_cast<std::byte>((i * 131) >> 3);
+
+    auto listenSock = sim.host("h2").tcpListen(PORT);
+    REQUIRE(listenSock.has_value());
+
+    // Reads until the end of the stream
+    auto received = std::async(std::launch::async, [&listenSock] {
+        std::vector<std::byte> buffer;
+        auto sock = listenSock->get().vAccept();
+        if (!sock)
+            return std::make_pair(buffer, SocketError::CONN_NOT_EXIST);
+        std::vector<std::byte> chunk(4096);
+        while (true) {
+            const auto n = sock->get().vRecv(std::span{chunk}, chunk.size());
+            if (!n)
+                return std::make_pair(buffer, n.error());
+            buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + static_cast<std::ptrdiff_t>(*n));
+        }
+    });
+
+    auto sock = sim.host("h1").tcpConnect(sim.address("h2"), PORT);
+    REQUIRE(sock.has_value());
+    REQUIRE(sock->get().vSend(std::span<const std::byte>{sent}) == SIZE);
+    REQUIRE(sock->get().vClose().has_value());
+
+    REQUIRE(received.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    const auto [buffer, error] = received.get();
+    REQUIRE(buffer.size() == SIZE);
+    REQUIRE(buffer == sent);
+    REQUIRE(error == SocketError::CLOSING);
+    listenSock->get().vClose();
+}
+
+TEST_CASE("sim::Simulator - Sending a file over a slow link") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+
+    // Slow enough that much of the file is still unacknowledged when the sender is done writing it
+    const auto impairment = parseImpairment("rate 16mbit");
+    REQUIRE(impairment.has_value());
+    REQUIRE(sim.host("h1").setImpairment("if0", *impairment));
+
+    constexpr std::size_t SIZE = 3 * 1024 * 1024;
+    constexpr in_port_t PORT = 9007;
+    const auto dir = std::filesystem::temp_directory_path();
+    const auto inPath = (dir / "tns_test_send_file.in").string();
+    const auto outPath = (dir / "tns_test_send_file.out").string();
+    std::string content(SIZE, '\0');
+    for (std::size_t i = 0; i < SIZE; i++)
+        content[i] = static_cast<char>((i * 131) >> 3);
+    std::ofstream{inPath, std::ios::binary} << content;
+
+    auto &receiver = sim.host("h2");
+    auto received = std::async(std::launch::async, [&receiver, &outPath] { return receiver.tcpRecvFile(outPath, PORT); });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    for (std::stringstream ss; ss.str().find("LISTEN") == std::string::npos && std::chrono::steady_clock::now() < deadline; ) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ss.str("");
+        receiver.tcpListSockets(ss);
+    }
+
+    REQUIRE(sim.host("h1").tcpSendFile(inPath, sim.address("h2"), PORT) == SIZE);
+    REQUIRE(received.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    REQUIRE(received.get() == SIZE);
+
+    std::ifstream file{outPath, std::ios::binary};
+    const std::string written{std::istreambuf_iterator<char>(file), {}};
+    REQUIRE(written == content);
+    std::filesystem::remove(inPath);
+    std::filesystem::remove(outPath);
+}
+
+TEST_CASE("sim::Simulator - Bulk-loaded static routes") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    auto &r1 = sim.router("r1");
+    waitForRoute(r1, "10.2.0.0/24");
+    const auto ripCost = routeCost(r1, "10.2.0.0/24");
+    REQUIRE(ripCost > 0);
+
+    // h1 is a neighbor of r1, 10.9.9.9 is on none of its subnets
+    const auto path = (std::filesystem::temp_directory_path() / "tns_test_bulk_routes.txt").string();
+    std::ofstream(path) << "172.16.0.0/16 via 10.0.0.1\n"
+                        << "172.17.0.0/16 via 10.9.9.9\n"
+                        << "10.2.0.0/24 via 10.0.0.1\n";
+    const auto loaded = r1.loadStaticRoutes(path);
+    std::filesystem::remove(path);
+
+    REQUIRE(loaded == std::size_t{1});
+    REQUIRE(routeCost(r1, "172.16.0.0/16") == 0);  // Static: no cost
+    REQUIRE(routeCost(r1, "172.17.0.0/16") == -1);
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == ripCost);  // The route learned by RIP is kept
+}
+
+TEST_CASE("sim::Simulator - Closed sockets are reaped") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    auto &client = sim.host("h1");
+    auto &server = sim.host("h2");
+
+    // Sockets listed by a host, without the header line
+    const auto countSockets = [](const HostNode &host) {
+        std::stringstream ss;
+        host.tcpListSockets(ss);
+        const auto lines = std::count(std::istreambuf_iterator<char>(ss), {}, '\n');
+        return lines - 1;
+    };
+
+    constexpr in_port_t PORT = 9001;
+    auto listenSock = server.tcpListen(PORT);
+    REQUIRE(listenSock.has_value());
+    const auto listenId = listenSock->get().getID();
+    auto accepted = std::async(std::launch::async, [&listenSock] { return listenSock->get().vAccept(); });
+
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+    auto sock = client.tcpConnect(sim.address("h2"), PORT);
+    REQUIRE(sock.has_value());
+    REQUIRE(accepted.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    auto serverSock = accepted.get();
+    REQUIRE(serverSock.has_value());
+    REQUIRE(countSockets(server) == 2);
+
+    REQUIRE(client.tcpAbort(sock->get().getID()).has_value());
+    REQUIRE(serverSock->get().vAbort().has_value());
+    REQUIRE(listenSock->get().vClose().has_value());
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while ((countSockets(client) > 0 || countSockets(server) > 0) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    REQUIRE(countSockets(client) == 0);
+    REQUIRE(countSockets(server) == 0);
+
+    // The ids are free again
+    auto relisten = server.tcpListen(PORT);
+    REQUIRE(relisten.has_value());
+    REQUIRE(relisten->get().getID() == listenId);
+    relisten->get().vClose();
+}
+
+TEST_CASE("sim::Simulator - Window scaling and timestamps need both ends") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    auto &client = sim.host("h1");
+    auto &server = sim.host("h2");
+    server.tcpSetWindowScalingEnabled(false);
+    server.tcpSetTimestampsEnabled(false);
+
+    constexpr in_port_t PORT = 9002;
+    auto listenSock = server.tcpListen(PORT);
+    REQUIRE(listenSock.has_value());
+    auto accepted = std::async(std::launch::async, [&listenSock] { return listenSock->get().vAccept(); });
+
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+    auto sock = client.tcpConnect(sim.address("h2"), PORT);
+    REQUIRE(sock.has_value());
+    REQUIRE(accepted.wait_for(std::chrono::seconds(10)) == std::future_status::ready);
+    auto serverSock = accepted.get();
+    REQUIRE(serverSock.has_value());
+
+    // The client offered them, the server did not accept: windows are plain 16-bit fields both ways, no timestamps
+    REQUIRE(sock->get().getSendWndShift() == 0);
+    REQUIRE(sock->get().getRecvWndShift() == 0);
+    REQUIRE(serverSock->get().getSendWndShift() == 0);
+    REQUIRE(serverSock->get().getRecvWndShift() == 0);
+    REQUIRE( !sock->get().hasTimestamps() );
+    REQUIRE( !serverSock->get().hasTimestamps() );
+
+    sock->get().vClose();
+    serverSock->get().vClose();
+    listenSock->get().vClose();
+}
+
+TEST_CASE("sim::Simulator - Delayed ACKs") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    auto &sender = sim.host("h1");
+    auto &receiver = sim.host("h2");
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+
+    // Sends `SIZE` bytes, returns the pure ACKs the receiver sent for them
+    constexpr std::size_t SIZE = 256 * 1024;
+    const std::vector<std::byte> sent(SIZE, std::byte{0x5a});
+    const auto transfer = [&](in_port_t port) -> std::size_t {
+        auto listenSock = receiver.tcpListen(port);
+        REQUIRE(listenSock.has_value());
+        auto received = std::async(std::launch::async, [&listenSock] {
+            std::vector<std::byte> buffer(SIZE);
+            std::size_t total = 0;
+            auto sock = listenSock->get().vAccept();
+            while (sock && total < SIZE) {
+                const auto n = sock->get().vRecv(std::span{buffer}.subspan(total), SIZE - total);
+                if (!n)
+                    break;
+                total += *n;
+            }
+            return std::make_pair(total, sock ? sock->get().getPureAcksSent() : 0);
+        });
+
+        auto sock = sender.tcpConnect(sim.address("h2"), port);
+        REQUIRE(sock.has_value());
+        REQUIRE(sock->get().vSend(std::span<const std::byte>{sent}) == SIZE);
+        REQUIRE(received.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+        const auto [total, pureAcks] = received.get();
+        REQUIRE(total == SIZE);
+        sock->get().vClose();
+        listenSock->get().vClose();
+        return pureAcks;
+    };
+
+    // Without delayed ACKs, every data segment gets its own ACK
+    receiver.tcpSetDelayedAck(false);
+    const auto everySegment = transfer(9003);
+    REQUIRE(everySegment >= SIZE / tcp::MAX_TCP_PAYLOAD_SIZE);
+
+    // With them, at most one for two segments past the first ones
+    receiver.tcpSetDelayedAck(true);
+    const auto delayed = transfer(9004);
+    REQUIRE(delayed > 0);
+    REQUIRE(delayed <= (everySegment + tcp::QUICK_ACK_SEGMENTS) / 2);
+}
+
+TEST_CASE("sim::Simulator - Reading a socket in place") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    Simulator sim{*topology};
+    waitForRoute(sim.router("r1"), "10.2.0.0/24");
+
+    // More than the receive buffer, so that the views wrap around its end
+    constexpr std::size_t SIZE = 3 * 1024 * 1024;
+    constexpr in_port_t PORT = 9005;
+    std::vector<std::byte> sent(SIZE);
+    for (std::size_t i = 0; i < SIZE; i++)
+        sent[i] = static_cast<std::byte>((i * 131) >> 3);
+
+    auto listenSock = sim.host("h2").tcpListen(PORT);
+    REQUIRE(listenSock.has_value());
+
+    auto received = std::async(std::launch::async, [&listenSock] {
+        std::vector<std::byte> buffer;
+        auto sock = listenSock->get().vAccept();
+        if (!sock)
+            return buffer;
+        while (buffer.size() < SIZE) {
+            const auto view = sock->get().vRecvView();
+            if (!view)
+                break;
+            buffer.insert(buffer.end(), view->head.begin(), view->head.end());
+            buffer.insert(buffer.end(), view->tail.begin(), view->tail.end());
+            if (sock->get().vConsume(view->size()) != view->size())
+                break;
+        }
+        sock->get().vClose();
+        return buffer;
+    });
+
+    auto sock = sim.host("h1").tcpConnect(sim.address("h2"), PORT);
+    REQUIRE(sock.has_value());
+    REQUIRE(sock->get().vSend(std::span<const std::byte>{sent}) == SIZE);
+
+    REQUIRE(received.wait_for(std::chrono::seconds(30)) == std::future_status::ready);
+    REQUIRE(received.get() == sent);
+    sock->get().vClose();
+    listenSock->get().vClose();
+}
+
+TEST_CASE("sim::Simulator - RIP in virtual time") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    const auto realStart = std::chrono::steady_clock::now();
+
+    // Counters of both routers after startup and after r2 loses its link to h2
+    const auto run = [&topology] {
+        util::Scheduler scheduler;
+        Simulator sim{*topology};
+        auto &r1 = sim.router("r1"), &r2 = sim.router("r2");
+
+        scheduler.runFor(std::chrono::seconds(1));
+        REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);  // Learned from r2
+
+        // r2 advertises its downed interface's route as it does over UDP; r1 keeps it while r2 refreshes it
+        r2.disableInterface("if1");
+        scheduler.runFor(std::chrono::minutes(2));
+        REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);
+
+        std::vector<std::uint64_t> counters;
+        for (const auto *router : {&r1, &r2}) {
+            const auto &stats = router->getRipStats();
+            counters.insert(counters.end(), {stats.messagesSent.load(), stats.entriesSent.load(),
+                                             stats.messagesRecv.load(), stats.triggeredUpdates.load()});
+        }
+        return counters;
+    };
+
+    // Two virtual minutes replay the exact same exchange, without waiting for them
+    const auto first = run();
+    REQUIRE(first[0] >= 12);  // At least a full periodic update every 10 seconds
+    REQUIRE(run() == first);
+    REQUIRE(std::chrono::steady_clock::now() - realStart < std::chrono::seconds(30));
+}
+
+TEST_CASE("sim::Simulator - RIP incremental and triggered updates") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    util::Scheduler scheduler;
+    Simulator sim{*topology};
+    auto &r1 = sim.router("r1"), &r2 = sim.router("r2");
+    const auto &stats = r1.getRipStats();
+
+    // What r1 sends to r2, its only RIP neighbor, over the next `duration`: (messages, entries)
+    const auto sentOver = [&](auto duration) {
+        const auto messages = stats.messagesSent.load();
+        const auto entries = stats.entriesSent.load();
+        scheduler.runFor(duration);
+        return std::make_pair(stats.messagesSent - messages, stats.entriesSent - entries);
+    };
+
+    // Periodic rounds at 5s, 10s, 15s, ...: the whole table in the 1st, 3rd, ..., the changed routes in the others
+    scheduler.runFor(std::chrono::seconds(1));
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);
+    const auto full = sentOver(std::chrono::seconds(5));
+    REQUIRE(full.first == 1);
+    REQUIRE(full.second == 3);  // Its two subnets and the one behind r2
+    REQUIRE(stats.periodicFull == 1);
+
+    // Nothing changed: the incremental round at 10s sends nothing, the full one at 15s everything
+    REQUIRE(sentOver(std::chrono::seconds(10)) == full);
+    REQUIRE(stats.periodicFull == 2);
+    REQUIRE(stats.periodicIncremental == 1);
+
+    // r2 loses then regains its link to h2 at once: both changes reach r1 within one damping window, and r1 passes
+    // on only the last one, in a single triggered update
+    const auto triggered = stats.triggeredUpdates.load();
+    const auto routesTriggered = stats.routesTriggered.load();
+    const auto coalesced = stats.routesCoalesced.load();
+    r2.disableInterface("if1");
+    r2.enableInterface("if1");
+    scheduler.runFor(std::chrono::seconds(1));
+    REQUIRE(stats.triggeredUpdates - triggered == 1);
+    REQUIRE(stats.routesTriggered - routesTriggered == 2);
+    REQUIRE(stats.routesCoalesced - coalesced == 1);
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);
+
+    // The incremental round at 20s carries the changed route only
+    REQUIRE(sentOver(std::chrono::seconds(4)) == std::make_pair(std::uint64_t{1}, std::uint64_t{1}));
+    REQUIRE(stats.periodicIncremental == 2);
+}
+
+TEST_CASE("sim::Simulator - Warm start from a route snapshot") {
+    const auto topology = parseTopology(LINEAR_R2H2);
+    REQUIRE(topology.has_value());
+    util::Scheduler scheduler;
+    Simulator sim{*topology};
+    auto &r1 = sim.router("r1");
+
+    // Saved by an earlier run: the route behind r2 at a stale cost, and one r2 no longer has
+    const auto path = (std::filesystem::temp_directory_path() / "tns_test_warm_start.bin").string();
+    const auto viaR2 = sim.address("r2");
+    REQUIRE(ip::saveRouteSnapshot(path, {{0x0A020000, 0xFFFFFF00, viaR2, 5},
+                                         {0xAC140000, 0xFFFF0000, viaR2, 2}}).has_value());
+
+    // Both are usable right away, before RIP has said anything
+    r1.enableRouteSnapshots(path);
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == 5);
+    REQUIRE(routeCost(r1, "172.20.0.0/16") == 2);
+
+    // r2 re-announces the first: confirmed, at the cost it announces
+    scheduler.runFor(std::chrono::seconds(1));
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);
+    REQUIRE(routeCost(r1, "172.20.0.0/16") == 2);
+
+    // The other is never confirmed: withdrawn after RIP_PROVISIONAL_TIME, while the confirmed one stays
+    scheduler.runFor(std::chrono::seconds(10));
+    REQUIRE(routeCost(r1, "172.20.0.0/16") == -1);
+    REQUIRE(routeCost(r1, "10.2.0.0/24") == 1);
+
+    // The next snapshot has only the confirmed route
+    scheduler.runFor(std::chrono::seconds(30));
+    const auto saved = ip::loadRouteSnapshot(path);
+    REQUIRE(saved.has_value());
+    REQUIRE(*saved == std::vector<ip::SnapshotRoute>{{0x0A020000, 0xFFFFFF00, viaR2, 1}});
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,57 @@
+#include "catch_amalgamated.hpp"
+#include <util/slab.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace tns;
+using util::Slab;
+
+TEST_CASE("util::Slab - Acquire, construct and erase") {
+    Slab<std::string, 4> slab{10};
+
+    std::vector<Slab<std::string, 4>::Handle> handles;
+    for (int i = 0; i < 6; i++) {
+        const auto handle = slab.acquire();
+        REQUIRE(handle == static_cast<std::uint32_t>(i));
+        REQUIRE(slab.get(*handle) == nullptr);  // Acquired, not constructed yet
+        slab.construct(*handle, std::to_string(i));
+        handles.push_back(*handle);
+    }
+    REQUIRE(slab.size() == 6);
+
+    // Objects do not move when the slab grows
+    auto *three = slab.get(3);
+    REQUIRE(*three == "3");
+    for (int i = 0; i < 4; i++)
+        slab.construct(*slab.acquire(), "more");
+    REQUIRE(slab.get(3) == three);
+    REQUIRE( !slab.acquire() );  // Full
+
+    // Freed handles are reused last-in first-out
+    slab.erase(1);
+    slab.erase(4);
+    REQUIRE(slab.get(1) == nullptr);
+    REQUIRE(slab.size() == 8);
+    REQUIRE(slab.acquire() == 4u);
+    REQUIRE(slab.acquire() == 1u);
+    REQUIRE(slab.get(42) == nullptr);
+}
+
+TEST_CASE("util::Slab - forEach visits the objects by handle") {
+    Slab<int> slab{1000};
+    for (int i = 0; i < 200; i++)
+        slab.construct(*slab.acquire(), i * 10);
+    for (std::uint32_t handle = 0; handle < 200; handle += 2)
+        slab.erase(handle);
+
+    std::vector<int> seen;
+    slab.forEach([&](auto handle, int value) {
+        REQUIRE(value == static_cast<int>(handle) * 10);
+        seen.push_back(value);
+    });
+    REQUIRE(seen.size() == 100);
+    REQUIRE(seen.front() == 10);
+    REQUIRE(seen.back() == 1990);
+    REQUIRE(slab.memoryUsage() >= 4 * sizeof(std::array<std::optional<int>, 64>));
+}
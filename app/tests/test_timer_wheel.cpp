@@ -0,0 +1,108 @@
+#include "catch_amalgamated.hpp"
+#include <util/timer_wheel.hpp>
+#include <util/scheduler.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <vector>
+
+using namespace tns;
+using namespace std::chrono_literals;
+using util::Clock, util::Scheduler, util::Timer, util::TimerWheel, util::PeriodicTimer;
+
+TEST_CASE("util::TimerWheel - Arm, cancel and re-arm in virtual time") {
+    Scheduler scheduler;
+    TimerWheel wheel;
+    const auto start = Clock::now();
+
+    std::vector<int> fired;
+    Timer a{wheel, [&] { fired.push_back(1); REQUIRE(Clock::now() == start + 10ms); }};
+    Timer b{wheel, [&] { fired.push_back(2); }};
+    Timer c{wheel, [&] { fired.push_back(3); }};
+
+    a.arm(10ms);
+    b.arm(5ms);
+    c.arm(1s);
+    REQUIRE(wheel.size() == 3);
+    REQUIRE(a.isArmed());
+
+    b.arm(20ms);  // Moved behind a
+    c.cancel();
+    REQUIRE( !c.isArmed() );
+    REQUIRE(wheel.size() == 2);
+
+    scheduler.runFor(2s);
+    REQUIRE(fired == std::vector{1, 2});
+    REQUIRE(wheel.size() == 0);
+    REQUIRE( !a.isArmed() );
+}
+
+TEST_CASE("util::TimerWheel - Timers fire in order across the levels") {
+    TimerWheel wheel;
+
+    std::mutex mutex;
+    std::vector<int> fired;
+    std::promise<void> done;
+
+    // Level 0 (< 256 ticks), level 1 (< 65536 ticks), and cascaded back down
+    Timer late{wheel, [&] { std::lock_guard lock(mutex); fired.push_back(3); done.set_value(); }};
+    Timer middle{wheel, [&] { std::lock_guard lock(mutex); fired.push_back(2); }};
+    Timer early{wheel, [&] { std::lock_guard lock(mutex); fired.push_back(1); }};
+    late.arm(600ms);
+    middle.arm(300ms);
+    early.arm(20ms);
+
+    REQUIRE(done.get_future().wait_for(5s) == std::future_status::ready);
+    std::lock_guard lock(mutex);
+    REQUIRE(fired == std::vector{1, 2, 3});
+}
+
+TEST_CASE("util::TimerWheel - Timers fire when due, not early") {
+    TimerWheel wheel;
+
+    std::promise<Clock::time_point> firedAt;
+    Timer timer{wheel, [&] { firedAt.set_value(Clock::now()); }};
+
+    const auto armedAt = Clock::now();
+    timer.arm(50ms);
+    auto future = firedAt.get_future();
+    REQUIRE(future.wait_for(5s) == std::future_status::ready);
+
+    const auto elapsed = future.get() - armedAt;
+    REQUIRE(elapsed >= 50ms);
+    REQUIRE(elapsed < 1s);  // Generous: the test machine may be loaded
+}
+
+TEST_CASE("util::TimerWheel - Cancel waits for a running callback") {
+    TimerWheel wheel;
+
+    std::promise<void> started;
+    std::atomic<bool> finished{false};
+    Timer timer{wheel, [&] {
+        started.set_value();
+        std::this_thread::sleep_for(100ms);
+        finished = true;
+    }};
+
+    timer.arm(1ms);
+    REQUIRE(started.get_future().wait_for(5s) == std::future_status::ready);
+    timer.cancel();
+    REQUIRE(finished);
+}
+
+TEST_CASE("util::PeriodicTimer - Runs once per period in virtual time") {
+    Scheduler scheduler;
+    TimerWheel wheel;
+
+    int runs = 0;
+    PeriodicTimer periodic{wheel, 1s, [&] { runs++; }};
+    scheduler.runFor(10s);
+    REQUIRE(runs == 10);
+
+    periodic.stop();
+    scheduler.runFor(10s);
+    REQUIRE(runs == 10);
+    REQUIRE(scheduler.pending() == 0);
+}
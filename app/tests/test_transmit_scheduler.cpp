@@ -0,0 +1,108 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/buffers.hpp>
+#include <tcp/transmit_scheduler.hpp>
+#include <util/scheduler.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace tns;
+using namespace std::chrono_literals;
+using tcp::TransmitScheduler;
+
+TEST_CASE("tcp::TransmitScheduler - Ready sources share the workers round-robin") {
+    util::Scheduler scheduler;  // Virtual time: transmissions run as events, in order
+    TransmitScheduler transmitter;
+
+    std::vector<int> order;
+    int aLeft = 3, bLeft = 2;
+    const auto a = transmitter.add([&] { order.push_back(1); return --aLeft > 0; });
+    const auto b = transmitter.add([&] { order.push_back(2); return --bLeft > 0; });
+    const auto c = transmitter.add([&] { order.push_back(3); return false; });
+    REQUIRE(transmitter.size() == 3);
+
+    transmitter.notify(a);
+    transmitter.notify(b);
+    transmitter.notify(a);  // Already queued: no second turn
+    scheduler.runFor(1s);
+    REQUIRE(order == std::vector{1, 2, 1, 2, 1});
+
+    // A removed source is skipped even if still queued
+    transmitter.notify(c);
+    transmitter.remove(c);
+    scheduler.runFor(1s);
+    REQUIRE(order.size() == 5);
+    REQUIRE(transmitter.size() == 2);
+    REQUIRE(scheduler.pending() == 0);
+}
+
+TEST_CASE("tcp::TransmitScheduler - A source is transmitted by one worker at a time") {
+    TransmitScheduler transmitter{4};
+
+    std::atomic<int> running{0}, maxRunning{0}, runs{0};
+    const auto id = transmitter.add([&] {
+        const auto now = ++running;
+        for (auto max = maxRunning.load(); now > max && !maxRunning.compare_exchange_weak(max, now); ) {}
+        std::this_thread::sleep_for(1ms);
+        --running;
+        return ++runs < 20;
+    });
+
+    for (int i = 0; i < 50; i++)
+        transmitter.notify(id);  // Notified while running: requeued, not run concurrently
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (runs < 20 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+
+    transmitter.remove(id);  // Waits for a transmission in progress
+    REQUIRE(runs >= 20);
+    REQUIRE(running == 0);
+    REQUIRE(maxRunning == 1);
+}
+
+TEST_CASE("tcp::TransmitScheduler - Remove waits for the running transmission") {
+    TransmitScheduler transmitter{1};
+
+    std::promise<void> started;
+    std::atomic<bool> finished{false};
+    const auto id = transmitter.add([&] {
+        started.set_value();
+        std::this_thread::sleep_for(100ms);
+        finished = true;
+        return false;
+    });
+
+    transmitter.notify(id);
+    REQUIRE(started.get_future().wait_for(5s) == std::future_status::ready);
+    transmitter.remove(id);
+    REQUIRE(finished);
+    REQUIRE(transmitter.size() == 0);
+}
+
+TEST_CASE("tcp::SendBuffer - A reopened window wakes the transmitter") {
+    constexpr std::uint32_t WND = 1 << 15;
+    tcp::SendBuffer<1 << 16> sendBuffer{0, WND};
+    sendBuffer.onAck(0, WND);
+    sendBuffer.setNoDelay(true);
+
+    int notified = 0;
+    sendBuffer.setReadyCallback([&notified] { notified++; });
+
+    // The peer's window is closed: written data waits
+    sendBuffer.onAck(0, 0, /* pureAck= */ true);
+    const std::vector<std::byte> data(100, std::byte{0x5a});
+    REQUIRE(sendBuffer.write(std::span<const std::byte>{data}) == data.size());
+    REQUIRE(notified == 0);
+    REQUIRE(sendBuffer.getSizeCanSend() == 0);
+
+    // A pure window update, acknowledging nothing new, opens it again
+    sendBuffer.onAck(0, WND, /* pureAck= */ true);
+    REQUIRE(notified == 1);
+    const auto ready = sendBuffer.takeReadyData(tcp::MAX_TCP_PAYLOAD_SIZE);
+    REQUIRE(ready);
+    REQUIRE(ready->payload.size() == data.size());
+}
@@ -0,0 +1,133 @@
+#include "catch_amalgamated.hpp"
+#include <tcp/buffers.hpp>
+#include <tcp/packet.hpp>
+
+#include <algorithm>
+#include <vector>
+
+using namespace tns;
+
+namespace {
+
+constexpr std::size_t N = 4096;
+constexpr std::size_t SEG = 1000;
+
+const tcp::SessionTuple TUPLE{{ip::Ipv4Address{"10.0.0.1"}, tns::util::hton<in_port_t>(1234)},
+                              {ip::Ipv4Address{"10.0.0.2"}, tns::util::hton<in_port_t>(80)}};
+
+std::vector<std::byte> makeData(std::size_t size, std::size_t first = 0)
+{
+    std::vector<std::byte> data(size);
+    for (std::size_t i = 0; i < size; i++)
+        data[i] = static_cast<std::byte>((first + i) % 251);
+    return data;
+}
+
+// The payload of a segment, copied out of its spans
+std::vector<std::byte> flatten(const tcp::PayloadSpans &spans)
+{
+    std::vector<std::byte> bytes(spans.head.begin(), spans.head.end());
+    bytes.insert(bytes.end(), spans.tail.begin(), spans.tail.end());
+    return bytes;
+}
+
+} // namespace
+
+TEST_CASE("tcp::SendBuffer - Segments are views of the buffer") {
+    tcp::SendBuffer<N> sendBuffer{0, N};
+    const auto data = makeData(2 * N);
+    const auto write = [&sendBuffer, &data](std::size_t from, std::size_t size) {
+        REQUIRE(sendBuffer.write(std::span{data}.subspan(from, size)) == size);
+    };
+
+    // Three segments in a row, each a single run of the buffer
+    write(0, 3 * SEG);
+    for (std::uint32_t seq = 0; seq < 3 * SEG; seq += SEG) {
+        const auto ready = sendBuffer.takeReadyData(SEG);
+        REQUIRE(ready);
+        REQUIRE(ready->seq == seq);
+        REQUIRE(ready->payload.tail.empty());
+        REQUIRE(std::ranges::equal(ready->payload.head, std::span{data}.subspan(seq, SEG)));
+    }
+    sendBuffer.onAck(3 * SEG, N);
+
+    // The second segment from here wraps around the end of the buffer
+    write(3 * SEG, 3 * SEG);
+    REQUIRE(sendBuffer.takeReadyData(SEG));
+    const auto ready = sendBuffer.takeReadyData(SEG);
+    REQUIRE(ready);
+    REQUIRE(ready->payload.head.size() == N - 4 * SEG);
+    REQUIRE(ready->payload.tail.size() == 5 * SEG - N);
+    REQUIRE(flatten(ready->payload) == makeData(SEG, 4 * SEG));
+
+    // Serialized straight from the buffer, it is the same packet as one that owns a copy of the payload
+    const auto view = tcp::Packet::makeAckPacket(TUPLE, ready->seq, 1, 2, ready->payload);
+    const auto copy = tcp::Packet::makeAckPacket(TUPLE, ready->seq, 1, 2, std::make_unique<Payload>(makeData(SEG, 4 * SEG)));
+    REQUIRE(view.getPayloadSize() == SEG);
+    REQUIRE(*view.serialize() == *copy.serialize());
+
+    const auto parsed = tcp::Packet::makePacketFromPayload(
+        TUPLE.localAddr.getAddrNetwork(), TUPLE.remoteAddr.getAddrNetwork(), *view.serialize());
+    REQUIRE(parsed.has_value());
+    REQUIRE(std::ranges::equal(parsed->getPayloadView(), makeData(SEG, 4 * SEG)));
+}
+
+TEST_CASE("tcp::SendBuffer - Acknowledged bytes stay until their whole segment is") {
+    tcp::SendBuffer<N> sendBuffer{0, N};
+    const auto data = makeData(N);
+    REQUIRE(sendBuffer.write(std::span{data}) == N);
+    REQUIRE(sendBuffer.getSizeFree() == 0);
+
+    // Sent as the socket does, keeping the view on the retransmission queue
+    const auto ready = sendBuffer.takeReadyData(SEG);
+    REQUIRE(ready);
+    (void)sendBuffer.retransmitQueue.enqueue(tcp::Packet::makeAckPacket(TUPLE, ready->seq, 0, 0, ready->payload));
+
+    // Half of the segment is acknowledged: its retransmissions still read all of it from the buffer
+    sendBuffer.onAck(SEG / 2, N);
+    REQUIRE(sendBuffer.getSizeUnacked() == SEG / 2);
+    REQUIRE(sendBuffer.getSizeFree() == 0);
+
+    sendBuffer.onAck(SEG, N);
+    REQUIRE(sendBuffer.getSizeFree() == SEG);
+
+    // The space is reused
+    REQUIRE(sendBuffer.write(std::span{data}.first(SEG)) == SEG);
+    REQUIRE(sendBuffer.getSizeFree() == 0);
+}
+
+TEST_CASE("tcp::RecvBuffer - Reading in place") {
+    tcp::RecvBuffer<N> recvBuffer{0};
+    const auto data = makeData(2 * N);
+
+    recvBuffer.onRecv(0, std::span{data}.first(3 * SEG));
+    auto view = recvBuffer.peek();
+    REQUIRE(view.has_value());
+    REQUIRE(view->tail.empty());
+    REQUIRE(std::ranges::equal(view->head, std::span{data}.first(3 * SEG)));
+
+    // The window opens only for the bytes consumed
+    REQUIRE(recvBuffer.consume(SEG) == SEG);
+    REQUIRE(recvBuffer.getAckWnd() == std::make_pair(std::uint32_t{3 * SEG}, N - 2 * SEG));
+    REQUIRE(recvBuffer.consume(N) == 2 * SEG);
+    REQUIRE(recvBuffer.getSizeToRead() == 0);
+
+    // Data wrapping around the end of the buffer is viewed as two spans
+    recvBuffer.onRecv(3 * SEG, std::span{data}.subspan(3 * SEG, 2 * SEG));
+    view = recvBuffer.peek();
+    REQUIRE(view.has_value());
+    REQUIRE(view->head.size() == N - 3 * SEG);
+    REQUIRE(flatten(*view) == makeData(2 * SEG, 3 * SEG));
+
+    // Segments received meanwhile do not touch the bytes viewed
+    recvBuffer.onRecv(5 * SEG, std::span{data}.subspan(5 * SEG, SEG));
+    REQUIRE(flatten(*view) == makeData(2 * SEG, 3 * SEG));
+    REQUIRE(recvBuffer.consume(2 * SEG) == 2 * SEG);
+    REQUIRE(flatten(*recvBuffer.peek()) == makeData(SEG, 5 * SEG));
+
+    // Once shut down, what is left can still be viewed, then the stream ends
+    recvBuffer.shutdown();
+    REQUIRE(flatten(*recvBuffer.peek()) == makeData(SEG, 5 * SEG));
+    REQUIRE(recvBuffer.consume(SEG) == SEG);
+    REQUIRE(recvBuffer.peek().error() == SocketError::CLOSING);
+}
@@ -1,5 +1,7 @@
 #include <host_node.hpp>
+#include <sim/impairment.hpp>
 
+#include <chrono>
 #include <string>
 #include <sstream>
 #include <thread>
@@ -24,12 +26,26 @@ constexpr std::string_view HELP_TEXT =
 "\n  rf <dest-file> <port>        - Receive a file via TCP"
 "\n  cl <sid>                     - Close a TCP socket"
 "\n  ls                           - List TCP sockets"
+"\n  cc                           - Show the congestion control of new TCP sockets"
+"\n  cc <reno|cubic> [sid]        - Set the congestion control of new TCP sockets, or of socket <sid>"
+"\n  sack [on|off]                - Show or set selective acknowledgments for new TCP connections"
+"\n  wscale [on|off]              - Show or set window scaling for new TCP connections"
+"\n  ts [on|off]                  - Show or set timestamps for new TCP connections"
+"\n  rtomin [ms]                  - Show or set the minimum retransmission timeout of new TCP sockets"
+"\n  delack [on|off] [sid]        - Show or set delayed ACKs for new TCP sockets, or of socket <sid>"
+"\n  nodelay <on|off> <sid>       - Send small writes on socket <sid> at once, or wait for the ACKs (Nagle, default)"
+"\n  cork <on|off> <sid>          - Hold back partial segments on socket <sid> until uncorked"
+"\n  impair                       - List link impairments and their counters"
+"\n  impair <interface-name> <settings>|off"
+"\n                               - Emulate an impaired link on an interface's outgoing datagrams, e.g."
+"\n                                 loss 2% burst 3 delay 40ms jitter 5ms reorder 1% duplicate 1% rate 10mbit limit 1000 seed 7"
 "\n";
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3 || std::string_view(argv[1]) != "--config") {
-        std::cerr << "Usage: " << argv[0] << " --config <lnx-file>\n";
+    if ((argc != 3 && argc != 5) || std::string_view(argv[1]) != "--config" ||
+        (argc == 5 && std::string_view(argv[3]) != "--routes")) {
+        std::cerr << "Usage: " << argv[0] << " --config <lnx-file> [--routes <route-file>]\n";
         return EXIT_FAILURE;
     }
 
@@ -37,6 +53,13 @@ int main(int argc, char *argv[])
 
     {
         HostNode hostNode{ std::string_view{argv[2]} };
+        if (argc == 5) {
+            const auto loaded = hostNode.loadStaticRoutes(argv[4]);
+            if (!loaded)
+                std::cerr << "ERROR: " << loaded.error() << "\n";
+            else
+                std::cout << "Loaded " << *loaded << " static routes from " << argv[4] << "\n";
+        }
         
         std::string line;
         std::stringstream ss;
@@ -396,6 +419,110 @@ int main(int argc, char *argv[])
                 else if (line == "ls") {
                     hostNode.tcpListSockets();
                 }
+                else if (line == "cc") {
+                    std::cout << "Congestion control: " << hostNode.tcpGetCongestionAlgorithm() << "\n";
+                }
+                else if (line.starts_with("cc ")) {
+                    std::string name, sid;
+
+                    // Ignore "cc"
+                    ss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+                    ss >> name >> sid;
+
+                    const auto algorithm = tcp::parseCongestionAlgorithm(name);
+                    if (!algorithm) {
+                        std::cout << "ERROR: Command `cc`: " << algorithm.error() << "\n";
+                        continue;
+                    }
+
+                    if (sid.empty()) {
+                        hostNode.tcpSetCongestionAlgorithm(*algorithm);
+                        std::cout << "New sockets use " << *algorithm << "\n";
+                    }
+                    else if (auto ok = hostNode.tcpSetCongestionAlgorithm(std::stoi(sid), *algorithm); ok)
+                        std::cout << "Socket " << sid << " uses " << *algorithm << "\n";
+                    else
+                        std::cout << "ERROR: Failed to set congestion control of socket " << sid << " (" << ok.error() << ")\n";
+                }
+                else if (line == "sack") {
+                    std::cout << "SACK: " << (hostNode.tcpIsSackEnabled() ? "on" : "off") << "\n";
+                }
+                else if (line == "sack on" || line == "sack off") {
+                    hostNode.tcpSetSackEnabled(line == "sack on");
+                    std::cout << "New connections " << (line == "sack on" ? "offer" : "do not offer") << " SACK\n";
+                }
+                else if (line == "wscale") {
+                    std::cout << "Window scaling: " << (hostNode.tcpIsWindowScalingEnabled() ? "on" : "off") << "\n";
+                }
+                else if (line == "wscale on" || line == "wscale off") {
+                    hostNode.tcpSetWindowScalingEnabled(line == "wscale on");
+                    std::cout << "New connections " << (line == "wscale on" ? "offer" : "do not offer") << " window scaling\n";
+                }
+                else if (line == "ts") {
+                    std::cout << "Timestamps: " << (hostNode.tcpIsTimestampsEnabled() ? "on" : "off") << "\n";
+                }
+                else if (line == "ts on" || line == "ts off") {
+                    hostNode.tcpSetTimestampsEnabled(line == "ts on");
+                    std::cout << "New connections " << (line == "ts on" ? "offer" : "do not offer") << " timestamps\n";
+                }
+                else if (line == "rtomin") {
+                    const auto minRto = std::chrono::duration_cast<std::chrono::milliseconds>(hostNode.tcpGetMinRto());
+                    std::cout << "Minimum RTO: " << minRto.count() << " ms\n";
+                }
+                else if (line == "delack") {
+                    std::cout << "Delayed ACKs: " << (hostNode.tcpIsDelayedAck() ? "on" : "off") << "\n";
+                }
+                else if (line.starts_with("delack ")) {
+                    std::string setting, sid;
+
+                    // Ignore "delack"
+                    ss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+                    ss >> setting >> sid;
+
+                    if (setting != "on" && setting != "off") {
+                        std::cout << "ERROR: Command `delack`: expected on or off\n";
+                        continue;
+                    }
+
+                    const auto enabled = setting == "on";
+                    if (sid.empty()) {
+                        hostNode.tcpSetDelayedAck(enabled);
+                        std::cout << "New sockets " << (enabled ? "delay" : "do not delay") << " their ACKs\n";
+                    }
+                    else if (auto ok = hostNode.tcpSetDelayedAck(std::stoi(sid), enabled); ok)
+                        std::cout << "Socket " << sid << (enabled ? " delays" : " does not delay") << " its ACKs\n";
+                    else
+                        std::cout << "ERROR: Failed to set delayed ACKs of socket " << sid << " (" << ok.error() << ")\n";
+                }
+                else if (line.starts_with("nodelay ") || line.starts_with("cork ")) {
+                    std::string command, setting, sid;
+                    ss >> command >> setting >> sid;
+
+                    if ((setting != "on" && setting != "off") || sid.empty()) {
+                        std::cout << "ERROR: Command `" << command << "`: expected on or off, and a socket id\n";
+                        continue;
+                    }
+
+                    const auto on = setting == "on";
+                    const auto ok = command == "nodelay" ? hostNode.tcpSetNoDelay(std::stoi(sid), on)
+                                                         : hostNode.tcpSetCork(std::stoi(sid), on);
+                    if (ok)
+                        std::cout << "Socket " << sid << ": " << command << " " << setting << "\n";
+                    else
+                        std::cout << "ERROR: Failed to set " << command << " of socket " << sid << " (" << ok.error() << ")\n";
+                }
+                else if (line.starts_with("rtomin ")) {
+                    int ms = 0;
+
+                    // Ignore "rtomin"
+                    ss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+                    if (!(ss >> ms) || ms <= 0) {
+                        std::cout << "ERROR: Command `rtomin`: expected a positive number of milliseconds\n";
+                        continue;
+                    }
+                    hostNode.tcpSetMinRto(std::chrono::milliseconds{ms});
+                    std::cout << "New sockets wait at least " << ms << " ms before a retransmission\n";
+                }
                 else if (line == "li") {
                     hostNode.listInterfaces();
                 }
@@ -405,6 +532,22 @@ int main(int argc, char *argv[])
                 else if (line == "lr") {
                     hostNode.listRoutes();
                 }
+                else if (line == "impair") {
+                    hostNode.listImpairments();
+                }
+                else if (line.starts_with("impair ")) {
+                    std::string interfaceName;
+                    ss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+                    ss >> interfaceName;
+
+                    const auto impairment = sim::parseImpairment(line.substr(std::min(line.size(), static_cast<std::size_t>(ss.tellg()))));
+                    if (!impairment) {
+                        std::cout << "ERROR: Command `impair`: " << impairment.error() << "\n";
+                        continue;
+                    }
+                    if (const auto set = hostNode.setImpairment(interfaceName, *impairment); !set)
+                        std::cout << "ERROR: Command `impair`: " << set.error() << "\n";
+                }
                 else {
                     std::cout << "ERROR: Unknown command. Type 'help' for a list of supported commands.\n";
                 }
@@ -1,4 +1,5 @@
 #include <router_node.hpp>
+#include <sim/impairment.hpp>
 
 #include <string>
 #include <sstream>
@@ -15,16 +16,46 @@ constexpr std::string_view HELP_TEXT =
 "\n  li                        - List interfaces"
 "\n  ln                        - List neighbors"
 "\n  lr                        - List routes"
+"\n  rs                        - Show RIP statistics"
+"\n  ls                        - Show the link-state database"
+"\n  dump                      - Print routes and RIP counters as one line of JSON"
+"\n  impair                    - List link impairments and their counters"
+"\n  impair <interface-name> <settings>|off"
+"\n                            - Emulate an impaired link on an interface's outgoing datagrams, e.g."
+"\n                              loss 2% burst 3 delay 40ms jitter 5ms reorder 1% duplicate 1% rate 10mbit limit 1000 seed 7"
 "\n";
 
 int main(int argc, char *argv[])
 {
-    if (argc != 3 || std::string_view(argv[1]) != "--config") {
-        std::cerr << "Usage: " << argv[0] << " --config <lnx-file>\n";
+    const auto usage = [argv]() {
+        std::cerr << "Usage: " << argv[0] << " --config <lnx-file> [--snapshot <route-snapshot-file>]"
+                                              " [--routes <route-file>]\n";
         return EXIT_FAILURE;
+    };
+    if (argc < 3 || argc % 2 == 0 || std::string_view(argv[1]) != "--config")
+        return usage();
+
+    const char *snapshotFile = nullptr;
+    const char *routeFile = nullptr;
+    for (int i = 3; i < argc; i += 2) {
+        if (std::string_view(argv[i]) == "--snapshot")
+            snapshotFile = argv[i + 1];
+        else if (std::string_view(argv[i]) == "--routes")
+            routeFile = argv[i + 1];
+        else
+            return usage();
     }
 
     RouterNode routerNode{ std::string_view{argv[2]} };
+    if (routeFile) {
+        const auto loaded = routerNode.loadStaticRoutes(routeFile);
+        if (!loaded)
+            std::cerr << "ERROR: " << loaded.error() << "\n";
+        else
+            std::cout << "Loaded " << *loaded << " static routes from " << routeFile << "\n";
+    }
+    if (snapshotFile)
+        routerNode.enableRouteSnapshots(snapshotFile);
 
     std::string line;
     std::stringstream ss;
@@ -112,6 +143,31 @@ int main(int argc, char *argv[])
             else if (line == "lr") {
                 routerNode.listRoutes();
             }
+            else if (line == "rs") {
+                routerNode.listRipStats();
+            }
+            else if (line == "ls") {
+                routerNode.listLinkState();
+            }
+            else if (line == "dump") {
+                routerNode.dumpJson();
+            }
+            else if (line == "impair") {
+                routerNode.listImpairments();
+            }
+            else if (line.starts_with("impair ")) {
+                std::string interfaceName;
+                ss.ignore(std::numeric_limits<std::streamsize>::max(), ' ');
+                ss >> interfaceName;
+
+                const auto impairment = sim::parseImpairment(line.substr(std::min(line.size(), static_cast<std::size_t>(ss.tellg()))));
+                if (!impairment) {
+                    std::cout << "ERROR: Command `impair`: " << impairment.error() << "\n";
+                    continue;
+                }
+                if (const auto set = routerNode.setImpairment(interfaceName, *impairment); !set)
+                    std::cout << "ERROR: Command `impair`: " << set.error() << "\n";
+            }
             else {
                 std::cout << "ERROR: Unknown command. Type 'help' for a list of supported commands.\n";
             }
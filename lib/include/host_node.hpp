@@ -16,10 +16,12 @@ public:
     HostNode() = default;
     HostNode(const std::string_view lnxFile);
     HostNode(const std::string &lnxFile) : HostNode(std::string_view(lnxFile)) {};
+    // Build the host from parsed config; with a fabric its links are simulated in memory (see sim/simulator.hpp)
+    HostNode(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric);
     HostNode(const HostNode&) = delete;
     HostNode(HostNode&&) = delete;
 
-    ~HostNode() { std::cout << "HostNode::~HostNode() : DONE!\n"; };
+    ~HostNode() { stopReceiving_(); std::cout << "HostNode::~HostNode() : DONE!\n"; };
 
     // Public API with TCP stack
 
@@ -30,7 +32,7 @@ public:
     {
         // Use address of the first interface as local
         return tcpStack_.vConnect(/*  local= */ interfaces_.front().ipAddress_,
-                                  /* remote= */ {remoteIP.getAddrNetwork(), tns::util::hton(remotePort)});
+                                  /* remote= */ {remoteIP, tns::util::hton(remotePort)});
     }
  
     // Create a listening socket bound to the given port (Passive Open)
@@ -43,6 +45,10 @@ public:
     // Receive data from a TCP socket into a buffer.
     auto tcpRecv(int socketID, const std::span<std::byte> buff) { return tcpStack_.vRecv(socketID, buff); }
 
+    // Receive data from a TCP socket without copying it: view it in the socket's buffer, then free it.
+    auto tcpRecvView(int socketID) { return tcpStack_.vRecvView(socketID); }
+    auto tcpConsume(int socketID, std::size_t n) { return tcpStack_.vConsume(socketID, n); }
+
     // Send a file via a TCP socket.
     auto tcpSendFile(const std::string &filename, const ip::Ipv4Address &remoteIP, in_port_t remotePort) -> tl::expected<std::size_t, SocketError>
     {
@@ -87,8 +93,8 @@ public:
 
         const auto duration = duration_cast<milliseconds>(high_resolution_clock::now() - start);
 
+        // The FIN is queued behind the data still in the send buffer, so nothing needs waiting for here
         std::cout << "Closing socket...\n";
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
         sock.vClose();
 
         std::cout << "[SUCCESS] Sent " << total << " bytes in " << duration.count() << "ms.\n";
@@ -99,6 +105,11 @@ public:
     // Receive a file from a TCP socket.
     auto tcpRecvFile(const std::string &filename, in_port_t localPort) -> tl::expected<std::size_t, SocketError>
     {
+        // Opened first, so that nothing is received for a file that cannot be written
+        std::ofstream file(filename, std::ios::binary);
+        if (!file)
+            return tl::unexpected{SocketError::NO_RESOURCES};
+
         std::cout << "tcpRecvFile(): Listening on port " << localPort << "\n";
 
         auto lSockMaybe = tcpListen(localPort);
@@ -117,35 +128,29 @@ public:
 
         std::cout << "Connection accepted. Receiving file on socket " << sock.getID() << "\n";
 
-        static constexpr std::size_t MAXSIZE = 10 * 1024 * 1024;  // 10 MB buffer
-        std::vector<std::byte> buf(MAXSIZE);
+        // Write the data straight from the socket's receive buffer
+        std::cout << "tcpRecvFile(): Writing to file " << filename << "...\n";
         std::size_t total = 0;
         while (true) {
-            // std::this_thread::sleep_for(std::chrono::seconds(10000));
-            // Recv starting from buf[total]
-            const auto span   = std::span<std::byte>{buf.begin() + total, buf.end()};
-            const auto nMaybe = sock.vRecv(span, span.size());
-            if (!nMaybe) {
-                if (nMaybe.error() == SocketError::CLOSING) {
+            const auto viewMaybe = sock.vRecvView();
+            if (!viewMaybe) {
+                if (viewMaybe.error() == SocketError::CLOSING) {
                     std::cout << "tcpRecvFile(): Connection has been closed by sender.\n";
                     break;
                 }
-                return tl::unexpected{nMaybe.error()};
+                return tl::unexpected{viewMaybe.error()};
             }
 
-            const auto n = nMaybe.value();
-
-            total += n;
-
-            // std::cout << "tcpRecvFile(): Received " << n << " new bytes. \tTotal " << total << "\n";
+            const auto &view = viewMaybe.value();
+            for (const auto part : {view.head, view.tail})
+                file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+            if (!file)
+                return tl::unexpected{SocketError::NO_RESOURCES};
 
-            // static constexpr std::size_t CHUNK_SIZE = 100 * 1024;  // 100 KB
-            // if (chunk >= CHUNK_SIZE) {  // 100 KB
-            //     std::stringstream ss;
-            //     ss << "tcpRecvFile(): Received " << chunk << " new bytes. \tTotal " << total << "\r";
-            //     std::cout << ss.str() << std::flush;
-            //     chunk = 0;
-            // }
+            const auto nMaybe = sock.vConsume(view.size());
+            if (!nMaybe)
+                return tl::unexpected{nMaybe.error()};
+            total += nMaybe.value();
         }
 
         std::cout << "\ntcpRecvFile(): Received " << total << " bytes in total.\n";
@@ -154,14 +159,6 @@ public:
         sock.vClose();
         lSock.vClose();
 
-        std::cout << "tcpRecvFile(): Writing to file " << filename << "...\n";
-
-        std::ofstream file(filename, std::ios::binary);
-        if (!file)
-            return tl::unexpected{SocketError::NO_RESOURCES};
-        
-        file.write(reinterpret_cast<const char*>(buf.data()), total);
-
         std::cout << "tcpRecvFile(): File written.\n";
 
         return total;
@@ -176,12 +173,40 @@ public:
     // List info of all sockets
     void tcpListSockets(std::ostream &os = std::cout) const { tcpStack_.listSockets(os); }
 
+    // Congestion control of new connections, or of an open one
+    void tcpSetCongestionAlgorithm(tcp::CongestionAlgorithm algorithm) { tcpStack_.setCongestionAlgorithm(algorithm); }
+    auto tcpSetCongestionAlgorithm(int socketID, tcp::CongestionAlgorithm algorithm) { return tcpStack_.setCongestionAlgorithm(socketID, algorithm); }
+    auto tcpGetCongestionAlgorithm() const { return tcpStack_.getCongestionAlgorithm(); }
+
+    // Selective acknowledgments for new connections
+    void tcpSetSackEnabled(bool enabled) { tcpStack_.setSackEnabled(enabled); }
+    bool tcpIsSackEnabled() const { return tcpStack_.isSackEnabled(); }
+
+    // Window scaling for new connections
+    void tcpSetWindowScalingEnabled(bool enabled) { tcpStack_.setWindowScalingEnabled(enabled); }
+    bool tcpIsWindowScalingEnabled() const { return tcpStack_.isWindowScalingEnabled(); }
+
+    // Timestamps for new connections, and the minimum RTO of new sockets
+    void tcpSetTimestampsEnabled(bool enabled) { tcpStack_.setTimestampsEnabled(enabled); }
+    bool tcpIsTimestampsEnabled() const { return tcpStack_.isTimestampsEnabled(); }
+    void tcpSetMinRto(std::chrono::microseconds minRto) { tcpStack_.setMinRto(minRto); }
+    std::chrono::microseconds tcpGetMinRto() const { return tcpStack_.getMinRto(); }
+
+    // Delayed ACKs of new connections, or of an open one
+    void tcpSetDelayedAck(bool enabled) { tcpStack_.setDelayedAckEnabled(enabled); }
+    auto tcpSetDelayedAck(int socketID, bool enabled) { return tcpStack_.setDelayedAck(socketID, enabled); }
+    bool tcpIsDelayedAck() const { return tcpStack_.isDelayedAckEnabled(); }
+
+    // Nagle's algorithm and cork of an open connection
+    auto tcpSetNoDelay(int socketID, bool noDelay) { return tcpStack_.setNoDelay(socketID, noDelay); }
+    auto tcpSetCork(int socketID, bool cork) { return tcpStack_.setCork(socketID, cork); }
+
 
 private:
     void datagramHandler_(DatagramPtr datagram, const ip::Ipv4Address &infaceAddr) const override;
 
 private:
-    tcp::TcpStack tcpStack_;
+    tcp::TcpStack tcpStack_{timerWheel_};
 };
 
 } // namespace tns
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <compare>
+#include <functional>
 #include <string>
 #include <stdexcept>
 
@@ -10,51 +12,63 @@
 namespace tns {
 namespace ip {
 
-// Virtual IPv4 address defined in a lnx file
+// Virtual IPv4 address defined in a lnx file.
+// Just the 4-byte address in network byte order, so it is cheap to copy, compare and hash.
+// Transport-layer ports live with the transport (see tcp::Endpoint).
 class Ipv4Address {
 
 public:
-    constexpr Ipv4Address() noexcept : addr_({AF_INET, 0, {0}}) {};
-    constexpr Ipv4Address(in_addr_t addr, in_port_t port = 0) noexcept : addr_({AF_INET, port, {addr}}) {}  // addr, port: network byte order
-    constexpr Ipv4Address(sockaddr_in addr) noexcept : addr_(addr) {};  // addr: network byte order
+    constexpr Ipv4Address() noexcept = default;
+    constexpr Ipv4Address(in_addr_t addr) noexcept : addr_(addr) {}  // addr: network byte order
+    constexpr Ipv4Address(sockaddr_in addr) noexcept : addr_(addr.sin_addr.s_addr) {};  // addr: network byte order
 
-    constexpr Ipv4Address(const char *addr, in_port_t port = 0) : addr_({AF_INET, port, {}}) 
+    Ipv4Address(const char *addr)
     {
-        if (inet_aton(addr, &addr_.sin_addr) == 0)
+        in_addr parsed{};
+        if (inet_aton(addr, &parsed) == 0)
             throw std::invalid_argument(std::string("Ipv4Address::Ipv4Address: Invalid IPv4 address ") + addr);
+        addr_ = parsed.s_addr;
     };
     Ipv4Address(const std::string &addr) : Ipv4Address(addr.c_str()) {};
-    
+
     ~Ipv4Address() = default;
 
-    bool operator==(const Ipv4Address &other) const noexcept
+    constexpr bool operator==(const Ipv4Address &other) const noexcept = default;
+
+    // Ordered numerically, i.e. by the host byte order value
+    constexpr std::strong_ordering operator<=>(const Ipv4Address &other) const noexcept
     {
-        return addr_.sin_addr.s_addr == other.addr_.sin_addr.s_addr
-            && addr_.sin_port == other.addr_.sin_port;
+        return getAddrHost() <=> other.getAddrHost();
     }
 
-    bool operator< (const Ipv4Address &other) const noexcept
+    std::string toString() const { return toStringAddr(); }
+    std::string toStringAddr() const
     {
-        using tns::util::ntoh;
-        return getAddrHost() < other.getAddrHost()
-            || (getAddrHost() == other.getAddrHost() && ntoh(addr_.sin_port) < ntoh(other.addr_.sin_port));
+        char buf[INET_ADDRSTRLEN];
+        const in_addr addr{addr_};
+        return inet_ntop(AF_INET, &addr, buf, sizeof(buf));
     }
 
-    std::string toString() const { return toStringAddr() + ":" + std::to_string(tns::util::ntoh(addr_.sin_port)); }
-    std::string toStringAddr() const { return inet_ntoa(addr_.sin_addr); }
-
-    constexpr in_addr_t getAddrHost() const noexcept { return tns::util::ntoh(addr_.sin_addr.s_addr); }
-    constexpr in_addr_t getAddrNetwork() const noexcept { return addr_.sin_addr.s_addr; }
+    constexpr in_addr_t getAddrHost() const noexcept { return tns::util::ntoh(addr_); }
+    constexpr in_addr_t getAddrNetwork() const noexcept { return addr_; }
 
-    constexpr in_port_t getPortHost() const noexcept { return tns::util::ntoh(addr_.sin_port); }
-    constexpr in_port_t getPortNetwork() const noexcept { return addr_.sin_port; }
-    
     // Literals
-    [[nodiscard]] static constexpr auto LOCALHOST() { return Ipv4Address("127.0.0.1"); }
+    [[nodiscard]] static constexpr auto LOCALHOST() noexcept { return Ipv4Address(tns::util::hton<in_addr_t>(INADDR_LOOPBACK)); }
 
 private:
-    sockaddr_in addr_ = {};  // network byte order
+    in_addr_t addr_ = 0;  // network byte order
 };
 
+static_assert(sizeof(Ipv4Address) == 4);
+
 } // namespace ip
 } // namespace tns
+
+
+template <>
+struct std::hash<tns::ip::Ipv4Address> {
+    std::size_t operator()(const tns::ip::Ipv4Address &addr) const noexcept
+    {
+        return tns::util::mix64(addr.getAddrNetwork());
+    }
+};
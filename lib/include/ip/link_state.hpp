@@ -0,0 +1,202 @@
+#pragma once
+
+#include "ip/address.hpp"
+#include "util/clock.hpp"
+#include "util/defines.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace tns {
+namespace ip {
+
+// Link-state routing (OSPF-like), an alternative to RIP selected with `routing link-state` in the lnx file.
+//
+// Each router floods a link-state advertisement (LSA) listing its two-way neighbors and its directly
+// connected subnets. Every router keeps all LSAs in a link-state database and computes shortest paths
+// from itself, updating them incrementally as LSAs change.
+
+using RouterId = std::uint32_t;  // Address of the router's first interface, host byte order
+
+struct LsaPrefix {  // Host byte order
+    std::uint32_t address;
+    std::uint32_t mask;
+    auto operator<=>(const LsaPrefix &other) const = default;
+};
+
+struct LsaLink {
+    RouterId neighbor;
+    std::uint32_t cost;
+    bool operator==(const LsaLink &other) const = default;
+};
+
+// Link-state advertisement
+struct Lsa {
+    RouterId originator;
+    std::uint32_t seq;
+    std::vector<LsaLink> links;
+    std::vector<LsaPrefix> prefixes;
+};
+
+
+// Link-state database and shortest path tree rooted at this router.
+// Pure state, no I/O or locking: LinkStateRouting drives it.
+class LinkStateDatabase {
+public:
+    static constexpr std::uint32_t UNREACHABLE = std::numeric_limits<std::uint32_t>::max();
+    static constexpr std::uint32_t MAX_COST = 0xFFFF;  // Link costs are clamped to [1, MAX_COST], so sums cannot overflow
+
+    struct Route {
+        RouterId firstHop;   // Neighbor router to forward to
+        std::uint32_t cost;  // Path cost to the advertising router
+        bool operator==(const Route &other) const = default;
+    };
+    using Routes = std::map<LsaPrefix, Route>;
+
+    struct RouteChange {
+        LsaPrefix prefix;
+        std::optional<Route> route;  // nullopt: withdrawn
+    };
+    using RouteChanges = std::vector<RouteChange>;
+
+    struct Stats {
+        std::size_t lsasInstalled = 0;
+        std::size_t prefixOnlyUpdates = 0;  // LSA changes that did not touch the topology
+        std::size_t incrementalRuns = 0;    // SPF updates limited to the affected part of the tree
+        std::size_t nodesRelaxed = 0;       // Total nodes settled by those updates
+    };
+
+    explicit LinkStateDatabase(RouterId self) : self_(self) { nodes_[self].dist = 0; }
+
+    // Install the LSA if it is newer than the one we have (or new). Route changes are appended to `changes`.
+    // Returns whether the LSA was installed.
+    bool install(Lsa lsa, RouteChanges &changes);
+
+    // Remove the LSA of the originator (e.g. aged out). Route changes are appended to `changes`.
+    void remove(RouterId originator, RouteChanges &changes);
+
+    const Lsa *find(RouterId originator) const;
+    std::vector<const Lsa*> getLsas() const;
+
+    const Routes &getRoutes() const noexcept { return routes_; }
+    std::uint32_t getDistance(RouterId router) const;
+    const Stats &getStats() const noexcept { return stats_; }
+
+    // Shortest paths computed from scratch (plain Dijkstra), for checking the incremental state
+    Routes computeRoutesFromScratch() const;
+
+private:
+    struct Node {
+        std::optional<Lsa> lsa;
+        std::uint32_t dist = UNREACHABLE;
+        std::optional<RouterId> parent;  // Previous router on the shortest path
+        RouterId firstHop = 0;
+    };
+
+    // Cost of the edge u -> v, which exists only if both LSAs list each other (two-way check)
+    std::uint32_t edgeCost_(RouterId u, RouterId v) const;
+
+    // Update the tree after the edges around `originator` changed from `oldLinks` to its current LSA.
+    // Nodes whose distance or first hop changed are added to `touched`.
+    void updateTree_(RouterId originator, const std::vector<LsaLink> &oldLinks, std::set<RouterId> &touched);
+
+    // Continue Dijkstra from the seeded nodes, lowering distances only
+    using HeapItem = std::pair<std::uint32_t, RouterId>;
+    void relax_(std::vector<HeapItem> heap, std::set<RouterId> &touched);
+
+    // Recompute the best route of the given prefixes, appending changes
+    void updateRoutes_(const std::set<LsaPrefix> &prefixes, RouteChanges &changes);
+
+    RouterId self_;
+    std::unordered_map<RouterId, Node> nodes_;
+    std::map<LsaPrefix, std::set<RouterId>> advertisers_;  // Prefix -> routers advertising it
+    Routes routes_;
+    Stats stats_;
+};
+
+
+// The link-state protocol engine of a router: hellos, adjacencies, flooding and LSA aging.
+// Datagrams go out through the send callback, computed routes through the routes callback.
+class LinkStateRouting {
+public:
+    using Clock = tns::util::Clock;
+
+    static constexpr auto HELLO_INTERVAL = std::chrono::seconds(1);
+    static constexpr auto DEAD_INTERVAL  = std::chrono::seconds(4);   // Neighbor is down after 4 missed hellos
+    static constexpr auto LSA_REFRESH    = std::chrono::seconds(10);  // Re-flood our own LSA
+    static constexpr auto LSA_MAX_AGE    = std::chrono::seconds(40);  // Drop LSAs not refreshed for that long
+
+    // A route resolved to the neighbor's interface address, ready for the routing table
+    struct InstalledRoute {
+        LsaPrefix prefix;
+        std::optional<Ipv4Address> gateway;  // nullopt: withdrawn
+        std::uint32_t metric;
+    };
+
+    struct Callbacks {
+        std::function<void(const Ipv4Address &dest, PayloadPtr payload)> send;
+        std::function<void(const std::vector<InstalledRoute> &routes)> installRoutes;
+        std::function<std::vector<LsaPrefix>()> localPrefixes;  // Subnets of the interfaces that are up
+    };
+
+    LinkStateRouting(RouterId self, std::vector<Ipv4Address> neighbors, Callbacks callbacks);
+
+    // Handle a received link-state datagram payload from `src`
+    void handleMessage(PayloadView payload, const Ipv4Address &src);
+
+    // Called every HELLO_INTERVAL: send hellos, expire dead neighbors and old LSAs, refresh our LSA
+    void tick();
+
+    // Called after a local interface went up or down
+    void onInterfaceChange();
+
+    // Write the link-state database to an ostream
+    void listDatabase(std::ostream &os) const;
+
+private:
+    struct Neighbor {
+        std::optional<RouterId> routerId;  // Learned from its hellos
+        Clock::time_point lastHeard;
+        bool twoWay = false;               // It has heard our hellos as well
+    };
+
+    // All with mutex_ held
+    void handleHello_(PayloadView ids, RouterId sender, const Ipv4Address &src, Clock::time_point now);
+    void handleLsa_(Lsa lsa, const Ipv4Address &src, Clock::time_point now);
+
+    // Originate a new LSA for this router if its links or prefixes changed (or always, if `refresh`),
+    // flood it, and re-resolve all routes, since first hops may now be reached through other interfaces.
+    void originateLsa_(Clock::time_point now, bool refresh);
+    void installLsa_(Lsa lsa, Clock::time_point now);
+    void installRoutes_(const LinkStateDatabase::RouteChanges &changes);
+
+    void sendHello_(const Ipv4Address &dest);
+    void sendLsa_(const Lsa &lsa, const Ipv4Address &dest);
+    void floodLsa_(const Lsa &lsa, const std::optional<Ipv4Address> &except);
+
+    // Interface address of a two-way neighbor with the given router ID
+    std::optional<Ipv4Address> neighborAddress_(RouterId routerId) const;
+
+    RouterId self_;
+    Callbacks callbacks_;
+
+    std::map<Ipv4Address, Neighbor> neighbors_;  // By interface address
+    LinkStateDatabase lsdb_;
+    std::unordered_map<RouterId, Clock::time_point> lsaInstalled_;  // For aging out LSAs of other routers
+    std::uint32_t seq_ = 0;              // Sequence number of our latest LSA
+    Clock::time_point lastOriginated_;   // Default (epoch): our first LSA is originated on the first tick
+    mutable std::mutex mutex_;
+};
+
+} // namespace ip
+} // namespace tns
@@ -10,6 +10,7 @@ namespace ip {
         TEST = 0,
         TCP  = 6,
         RIP  = 200,
+        LINK_STATE = 201,  // Hellos and LSAs of the link-state routing protocol
     };
 
     // Default handlers for protocols
@@ -1,29 +1,35 @@
 #pragma once
 
+#include "ip/address.hpp"
 #include "util/defines.hpp"
+#include "util/tl/expected.hpp"
 
 #include <arpa/inet.h>
 #include <iostream>
+#include <iterator>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace tns {
 namespace ip {
 
-class Ipv4Address;
-
 // Routing Information Protocol (RIP) packet
 class RipMessage {
 public:
     static constexpr std::uint32_t INFINITY = 16;
 
+    // RFC 2453 caps a message at 25 entries; we use 64, which keeps a message (4 + 64*12 = 772 bytes)
+    // well within one datagram (Datagram::MAX_DATAGRAM_SIZE - 20 bytes of IP header).
+    static constexpr std::size_t MAX_ENTRIES_PER_MESSAGE = 64;
+
     enum class Command : std::uint16_t {
         REQUEST = 1,
         RESPONSE = 2,
     };
 
     struct Entry {  // Host byte order
-        std::uint32_t cost;  
+        std::uint32_t cost;
         std::uint32_t address;
         std::uint32_t mask;
     };
@@ -38,28 +44,92 @@ public:
         return RipMessage(Command::RESPONSE, std::move(entries), std::move(learnedFrom));
     }
 
-    RipMessage(PayloadView payload);  // recv, convert to host byte order when receiving
     ~RipMessage() { /* std::cout << "RipMessage::~RipMessage() : DONE!\n"; */ }
 
     Command getCommand() const { return command_; }
-    std::uint16_t getNumEntries() const { return numEntries_; }
+    std::size_t getNumEntries() const { return entries_.size(); }
     const Entries &getEntries() const { return entries_; }
     const OptionalAddresses &getLearnedFrom() const { return learnedFrom_; }
-    std::size_t payloadSize() const { return sizeof(command_) + sizeof(numEntries_) + entries_.size() * sizeof(Entry); }
 
 private:
     RipMessage(Command command, Entries entries, OptionalAddresses learnedFrom);  // send, convert to network byte order when sending
 
     // RIP packet payload: Host byte order
     Command command_;
-    std::uint16_t numEntries_;
     Entries entries_;
 
     // Optionally used when the router generates a RipMessage.
-    // When broadcasting, the router should poison entries_[i] 
+    // When broadcasting, the router should poison entries_[i]
     // if the neighbor receiver matches learnedFrom_[i].
     OptionalAddresses learnedFrom_;
 };
 
+// A read-only view of a received RIP message. Entries are decoded from the payload on access,
+// so the payload must outlive the view.
+class RipMessageView {
+public:
+    // Validates the header and that the payload holds all the entries it announces
+    static tl::expected<RipMessageView, std::string> parse(PayloadView payload);
+
+    RipMessage::Command getCommand() const noexcept { return command_; }
+    std::uint16_t getNumEntries() const noexcept { return numEntries_; }
+
+    // The i-th entry in host byte order, with the cost as sent by the neighbor
+    RipMessage::Entry getEntry(std::size_t i) const noexcept;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = RipMessage::Entry;
+
+        Iterator() = default;
+        Iterator(const RipMessageView *view, std::size_t i) noexcept : view_(view), i_(i) {}
+
+        value_type operator*() const noexcept { return view_->getEntry(i_); }
+        Iterator &operator++() noexcept { ++i_; return *this; }
+        Iterator  operator++(int) noexcept { auto tmp = *this; ++i_; return tmp; }
+        bool operator==(const Iterator &other) const noexcept { return i_ == other.i_; }
+
+    private:
+        const RipMessageView *view_ = nullptr;
+        std::size_t i_ = 0;
+    };
+
+    Iterator begin() const noexcept { return {this, 0}; }
+    Iterator end()   const noexcept { return {this, numEntries_}; }
+
+private:
+    RipMessageView(PayloadView entries, RipMessage::Command command, std::uint16_t numEntries) noexcept
+        : entries_(entries), command_(command), numEntries_(numEntries) {}
+
+    PayloadView entries_;  // Network byte order, numEntries_ * 12 bytes
+    RipMessage::Command command_;
+    std::uint16_t numEntries_;
+};
+
+// A RIP message encoded once into wire format, split into as many messages as needed
+// (at most MAX_ENTRIES_PER_MESSAGE entries each).
+// Per-neighbor payloads are copies of the encoded messages in which only the entries
+// learned from that neighbor are patched to INFINITY (poisoned reverse).
+class RipEncoding {
+public:
+    explicit RipEncoding(const RipMessage &ripMessage);
+
+    // The payloads to send to the given neighbor, one per message
+    std::vector<PayloadPtr> makePayloads(const Ipv4Address &neighbor) const;
+
+    std::size_t getNumMessages() const noexcept { return messages_.size(); }
+    std::size_t getNumEntries() const noexcept { return numEntries_; }
+
+private:
+    struct Message {
+        Payload payload;
+        std::vector<std::pair<std::size_t, Ipv4Address>> learnedFrom;  // (offset of cost in payload, neighbor)
+    };
+    std::vector<Message> messages_;
+    std::size_t numEntries_ = 0;
+};
+
 } // namespace ip
 } // namespace tns
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "ip/route_snapshot.hpp"
+#include "util/tl/expected.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace tns {
+namespace ip {
+
+// Static routes for bulk loading, in either of two forms:
+//  - Text: one route per line, `<address>/<prefix-length> [via] <gateway>`. `#` starts a comment.
+//  - Binary: a route snapshot (see route_snapshot.hpp), recognized by its magic. Metrics are ignored.
+// The file is memory-mapped and parsed in place.
+tl::expected<std::vector<SnapshotRoute>, std::string> loadRouteFile(const std::string &path);
+
+// Parse routes in the text form. `name` is used in error messages.
+tl::expected<std::vector<SnapshotRoute>, std::string> parseRouteText(std::string_view text, const std::string &name);
+
+} // namespace ip
+} // namespace tns
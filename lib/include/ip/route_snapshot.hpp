@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ip/address.hpp"
+#include "util/tl/expected.hpp"
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace tns {
+namespace ip {
+
+// A learned route persisted across router restarts (host byte order)
+struct SnapshotRoute {
+    std::uint32_t address;
+    std::uint32_t mask;
+    Ipv4Address gateway;
+    std::uint32_t metric;
+    bool operator==(const SnapshotRoute &other) const = default;
+};
+
+// Binary route snapshot: a 12-byte header (magic "TNSR", version, count) followed by 16 bytes per route,
+// all in network byte order. The file is written to `<path>.tmp` and renamed over `path`, so a crash
+// mid-write never leaves a torn snapshot behind.
+tl::expected<void, std::string> saveRouteSnapshot(const std::string &path, const std::vector<SnapshotRoute> &routes);
+
+// Fails on a missing, truncated or foreign file
+tl::expected<std::vector<SnapshotRoute>, std::string> loadRouteSnapshot(const std::string &path);
+
+// Decode a snapshot held in memory (e.g. a mapped file). `name` is used in error messages.
+tl::expected<std::vector<SnapshotRoute>, std::string> decodeRouteSnapshot(std::span<const std::byte> data,
+                                                                          const std::string &name);
+
+// Whether the data starts like a route snapshot
+bool isRouteSnapshot(std::span<const std::byte> data) noexcept;
+
+} // namespace ip
+} // namespace tns
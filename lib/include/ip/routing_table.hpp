@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <map>           // map
 #include <mutex>         // mutex, lock_guard
 #include <shared_mutex>
@@ -9,8 +10,13 @@
 #include <chrono>
 
 #include "address.hpp"
+#include "link_state.hpp"
 #include "rip_message.hpp"
+#include "route_snapshot.hpp"
 #include "util/defines.hpp"
+#include "util/flat_hash_map.hpp"
+#include "util/util.hpp"
+#include "util/clock.hpp"
 
 
 namespace tns {
@@ -46,6 +52,7 @@ public:
         LOCAL,
         RIP,
         STATIC,
+        LINK_STATE,
     };
 
     friend std::ostream& operator<< (std::ostream& os, EntryType entryType)
@@ -54,18 +61,21 @@ public:
             case EntryType::LOCAL  : return os << "L";
             case EntryType::RIP    : return os << "R";
             case EntryType::STATIC : return os << "S";
+            case EntryType::LINK_STATE : return os << "O";
             default                : return os << "?";
         };
     }
 
     struct Entry {
-        EntryType type;                      // EntryType::LOCAL, ::RIP, ::STATIC
+        EntryType type;                      // EntryType::LOCAL, ::RIP, ::STATIC, ::LINK_STATE
         Ipv4Address addr;                    // addr & mask defines a subnet
         in_addr_t mask;                      // Subnet mask in host byte order
         std::optional<Ipv4Address> gateway;  // If gateway is not null, requery with gateway
         NetworkInterfaceIter interfaceIt;    // Iterator into NetworkNode::interfaces_
         std::optional<std::size_t> metric;   // Metric is null for static routes
-        std::chrono::steady_clock::time_point lastRefresh;  // Last time this entry was refreshed, for RIP entries
+        tns::util::Clock::time_point lastRefresh;  // Last time this entry was refreshed, for RIP entries
+        bool changed = true;                 // Changed since the last periodic RIP update (incremental updates)
+        bool provisional = false;            // Preloaded from a snapshot, not yet confirmed by a neighbor
     };
     using Entries = std::vector<Entry>;
 
@@ -85,13 +95,31 @@ public:
     const Entry *queryLongestPrefixMatchNoLock_(const Ipv4Address &addr) const;
 
     // Find an iterator to the exact entry in the routing table given the address and mask.
+    // O(1) through the (prefix, mask) index.
     Entries::iterator findEntry_(const Ipv4Address &addr, const std::uint32_t maskHost);
     Entries::iterator findEntryNoLock_(const Ipv4Address &addr, const std::uint32_t maskHost);
 
+    // Append an entry and index it. The caller must have checked that its prefix is not in the table yet.
+    void pushEntryNoLock_(Entry entry);
+
+    // Remove an entry by swapping the last entry into its place (swap-and-pop), keeping the index in sync.
+    // Returns an iterator to the same position, which now holds the previously last entry (or end()).
+    Entries::iterator eraseEntryNoLock_(Entries::iterator it);
+
     // Write info of the routing table to an ostream. (Default is standard output.)
     void listEntries_(std::ostream &os = std::cout) const;
     void listEntriesNoLock_(std::ostream &os = std::cout) const;
 
+    // Write the entries as a JSON array of {"type", "prefix", "next_hop", "cost"} objects (for scripts)
+    void listEntriesJson_(std::ostream &os) const;
+
+    // Add static routes in one batch: the new table is built from a copy outside the lock and swapped in,
+    // so queries are only blocked for the swap. If the table was written meanwhile, it starts over from it, up to
+    // BULK_LOAD_ATTEMPTS times; then the routes are added under the lock.
+    // Prefixes already in the table, and gateways that are not on a local subnet, are skipped.
+    // Returns the number of routes added.
+    std::size_t bulkLoadStaticRoutes_(const std::vector<SnapshotRoute> &routes);
+
     // Add an entry to the routing table.
     void addEntry_(EntryType type,
                    const std::string &cidr,
@@ -112,27 +140,59 @@ public:
     bool handleRipEntryNoLock_(const RipMessage::Entry &entry, const Ipv4Address &learnedFrom);
 
     // Handle RIP route update. (recv)
-    RipMessage handleRipEntries_(const RipMessage::Entries &ripEntries, const Ipv4Address &learnedFrom);
+    // The entries are taken as sent by the neighbor; the cost of the hop to it is added here.
+    RipMessage handleRipEntries_(const RipMessageView &ripMessage, const Ipv4Address &learnedFrom);
 
     // Generate RIP route entries to send to neighbors. (send)
     RipMessage generateRipEntries_() const;
 
+    // Generate RIP route entries for a periodic update: all entries if `full`, otherwise
+    // only those changed since the previous periodic update. Resets the changed flags.
+    RipMessage generatePeriodicRipEntries_(bool full);
+
+    // Incremented whenever an entry is added, removed, or changes what would be advertised for it.
+    // Lets the router reuse an encoded table while this stays the same.
+    std::uint64_t getGeneration_() const noexcept { return generation_.load(std::memory_order_acquire); }
+
+    // ====================== Link-State Related ======================
+
+    // Install, update or withdraw (no gateway) routes computed by the link-state protocol.
+    // Prefixes that have a route of another type (e.g. local) are left alone.
+    void applyLinkStateRoutes_(const std::vector<LinkStateRouting::InstalledRoute> &routes);
+
+    // ====================== Snapshots ======================
+
+    // Learned RIP routes worth restoring after a restart (confirmed, finite cost)
+    std::vector<SnapshotRoute> snapshotRipRoutes_() const;
+
+    // Preload snapshot routes as provisional RIP routes. They are not advertised, and are replaced by
+    // the first RIP entry received for their prefix or dropped after RIP_PROVISIONAL_TIME.
+    // Routes whose prefix is already in the table, or whose gateway is not on a local subnet, are skipped.
+    // Returns the number of routes loaded.
+    std::size_t loadProvisionalRoutes_(const std::vector<SnapshotRoute> &routes);
+
     // Remove RIP routes that have been expired for RIP_EXPIRATION_TIME
     // Return the removed entries as having infinite cost for triggered update
     // Also remove RIP routes with infinite cost (poisoned routes) but don't send triggered updates for them
-    constexpr RipMessage removeStaleRipEntries_(auto expirationTime)
+    // Provisional routes expire after provisionalTime, silently as they were never advertised
+    constexpr RipMessage removeStaleRipEntries_(auto expirationTime, auto provisionalTime)
     {
         RipMessage::Entries expiredEntries;
         RipMessage::OptionalAddresses learnedFrom;
 
-        const auto now = std::chrono::steady_clock::now();
+        const auto now = tns::util::Clock::now();
         std::unique_lock lock(mutex_);
         for (auto it = entries_.begin(); it != entries_.end(); ) {
             if (it->type == EntryType::RIP) {
                 if (it->metric == RipMessage::INFINITY) {
                     // Remove entry with infinite cost
-                    *it = entries_.back();
-                    entries_.pop_back();
+                    it = eraseEntryNoLock_(it);
+                }
+                else if (it->provisional) {
+                    if (now - it->lastRefresh > provisionalTime)
+                        it = eraseEntryNoLock_(it);
+                    else
+                        it++;
                 }
                 else if (now - it->lastRefresh > expirationTime) {
                     // Triggered update
@@ -141,8 +201,7 @@ public:
                     );
                     learnedFrom.emplace_back(std::nullopt);
                     // Remove expired entry
-                    *it = entries_.back();
-                    entries_.pop_back();
+                    it = eraseEntryNoLock_(it);
                 }
                 else {
                     it++;
@@ -161,9 +220,39 @@ private:
         return std::make_unique<RoutingTable>(node, CtorToken{});
     }
 
+private:
+    // Exact subnet of an entry: (addr & mask, mask), host byte order
+    struct PrefixKey {
+        in_addr_t prefix;
+        in_addr_t mask;
+        bool operator==(const PrefixKey &other) const noexcept = default;
+    };
+    struct PrefixKeyHash {
+        std::size_t operator()(const PrefixKey &key) const noexcept
+        {
+            return tns::util::mix64((static_cast<std::uint64_t>(key.prefix) << 32) | key.mask);
+        }
+    };
+    static PrefixKey prefixKey_(const Ipv4Address &addr, in_addr_t maskHost) noexcept
+    {
+        return {addr.getAddrHost() & maskHost, maskHost};
+    }
+    using PrefixIndex = tns::util::FlatHashMap<PrefixKey, std::size_t, PrefixKeyHash>;
+
+    // Append the static routes that bulkLoadStaticRoutes_() keeps to `entries` and their `index`.
+    // Returns the number of routes added.
+    std::size_t mergeStaticRoutes_(Entries &entries, PrefixIndex &index,
+                                   const std::vector<SnapshotRoute> &routes, tns::util::Clock::time_point now) const;
+
+    // Optimistic bulk loads before falling back to one under the lock, see bulkLoadStaticRoutes_()
+    static constexpr std::size_t BULK_LOAD_ATTEMPTS = 3;
+
 private:
     NetworkNode &node_;
     Entries entries_;
+    PrefixIndex indexByPrefix_;  // Exact subnet -> index in entries_
+    std::atomic<std::uint64_t> generation_{0};  // Only modified with mutex_ held
+    std::uint64_t modifications_ = 0;  // Incremented by every write to entries_ (even one not advertised), under mutex_
     mutable std::shared_mutex mutex_;
 };
 
@@ -3,6 +3,7 @@
 #include <vector>
 #include <thread>
 #include <chrono>
+#include <memory>
 
 #include "network_node.hpp"
 #include "ip/address.hpp"
@@ -15,6 +16,7 @@ class NetworkInterface {
 
     friend class NetworkNode;
     friend class HostNode;
+    friend class RouterNode;
     friend class ip::RoutingTable;
 
 // Visible to NetworkNode and derived classes
@@ -33,6 +35,7 @@ public:
         // The following is used when listing neighbors with `lr`
         ip::Ipv4Address udpAddr_;    // The UDP address for link emulation
         in_port_t udpPort_;      // The UDP port for link emulation
+        sim::MemoryPort *memoryPort_ = nullptr;  // The remote interface's port on a simulated link
     };
     using InterfaceEntries = std::vector<NetworkInterfaceEntry>;
 
@@ -40,18 +43,26 @@ public:
     InterfaceEntries::const_iterator findNextHopInterface(const ip::Ipv4Address &nextHop) const;
 
     // Start receiving incoming datagrams
+    // (on a receive thread, or straight from the scheduler when the link runs in virtual time)
     void startListening();
 
-    // Receive a single datagram from udp_sock_ and submit it to the thread pool of the network node
+    // Stop receiving: wake up and join the receive thread. Sending still works.
+    void stopListening();
+
+    // Receive a single datagram from udp_sock_ (or the memory port) and submit it to the thread pool of the network node
     void recvDatagram() const;
 
     /**
      * Sends the datagram to the next-hop interface in neighborInterfaces_,
-     * effectively emulating the link layer with UDP communication.
+     * effectively emulating the link layer with UDP communication (or an in-memory queue when simulated).
      * Called in RouterNode::forwardDatagram_().
      */
     void sendDatagram(const ip::Datagram &datagram, const ip::Ipv4Address &nextHop) const;
 
+    // Emulate loss, delay, reordering, duplication and a rate limit on the datagrams sent out of this interface
+    void setImpairment(const sim::Impairment &impairment);
+    const sim::LinkImpairment &getImpairment() const noexcept { return *impairment_; }
+
     void  turnOn() { isUp_ =  true; std::cout << "Interface " << name_ << " is up\n";   };
     void turnOff() { isUp_ = false; std::cout << "Interface " << name_ << " is down\n"; };
 
@@ -60,14 +71,30 @@ public:
 
 private:
     // NetworkInterface objects can be constructed only by NetworkNode
+    // With a fabric, the link is simulated in memory: the interface uses the fabric's port for
+    // (udpAddr, udpPort) instead of binding a UDP socket.
     using NodeDatagramSubmitter = std::function<void(DatagramPtr, const ip::Ipv4Address &)>;
     NetworkInterface(NodeDatagramSubmitter submitter,
                      const std::string &cidr, 
                      const std::vector<std::string> &neighborIpAddrs,
                      const std::vector<in_port_t> &neighborUdpPorts,
                      const std::vector<std::string> &neighborUdpAddrs,
+                     const std::string &udpAddr,
                      in_port_t udpPort,
-                     std::string name);
+                     std::string name,
+                     const sim::MemoryFabric *fabric = nullptr);
+
+    // Pop the next datagram from memoryPort_, applying the checks Datagram::recvDatagram() does on the wire
+    tl::expected<DatagramPtr, std::string> recvFromMemoryPort_() const;
+
+    // Checks on a datagram taken off a simulated link: never corrupted, but still ages like on the wire
+    static tl::expected<DatagramPtr, std::string> ageOnLink_(DatagramPtr datagram);
+
+    // Put a datagram on the link to the next-hop interface, bypassing the impairment
+    void transmit_(const ip::Datagram &datagram, const ip::Ipv4Address &nextHopAddr) const;
+
+    // Impairment applied to outgoing datagrams, bound to this object (recreated on move)
+    std::unique_ptr<sim::LinkImpairment> makeImpairment_();
 
 private:
     // Local area network
@@ -77,11 +104,17 @@ private:
     InterfaceEntries neighborInterfaces_;  // Interfaces on the same link as this interface 
 
     // UDP socket emulating the network interface; the link layer is emulated as UDP communication
-    int udp_sock_;
+    int udp_sock_ = -1;
+
+    // Receive queue of this interface when the link is simulated in memory (udp_sock_ is then unused)
+    sim::MemoryPort *memoryPort_ = nullptr;
 
     // Interface thread for receiving datagrams from udp_sock_
     std::thread recvThread_;
 
+    // Emulated impairment of outgoing datagrams (inactive by default)
+    std::unique_ptr<sim::LinkImpairment> impairment_;
+
     std::string name_;       // Name of the interface
     bool isUp_ = true;       // Whether the interface is up
 
@@ -9,9 +9,12 @@
 #include <optional>
 #include <string_view>
 
+#include "ip/address.hpp"
 #include "ip/routing_table.hpp"
 #include "ip/protocols.hpp"
 #include "util/defines.hpp"
+#include "util/flat_hash_map.hpp"
+#include "util/timer_wheel.hpp"
 #include "util/tl/expected.hpp"
 
 
@@ -35,6 +38,13 @@ namespace ip {
     class Datagram;
 } // namespace ip
 
+namespace sim {
+    class MemoryPort;
+    class MemoryFabric;
+    class LinkImpairment;
+    struct Impairment;
+} // namespace sim
+
 class NetworkInterface;
 
 // Abstract class that represents either a host or a router.
@@ -57,17 +67,26 @@ public:
     virtual void enableInterface(const std::string &name);
     virtual void disableInterface(const std::string &name);
 
+    // Emulate an impaired link on the datagrams sent out of an interface (see sim/impairment.hpp)
+    tl::expected<void, std::string> setImpairment(const std::string &interfaceName, const sim::Impairment &impairment);
+
     // Writing node info to an ostream. (Default is standard output.)
     void listInterfaces(std::ostream &os = std::cout) const;
+    void listImpairments(std::ostream &os = std::cout) const;
     void listNeighbors(std::ostream &os = std::cout) const;
     void listRoutes(std::ostream &os = std::cout) const;
 
+    // Bulk-load static routes from a route file (see ip/route_file.hpp), meant for large tables at startup.
+    // Returns the number of routes added, or an error if the file cannot be read.
+    tl::expected<std::size_t, std::string> loadStaticRoutes(const std::string &routeFile);
+
     // void registerRecvHandler(ip::Protocol protocol, PayloadHandler handler);
     void registerRecvHandler(ip::Protocol protocol, DatagramHandler handler);
 
 protected:
     // Initialize the network node with the given parsed data.
-    void initialize_(const util::lnx::NetworkNodeData &nodeData);
+    // With a fabric, the interfaces are attached to its in-memory links instead of UDP sockets.
+    void initialize_(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric = nullptr);
 
     struct QueryResult_ {
         const NetworkInterface &interface;
@@ -84,7 +103,7 @@ protected:
     bool isMyIpAddress_(const ip::Ipv4Address &addr) const;
 
     // Submit the received datagram to the thread pool of the network node to process it.
-    // Enqueue as a task to the thread pool.
+    // Enqueue as a task to the thread pool, or handle it right away when the node runs in virtual time.
     void submitDatagram_(DatagramPtr datagram, const ip::Ipv4Address &infaceAddr) const;
 
     // Send out a payload as an IP datagram to the given destination address using the given protocol.
@@ -107,21 +126,33 @@ protected:
     // Invoke the handler for the protocol specified in the datagram
     void invokeProtocolHandler_(DatagramPtr datagram) const;
 
+    // Start the receive threads of all interfaces.
+    // Derived constructors call this last, once every protocol handler is registered.
+    void startReceiving_();
+
+    // Stop all interfaces from receiving and drop the datagrams not handled yet.
+    // Derived destructors call this first, so no worker thread calls datagramHandler_() on a half-destroyed node.
+    void stopReceiving_();
+
 protected:
     // Routing table of the network node, maps dest IP addresses to interfaces
     std::unique_ptr<ip::RoutingTable> routingTable_;
  
     // Interfaces of the network node
     NetworkInterfaces interfaces_;
-    std::map<ip::Ipv4Address, NetworkInterfaceIter> interfacesByAddr_;
+    util::FlatHashMap<ip::Ipv4Address, NetworkInterfaceIter> interfacesByAddr_;  // Probed for every datagram received
     std::unordered_map<std::string, NetworkInterfaceIter> interfacesByName_;
 
     // Protocol handlers for IP datagrams
     std::unordered_map<ip::Protocol, DatagramHandler> protocolHandlers_;
 
-    // Thread pool to handle received datagrams
+    // Thread pool to handle received datagrams (null in virtual time, where the scheduler's thread handles them)
     std::unique_ptr<util::threading::ThreadPool> threadPool_;
 
+    // Timers of the whole node (routing updates and expiry, TCP retransmissions, ...), on one thread.
+    // Part of the base, so it outlives every timer of the derived node.
+    util::TimerWheel timerWheel_;
+
 private:
     /**
      * Executed by a worker thread after a datagram arrives via one of the interfaces of this node.
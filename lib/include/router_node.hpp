@@ -1,7 +1,10 @@
 #pragma once
 
 #include "network_node.hpp"
+#include "ip/link_state.hpp"
 
+#include <atomic>
+#include <map>
 #include <mutex>
 #include <condition_variable>
 
@@ -13,6 +16,8 @@ public:
     RouterNode();
     RouterNode(const std::string_view lnxFile);
     RouterNode(const std::string &lnxFile);
+    // Build the router from parsed config; with a fabric its links are simulated in memory (see sim/simulator.hpp)
+    RouterNode(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric);
     RouterNode(const RouterNode&) = delete;
     RouterNode(RouterNode&&) = delete;
 
@@ -21,34 +26,123 @@ public:
     void  enableInterface(const std::string &name) override;
     void disableInterface(const std::string &name) override;
 
+    // Counters of RIP traffic handled by this router
+    struct RipStats {
+        std::atomic<std::uint64_t> messagesSent{0};      // RIP messages sent (one per neighbor)
+        std::atomic<std::uint64_t> entriesSent{0};       // Route entries carried by those messages
+        std::atomic<std::uint64_t> messagesRecv{0};
+        std::atomic<std::uint64_t> entriesRecv{0};
+        std::atomic<std::uint64_t> triggeredUpdates{0};  // Triggered updates broadcast after the damping window
+        std::atomic<std::uint64_t> routesTriggered{0};   // Route changes queued for a triggered update
+        std::atomic<std::uint64_t> routesCoalesced{0};   // ... of which superseded by a later change before sending
+        std::atomic<std::uint64_t> periodicFull{0};      // Periodic updates that carried the whole table
+        std::atomic<std::uint64_t> periodicIncremental{0};  // Periodic updates that carried changed routes only
+        std::atomic<std::uint64_t> encodingsReused{0};   // Full periodic updates sent from the cached encoding
+        std::atomic<std::uint64_t> malformedRecv{0};     // Received RIP messages dropped as malformed
+    };
+    const RipStats &getRipStats() const noexcept { return ripStats_; }
+
+    // Write RIP counters to an ostream. (Default is standard output.)
+    void listRipStats(std::ostream &os = std::cout) const;
+
+    // Write the routing table and RIP counters as a single line of JSON, for benchmark scripts.
+    void dumpJson(std::ostream &os = std::cout) const;
+
+    // Write the link-state database to an ostream, if the router runs the link-state protocol.
+    void listLinkState(std::ostream &os = std::cout) const;
+
+    // Warm start: preload the RIP routes saved in the snapshot file (if any) as provisional routes,
+    // then save the learned routes back to it every SNAPSHOT_INTERVAL and on shutdown.
+    void enableRouteSnapshots(const std::string &path);
+
 private:
     void datagramHandler_(DatagramPtr datagram, const ip::Ipv4Address &infaceAddr) const override;
 
     // Forward the received datagram to the correct interface within the network node.
     void forwardDatagram_(const ip::Datagram &datagram) const;
 
-    // Spin up RIP related threads
+    // Arm the RIP related timers
     void initializeRip_();
 
+    // Run the link-state protocol instead of RIP, with the RIP neighbors as its neighbors
+    void initializeLinkState_();
+
+    // Subnets of the interfaces that are up, announced in our LSA
+    std::vector<ip::LsaPrefix> upLocalPrefixes_() const;
+
     // Handler upon receiving a RIP packet
     void ripProtocolHandler_(DatagramPtr datagram);
 
-    // Helpers for sending a RIP message to one/all RIP neighbors
-    // NOTE: These increment the metric of the RIP routes by 1
+    // Helpers for sending a RIP message to one/all RIP neighbors.
+    // The message is encoded once; each neighbor gets a copy with its own routes poisoned.
     void sendRipMessage_(const ip::RipMessage &ripMessage, const ip::Ipv4Address &destIP) const;
     void broadcastRipMessage_(const ip::RipMessage &ripMessage) const;
+    void sendRipEncoding_(const ip::RipEncoding &encoding, const ip::Ipv4Address &destIP) const;
+    void broadcastRipEncoding_(const ip::RipEncoding &encoding) const;
+
+    // Queue the entries of a RIP response for the next triggered update.
+    // A later change to the same route replaces the queued one.
+    void queueTriggeredUpdate_(const ip::RipMessage &ripMessage);
+
+    // Broadcast all queued route changes as a single triggered update
+    void flushTriggeredUpdate_();
+
+    // Write the learned RIP routes to snapshotPath_ if the table changed since the last snapshot
+    void saveRouteSnapshot_();
 
 private:
     std::vector<ip::Ipv4Address> ripNeighbors_;
 
-    // Thread for sending RIP packets to all RIP neighbors at a constant rate
-    PeriodicThreadPtr ripThread_;
+    mutable RipStats ripStats_;
+
+    // Route changes waiting for the next triggered update, keyed by (address, mask) in host byte order
+    struct PendingRoute {
+        ip::RipMessage::Entry entry;
+        std::optional<ip::Ipv4Address> learnedFrom;
+    };
+    std::map<std::pair<std::uint32_t, std::uint32_t>, PendingRoute> pendingRoutes_;
+    std::mutex pendingRoutesMutex_;
+
+    // Number of periodic updates sent so far (only touched by ripTimer_)
+    std::size_t ripRound_ = 0;
+
+    // Encoded full table of the last full periodic update, reused while the routing table generation
+    // is unchanged (only touched by ripTimer_)
+    std::optional<ip::RipEncoding> fullTableEncoding_;
+    std::uint64_t fullTableGeneration_ = 0;
+
+    // One-shot timer sending the startup RIP request
+    std::unique_ptr<util::Timer> ripRequestTimer_;
+
+    // Timer for sending RIP packets to all RIP neighbors at a constant rate
+    PeriodicTimerPtr ripTimer_;
     constexpr static std::chrono::duration RIP_INTERVAL = std::chrono::seconds(5);  // Send RIP packets every 5 seconds
+    // Send the whole table every 2nd round, the changed routes only in the others. Every route is then refreshed
+    // every 10s, three times per RIP_EXPIRATION_TIME, so that a lost update or two do not expire it
+    constexpr static std::size_t RIP_FULL_REFRESH_ROUNDS = 2;
 
-    // Thread for cleaning up RIP routes if they are not refreshed for a certain amount of time
-    PeriodicThreadPtr ripCleanerThread_;
+    // Timer for flushing queued route changes as one triggered update
+    PeriodicTimerPtr ripTriggerTimer_;
+    constexpr static std::chrono::duration RIP_TRIGGER_DAMPING = std::chrono::milliseconds(200);  // Batch changes over 200ms
+
+    // Timer for cleaning up RIP routes if they are not refreshed for a certain amount of time
+    PeriodicTimerPtr ripCleanerTimer_;
     constexpr static std::chrono::duration RIP_CLEANER_INTERVAL = std::chrono::milliseconds(500);  // Clean up RIP routes every half a second
-    constexpr static std::chrono::duration RIP_EXPIRATION_TIME = std::chrono::seconds(12);  // Expire RIP routes not refreshed for 12 seconds
+    constexpr static std::chrono::duration RIP_EXPIRATION_TIME = std::chrono::seconds(30);  // Expire RIP routes not refreshed for 30 seconds
+    constexpr static std::chrono::duration RIP_PROVISIONAL_TIME = std::chrono::seconds(3);  // Drop snapshot routes not confirmed within 3 seconds
+
+    // Route snapshot file (empty if disabled) and the routing table generation it was last written at
+    std::string snapshotPath_;
+    std::optional<std::uint64_t> snapshotGeneration_;
+    std::mutex snapshotMutex_;
+
+    // Timer for saving the route snapshot periodically
+    PeriodicTimerPtr snapshotTimer_;
+    constexpr static std::chrono::duration SNAPSHOT_INTERVAL = std::chrono::seconds(30);
+
+    // Link-state protocol engine (null when running RIP), driven by its timer once per hello interval
+    std::unique_ptr<ip::LinkStateRouting> linkState_;
+    PeriodicTimerPtr linkStateTimer_;
 };
 
 } // namespace tns
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "ip/address.hpp"
+#include "util/clock.hpp"
+#include "util/defines.hpp"
+#include "util/tl/expected.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+namespace tns {
+namespace sim {
+
+// Impairment settings of a link direction, in the spirit of Linux netem.
+struct Impairment {
+    double loss = 0;                  // Probability of dropping a datagram
+    double burst = 1;                 // Mean length of a loss burst (Gilbert model); 1 for independent losses
+    util::Clock::duration delay{};    // Fixed one-way delay
+    util::Clock::duration jitter{};   // Delay varies uniformly within +-jitter (which may reorder datagrams)
+    double reorder = 0;               // Probability of sending a datagram right away, ahead of delayed ones
+    double duplicate = 0;             // Probability of sending a datagram twice
+    std::uint64_t rate = 0;           // Bytes per second, 0 for unlimited
+    std::size_t limit = 1000;         // Datagrams held back at most; more are dropped
+    std::uint64_t seed = 1;           // Seed of the random decisions, for reproducible runs
+
+    bool isActive() const noexcept
+    {
+        return loss > 0 || delay.count() > 0 || jitter.count() > 0 || duplicate > 0 || rate > 0;
+    }
+};
+
+// Parse settings given as "<key> <value>" pairs, e.g. "loss 2% burst 3 delay 40ms jitter 5ms rate 10mbit".
+// Keys: loss, burst, delay, jitter, reorder, duplicate, rate, limit, seed. "off" gives no impairment.
+// Probabilities take a % suffix, times us/ms/s, rates bit/kbit/mbit/gbit (or bps/kbps/... for bytes).
+tl::expected<Impairment, std::string> parseImpairment(std::string_view settings);
+
+std::ostream& operator<<(std::ostream &os, const Impairment &impairment);
+
+// Applies an Impairment to the datagrams sent out of an interface.
+//
+// Each datagram is dropped, duplicated or held back as configured; those held back are handed to the
+// transmit function once due, by a timer thread (started on first use) or, in virtual time, by events
+// of the util::Scheduler. All random decisions come from one generator seeded with Impairment::seed,
+// so a single-threaded (e.g. virtual-time) run is reproducible.
+class LinkImpairment {
+public:
+    using Transmit = std::function<void(const ip::Datagram&, const ip::Ipv4Address &nextHop)>;
+
+    struct Stats {
+        std::atomic<std::uint64_t> passed{0};      // Datagrams handed to the transmit function, duplicates included
+        std::atomic<std::uint64_t> dropped{0};     // Lost on purpose
+        std::atomic<std::uint64_t> duplicated{0};
+        std::atomic<std::uint64_t> reordered{0};   // Sent ahead of the delay
+        std::atomic<std::uint64_t> overLimit{0};   // Dropped because too many were held back
+    };
+
+    explicit LinkImpairment(Transmit transmit);
+    LinkImpairment(const LinkImpairment&) = delete;
+    LinkImpairment& operator=(const LinkImpairment&) = delete;
+    // Datagrams still held back are dropped
+    ~LinkImpairment();
+
+    // Replace the settings and restart the random generator from their seed
+    void configure(const Impairment &impairment);
+    Impairment getConfig() const;
+    bool isActive() const noexcept { return active_.load(std::memory_order_acquire); }
+
+    void send(DatagramPtr datagram, const ip::Ipv4Address &nextHop);
+
+    const Stats &getStats() const noexcept { return stats_; }
+
+private:
+    struct HeldBack {
+        DatagramPtr datagram;
+        ip::Ipv4Address nextHop;
+        int copies;  // 2 if duplicated
+    };
+    using Batch = std::vector<HeldBack>;
+
+    // Departure time of a datagram of the given total size, or nullopt if it is to be sent right away.
+    // linkFree is advanced past the datagram; it is up to the caller to commit it to linkFree_ if the datagram is sent.
+    std::optional<util::Clock::time_point> departureNoLock_(std::size_t size, util::Clock::time_point now,
+                                                            util::Clock::time_point &linkFree);
+    bool chanceNoLock_(double probability) { return probability > 0 && uniform_(rng_) < probability; }
+    bool loseNoLock_();
+
+    // Make sure the held-back datagrams get sent when due: wake the timer thread or schedule an event
+    void armTimerNoLock_();
+    Batch takeDueNoLock_(util::Clock::time_point now);
+    void transmitBatch_(const Batch &batch);
+
+    // Timer event in virtual time: transmit what is due and re-arm
+    void onTimerEvent_();
+    void timerLoop_(std::stop_token stop);
+
+    Transmit transmit_;
+    Stats stats_;
+    std::atomic<bool> active_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any cv_;
+    Impairment config_;
+    std::mt19937_64 rng_;
+    std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+    bool lossBurst_ = false;                          // State of the Gilbert model
+    util::Clock::time_point linkFree_{};              // When the rate limiter finishes the datagrams queued so far
+    std::multimap<util::Clock::time_point, HeldBack> heldBack_;  // By departure time, FIFO among equal times
+    std::uint64_t timerEvent_ = 0;                    // Pending scheduler event, in virtual time
+    util::Clock::time_point timerAt_{};
+    std::jthread timerThread_;  // Declared last: started after, and joined before, the state it uses
+};
+
+} // namespace sim
+} // namespace tns
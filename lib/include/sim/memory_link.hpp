@@ -0,0 +1,92 @@
+#pragma once
+
+#include "util/defines.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/in.h>
+
+
+namespace tns {
+namespace util {
+    class Scheduler;
+} // namespace util
+
+namespace sim {
+
+// Receive queue of one simulated interface: the in-memory stand-in for its UDP socket.
+// Lock-free multi-producer, single-consumer queue (any node may send to it, only the interface's
+// receive thread pops). The consumer sleeps on an atomic counter while the queue is empty.
+//
+// A port created with a scheduler has no queue: each push schedules the delivery of the datagram
+// to the receiver instead, so datagrams travel in virtual time. Such ports must be owned by a shared_ptr.
+class MemoryPort : public std::enable_shared_from_this<MemoryPort> {
+public:
+    using Receiver = std::function<void(DatagramPtr)>;
+
+    MemoryPort();
+    explicit MemoryPort(util::Scheduler *scheduler);
+    MemoryPort(const MemoryPort&) = delete;
+    MemoryPort& operator=(const MemoryPort&) = delete;
+    ~MemoryPort();
+
+    // Enqueue a datagram. Returns false (and drops it) if the port is closed.
+    bool push(DatagramPtr datagram);
+
+    // Dequeue the oldest datagram, blocking while the queue is empty. Returns null once the port is closed.
+    DatagramPtr pop();
+
+    // Wake up the consumer and drop everything sent from now on
+    void close() noexcept;
+
+    bool isClosed() const noexcept { return closed_.load(std::memory_order_acquire); }
+
+    // Scheduled ports only: set the function the scheduler hands datagrams to. Datagrams delivered
+    // while there is no receiver are dropped.
+    void setReceiver(Receiver receiver) { receiver_ = std::move(receiver); }
+    bool isScheduled() const noexcept { return scheduler_ != nullptr; }
+
+private:
+    // Scheduled ports: hand a datagram to the receiver, unless the port was closed in the meantime
+    void deliver_(DatagramPtr datagram) const;
+
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        DatagramPtr datagram;
+    };
+
+    std::atomic<Node*> head_;  // Most recently pushed node (producers)
+    Node *tail_;               // Stub node before the oldest datagram (consumer)
+    std::atomic<std::uint32_t> pending_{0};  // Datagrams pushed but not popped yet; the consumer waits on it
+    std::atomic<bool> closed_{false};
+    util::Scheduler *scheduler_ = nullptr;
+    Receiver receiver_;
+};
+
+// The in-memory "wire" of a simulated network: one MemoryPort per interface, keyed by the UDP
+// address the interface would otherwise bind. All ports are created up front, so lookups never
+// race with insertions and need no lock. With a scheduler, all ports deliver in virtual time.
+class MemoryFabric {
+public:
+    explicit MemoryFabric(const std::vector<sockaddr_in> &endpoints, util::Scheduler *scheduler = nullptr);
+    MemoryFabric(const MemoryFabric&) = delete;
+    MemoryFabric& operator=(const MemoryFabric&) = delete;
+
+    // Port bound to the given UDP address, or null if there is none
+    MemoryPort *find(const sockaddr_in &endpoint) const noexcept;
+
+    std::size_t size() const noexcept { return ports_.size(); }
+
+private:
+    static std::uint64_t key_(const sockaddr_in &endpoint) noexcept;
+
+    std::unordered_map<std::uint64_t, std::shared_ptr<MemoryPort>> ports_;
+};
+
+} // namespace sim
+} // namespace tns
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "ip/address.hpp"
+#include "util/tl/expected.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+namespace tns {
+
+class NetworkNode;
+class HostNode;
+class RouterNode;
+
+namespace sim {
+
+class MemoryFabric;
+
+// A network topology in the format of nets/*.json: named hosts and routers, and networks (links)
+// listing the nodes attached to them.
+struct Topology {
+    struct Node {
+        std::string name;
+        bool isRouter;
+    };
+    struct Network {
+        std::string name;
+        std::vector<std::string> links;  // Node names, in order of address assignment
+    };
+
+    std::vector<Node> nodes;
+    std::vector<Network> networks;
+};
+
+// Parse a topology from JSON text / a nets/*.json file. Fails on malformed JSON, unknown node types
+// and networks linking undeclared nodes.
+tl::expected<Topology, std::string> parseTopology(std::string_view json);
+tl::expected<Topology, std::string> loadTopology(const std::string &path);
+
+// Runs every host and router of a topology in this process, linked by in-memory queues instead of UDP.
+// Addresses, interface names and routing config are assigned exactly as util/vnet_generate does:
+// network i gets 10.<i % 256>.<i / 256>.0/24, its nodes get .1, .2, ... in link order, routers run
+// RIP with their router neighbors and hosts default-route to their first neighboring router.
+// The nodes are fully running once the constructor returns; destroying the simulator stops them.
+//
+// Built while a util::Scheduler is alive, the simulation runs in virtual time on the thread running the
+// scheduler: links deliver through it, nodes handle datagrams inline and the routing timers are its events,
+// so e.g. minutes of RIP convergence replay deterministically in milliseconds. The scheduler must outlive
+// the simulator. TCP sockets still run their own threads in real time.
+class Simulator {
+public:
+    // Throws std::runtime_error if the topology cannot be built (e.g. a host without a router)
+    explicit Simulator(const Topology &topology);
+    Simulator(const Simulator&) = delete;
+    Simulator& operator=(const Simulator&) = delete;
+    ~Simulator();
+
+    // Nodes by name. Throw std::out_of_range for unknown names or the wrong node type.
+    NetworkNode &node(const std::string &name);
+    HostNode &host(const std::string &name);
+    RouterNode &router(const std::string &name);
+
+    // Virtual IP address of a node's interface `if<index>`
+    ip::Ipv4Address address(const std::string &name, std::size_t index = 0) const;
+
+    std::size_t size() const noexcept { return nodes_.size(); }
+
+private:
+    struct SimNode {
+        std::unique_ptr<NetworkNode> node;
+        HostNode *host = nullptr;
+        RouterNode *router = nullptr;
+        std::vector<ip::Ipv4Address> addresses;  // By interface index
+    };
+
+    const SimNode &find_(const std::string &name) const;
+
+    std::unique_ptr<MemoryFabric> fabric_;  // Declared first: outlives the nodes sending through it
+    std::unordered_map<std::string, SimNode> nodes_;
+};
+
+} // namespace sim
+} // namespace tns
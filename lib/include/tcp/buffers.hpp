@@ -1,17 +1,27 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cassert>
 #include <condition_variable>
+#include <functional>
 // #include <iostream>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <ranges>
 #include <span>
+#include <utility>
 // #include <experimental/memory>
 
+#include "tcp/congestion_control.hpp"
 #include "tcp/intervals.hpp"
+#include "tcp/options.hpp"
 #include "tcp/retransmission_queue.hpp"
 #include "tcp/socket_error.hpp"
+#include "tcp/util.hpp"
 #include "util/defines.hpp"
+#include "util/timer_wheel.hpp"
 #include "util/tl/expected.hpp"
 
 
@@ -41,6 +51,7 @@ public:
         assert(last - at < N && "Cannot write more than the buffer size");
         // Alternatively: last = std::min(last, at + N - 1);
 
+        const auto buf = storage_().begin();
         auto atIdx = idx(at);
         auto lastIdx = idx(last);
         auto lastIdxPlus1 = lastIdx + 1;
@@ -48,7 +59,7 @@ public:
         if (atIdx <= lastIdx) {
             // [atIdx, lastIdx] is the available range for write
             const auto n = std::min(lastIdxPlus1 - atIdx, data.size());
-            std::copy(data.begin(), data.begin() + n, buf_.begin() + atIdx);
+            std::copy(data.begin(), data.begin() + n, buf + atIdx);
             return n;
         }
         else {
@@ -57,17 +68,17 @@ public:
             const auto n1 = N - atIdx;
             if (n1 >= nLeft) {
                 // Copy to buf_[atIdx, atIdx + data.size())
-                std::copy(data.begin(), data.begin() + nLeft, buf_.begin() + atIdx);
+                std::copy(data.begin(), data.begin() + nLeft, buf + atIdx);
                 return nLeft;
             }
             else {
                 // Copy to buf_[atIdx, N)
-                std::copy(data.begin(), data.begin() + n1, buf_.begin() + atIdx);
+                std::copy(data.begin(), data.begin() + n1, buf + atIdx);
                 nLeft -= n1;
 
                 // Copy to buf_[0, std::min(lastIdx + 1, nLeft))
                 const auto n2 = std::min(lastIdxPlus1, nLeft);
-                std::copy(data.begin() + n1, data.begin() + n1 + n2, buf_.begin());
+                std::copy(data.begin() + n1, data.begin() + n1 + n2, buf);
 
                 return n1 + n2;
             }
@@ -85,6 +96,58 @@ public:
      * @param last The *absolute* index of last (potential) element to read, inclusive
      */
     std::size_t read(const std::span<T> buff, const std::size_t at, const std::size_t last) const
+    {
+        return readWith_(buff, at, last, [](auto first, auto lastExcl, auto dst) {
+            std::copy(first, lastExcl, dst);
+        });
+    }
+
+    /**
+     * @brief View the `n` elements starting from buf_[idx(at)] without copying them: the run up to the end of the
+     * buffer, and the one that wraps around to its start (empty if none does).
+     * 
+     * @param at The *absolute* index of first element to view, inclusive
+     * @param n The number of elements to view, at most N
+     */
+    std::pair<std::span<const T>, std::span<const T>> view(const std::size_t at, const std::size_t n) const
+    {
+        assert(n <= N && "Cannot view more than the buffer size");
+        const std::span<const T> buf{storage_()};
+        const auto atIdx = idx(at);
+        const auto n1 = std::min(n, N - atIdx);
+        return {buf.subspan(atIdx, n1), buf.first(n - n1)};
+    }
+
+    const T& at(std::size_t seq) const { return storage_()[idx(seq)]; }
+
+    // // for DEBUG
+    // void print() const noexcept
+    // {
+    //     for (const auto &elem : buf_)
+    //         std::cout << elem << ", ";
+    //     std::cout << "\n";
+    // }
+
+    static constexpr std::size_t max_size() noexcept { return N; }
+
+protected:
+    // The storage is allocated on the first access, so that idle connections hold no buffer memory.
+    // Like the rest of the ring, it is guarded by the owner.
+    std::array<T, N>& storage_() const
+    {
+        if (!buf_)
+            buf_ = std::make_unique_for_overwrite<std::array<T, N>>();
+        return *buf_;
+    }
+
+    mutable std::unique_ptr<std::array<T, N>> buf_;
+protected:
+    static constexpr std::size_t idx(std::size_t seq) noexcept { return seq % N; }
+
+private:
+    // Body of read(); `copy(first, last, dst)` moves one contiguous run of the ring into buff
+    template <typename CopyFn>
+    std::size_t readWith_(const std::span<T> buff, const std::size_t at, const std::size_t last, CopyFn &&copy) const
     {
         if (at > last)
             return 0;
@@ -94,6 +157,7 @@ public:
         assert(last - at < N && "Cannot read more than the buffer size");
         // Alternatively: last = std::min(last, at + N - 1);
 
+        const auto buf = storage_().begin();
         auto atIdx = idx(at);
         auto lastIdx = idx(last);
         auto lastIdxPlus1 = lastIdx + 1;
@@ -101,7 +165,7 @@ public:
         if (atIdx <= lastIdx) {
             // [atIdx, lastIdx] is the available range for read
             const auto n = std::min(lastIdxPlus1 - atIdx, buff.size());
-            std::copy(buf_.begin() + atIdx, buf_.begin() + atIdx + n, buff.begin());
+            copy(buf + atIdx, buf + atIdx + n, buff.begin());
             return n;
         }
         else {
@@ -110,39 +174,22 @@ public:
             const auto n1 = N - atIdx;
             if (n1 >= nLeft) {
                 // Copy to buff[0, buff.size())
-                std::copy(buf_.begin() + atIdx, buf_.begin() + atIdx + nLeft, buff.begin());
+                copy(buf + atIdx, buf + atIdx + nLeft, buff.begin());
                 return nLeft;
             }
             else {
                 // Copy to buff[0, N - atIdx)
-                std::copy(buf_.begin() + atIdx, buf_.begin() + atIdx + n1, buff.begin());
+                copy(buf + atIdx, buf + atIdx + n1, buff.begin());
                 nLeft -= n1;
 
                 // Copy to buff[n1, std::min(lastIdx + 1, nLeft))
                 const auto n2 = std::min(lastIdx + 1, nLeft);
-                std::copy(buf_.begin(), buf_.begin() + n2, buff.begin() + n1);
+                copy(buf, buf + n2, buff.begin() + n1);
 
                 return n1 + n2;
             }
         }
     }
-
-    const T& at(std::size_t seq) const { return buf_[idx(seq)]; }
-
-    // // for DEBUG
-    // void print() const noexcept
-    // {
-    //     for (const auto &elem : buf_)
-    //         std::cout << elem << ", ";
-    //     std::cout << "\n";
-    // }
-
-    static constexpr std::size_t max_size() noexcept { return N; }
-
-protected:
-    std::array<T, N> buf_;
-protected:
-    static constexpr std::size_t idx(std::size_t seq) noexcept { return seq % N; }
 };
 
 
@@ -153,8 +200,10 @@ public:
     // using seq_t = std::uint32_t?
 
     SendBuffer() = default;
-    SendBuffer(std::uint32_t initSeqNum, std::uint32_t windowSize) noexcept
-        : una_(initSeqNum), nxt_(initSeqNum), nbw_(initSeqNum), wnd_(windowSize) 
+    SendBuffer(std::uint32_t initSeqNum, std::uint32_t windowSize,
+               CongestionAlgorithm congestionAlgorithm = CongestionAlgorithm::NEW_RENO)
+        : una_(initSeqNum), nxt_(initSeqNum), nbw_(initSeqNum), pinned_(initSeqNum), wnd_(windowSize)
+        , cc_(makeCongestionControl(congestionAlgorithm))
     {}
 
     ~SendBuffer() { shutdown(); std::cout << "SendBuffer DESTRUCTED\n"; }
@@ -187,15 +236,15 @@ public:
                 if (stopped_)
                     return tl::unexpected{SocketError::CLOSING};
 
-                n = RB::write(bytesLeft, nbw_, nbw_ + sizeFreeNoLock_()-1);  // Write to [nbw_..una_ + N-1]            
+                n = RB::write(bytesLeft, nbw_, nbw_ + sizeFreeNoLock_()-1);  // Write to [nbw_..pinned_ + N-1]            
                 nbw_ += static_cast<decltype(nbw_)>(n);                      // Move nbw_ to the right
 
                 // std::cout << "Wrote " << n << " bytes to the buffer, nbw_ = " << nbw_ << "\n";
 
-                // Notify the single SENDER thread that there is new data to send out
-                // std::cout << "sizeCanSend = " << sizeCanSendNoLock_() << ", notifying sender thread\n";
+                // Tell the transmit scheduler that there is new data to send out
+                // std::cout << "sizeCanSend = " << sizeCanSendNoLock_() << ", notifying transmit scheduler\n";
                 if (sizeCanSendNoLock_() > 0)
-                    cvSender_.notify_one();
+                    notifyReadyNoLock_();
             }
         }
         return data.size_bytes();
@@ -208,17 +257,32 @@ public:
      * It updates the unacknowledged data pointer (una_) if the received ACK number is within the expected range.
      * After updating, it notifies all waiting (write) threads.
      * 
+     * A segment without data that acknowledges nothing new while data is in flight, and leaves the window as is,
+     * is a duplicate ACK: the remote got a segment out of order. Each of the first ones lets one new segment out
+     * (limited transmit, RFC 3042), and the DUPACK_THRESHOLD-th one triggers a fast retransmit of the first
+     * unacknowledged segment and enters fast recovery (RFC 5681 and RFC 6582), see takeFastRetransmit().
+     * With SACK, the duplicate ACKs in fast recovery resend the other holes the SACK blocks reveal, one per ACK,
+     * rather than waiting for a partial ACK per hole (RFC 6675).
+     * 
+     * With timestamps, an ACK of new data yields an RTT sample from the echoed timestamp, even when the data
+     * acknowledged was retransmitted (RFC 7323, section 4).
+     * 
      * @param ackNum The number of the received acknowledgement
      * @param wndSize The window size advertised by the remote
+     * @param pureAck Whether the segment carries no data (nor SYN/FIN), i.e. may be a duplicate ACK
+     * @param options The options of the segment: SACK blocks and timestamps, if any
      * @return The new in-flight data window as a pair of (una_, nxt_)
      */
     std::pair<std::uint32_t, std::uint32_t>
-    onAck(std::uint32_t ackNum, std::uint32_t wndSize)
+    onAck(std::uint32_t ackNum, std::uint32_t wndSize, bool pureAck = false, const TcpOptions &options = {})
     {
         std::pair<std::uint32_t, std::uint32_t> una_nxt{};
         {
             std::lock_guard lk(mutex_);
 
+            if (options.numSackBlocks > 0)
+                retransmitQueue.onSack(options.sack());
+
             una_nxt.first  = una_;
             una_nxt.second = nxt_;
 
@@ -230,23 +294,26 @@ public:
              * segments that carry the highest acknowledgment number (that is, segments with an acknowledgment number equal to 
              * or greater than the highest previously received).
              */
+            if (pureAck && ackNum == una_ && una_ != nxt_ && wndSize == wnd_ && wnd_ > 0)
+                onDuplicateAckNoLock_();
+
             if (ackNum >= una_) {
                 // Update the window size
-                if (wndSize > wnd_)
-                    cvSender_.notify_one();  // Notify SENDER thread if window expands
+                const auto oldWnd = wnd_;
                 wnd_ = wndSize;
+                maxWnd_ = std::max(maxWnd_, wnd_);
 
-                // zwp_.onWnd(wndSize);
                 switch (zwp_.state) {
                 case 0:  // PAUSE
                     if (wnd_ == 0) {
                         std::cout << "Got zero window ack (" << ackNum << ") in state 0" << std::endl;
-                        zwp_.cvOnPause.notify_one();
+                        zwpStartCountdownNoLock_();
                     }
                     break;
                 case 1:  // COUNTDOWN
                     // std::cout << "Got ack (" << ackNum << ") with WND = " << wnd_ << " in state 1" << std::endl;
-                    zwp_.cvOnCountdown.notify_one();
+                    if (wnd_ > 0)
+                        zwp_.state = 0;  // The window opened: the pending timeout finds nothing to probe
                     break;
                 case 2:  // WAITACK
                     std::cout << "Got ack (" << ackNum << ") with WND = " << wnd_ << " in state 2" << std::endl;
@@ -255,14 +322,19 @@ public:
                      * timeout period (SHLD-29) (Section 3.8.1), and SHOULD increase exponentially the interval between successive probes (SHLD-30).
                     */
                     if (ackNum > zwp_.seq) {
-                        // If the probe data is ACKed, go back to PAUSE (new probe)
+                        // If the probe data is ACKed, go back to PAUSE (new probe if the window is still closed)
                         zwp_.state = 0;
-                        zwp_.cvOnCountdown.notify_one();
+                        if (wnd_ == 0)
+                            zwpStartCountdownNoLock_();
                     } else if (wnd_ > 0) {
                         retransmitQueue.resetZwpCounter();  // Restart the exponential countdown
                     }
                     break;
                 }
+
+                // A window update alone (e.g. the window reopening) may let the data held back go
+                if (wnd_ > oldWnd && sizeCanSendNoLock_() > 0)
+                    notifyReadyNoLock_();
             }
             
 
@@ -275,7 +347,37 @@ public:
                 return una_nxt;
 
             // Acceptable ACK
+            const std::size_t bytesAcked = ackNum - una_;
+            if (options.timestamps) {
+                // About one sample per two segments in flight: each weighs less than a sample per round trip
+                const auto rtt = std::chrono::milliseconds{timestampNow() - options.timestamps->echoReply};
+                retransmitQueue.rto.addRttSample(rtt, sizeUnackedNoLock_() / (2 * MAX_TCP_PAYLOAD_SIZE));
+            }
+            if (!fastRecovery_) {
+                cc_->onAck(bytesAcked, retransmitQueue.rto.getSrtt());  // Grow the congestion window
+            } else if (ackNum >= recover_) {
+                fastRecovery_ = false;  // Full ACK: back to the reduced congestion window
+            } else {
+                // Partial ACK: the next segment was lost too. Resend it now, and deflate the window by the bytes
+                // acknowledged, keeping one segment for the retransmission (RFC 6582, section 3.2)
+                recoveryWnd_ = recoveryWnd_ - std::min(recoveryWnd_, bytesAcked) + MAX_TCP_PAYLOAD_SIZE;
+                ++pendingRetransmits_;
+                ++fastRetransmits_;
+            }
+            dupAcks_ = 0;
+            if (rtoRecovery_ && ackNum >= recover_)
+                rtoRecovery_ = false;  // Everything in flight at the timeout made it
+
+            // Any segments on the retransmission queue that are thereby
+            // *entirely* acknowledged are removed (3.10.7.4 RFC9293).
+            // Their bytes may be overwritten from now on, but not those of a segment acknowledged in part,
+            // which its retransmissions still read from the buffer
+            retransmitQueue.onAck(ackNum, /* sampleRtt= */ !options.timestamps);
+            pinned_ = std::min(ackNum, retransmitQueue.getFirstSeq().value_or(ackNum));
+
             una_ = una_nxt.first = ackNum;  // una_ is guaranteed to shift right -> notify writer threads
+            if (sizeCanSendNoLock_() > 0 || rtoRecovery_ || pendingRetransmits_ > 0)
+                notifyReadyNoLock_();  // Room in the window for the data not sent yet, or for retransmissions
 
             // std::cout << "Got valid ACK: now una_ = " << ackNum << ", nxt_ = " << nxt_ << ", sizeFree = " 
             //           << sizeFreeNoLock_() << ", wnd_ = " << wnd_ << "\n";
@@ -284,43 +386,95 @@ public:
 
         cvWriter_.notify_all();  // Acceptable ACK -> notify writers there's more space
 
-        // Any segments on the retransmission queue that are thereby
-        // *entirely* acknowledged are removed (3.10.7.4 RFC9293)
-        retransmitQueue.onAck(ackNum);
-
         return una_nxt;
     }
 
-    // TODO: This function currently copies the data from the sendbuffer to the provided buffer and is inefficient.
-    // Instead we should return a locked range of the sendbuffer and expect the caller to release the lock after use.
-    using SeqLenPair = std::pair<std::uint32_t, std::size_t>;
-    auto sendReadyData(const std::span<std::byte> buff) -> tl::expected<SeqLenPair, SocketError>
-    {
-        std::unique_lock lk{mutex_};
-        // if (sizeCanSendNoLock_() == 0) {
-        //     std::cout << "sendReadyData(): waiting for data to send (sizeCanSend=0, wnd_=" << wnd_ << ")" << std::endl;
-        // }
-        cvSender_.wait(lk, [this] { return sizeCanSendNoLock_() > 0 || stopped_; });
-
-        if (stopped_)
-            return tl::unexpected{SocketError::CLOSING};
+    // A segment's worth of ready data, as a view of the send buffer
+    struct ReadySegment {
+        std::uint32_t seq;
+        PayloadSpans payload;
+    };
 
-        const auto seq = nxt_;
-        const auto n = std::min(sizeCanSendNoLock_(), buff.size());  // Send as many bytes as we can
+    // Takes up to `maxSize` bytes of ready data, without copying them: the packet built on the view (and put on the
+    // retransmission queue) is serialized straight from the buffer, which keeps the bytes until the retransmission
+    // queue lets go of the segment, see onAck(). Segments of less than `maxSize` bytes may be held back, see
+    // sizeReadyNoLock_().
+    // Returns nullopt if nothing can be sent (no data, closed window, held back, or shut down). Never blocks.
+    auto takeReadyData(const std::size_t maxSize) -> std::optional<ReadySegment>
+    {
+        std::lock_guard lk{mutex_};
+        const auto n = sizeReadyNoLock_(maxSize);
+        if (stopped_ || n == 0)
+            return std::nullopt;
 
-        [[maybe_unused]] auto nRead = RB::read(buff, nxt_, nxt_ + n-1);
-        assert(nRead == n && "Failed to read correct number of bytes from send buffer");
+        const auto [head, tail] = RB::view(nxt_, n);
+        ReadySegment segment{nxt_, {head, tail}};
 
-        wnd_ -= static_cast<decltype(wnd_)>(n);  // We shrink the window precautiously (before onAck) to avoid over-sending
         nxt_ += static_cast<decltype(nxt_)>(n);  // Move those bytes to `sent but un-acked`
 
-        // std::cout << "sendReadyData(): sent " << n << " bytes, nxt_ = " << nxt_ 
+        // std::cout << "takeReadyData(): sent " << n << " bytes, nxt_ = " << nxt_ 
         //           << ", una_ = " << una_ << ", sizeCanSend = " << sizeCanSendNoLock_() << "\n";
 
         // No need to notify anyone here, as the sent bytes are still in the queue (moved from ready to unacked)
-        return std::make_pair(seq, n);
+        return segment;
     }
 
+    // Whether takeReadyData(maxSize) would return a segment now
+    bool hasReadyData(const std::size_t maxSize) const { std::lock_guard lk(mutex_); return !stopped_ && sizeReadyNoLock_(maxSize) > 0; }
+
+    // Nagle's algorithm (RFC 896), on by default: while data is in flight, the last bytes written wait for its ACK
+    // rather than going out in a segment of their own. Turning it off (TCP_NODELAY) sends them at once.
+    void setNoDelay(bool noDelay)
+    {
+        std::lock_guard lk(mutex_);
+        noDelay_ = noDelay;
+        if (noDelay && sizeCanSendNoLock_() > 0)
+            notifyReadyNoLock_();
+    }
+    bool isNoDelay() const { std::lock_guard lk(mutex_); return noDelay_; }
+
+    // While corked, only full segments are sent, whatever is in flight (TCP_CORK), so that the application can put
+    // several writes in one segment. Uncorking sends the rest.
+    void setCork(bool cork)
+    {
+        std::lock_guard lk(mutex_);
+        corked_ = cork;
+        if (!cork && sizeCanSendNoLock_() > 0)
+            notifyReadyNoLock_();
+    }
+    bool isCorked() const { std::lock_guard lk(mutex_); return corked_; }
+
+    // Nothing more will be written: the FIN goes out after the data left in the buffer, see takeFin(). Nagle's
+    // algorithm and the cork stop holding back the last bytes.
+    void queueFin()
+    {
+        std::lock_guard lk(mutex_);
+        finQueued_ = true;
+        corked_ = false;
+        noDelay_ = true;
+        if (!stopped_)
+            notifyReadyNoLock_();
+    }
+
+    // The sequence number of the FIN, once it is due: queued, not sent yet, and all the data before it sent.
+    // The FIN takes up that sequence number. Returns nullopt otherwise.
+    std::optional<std::uint32_t> takeFin()
+    {
+        std::lock_guard lk(mutex_);
+        if (stopped_ || !finQueued_ || finSent_ || nxt_ != nbw_)
+            return std::nullopt;
+        finSent_ = true;
+        writeAndSendOneNoLock();
+        return nxt_ - 1;
+    }
+
+    // Whether the FIN was sent, so that SND.NXT is past it
+    bool isFinSent() const { std::lock_guard lk(mutex_); return finSent_; }
+
+    // Called (with the buffer locked, so it must not call back into it) whenever data becomes ready to send.
+    // Set once by the socket owning the buffer.
+    void setReadyCallback(std::function<void()> onReady) { onReady_ = std::move(onReady); }
+
     auto getSizeUnacked() const { std::lock_guard lk(mutex_); return sizeUnackedNoLock_(); }
     auto getSizeNotSent() const { std::lock_guard lk(mutex_); return sizeNotSentNoLock_(); }
     auto getSizeCanSend() const { std::lock_guard lk(mutex_); return sizeCanSendNoLock_(); }
@@ -330,6 +484,57 @@ public:
     auto getWndEndExclusiveNoLock() const { return una_ + wnd_; }
     auto getWndEndExclusive() const { std::lock_guard lk(mutex_); return getWndEndExclusiveNoLock(); }
 
+    // End of the data that may be in flight: the peer's window, capped by the congestion window
+    auto getSendWndEndExclusive() const { std::lock_guard lk(mutex_); return una_ + sendWndNoLock_(); }
+
+    /**
+     * @brief Handle the expiry of the retransmission timer.
+     *
+     * Shrinks the congestion window to one segment, backs off the RTO, and enters RTO recovery: until everything
+     * in flight now is acknowledged, each acceptable ACK asks the transmit scheduler to resend the timed out
+     * segments that fit in the (growing) congestion window, instead of waiting for the timer again.
+     */
+    void onRetransmitTimeout()
+    {
+        std::lock_guard lk(mutex_);
+        cc_->onRetransmitTimeout(sizeUnackedNoLock_(), /* repeated= */ rtoRecovery_);
+        retransmitQueue.rto.backoff();
+        retransmitQueue.onRetransmitTimeout();
+        rtoRecovery_ = true;
+        recover_ = nxt_;
+        fastRecovery_ = false;
+        dupAcks_ = pendingRetransmits_ = 0;
+        ++retransmitTimeouts_;
+    }
+    bool isInRtoRecovery() const { std::lock_guard lk(mutex_); return rtoRecovery_; }
+
+    // If a fast retransmit is due, takes it and returns SND.UNA: the next hole after it is to be resent at once
+    // (see RetransmissionQueue::retransmitNextHole)
+    std::optional<std::uint32_t> takeFastRetransmit()
+    {
+        std::lock_guard lk(mutex_);
+        if (pendingRetransmits_ == 0)
+            return std::nullopt;
+        --pendingRetransmits_;
+        return una_;
+    }
+    bool isInFastRecovery() const { std::lock_guard lk(mutex_); return fastRecovery_; }
+
+    // Losses recovered by fast retransmits (including those of partial ACKs), and by retransmission timeouts
+    auto getFastRetransmits() const { std::lock_guard lk(mutex_); return fastRetransmits_; }
+    auto getRetransmitTimeouts() const { std::lock_guard lk(mutex_); return retransmitTimeouts_; }
+
+    // Replaces the congestion control with a fresh instance of an algorithm
+    void setCongestionAlgorithm(CongestionAlgorithm algorithm)
+    {
+        auto cc = makeCongestionControl(algorithm);
+        std::lock_guard lk(mutex_);
+        cc_ = std::move(cc);
+    }
+    auto getCongestionAlgorithm() const { std::lock_guard lk(mutex_); return cc_->algorithm(); }
+    auto getCwnd() const { std::lock_guard lk(mutex_); return cc_->cwnd(); }
+    auto getSsthresh() const { std::lock_guard lk(mutex_); return cc_->ssthresh(); }
+
     // Dirty ad-hoc stuff for handling handshakes ...
     // because we didn't consider the buffers when coding the handshake
     void writeAndSendOneNoLock() { ++nbw_; ++nxt_; }
@@ -343,12 +548,10 @@ public:
             stopped_ = true;
         }
         cvWriter_.notify_all();
-        cvSender_.notify_all();
-
-        zwp_.cvOnPause.notify_one();
-        zwp_.cvOnCountdown.notify_one();
     }
 
+    bool isShutdown() const { std::lock_guard lk(mutex_); return stopped_; }
+
     struct LockedDataView {
         std::uint32_t seq;
         std::span<const std::byte> data;
@@ -358,39 +561,27 @@ public:
         auto size() const noexcept { return data.size(); }
     };
 
-    // Returns a locked (1 byte) range of the sendbuffer, or a SocketError
-    auto zwpGetProbeByte() -> tl::expected<LockedDataView, SocketError>
-    {
-        static constexpr auto ZWP_TIMEOUT = RetransmissionQueue::RtoEstimator::MIN_RTO * 4;
+    // Timer counting down a zero window before probing it, see zwpOnTimeout(). Set once by the socket owning the buffer.
+    void setZwpTimer(tns::util::Timer *timer) noexcept { zwpTimer_ = timer; }
 
+    // Called when the zero-window probe timer fires. Returns a locked (1 byte) range of the sendbuffer to send
+    // as a probe, an empty view if no probe is due, or a SocketError once shut down
+    auto zwpOnTimeout() -> tl::expected<LockedDataView, SocketError>
+    {
         std::unique_lock lk{mutex_};
-
-        // Wait until we get a WND = 0
-        zwp_.state = 0;  // PAUSE
-        zwp_.cvOnPause.wait(lk, [this] { return wnd_ == 0 || stopped_; });
         if (stopped_)
             return tl::unexpected{SocketError::CLOSING};
 
-        // Wait until we get a WND > 0, or ZWP timeout
-        // std::cout << "Got WND = 0; ZWP counting down..." << std::endl;
-        zwp_.state = 1;  // COUNTDOWN
-        const auto pred = zwp_.cvOnCountdown.wait_for(lk, ZWP_TIMEOUT, 
-            [this] { return wnd_ > 0 || stopped_; });
-        if (stopped_)
-            return tl::unexpected{SocketError::CLOSING};
-
-        // If pred, that means we got an ACK with WND > 0, so we go back to pause
-        if (pred) {
-            zwp_.state = 0;
+        // An ACK with WND > 0 arrived during the countdown
+        if (zwp_.state != 1)
             return LockedDataView{};
-        }
 
         // Otherwise, WND is still 0 (but we timed out), so send a probe and wait for ACK
         std::cout << "ZWP timeout! Sending probe...\n";
 
         if (sizeNotSentNoLock_() == 0) {
-            zwp_.state = 0;
-            std::cout << "Ooops, no data to send, going back to begining\n";
+            std::cout << "Ooops, no data to send, counting down again\n";
+            zwpStartCountdownNoLock_();
             return LockedDataView{};
         }
 
@@ -404,73 +595,6 @@ public:
         return LockedDataView{zwp_.seq, data, std::move(lk)};
     }
 
-    auto zwpWaitAck(LockedDataView &&ldv) -> tl::expected<void, SocketError>
-    {
-        // Responds to any new advertised WND by going back to the begining of the loop
-        zwp_.cvOnCountdown.wait(ldv.lock, [this] { return zwp_.state == 0 || stopped_; });
-        if (stopped_)
-            return tl::unexpected{SocketError::CLOSING};
-
-        return {};
-    }
-
-    // void zwpRecordRetransmitEntry(RetransmissionQueue::Entry &entry)
-    // {
-    //     zwp_.retransmitEntry = std::experimental::make_observer(&entry);
-    // }
-
-    // void zwpResetRetransmitEntry()
-    // {
-    //     zwp_.retransmitEntry = nullptr;
-    // }
-
-    // void zwpFunction(std::function<void(Packet &&)> packetSender)
-    // {
-    //     static constexpr auto ZWP_TIMEOUT = std::chrono::seconds{3};
-    //     while (true) {
-    //         std::unique_lock lk{mutex_};
-
-    //         // Wait until we get a WND=0
-    //         zwp_.state = 0;
-    //         zwp_.cvOnPause.wait(lk, [this] { return wnd_ == 0 || stopped_; });
-    //         if (stopped_) break;
-
-    //         // Wait until we get a WND > 0, or ZWP timeout
-    //         std::cout << "ZWP counting down...\n";
-    //         zwp_.state = 1;
-    //         const auto pred = zwp_.cvOnCountdown.wait_for(lk, ZWP_TIMEOUT, 
-    //             [this] { return wnd_ > 0 || stopped_; });
-    //         if (stopped_) break;
-
-    //         // If pred, that means we got an ACK with WND > 0, so we go back to pause
-    //         // Otherwise, WND is still 0 (but we timed out), so send a probe and wait for ACK
-    //         if (!pred) {
-    //             std::cout << "ZWP timeout! Sending probe...\n";
-
-    //             if (sizeNotSentNoLock_() == 0) {
-    //                 std::cout << "Ooops, no data to send, going back to begining\n";
-    //                 zwp_.state = 0;
-    //                 continue;
-    //             }
-
-    //             // Send a probe with 1 byte of new data, if any
-    //             std::byte probeData;
-    //             [[maybe_unused]] auto nRead = RB::read(std::span(probeData), nxt_, nxt_);
-    //             assert(nRead == 1 && "Failed to read correct number (1) of bytes from send buffer");
-    //             nxt_++;  // Move byte to `sent but un-acked`
-
-    //             packetSender(Packet::makeAckPacket(una_, nxt_, wnd_, probeData));
-
-    //             // Responds to any new advertised WND by going back to the begining of the loop
-    //             zwp_.state = 2;
-    //             zwp_.cvOnCountdown.wait(lk, [this] { return zwp_.state == 0 || stopped_; });
-    //             if (stopped_) break;
-
-    //             std::cout << "Got ACK, going back to begining\n";
-    //         }
-    //     }
-    // }
-
     bool sanityCheckAtStart() const { std::lock_guard lk(mutex_); return una_ == nxt_ && nxt_ == nbw_; }
 
 public:
@@ -481,10 +605,78 @@ private:
     std::size_t sizeNotSentNoLock_() const noexcept { return nbw_ - nxt_; }
     std::size_t sizeCanSendNoLock_() const noexcept 
     {
-        return wnd_ > sizeUnackedNoLock_()
-             ? std::min(wnd_ - sizeUnackedNoLock_(), sizeNotSentNoLock_()) : 0;
+        const auto window = sendWndNoLock_();
+        return window > sizeUnackedNoLock_()
+             ? std::min(window - sizeUnackedNoLock_(), sizeNotSentNoLock_()) : 0;
+    }
+    // Bytes of the next segment of at most `maxSize` bytes, or 0 if it waits for more data or a wider window. Sends
+    // a full segment, else avoids the silly window syndrome (RFC 9293, section 3.8.6.2.1): only all the data left,
+    // and only if Nagle's algorithm is off or nothing is in flight, or at least half the largest window the remote
+    // offered. With nothing in flight, no ACK would come to send the rest, so whatever fits goes (unless corked).
+    // The congestion window is not the remote's: it grows by the byte, and the end of it is used as before.
+    std::size_t sizeReadyNoLock_(const std::size_t maxSize) const noexcept
+    {
+        const auto n = std::min(sizeCanSendNoLock_(), maxSize);
+        if (n == 0 || n == maxSize)
+            return n;
+        if (corked_)
+            return 0;
+        if (una_ == nxt_)
+            return n;
+        if (n == sizeNotSentNoLock_())
+            return noDelay_ ? n : 0;
+        if (sendWndNoLock_() < wnd_ || (maxWnd_ > 0 && n >= maxWnd_ / 2))
+            return n;
+        return 0;
+    }
+
+    std::uint32_t sendWndNoLock_() const noexcept
+    {
+        // In fast recovery, the window inflated by the duplicate ACKs. Before, one more segment per duplicate ACK
+        const auto cwnd = fastRecovery_ ? recoveryWnd_ : cc_->cwnd() + dupAcks_ * MAX_TCP_PAYLOAD_SIZE;
+        return static_cast<std::uint32_t>(std::min<std::size_t>(wnd_, cwnd));
+    }
+
+    void onDuplicateAckNoLock_()
+    {
+        if (fastRecovery_) {
+            // One more segment left the network: resend a hole that the SACK blocks revealed, or else new data
+            if (retransmitQueue.hasHole(una_)) {
+                ++pendingRetransmits_;
+                ++fastRetransmits_;
+            } else {
+                recoveryWnd_ += MAX_TCP_PAYLOAD_SIZE;
+            }
+        } else if (rtoRecovery_) {
+            return;  // Drawn by the segments resent after the timeout: not a new loss (RFC 6582, section 4.1)
+        } else if (++dupAcks_ == DUPACK_THRESHOLD) {
+            // Fast retransmit, then keep the ACK clock going with the window inflated by the segments that left
+            cc_->onLoss(sizeUnackedNoLock_());
+            retransmitQueue.beginRecovery();
+            fastRecovery_ = true;
+            ++pendingRetransmits_;
+            recover_ = nxt_;
+            recoveryWnd_ = cc_->cwnd() + DUPACK_THRESHOLD * MAX_TCP_PAYLOAD_SIZE;
+            dupAcks_ = 0;
+            ++fastRetransmits_;
+        }
+
+        if (sizeCanSendNoLock_() > 0 || pendingRetransmits_ > 0)
+            notifyReadyNoLock_();
+    }
+    std::size_t sizeFreeNoLock_() const noexcept { return N - (nbw_ - pinned_); }
+
+    void notifyReadyNoLock_() const { if (onReady_) onReady_(); }
+
+    // Got a zero window: probe it if it is still closed after ZWP_TIMEOUT
+    void zwpStartCountdownNoLock_()
+    {
+        static constexpr auto ZWP_TIMEOUT = std::chrono::seconds{2};
+
+        zwp_.state = 1;  // COUNTDOWN
+        if (zwpTimer_)
+            zwpTimer_->arm(ZWP_TIMEOUT);  // Never cancelled: a stale timeout sees the state has moved on
     }
-    std::size_t sizeFreeNoLock_() const noexcept { return N - (nbw_ - una_); }
 
 private:
     /**
@@ -496,55 +688,48 @@ private:
      *    - Sending data causes nxt_ to shift right (less data available)
      *    - Writing from app causes lbw_ to shift right : write()
      * 
-     *  Invariant: una_ <= nxt_ <= nbw_
+     *  [pinned_, una_) is acknowledged data that a segment on the retransmission queue still refers to,
+     *  as the ACK covered only part of it. It is not overwritten until the rest of the segment is acknowledged
+     * 
+     *  Invariant: pinned_ <= una_ <= nxt_ <= nbw_
     */
     std::uint32_t una_ = 0;  // oldest (sent but) unacknowledged sequence number
     std::uint32_t nxt_ = 0;  // next sequence number to be sent
     std::uint32_t nbw_ = 0;  // sequence number of next byte to write from app
+    std::uint32_t pinned_ = 0;  // oldest sequence number the retransmission queue refers to (una_ if none is older)
 
     // The window size advertised by remote is the max [una_, nxt_) could get. 
     // Sender must block (cannot increment nxt_) if this size has been reached.
 
     // Update this when receiving ACKs
     std::uint32_t wnd_ = std::numeric_limits<std::uint32_t>::max();
+    std::uint32_t maxWnd_ = 0;  // The largest window advertised by the remote so far: Max(SND.WND)
+
+    bool noDelay_ = false;  // Nagle's algorithm off
+    bool corked_ = false;
+    bool finQueued_ = false;  // Closed by the application: a FIN follows the data, see takeFin()
+    bool finSent_ = false;
 
     mutable std::mutex mutex_;
-    mutable std::condition_variable cvSender_;
     mutable std::condition_variable cvWriter_;
     bool stopped_ = false;
 
-    struct ZeroWindowProbing {
-        // using RetransmitEntryPtr = 
-        //     std::experimental::observer_ptr<RetransmissionQueue::Entry>;
-
-        int state = 0;
-        // std::mutex mutex;
-        
-        // RetransmitEntryPtr retransmitEntry;
-        std::uint32_t seq;
-        mutable std::condition_variable cvOnPause, cvOnCountdown;
+    std::unique_ptr<CongestionControl> cc_ = makeCongestionControl(CongestionAlgorithm::NEW_RENO);
+    bool rtoRecovery_ = false;  // Resending what was in flight when the retransmission timer expired
+    bool fastRecovery_ = false; // Resending the holes reported by duplicate (then partial) ACKs
+    std::uint32_t recover_ = 0; // SND.NXT when either recovery started: it ends once that is acknowledged
+    std::size_t dupAcks_ = 0;       // Duplicate ACKs in a row, outside fast recovery
+    std::size_t recoveryWnd_ = 0;   // Congestion window during fast recovery, inflated by the duplicate ACKs
+    std::size_t pendingRetransmits_ = 0;  // Holes to resend at once, see takeFastRetransmit()
+    std::size_t fastRetransmits_ = 0;
+    std::size_t retransmitTimeouts_ = 0;
 
-        void onWnd(std::uint32_t wnd)
-        {
-            // switch (state) {
-            // case 0:
-            //     if (wnd == 0) {
-            //         // std::cout << "Got zero window ack (" << ackNum << ") " << wnd_ << " in state 0\n";
-            //         cvOnPause.notify_one();
-            //     }
-            //     break;
-            // case 1:
-            //     // std::cout << "Got ack (" << ackNum << ") with WND = " << wnd_ << " in state 1\n";
-            //     cvOnCountdown.notify_one();
-            //     break;
-            // case 2:
-            //     // std::cout << "Got ack (" << ackNum << ") with WND = " << wnd_ << " in state 2\n";
-            //     state = 0;
-            //     cvOnCountdown.notify_one();
-            //     break;
-            // }
-        }
+    struct ZeroWindowProbing {
+        int state = 0;       // 0: PAUSE (window open), 1: COUNTDOWN (window closed), 2: WAITACK (probe sent)
+        std::uint32_t seq;   // Sequence number of the probe byte
     } zwp_;
+    tns::util::Timer *zwpTimer_ = nullptr;
+    std::function<void()> onReady_;
 };
 
 
@@ -569,7 +754,8 @@ public:
     /**
      * @brief Read up to `n` bytes into the provided buffer.
      * 
-     * Blocks if the receive buffer is empty.
+     * Blocks if the receive buffer is empty. Once shut down (e.g. on a FIN), the data received before can still be
+     * read; only then does it fail with CLOSING.
      * 
      * @param buff The buffer to read into
      * @param n The maximum number of bytes to read
@@ -582,7 +768,7 @@ public:
         std::unique_lock lk(mutex_);
         cv_.wait(lk, [this] { return sizeToReadNoLock_() > 0 || stopped_; });
 
-        if (stopped_)
+        if (sizeToReadNoLock_() == 0)  // Shut down, and the data received before has all been read
             return tl::unexpected{SocketError::CLOSING};
         
         // std::cout << "n = " << n << ", sizeToRead = " << sizeToReadNoLock_() << std::endl;
@@ -597,6 +783,41 @@ public:
         return n;
     }
 
+    /**
+     * @brief View the data available for reading, without copying it.
+     * 
+     * Blocks if the receive buffer is empty. The view holds all the data available: one run of the buffer, or two
+     * if the data wraps around its end. Incoming segments are only written past it, so the bytes stay put until
+     * consume() frees them.
+     * 
+     * @return The view, or a SocketError
+     */
+    tl::expected<PayloadSpans, SocketError> peek()
+    {
+        std::unique_lock lk(mutex_);
+        cv_.wait(lk, [this] { return sizeToReadNoLock_() > 0 || stopped_; });
+
+        if (sizeToReadNoLock_() == 0)
+            return tl::unexpected{SocketError::CLOSING};
+
+        const auto [head, tail] = RB::view(nbr_, sizeToReadNoLock_());
+        return PayloadSpans{head, tail};
+    }
+
+    /**
+     * @brief Free the first `n` bytes available for reading (e.g., those of a view from peek()), which opens the window.
+     * 
+     * @param n The number of bytes to free
+     * @return The number of bytes actually freed, at most the size available
+     */
+    std::size_t consume(std::size_t n)
+    {
+        std::lock_guard lk(mutex_);
+        n = std::min(n, sizeToReadNoLock_());
+        nbr_ += static_cast<decltype(nbr_)>(n);
+        return n;
+    }
+
     auto getSizeToRead() const { std::lock_guard lk(mutex_); return sizeToReadNoLock_(); }
     auto getSizeFree() const { std::lock_guard lk(mutex_); return sizeFreeNoLock_(); }
     auto getNxt() const { std::lock_guard lk(mutex_); return nxt_; }
@@ -614,7 +835,7 @@ public:
     bool sanityCheckAtStart() const { std::lock_guard lk(mutex_); return nbr_ == nxt_; }
 
 private:
-    std::size_t sizeToReadNoLock_() const noexcept { return nxt_ - nbr_; }
+    std::size_t sizeToReadNoLock_() const noexcept { return nxt_ - nbr_ - finReceived_; }  // The FIN is not data
     std::size_t sizeFreeNoLock_() const noexcept { return N - sizeToReadNoLock_(); }  // The advertised "recv window size"
 
 private:
@@ -625,8 +846,10 @@ private:
     */
     std::uint32_t nbr_ = 0; // sequence number of next byte to read from recv buffer (one past LBR)
     std::uint32_t nxt_ = 0; // Next sequence number expected to receive
+    bool finReceived_ = false;  // The FIN, the last sequence number before nxt_, was received: see onCtrl()
 
     RightOpenIntervalSet<std::uint32_t> earlyArrivals_;
+    std::uint32_t lastEarlyArrival_ = 0;  // Sequence number of the latest segment received out of order
 
     mutable std::mutex mutex_;
     mutable std::condition_variable cv_;
@@ -638,7 +861,10 @@ public:
     auto onCtrl(std::uint32_t seqNum)
     {
         std::lock_guard lk(mutex_);
-        if (seqNum == nxt_) nxt_++;
+        if (seqNum == nxt_) {
+            nxt_++;
+            finReceived_ = true;
+        }
         return std::make_pair(nxt_, sizeFreeNoLock_());
     }
 
@@ -665,6 +891,7 @@ public:
                 if (nWritten > 0) {
                     // Insert the new segment and merge all overlapping segments
                     earlyArrivals_.emplaceMerge({seqNum, seqNum + nWritten});
+                    lastEarlyArrival_ = seqNum;
                 }
                 return ack_wnd;
             }
@@ -700,6 +927,27 @@ public:
         std::lock_guard lk(mutex_);
         return std::make_pair(nxt_, sizeFreeNoLock_());
     }
+
+    // Whether data received out of order waits for a hole below it to be filled
+    bool hasEarlyArrivals() const { std::lock_guard lk(mutex_); return !earlyArrivals_.empty(); }
+
+    // Adds the blocks received out of order to the SACK option of an ACK: the one holding the latest early arrival
+    // first, then the others from the highest (RFC 2018, section 4)
+    void addSackBlocks(TcpOptions &options) const
+    {
+        std::lock_guard lk(mutex_);
+        const auto holdsLatest = [this](const auto &block) {
+            return block.begin <= lastEarlyArrival_ && lastEarlyArrival_ < block.end;
+        };
+
+        const auto latest = std::ranges::find_if(earlyArrivals_, holdsLatest);
+        if (latest != earlyArrivals_.end())
+            options.addSack({latest->begin, latest->end});
+        for (const auto &block : earlyArrivals_ | std::views::reverse) {
+            if (!holdsLatest(block) && !options.addSack({block.begin, block.end}))
+                break;
+        }
+    }
 };
 
 
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "tcp/constants.hpp"
+#include "util/clock.hpp"
+#include "util/tl/expected.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iosfwd>
+#include <limits>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+namespace tns {
+namespace tcp {
+
+enum class CongestionAlgorithm { NEW_RENO, CUBIC };
+
+// Parse an algorithm name: "reno"/"newreno" or "cubic"
+tl::expected<CongestionAlgorithm, std::string> parseCongestionAlgorithm(std::string_view name);
+
+std::ostream& operator<<(std::ostream &os, CongestionAlgorithm algorithm);
+
+// Congestion window of a connection (RFC 5681), in bytes.
+//
+// The send buffer owns one and reports to it under its lock: bytes newly acknowledged, losses detected from
+// the ACK stream, and retransmission timeouts. The sender keeps min(cwnd, peer window) bytes in flight at most.
+// The implementations differ in how they grow the window in congestion avoidance and shrink it on loss.
+class CongestionControl {
+public:
+    using Clock = tns::util::Clock;
+
+    virtual ~CongestionControl() = default;
+
+    virtual CongestionAlgorithm algorithm() const noexcept = 0;
+
+    // An acceptable ACK acknowledged `bytesAcked` new bytes. `srtt` is the current smoothed round-trip time.
+    virtual void onAck(std::size_t bytesAcked, Clock::duration srtt) = 0;
+
+    // A loss was detected without a timeout (e.g. by duplicate ACKs), with `bytesInFlight` unacknowledged
+    virtual void onLoss(std::size_t bytesInFlight) = 0;
+
+    // The retransmission timer expired. `repeated` if the timer already expired for the same data before
+    // it was acknowledged: the slow start threshold is then kept (RFC 5681, section 3.1).
+    virtual void onRetransmitTimeout(std::size_t bytesInFlight, bool repeated) = 0;
+
+    std::size_t cwnd() const noexcept { return cwnd_; }
+    std::size_t ssthresh() const noexcept { return ssthresh_; }
+    bool inSlowStart() const noexcept { return cwnd_ < ssthresh_; }
+
+protected:
+    // Initial window of RFC 5681: 2 to 4 segments, depending on the segment size
+    explicit CongestionControl(std::size_t mss) noexcept
+        : mss_(mss), cwnd_(std::min(4 * mss, std::max(2 * mss, std::size_t{4380})))
+    {}
+
+    // Slow start: grow by the bytes acknowledged, at most 2 segments per ACK (RFC 3465, L = 2)
+    void slowStart_(std::size_t bytesAcked) noexcept { cwnd_ += std::min(bytesAcked, 2 * mss_); }
+
+    const std::size_t mss_;
+    std::size_t cwnd_;
+    std::size_t ssthresh_ = std::numeric_limits<std::size_t>::max();
+};
+
+// RFC 5681 window growth and reduction (slow start, AIMD congestion avoidance).
+class NewReno : public CongestionControl {
+public:
+    explicit NewReno(std::size_t mss = MAX_TCP_PAYLOAD_SIZE) noexcept : CongestionControl(mss) {}
+
+    CongestionAlgorithm algorithm() const noexcept override { return CongestionAlgorithm::NEW_RENO; }
+    void onAck(std::size_t bytesAcked, Clock::duration srtt) override;
+    void onLoss(std::size_t bytesInFlight) override;
+    void onRetransmitTimeout(std::size_t bytesInFlight, bool repeated) override;
+
+private:
+    std::size_t bytesAckedInAvoidance_ = 0;  // Counts up to a window's worth before adding a segment
+};
+
+// RFC 9438 CUBIC: the window grows as a cubic function of the time since the last reduction, centered on
+// the window at that reduction, and never slower than Reno would.
+class Cubic : public CongestionControl {
+public:
+    static constexpr double C    = 0.4;  // Aggressiveness of the cubic growth
+    static constexpr double BETA = 0.7;  // Multiplicative decrease factor
+
+    explicit Cubic(std::size_t mss = MAX_TCP_PAYLOAD_SIZE) noexcept : CongestionControl(mss) {}
+
+    CongestionAlgorithm algorithm() const noexcept override { return CongestionAlgorithm::CUBIC; }
+    void onAck(std::size_t bytesAcked, Clock::duration srtt) override;
+    void onLoss(std::size_t bytesInFlight) override;
+    void onRetransmitTimeout(std::size_t bytesInFlight, bool repeated) override;
+
+private:
+    // Record the window at a congestion event and start a new epoch from the reduced window
+    void reduce_();
+
+    double wMax_ = 0;          // Window before the last reduction, in segments
+    double k_ = 0;             // Seconds the cubic function takes to grow back to wMax_
+    double wEst_ = 0;          // Reno-friendly estimate of the window, in segments
+    double growth_ = 0;        // Growth of the window not added yet, under a byte
+    bool epochStarted_ = false;
+    Clock::time_point epochStart_{};
+};
+
+std::unique_ptr<CongestionControl> makeCongestionControl(CongestionAlgorithm algorithm,
+                                                         std::size_t mss = MAX_TCP_PAYLOAD_SIZE);
+
+} // namespace tcp
+} // namespace tns
@@ -1,20 +1,51 @@
 #pragma once
 
-#include <limits>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 
 namespace tns {
 namespace tcp {
 
-inline constexpr std::size_t SEND_BUFFER_SIZE = std::numeric_limits<std::uint16_t>::max();
-inline constexpr std::size_t RECV_BUFFER_SIZE = std::numeric_limits<std::uint16_t>::max();
+// Send and receive buffers of a connection. Powers of 2, so that sequence numbers wrap around evenly
+inline constexpr std::size_t SEND_BUFFER_SIZE = std::size_t{1} << 21;  // 2 MiB
+inline constexpr std::size_t RECV_BUFFER_SIZE = std::size_t{1} << 21;
+
+// Window scale shift that lets the 16-bit window field advertise the whole receive buffer (RFC 7323)
+inline constexpr std::uint8_t RECV_WINDOW_SHIFT = [] {
+    std::uint8_t shift = 0;
+    while ((RECV_BUFFER_SIZE >> shift) > std::numeric_limits<std::uint16_t>::max())
+        ++shift;
+    return shift;
+}();
+static_assert(RECV_WINDOW_SHIFT <= 14, "The receive buffer is too large for window scaling");
 
 inline constexpr std::size_t MAX_TCP_PAYLOAD_SIZE = 1360UL;  // 1400 (Datagram::MAX_DATAGRAM_SIZE) - 20 (IP header) - 20 (TCP header)
 
 inline constexpr std::size_t MAX_RETRANSMISSIONS = 5;
-inline constexpr auto RETRANSMIT_THREAD_PERIOD = std::chrono::milliseconds{250};
 
-inline constexpr auto SOCKET_REAPER_THREAD_PERIOD = std::chrono::seconds{1};
+// Duplicate ACKs that trigger a fast retransmit (RFC 5681)
+inline constexpr std::size_t DUPACK_THRESHOLD = 3;
+
+// Delayed ACKs (RFC 1122, RFC 5681 section 4.2): data received in order is acknowledged once two full segments
+// are in, or after DELAYED_ACK_TIMEOUT if no second one comes
+inline constexpr std::size_t DELAYED_ACK_SEGMENTS = 2;
+inline constexpr auto DELAYED_ACK_TIMEOUT = std::chrono::milliseconds{40};
+// Segments acknowledged one by one at the start of a connection and after a loss, while the sender's window grows
+inline constexpr std::size_t QUICK_ACK_SEGMENTS = 16;
+
+// Transmit workers of a stack, and segments a socket sends before the next ready socket's turn
+inline constexpr std::size_t TRANSMIT_WORKERS = 2;
+inline constexpr std::size_t TRANSMIT_QUANTUM = 4;
+
+// Lock shards of the connection demultiplexing table (a power of 2)
+inline constexpr std::size_t DEMUX_SHARDS = 16;
+
+// Sockets of a stack (socket ids 1 .. MAX_SOCKETS)
+inline constexpr std::size_t MAX_SOCKETS = std::size_t{1} << 20;
+
+inline constexpr auto SOCKET_REAPER_PERIOD = std::chrono::seconds{1};
 
 } // namespace tcp
 } // namespace tns
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "tcp/constants.hpp"
+#include "tcp/session_tuple.hpp"
+#include "util/flat_hash_map.hpp"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+
+
+namespace tns {
+namespace tcp {
+
+// Demultiplexing table of the TCP connections of a stack: session tuple -> T&.
+//
+// The flows are spread over DEMUX_SHARDS shards by the top bits of the 4-tuple hash, each with its own lock,
+// so that lookups on different shards never contend and an insertion or removal only blocks its own shard.
+// On top of that, every thread remembers the last flow it looked up: a burst of segments of one connection
+// (the common case for a receive thread) is demultiplexed without taking any lock. The entry is validated by
+// the generation of its shard, which every removal bumps.
+//
+// As with any lookup, the caller must make sure that the value outlives its use of it.
+template <typename T>
+class FlowTable {
+public:
+    FlowTable() = default;
+    FlowTable(const FlowTable&) = delete;
+    FlowTable& operator=(const FlowTable&) = delete;
+
+    // The value of a flow, or null
+    T* find(const SessionTuple &tuple) const
+    {
+        const auto hash = std::hash<SessionTuple>{}(tuple);
+        const auto &shard = shard_(hash);
+        const auto generation = shard.generation.load(std::memory_order_acquire);
+
+        auto &hit = lastHit_;
+        if (hit.table == id_ && hit.generation == generation && hit.tuple == tuple)
+            return hit.value;
+
+        std::shared_lock lock(shard.mutex);
+        const auto it = shard.flows.find(tuple);
+        if (it == shard.flows.end())
+            return nullptr;
+        hit = {id_, generation, tuple, it->second};
+        return it->second;
+    }
+
+    bool contains(const SessionTuple &tuple) const { return find(tuple) != nullptr; }
+
+    // Insert a flow. Returns false if it is already in the table.
+    bool insert(const SessionTuple &tuple, T &value)
+    {
+        auto &shard = shard_(std::hash<SessionTuple>{}(tuple));
+        std::unique_lock lock(shard.mutex);
+        return shard.flows.try_emplace(tuple, &value).second;
+    }
+
+    // Remove a flow, if present
+    void erase(const SessionTuple &tuple)
+    {
+        auto &shard = shard_(std::hash<SessionTuple>{}(tuple));
+        std::unique_lock lock(shard.mutex);
+        if (shard.flows.erase(tuple))
+            shard.generation.fetch_add(1, std::memory_order_release);  // Invalidates the last hits on the shard
+    }
+
+    std::size_t size() const
+    {
+        std::size_t n = 0;
+        for (const auto &shard : shards_) {
+            std::shared_lock lock(shard.mutex);
+            n += shard.flows.size();
+        }
+        return n;
+    }
+
+private:
+    static_assert(std::has_single_bit(DEMUX_SHARDS) && DEMUX_SHARDS > 1, "DEMUX_SHARDS must be a power of 2 above 1");
+    static_assert(sizeof(std::size_t) == 8);
+    static constexpr auto SHARD_BITS = static_cast<unsigned>(std::bit_width(DEMUX_SHARDS - 1));
+
+    struct alignas(64) Shard {  // Starts a cache line: the locks of neighbor shards do not false-share
+        mutable std::shared_mutex mutex;
+        tns::util::FlatHashMap<SessionTuple, T*> flows;
+        std::atomic<std::uint64_t> generation{0};
+    };
+
+    // The last flow found by this thread, in any table of this type
+    struct LastHit {
+        std::uint64_t table = 0;
+        std::uint64_t generation = 0;
+        SessionTuple tuple;
+        T *value = nullptr;
+    };
+
+    // FlatHashMap picks slots with the low bits of the hash: shard by the high ones
+    Shard &shard_(std::size_t hash) { return shards_[hash >> (64 - SHARD_BITS)]; }
+    const Shard &shard_(std::size_t hash) const { return shards_[hash >> (64 - SHARD_BITS)]; }
+
+    static inline std::atomic<std::uint64_t> nextId_{1};
+    static inline thread_local LastHit lastHit_{};
+
+    const std::uint64_t id_ = nextId_.fetch_add(1, std::memory_order_relaxed);  // Never reused, unlike addresses
+    std::array<Shard, DEMUX_SHARDS> shards_;
+};
+
+} // namespace tcp
+} // namespace tns
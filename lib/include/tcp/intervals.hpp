@@ -89,6 +89,10 @@ public:
 
         return end;
     }
+
+    bool empty() const noexcept { return intervals_.empty(); }
+    auto begin() const noexcept { return intervals_.begin(); }
+    auto end() const noexcept { return intervals_.end(); }
     
     // // debug
     // void print() const
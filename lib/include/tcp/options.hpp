@@ -0,0 +1,89 @@
+#pragma once
+
+#include "util/defines.hpp"
+#include "util/tl/expected.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+
+
+namespace tns {
+namespace tcp {
+
+// Option kinds this stack reads or writes (RFC 9293, RFC 7323, RFC 2018)
+enum class OptionKind : std::uint8_t {
+    END_OF_LIST    = 0,
+    NOP            = 1,
+    WINDOW_SCALE   = 3,
+    SACK_PERMITTED = 4,
+    SACK           = 5,
+    TIMESTAMPS     = 8,
+};
+
+inline constexpr std::size_t MAX_OPTIONS_SIZE = 40;  // th_off = 15: a 60-byte header
+inline constexpr std::size_t MAX_SACK_BLOCKS  = 4;   // 2 + 4 * 8 bytes, the most that fit
+inline constexpr std::uint8_t MAX_WINDOW_SHIFT = 14;  // Windows up to 1 GiB (RFC 7323, section 2.3)
+inline constexpr std::size_t TIMESTAMPS_SIZE  = 12;  // NOP, NOP, kind, length, TSval, TSecr: on every segment once agreed
+
+// A block of data received out of order: [left, right) in sequence space, host byte order
+struct SackBlock {
+    std::uint32_t left = 0;
+    std::uint32_t right = 0;
+
+    bool operator==(const SackBlock &) const = default;
+};
+
+// The timestamps of a segment (RFC 7323): when it was sent, and the latest one received from the other end
+struct Timestamps {
+    std::uint32_t value = 0;      // TSval
+    std::uint32_t echoReply = 0;  // TSecr
+
+    bool operator==(const Timestamps &) const = default;
+};
+
+// The options of a segment that this stack understands. Other options are skipped when parsing.
+struct TcpOptions {
+    std::optional<std::uint8_t> windowShift;               // SYN, SYN-ACK: the sender scales its windows by 2^shift (RFC 7323)
+    bool sackPermitted = false;                            // SYN, SYN-ACK: SACK blocks may be sent (RFC 2018)
+    std::optional<Timestamps> timestamps;                  // Any segment, once both ends sent them in the SYNs (RFC 7323)
+    std::array<SackBlock, MAX_SACK_BLOCKS> sackBlocks{};   // ACK: data held by the receiver above the ACK number
+    std::size_t numSackBlocks = 0;
+
+    std::span<const SackBlock> sack() const noexcept { return {sackBlocks.data(), numSackBlocks}; }
+
+    // Append a SACK block. Returns false if there is no room left
+    bool addSack(SackBlock block) noexcept
+    {
+        if (numSackBlocks == sackBlocks.size())
+            return false;
+        sackBlocks[numSackBlocks++] = block;
+        return true;
+    }
+};
+
+// Options in wire format, padded with NOPs to a multiple of 4 bytes
+struct OptionBytes {
+    std::array<std::byte, MAX_OPTIONS_SIZE> data{};
+    std::uint8_t size = 0;
+
+    PayloadView view() const noexcept { return {data.data(), size}; }
+};
+
+// Parse the options part of a TCP header. Unknown options are skipped; fails on malformed lengths.
+tl::expected<TcpOptions, std::string> parseOptions(PayloadView bytes);
+
+// Serialize options. The SACK blocks that do not fit in the option space are left out.
+OptionBytes serializeOptions(const TcpOptions &options) noexcept;
+
+// Offset of the first option of a kind in the options part of a TCP header, or nullopt if there is none
+std::optional<std::size_t> findOption(PayloadView bytes, OptionKind kind) noexcept;
+
+// The timestamp clock: milliseconds of util::Clock, so simulated time under a util::Scheduler
+std::uint32_t timestampNow() noexcept;
+
+} // namespace tcp
+} // namespace tns
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <bit>
+#include <cassert>
 #include <limits>
 #include <sstream>
 #include <netinet/tcp.h>
 
 #include "util/defines.hpp"
+#include "tcp/options.hpp"
 #include "tcp/session_tuple.hpp"
 #include "tcp/util.hpp"
 
@@ -13,7 +17,16 @@
 namespace tns {
 namespace tcp {
 
-// A TCP packet composed of a TCP header and a payload.
+// Payload bytes not owned by whoever holds them, e.g. a packet or an application reading a socket in place:
+// up to two contiguous runs, as a range of a ring buffer may wrap around its end
+struct PayloadSpans {
+    PayloadView head;
+    PayloadView tail;  // Empty unless the range wraps around
+
+    std::size_t size() const noexcept { return head.size() + tail.size(); }
+};
+
+// A TCP packet composed of a TCP header, its options and a payload.
 class Packet {
     static constexpr auto     INIT_WINDOW_SIZE = std::numeric_limits<uint16_t>::max();  // 65535
     static constexpr uint32_t ACK_DONT_CARE    = 0;
@@ -21,12 +34,14 @@ class Packet {
 public:
     Packet() = default;
 
+    // The packet in wire format. The payload is copied from wherever it lies, e.g. straight from the send buffer
     PayloadPtr serialize() const
     {
         auto packet = std::make_unique<Payload>(size_);
         std::memcpy(packet->data(), &tcpHeader_, sizeof(tcpHeader_));
-        if (payload_)
-            std::memcpy(packet->data() + sizeof(tcpHeader_), payload_->data(), payload_->size());
+        auto out = std::ranges::copy(options_.view(), packet->begin() + sizeof(tcpHeader_)).out;
+        out = std::ranges::copy(payloadSpans_.head, out).out;
+        std::ranges::copy(payloadSpans_.tail, out);
         return packet;
     }
 
@@ -46,17 +61,23 @@ public:
             if (hdrSize < sizeof(tcphdr) || hdrSize > ipPayload.size())
                 return tl::unexpected("Invalid TCP header length (th_off is invalid)");
 
-            // Options are ipPayload[20:hdrSize]. Must be zero as we currently don't support them
+            // Options are ipPayload[20:hdrSize]
             const auto options = ipPayload.subspan(sizeof(tcphdr), hdrSize - sizeof(tcphdr));
-            if (std::ranges::any_of(options, [](const auto &b) { return b != std::byte{0}; }))
-                return tl::unexpected("TCP options are not supported");
+            if (const auto parsed = parseOptions(options); !parsed)
+                return tl::unexpected(parsed.error());
 
             // TCP payload is ipPayload[hdrSize:]
             const auto tcpPayload = ipPayload.subspan(hdrSize);
 
+            // Copy out the payload and sum it in the same pass
+            util::InetChecksum payloadSum;
+            auto payload = tcpPayload.empty() ? nullptr : std::make_unique<Payload>(tcpPayload.size());
+            if (payload)
+                payloadSum.copyAndAdd(*payload, tcpPayload);
+
             // Validate checksum
             const auto expectSum = hdrp->th_sum;  // network byte order
-            const auto actualSum = util::tcpChecksum(srcIP, dstIP, *hdrp, tcpPayload);
+            const auto actualSum = util::tcpChecksum(srcIP, dstIP, *hdrp, options, tcpPayload.size(), payloadSum);
             if (expectSum != actualSum) {
                 std::stringstream ss;
                 ss << "Invalid TCP checksum: expected " << std::hex 
@@ -65,50 +86,101 @@ public:
             }
 
             // Construct the packet
-            return Packet{*hdrp, tcpPayload};
+            return Packet{*hdrp, options, std::move(payload)};
 
         } catch (const std::exception &e) {
             return tl::unexpected(e.what());
         }
     }
 
-    static Packet makeSynPacket(const SessionTuple &tuple, uint32_t seqNum, uint16_t wndSize) noexcept
+    static Packet makeSynPacket(const SessionTuple &tuple, uint32_t seqNum, uint16_t wndSize,
+                                const TcpOptions &options = {}) noexcept
     {
         return Packet{
             tuple, static_cast<uint8_t>(TH_SYN),  // SYN flag
             seqNum, ACK_DONT_CARE,  // seq, ack
-            wndSize
+            wndSize, nullptr, nullptr, options
         };
     }
 
-    static Packet makeSynAckPacket(const SessionTuple &tuple, uint32_t seqNum, uint32_t ackNum, uint16_t wndSize) noexcept
+    static Packet makeSynAckPacket(const SessionTuple &tuple, uint32_t seqNum, uint32_t ackNum, uint16_t wndSize,
+                                   const TcpOptions &options = {}) noexcept
     {
         return Packet{
             tuple, static_cast<uint8_t>(TH_SYN | TH_ACK),  // SYN, ACK flags
             seqNum, ackNum,  // seq, ack
-            wndSize
+            wndSize, nullptr, nullptr, options
         };
     }
 
     static Packet makeAckPacket(const SessionTuple &tuple, uint32_t seqNum, uint32_t ackNum, 
-                                uint16_t wndSize, PayloadPtr payload_ = nullptr) noexcept
+                                uint16_t wndSize, PayloadPtr payload_ = nullptr, const TcpOptions &options = {}) noexcept
+    {
+        return Packet{
+            tuple, static_cast<uint8_t>(TH_ACK),  // ACK flag
+            seqNum, ackNum,  // seq, ack
+            wndSize, std::move(payload_), nullptr, options
+        };
+    }
+
+    // Same as above, with the payload sum already computed by the caller (see util::InetChecksum::copyAndAdd)
+    static Packet makeAckPacket(const SessionTuple &tuple, uint32_t seqNum, uint32_t ackNum, 
+                                uint16_t wndSize, PayloadPtr payload_, const util::InetChecksum &payloadSum,
+                                const TcpOptions &options = {}) noexcept
+    {
+        return Packet{
+            tuple, static_cast<uint8_t>(TH_ACK),  // ACK flag
+            seqNum, ackNum,  // seq, ack
+            wndSize, std::move(payload_), &payloadSum, options
+        };
+    }
+
+    // Same as above, with a payload the packet neither owns nor copies (see SendBuffer::takeReadyData()).
+    // The bytes must stay put until the packet is destroyed.
+    static Packet makeAckPacket(const SessionTuple &tuple, uint32_t seqNum, uint32_t ackNum,
+                                uint16_t wndSize, PayloadSpans payload, const TcpOptions &options = {}) noexcept
     {
         return Packet{
             tuple, static_cast<uint8_t>(TH_ACK),  // ACK flag
             seqNum, ackNum,  // seq, ack
-            wndSize, std::move(payload_)
+            wndSize, nullptr, nullptr, options, payload
         };
     }
 
-    static Packet makeFinPacket(const SessionTuple &tuple, uint32_t seqNum, uint16_t wndSize) noexcept
+    static Packet makeFinPacket(const SessionTuple &tuple, uint32_t seqNum, uint16_t wndSize,
+                                const TcpOptions &options = {}) noexcept
     {
         return Packet{
             tuple, static_cast<uint8_t>(TH_FIN),  // FIN flag
             seqNum, ACK_DONT_CARE,  // seq, ack
-            wndSize
+            wndSize, nullptr, nullptr, options
         };
     }
 
+    // Replace the timestamps of a packet about to be retransmitted (RFC 7323, section 3.2), if it has any.
+    // The checksum is updated for the 8 bytes that changed (RFC 1624), without summing the payload again.
+    void setTimestamps(const Timestamps &timestamps) noexcept
+    {
+        const auto at = findOption(options_.view(), OptionKind::TIMESTAMPS);
+        if (!at)
+            return;
+
+        const auto values = std::array{tns::util::hton(timestamps.value), tns::util::hton(timestamps.echoReply)};
+        const auto fresh = std::as_bytes(std::span{values});
+        const auto stale = std::span{options_.data}.subspan(*at + 2, fresh.size());
+
+        // HC' = ~(~HC + ~m + m')
+        std::array<std::byte, 8> staleComplement;
+        std::ranges::transform(stale, staleComplement.begin(), [](std::byte b) { return ~b; });
+        const auto sumComplement = static_cast<uint16_t>(~tcpHeader_.th_sum);
+        tcpHeader_.th_sum = util::InetChecksum{}
+            .add(std::as_bytes(std::span{&sumComplement, 1}))
+            .add(staleComplement)
+            .add(fresh)
+            .finish();
+        std::ranges::copy(fresh, stale.begin());
+    }
+
     auto size() const noexcept { return size_; }
 
     auto getSrcPortHost() const noexcept { return tns::util::ntoh(tcpHeader_.th_sport); }
@@ -124,54 +196,73 @@ public:
     auto getWndSizeHost() const noexcept { return tns::util::ntoh(tcpHeader_.th_win); }
     auto getWndSizeNetwork() const noexcept { return tcpHeader_.th_win; }
 
-    auto getPayloadView() const noexcept { return payload_ ? PayloadView{*payload_} : PayloadView{}; }
-    auto getPayloadSize() const noexcept { return payload_ ? payload_->size() : 0; }
+    // The payload, which is contiguous unless the packet is a view of a range that wraps around
+    auto getPayloadView() const noexcept
+    {
+        assert(payloadSpans_.tail.empty() && "Packet::getPayloadView(): The payload wraps around");
+        return payloadSpans_.head;
+    }
+    auto getPayloadSpans() const noexcept { return payloadSpans_; }
+    auto getPayloadSize() const noexcept { return payloadSpans_.size(); }
 
     auto getFlags() const noexcept { return tcpHeader_.th_flags; }
+
+    // The options were validated when the packet was parsed or built
+    TcpOptions getOptions() const noexcept { return parseOptions(options_.view()).value_or(TcpOptions{}); }
+    auto getOptionsSize() const noexcept { return options_.size; }
     // bool isSyn() const noexcept { return tcpHeader_.th_flags == TH_SYN; }
     // bool isAck() const noexcept { return tcpHeader_.th_flags == TH_ACK; }
     // bool isFin() const noexcept { return tcpHeader_.th_flags == TH_FIN; }
     // bool isSynAck() const noexcept { return tcpHeader_.th_flags == (TH_SYN | TH_ACK); }
 
 private:
-    Packet(const tcphdr &hdr, PayloadPtr tcpPayload = nullptr) noexcept
+    Packet(const tcphdr &hdr, PayloadView options, PayloadPtr tcpPayload = nullptr) noexcept
         : tcpHeader_(hdr)
         , payload_(std::move(tcpPayload))
-        , size_(sizeof(tcpHeader_) + (payload_ ? payload_->size() : 0))
-    {}
-
-    Packet(const tcphdr &hdr, PayloadView tcpPayload)
-        : Packet(hdr, std::make_unique<Payload>(tcpPayload.begin(), tcpPayload.end()))  // tcp payload copied here
-    {}
+        , payloadSpans_{payload_ ? PayloadView{*payload_} : PayloadView{}, {}}
+        , size_(sizeof(tcpHeader_) + options.size() + payloadSpans_.size())
+    {
+        std::ranges::copy(options, options_.data.begin());
+        options_.size = static_cast<std::uint8_t>(options.size());
+    }
 
     // Construct a packet from a TCP header and a payload (for send)
     // The source and destination IP addresses are needed to generate the pseudo header for checksum
     Packet(const SessionTuple &session,                // We need the whole session tuple to compute checksum
            uint8_t flags, uint32_t seq, uint32_t ack,  // TCP header fields (TODO: Window size)
            uint16_t winsz = INIT_WINDOW_SIZE,          // Window size
-           PayloadPtr payload = nullptr) noexcept      // Optional payload (TODO: Make this a view instead?)
-        : tcpHeader_{.th_sport = session.local.getPortNetwork(),  // source port
-                     .th_dport = session.remote.getPortNetwork(), // destination port
+           PayloadPtr payload = nullptr,               // Optional payload
+           const util::InetChecksum *payloadSum = nullptr,  // Optional precomputed sum over the payload
+           const TcpOptions &options = {},
+           PayloadSpans payloadSpans = {}) noexcept    // Optional payload not owned, if `payload` is null
+        : options_{serializeOptions(options)}
+        , tcpHeader_{.th_sport = session.localPort,               // source port
+                     .th_dport = session.remotePort,              // destination port
                      .th_seq = tns::util::hton(seq),              // sequence number
                      .th_ack = tns::util::hton(ack),              // ack number
-                     .th_off = TH_OFF,                            // header size = 20 bytes: no tcp options
+                     .th_off = static_cast<uint8_t>((TH_OFF + options_.size / 4) & 0xF),  // 20 bytes + options (at most 40)
                      .th_flags = flags,                           // {SYN, ACK, FIN, RST, ...}
                      .th_win = tns::util::hton(winsz)}
         , payload_{ std::move(payload) }
-        , size_(sizeof(tcpHeader_) + (payload_ ? payload_->size() : 0))
+        , payloadSpans_{payload_ ? PayloadSpans{*payload_, {}} : payloadSpans}
+        , size_(sizeof(tcpHeader_) + options_.size + payloadSpans_.size())
     {
         // Compute checksum over the pseudo header, TCP header, and payload
         tcpHeader_.th_sum = util::tcpChecksum(
-            session.local.getAddrNetwork(), 
-            session.remote.getAddrNetwork(),
+            session.localAddr.getAddrNetwork(), 
+            session.remoteAddr.getAddrNetwork(),
             tcpHeader_,
-            payload_ ? *payload_ : PayloadView{}
+            options_.view(),
+            payloadSpans_.size(),
+            payloadSum ? *payloadSum : util::InetChecksum{}.add(payloadSpans_.head).add(payloadSpans_.tail)
         );
     }
 
 private:
+    OptionBytes options_;     // Wire format, declared first: the header is built from its size
     tcphdr tcpHeader_ = {};   // 20-byte TCP header naked of options, in network byte order
-    PayloadPtr payload_;      // payload of variable length
+    PayloadPtr payload_;      // payload of variable length, if the packet owns it
+    PayloadSpans payloadSpans_;  // The payload bytes: those of payload_, or a view of bytes that outlive the packet
     std::size_t size_ = sizeof(tcphdr);        // Total size of the packet in bytes
 };
 
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "tcp/constants.hpp"
+#include "tcp/options.hpp"
 #include "tcp/packet.hpp"
+#include "tcp/socket_error.hpp"
+#include "util/clock.hpp"
 #include "util/tl/expected.hpp"
 
 #include <algorithm>
@@ -9,6 +12,7 @@
 #include <cmath>
 #include <deque>
 #include <mutex>
+#include <optional>
 #include <ranges>
 #include <functional>
 
@@ -18,7 +22,7 @@ namespace tcp {
 
 class RetransmissionQueue {
 public:
-    using SC = std::chrono::steady_clock;
+    using SC = tns::util::Clock;
     struct Entry {
         Entry() = default;
         Entry(Packet packet, SC::time_point lastSent) noexcept : packet{std::move(packet)}, lastSent{lastSent} {}
@@ -35,6 +39,9 @@ public:
         Packet packet;
         SC::time_point lastSent;
         std::size_t counter = 0;
+        bool sacked = false;             // The receiver holds it (SACK), only a cumulative ACK is missing
+        bool lost = false;               // In flight at a timeout: resent as soon as the window allows, whatever the RTO
+        std::size_t recoveryEpoch = 0;   // The last loss recovery that resent it
     };
 
     using EntryRef = std::reference_wrapper<Entry>;
@@ -46,7 +53,9 @@ public:
     // Remove all packets from the queue that are *entirely* acknowledged by the `ack` number.
     // i.e., those whose sequence number + payload size is <= `ack`.
     // i.e., those before the first packet whose sequence number + payload size is > `ack`.
-    void onAck(std::uint32_t ack)
+    // Unless `sampleRtt` is false (the caller took a timestamp sample), the newest packet acknowledged gives an RTT
+    // sample, if none of them was retransmitted (Karn's algorithm): the ACK may then be for either transmission.
+    void onAck(std::uint32_t ack, bool sampleRtt = true)
     {
         using namespace std;
         const auto now = SC::now();
@@ -56,9 +65,12 @@ public:
 
         // Regular entries
         const auto firstUnacked = ranges::upper_bound(deque_, ack, {}, &Entry::getEndExclusive);
-        for (const auto &entry : ranges::subrange(deque_.begin(), firstUnacked)
-                               | views::filter(&Entry::hasNotResent)) {
-            rto.addRttSample(entry.getRtt(now));
+        const auto acked = ranges::subrange(deque_.begin(), firstUnacked);
+        if (sampleRtt && !acked.empty() && ranges::all_of(acked, &Entry::hasNotResent))
+            rto.addRttSample(acked.back().getRtt(now));
+        for (const auto &entry : acked) {
+            if (entry.sacked)
+                unsackNoLock_(entry);
         }
 
         deque_.erase(deque_.begin(), firstUnacked);
@@ -113,7 +125,7 @@ public:
         */
         auto expEntries = views::all(deque_)
                         | views::filter([&](auto &entry) {
-                            return entry.hasExpired(now, rtoEst)
+                            return !entry.sacked && (entry.lost || entry.hasExpired(now, rtoEst))
                                 && entry.getEndExclusive() <= rightWindowEdge; });  // or should it be `<` ? Not sure.
 
         // Regular entries
@@ -126,8 +138,9 @@ public:
             }
             
             cout << "Retransmitting packet (seq: " << expEntry.packet.getSeqNumHost() << ", len: " << expEntry.packet.getPayloadSize()
-                 << ", retry #" << expEntry.counter << ", RTO = " << rtoEst.count() << "ms)\n";
+                 << ", retry #" << expEntry.counter << ", RTO = " << duration_cast<chrono::milliseconds>(rtoEst).count() << "ms)\n";
             expEntry.refreshTimestamp(now);
+            expEntry.lost = false;
             expiredEntries.emplace_back(expEntry);
         }
 
@@ -137,7 +150,7 @@ public:
 
             cout << "Retransmitting ZWP (seq: " << zwpEntry_->packet.getSeqNumHost() 
                  << ", len: " << zwpEntry_->packet.getPayloadSize()
-                 << ", retry #" << zwpEntry_->counter << ", RTO = " << rtoEst.count() << "ms)\n";
+                 << ", retry #" << zwpEntry_->counter << ", RTO = " << duration_cast<chrono::milliseconds>(rtoEst).count() << "ms)\n";
             zwpEntry_->refreshTimestamp(now);
             expiredEntries.emplace_back(*zwpEntry_);
         }
@@ -148,6 +161,109 @@ public:
         return make_pair(move(lk), move(expiredEntries));
     }
 
+    // Mark the entries entirely inside SACK blocks: the sender's scoreboard (RFC 6675). Marked entries are not
+    // retransmitted anymore, and tell which of the entries below them were lost.
+    void onSack(std::span<const SackBlock> blocks)
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (const auto &block : blocks) {
+            auto it = std::ranges::lower_bound(deque_, block.left, {}, [](const Entry &e) { return e.packet.getSeqNumHost(); });
+            for (; it != deque_.end() && it->getEndExclusive() <= block.right; ++it) {
+                if (it->packet.getPayloadSize() == 0 || it->sacked)
+                    continue;
+                it->sacked = true;
+                sackedBytes_ += it->packet.getPayloadSize();
+                if (it->getEndExclusive() <= highRxt_)
+                    sackedBelowRxt_ += it->packet.getPayloadSize();
+            }
+        }
+    }
+
+    // The first sequence number of the entries left, if any: their payloads are views of the send buffer,
+    // which must keep the bytes from there on
+    std::optional<std::uint32_t> getFirstSeq()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        std::optional<std::uint32_t> first;
+        if (!deque_.empty())
+            first = deque_.front().packet.getSeqNumHost();
+        if (zwpEntry_)
+            first = std::min(first.value_or(zwpEntry_->packet.getSeqNumHost()), zwpEntry_->packet.getSeqNumHost());
+        return first;
+    }
+
+    // The retransmission timer expired: everything in flight but the SACKed entries is lost (go-back-N)
+    void onRetransmitTimeout()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (auto &entry : deque_)
+            entry.lost = !entry.sacked;
+    }
+
+    // Start a loss recovery: every hole may be resent once more
+    void beginRecovery()
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        ++recoveryEpoch_;
+        highRxt_ = 0;
+        sackedBelowRxt_ = 0;
+    }
+
+    // Whether retransmitNextHole() has an entry to resend
+    bool hasHole(std::uint32_t una)
+    {
+        std::lock_guard<std::mutex> lk(mutex_);
+        return nextHoleNoLock_(una).first != deque_.end();
+    }
+
+    // The next lost entry not resent yet in this recovery, marked as retransmitted now. Returns nullopt if there is none.
+    [[nodiscard]] std::optional<LockedEntryRef> retransmitNextHole(std::uint32_t una)
+    {
+        std::unique_lock<std::mutex> lk(mutex_);
+        const auto [hole, sackedBelow] = nextHoleNoLock_(una);
+        if (hole == deque_.end())
+            return std::nullopt;
+
+        highRxt_ = hole->getEndExclusive();
+        sackedBelowRxt_ = sackedBelow;
+        hole->recoveryEpoch = recoveryEpoch_;
+        hole->lost = false;
+        ++hole->counter;  // Karn's algorithm: no RTT sample from it anymore
+        hole->refreshTimestamp();
+        std::cout << "Fast retransmitting packet (seq: " << hole->packet.getSeqNumHost()
+                  << ", len: " << hole->packet.getPayloadSize() << ")\n";
+        return std::make_pair(std::move(lk), std::ref(*hole));
+    }
+
+    // Whether any regular entry (not the zero window probe) within the window has timed out
+    bool hasExpiredEntries(std::uint32_t rightWindowEdge = 0)
+    {
+        const auto now = SC::now();
+        const auto rtoEst = rto.get();
+        std::lock_guard<std::mutex> lk(mutex_);
+        return std::ranges::any_of(deque_, [&](const Entry &entry) {
+            return !entry.sacked && entry.hasExpired(now, rtoEst) && entry.getEndExclusive() <= rightWindowEdge;
+        });
+    }
+
+    // When the retransmission timer should fire next: the earliest time an entry expires, or nullopt if the queue is empty.
+    // Entries beyond the right window edge do not time out, but are checked again after an RTO.
+    std::optional<SC::time_point> nextExpiry(std::uint32_t rightWindowEdge = 0)
+    {
+        using namespace std::chrono;
+        const auto now = SC::now();
+        const auto rtoEst = duration_cast<SC::duration>(rto.get());
+        std::optional<SC::time_point> next;
+        const auto consider = [&next](SC::time_point at) { next = next ? std::min(*next, at) : at; };
+
+        std::lock_guard<std::mutex> lk(mutex_);
+        for (const auto &entry : deque_ | std::views::filter([](const Entry &e) { return !e.sacked; }))
+            consider(entry.getEndExclusive() <= rightWindowEdge ? entry.lastSent + rtoEst : now + rtoEst);
+        if (zwpEntry_)
+            consider(zwpEntry_->lastSent + duration_cast<SC::duration>(rtoEst * std::exp2(zwpEntry_->counter)));
+        return next;
+    }
+
     void resetZwpCounter() noexcept
     {
         if (zwpEntry_)
@@ -164,38 +280,109 @@ public:
     //     }
     // }
 
+    // Smoothed RTT and retransmission timeout (RFC 6298), with the variance of the samples
     struct RtoEstimator {
     public:
-        using msec = std::chrono::milliseconds;
-        static constexpr auto MIN_RTO = msec{500};   // minimum RTO (500 ms)
-        static constexpr auto MAX_RTO = msec{1000};  // maximum RTO (1 second)
-        static constexpr auto ALPHA   = 0.875;       // "smoothing factor"
-        static constexpr auto BETA    = 1.5;         // "delay factor"
-
-        const msec &get() const noexcept
+        using usec = std::chrono::microseconds;
+        static constexpr usec INIT_RTO{std::chrono::seconds{1}};            // Until the first sample (section 2.1)
+        static constexpr usec DEFAULT_MIN_RTO{std::chrono::milliseconds{200}};
+        static constexpr usec MAX_RTO{std::chrono::seconds{60}};
+        static constexpr usec GRANULARITY{std::chrono::milliseconds{1}};    // Of the timer wheel
+        static constexpr double ALPHA = 1.0 / 8;  // Gain of SRTT
+        static constexpr double BETA  = 1.0 / 4;  // Gain of RTTVAR
+        static constexpr int    K     = 4;
+
+        usec get() const { std::lock_guard lk(mutex_); return rto_; }
+        usec getSrtt() const { std::lock_guard lk(mutex_); return srtt_; }
+        usec getRttVar() const { std::lock_guard lk(mutex_); return rttvar_; }
+        usec getMinRto() const { std::lock_guard lk(mutex_); return minRto_; }
+
+        // The RTO never goes below `minRto`. RFC 6298 asks for 1 s, which a simulated network would wait out for nothing
+        void setMinRto(usec minRto)
         {
-            // return _rto_dbg_;  // hard coded 10s RTO for DEBUGGING EARLY ARRIVAL ONLY
-            return rto_;
+            std::lock_guard lk(mutex_);
+            minRto_ = std::clamp(minRto, GRANULARITY, MAX_RTO);
+            rto_ = std::max(rto_, minRto_);
         }
 
-        void addRttSample(const auto &rtt) noexcept
+        // Take an RTT sample, which also ends any backoff. With timestamps, most ACKs yield one: each then weighs
+        // less, as if the `expectedSamples` of a round trip made one (RFC 7323, section 4.2)
+        void addRttSample(const auto &rtt, std::size_t expectedSamples = 1)
         {
             using std::chrono::duration_cast;
-            srtt_ = duration_cast<msec>(ALPHA * srtt_ + (1 - ALPHA) * rtt);
-            rto_  = std::clamp(duration_cast<msec>(BETA * srtt_), MIN_RTO, MAX_RTO);
-            // std::cout << "added rtt sample " << duration_cast<msec>(rtt).count() << "ms, SRTT = " 
-            //           << srtt_.count() << "ms, new RTO = " << rto_.count() << "ms\n";
+            const auto r = std::max(duration_cast<usec>(rtt), usec::zero());
+            const auto n = static_cast<double>(std::max<std::size_t>(expectedSamples, 1));
+
+            std::lock_guard lk(mutex_);
+            if (!hasSample_) {
+                srtt_ = r;
+                rttvar_ = r / 2;
+                hasSample_ = true;
+            } else {
+                const auto beta = BETA / n, alpha = ALPHA / n;
+                rttvar_ = duration_cast<usec>((1 - beta) * rttvar_ + beta * (srtt_ > r ? srtt_ - r : r - srtt_));
+                srtt_ = duration_cast<usec>((1 - alpha) * srtt_ + alpha * r);
+            }
+            rto_ = std::clamp(srtt_ + std::max(GRANULARITY, K * rttvar_), minRto_, MAX_RTO);
+        }
+
+        // The retransmission timer expired: double the RTO until the next sample (section 5.5)
+        void backoff()
+        {
+            std::lock_guard lk(mutex_);
+            rto_ = std::min(2 * rto_, MAX_RTO);
         }
 
     private:
-        msec srtt_{300};     // "smoothed round-trip time"
-        msec  rto_{500};     // "retransmission timeout"
-        // msec  _rto_dbg_{10000};  // hard coded 10s RTO for DEBUGGING EARLY ARRIVAL ONLY
+        usec srtt_{0};       // "smoothed round-trip time"
+        usec rttvar_{0};     // "round-trip time variation"
+        usec rto_{INIT_RTO}; // "retransmission timeout"
+        usec minRto_{DEFAULT_MIN_RTO};
+        bool hasSample_ = false;
+        mutable std::mutex mutex_;
     } rto;
 
 private:
+    // The first entry after `una` is lost: a duplicate or partial ACK reported it. Any later one is, once more than
+    // DUPACK_THRESHOLD - 1 segments above it were SACKed (IsLost() of RFC 6675). Skips those resent in this recovery.
+    // The scan resumes at highRxt_, as everything below it was SACKed or resent already (NextSeg() of RFC 6675).
+    // Returns the hole (end() if none) and the bytes SACKed below it.
+    std::pair<std::deque<Entry>::iterator, std::size_t> nextHoleNoLock_(std::uint32_t una)
+    {
+        const auto first = std::ranges::upper_bound(deque_, una, {}, &Entry::getEndExclusive);
+        auto it = std::ranges::lower_bound(deque_, highRxt_, {}, [](const Entry &e) { return e.packet.getSeqNumHost(); });
+
+        std::size_t sackedBelow = sackedBelowRxt_;
+        for (; it < first; ++it)
+            sackedBelow += it->sacked ? it->packet.getPayloadSize() : 0;
+
+        for (; it != deque_.end(); ++it) {
+            if (it->sacked) {
+                sackedBelow += it->packet.getPayloadSize();
+                continue;
+            }
+            if (it != first && sackedBytes_ - sackedBelow <= (DUPACK_THRESHOLD - 1) * MAX_TCP_PAYLOAD_SIZE)
+                break;
+            if (it->recoveryEpoch != recoveryEpoch_)
+                return {it, sackedBelow};
+        }
+        return {deque_.end(), sackedBelow};
+    }
+
+    // An entry SACKed before leaves the queue
+    void unsackNoLock_(const Entry &entry) noexcept
+    {
+        sackedBytes_ -= entry.packet.getPayloadSize();
+        if (entry.getEndExclusive() <= highRxt_)
+            sackedBelowRxt_ -= entry.packet.getPayloadSize();
+    }
+
     std::deque<Entry> deque_;
     std::optional<Entry> zwpEntry_;
+    std::size_t recoveryEpoch_ = 0;
+    std::size_t sackedBytes_ = 0;      // Payload bytes of the SACKed entries
+    std::size_t highRxt_ = 0;          // HighRxt: end of the last hole resent in this recovery, see nextHoleNoLock_()
+    std::size_t sackedBelowRxt_ = 0;   // Payload bytes of the SACKed entries below it
     std::mutex mutex_;  // Separate mutex for the retransmission queue
 };
 
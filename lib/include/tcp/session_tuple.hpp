@@ -1,37 +1,59 @@
 #pragma once
 
+#include <string>
+
 #include "ip/address.hpp"
 
 namespace tns {
 namespace tcp {
 
+// An (IPv4 address, port) pair identifying one end of a TCP connection
+struct Endpoint {
+    ip::Ipv4Address addr;
+    in_port_t port = 0;  // network byte order
+
+    constexpr bool operator==(const Endpoint &other) const noexcept = default;
+
+    constexpr in_port_t getPortHost() const noexcept { return tns::util::ntoh(port); }
+    constexpr in_port_t getPortNetwork() const noexcept { return port; }
+
+    std::string toString() const { return addr.toStringAddr() + ":" + std::to_string(getPortHost()); }
+};
+
+// Flow key of a TCP connection, packed into 12 bytes (addresses first, then ports).
+// All fields are in network byte order, exactly as they appear on the wire.
 struct SessionTuple {
-    ip::Ipv4Address local;
-    ip::Ipv4Address remote;
+    ip::Ipv4Address localAddr;
+    ip::Ipv4Address remoteAddr;
+    in_port_t localPort = 0;
+    in_port_t remotePort = 0;
 
-    bool operator==(const SessionTuple& other) const {
-        return local == other.local && remote == other.remote;
-    }
+    constexpr SessionTuple() noexcept = default;
+    constexpr SessionTuple(const Endpoint &local, const Endpoint &remote) noexcept
+        : localAddr(local.addr), remoteAddr(remote.addr), localPort(local.port), remotePort(remote.port)
+    {}
+
+    constexpr Endpoint local()  const noexcept { return {localAddr, localPort}; }
+    constexpr Endpoint remote() const noexcept { return {remoteAddr, remotePort}; }
+
+    constexpr bool operator==(const SessionTuple &other) const noexcept = default;
 };
 
+static_assert(sizeof(SessionTuple) == 12);
+
 } // namespace tcp
 } // namespace tns
 
 
-// Simple hash function for a SessionTuple
+// Mixes all 96 bits of the flow key (both addresses and both ports)
 template <>
 struct std::hash<tns::tcp::SessionTuple> {
-    std::size_t operator()(const tns::tcp::SessionTuple& tuple) const
+    std::size_t operator()(const tns::tcp::SessionTuple &tuple) const noexcept
     {
-        using tns::util::hash_combine;
-        std::uint32_t addrL = tuple.local.getAddrNetwork();
-        std::uint32_t addrR = tuple.remote.getAddrNetwork();
-        std::uint32_t ports = (static_cast<std::uint32_t>(tuple.local.getAddrNetwork()) << 16) | tuple.remote.getAddrNetwork();
-        
-        std::size_t seed = 0;
-        hash_combine(seed, addrL);
-        hash_combine(seed, addrR);
-        hash_combine(seed, ports);
-        return seed;
+        using tns::util::mix64;
+        const auto addrs = (static_cast<std::uint64_t>(tuple.localAddr.getAddrNetwork()) << 32)
+                         | tuple.remoteAddr.getAddrNetwork();
+        const auto ports = (static_cast<std::uint64_t>(tuple.localPort) << 16) | tuple.remotePort;
+        return mix64(addrs ^ mix64(ports));
     }
 };
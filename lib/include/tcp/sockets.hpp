@@ -6,9 +6,11 @@
 #include "tcp/socket_error.hpp"
 #include "tcp/buffers.hpp"
 #include "tcp/constants.hpp"
+#include "tcp/transmit_scheduler.hpp"
 #include "ip/address.hpp"
 #include "util/tl/expected.hpp"
 #include "util/defines.hpp"
+#include "util/timer_wheel.hpp"
 
 #include <iomanip>
 #include <variant>
@@ -44,7 +46,9 @@ class ListenSocket {
     struct CtorToken {};  // passkey idiom
 
 public:
-    ListenSocket(int id, in_port_t port, CtorToken) : id_(id), port_(port) {}
+    // onClosed: the socket transitioned to CLOSED and can be reaped
+    ListenSocket(int id, in_port_t port, std::function<void()> onClosed, CtorToken)
+        : id_(id), port_(port), onClosed_(std::move(onClosed)) {}
 
     // ListenSocket() = delete;
     // ListenSocket(const ListenSocket&) = delete;
@@ -72,6 +76,7 @@ public:
                 pendingSocks_.onClose();  // Close all pending connections; Remove from socket table?
                 acceptQ_.onClose();       // Empty the queue & wake up all threads waiting on the queue
                 state_ = states::Closed{};
+                onClosed_();
                 return {};
             },
             [](const states::Closed &) -> ReturnType { return tl::unexpected{SocketError::CONN_NOT_EXIST}; },
@@ -89,6 +94,7 @@ private:
     int id_;
     in_port_t port_;  // host byte order
     State state_ = states::Listen{};  // LISTEN/CLOSED
+    const std::function<void()> onClosed_;
 
     // A list of pending connections (SYN-RECEIVED sockets) keyed by the session tuple
     struct PendingSocks {
@@ -134,26 +140,36 @@ class NormalSocket {
     struct CtorToken {};  // passkey idiom
     struct TcpStackCallbacks {
         std::function<void(const Packet &packet, const ip::Ipv4Address &destAddr)> sendPacket;
+        std::function<void()> onClosed;  // The socket transitioned to CLOSED and can be reaped
     };
 
 public:
     NormalSocket(int id, const SessionTuple &tuple, 
-                 uint32_t isn, uint32_t windowSize, // sendBuffer_
+                 uint32_t isn, uint32_t windowSize, CongestionAlgorithm congestionAlgorithm, // sendBuffer_
                  uint32_t rcvNxt,  // recvBuffer_
+                 tns::util::TimerWheel &timerWheel,
+                 TransmitScheduler &transmitScheduler,
                  TcpStackCallbacks callbacks,
                  CtorToken)
         : id_{id}, tuple_{tuple}
-        , sendBuffer_(isn, windowSize)
+        , sendBuffer_(isn, windowSize, congestionAlgorithm)
         , recvBuffer_(rcvNxt)
-        // , senderThread_{&NS::senderFunction_, this}
-        // , retransmitThread_{RETRANSMIT_THREAD_PERIOD, &NS::retransmitFunction_, this}
-        // , zwpThread_{&NS::zwpFunction_, this}
+        , lastAckSent_{rcvNxt}
         , tcpStackCallbacks_{std::move(callbacks)}
-    {}
+        , rtoTimer_{timerWheel, [this] { onRtoTimeout_(); }}
+        , zwpTimer_{timerWheel, [this] { onZwpTimeout_(); }}
+        , ackTimer_{timerWheel, [this] { onAckTimeout_(); }}
+        , transmitScheduler_{transmitScheduler}
+        , transmitId_{transmitScheduler.add([this] { return transmitReady_(); })}
+    {
+        sendBuffer_.setZwpTimer(&zwpTimer_);
+        sendBuffer_.setReadyCallback([this] { transmitScheduler_.notify(transmitId_); });
+    }
 
     ~NormalSocket()
     {
         std::cout << "NormalSocket::~NormalSocket: Normal socket " << id_ << " is being destroyed\n";
+        transmitScheduler_.remove(transmitId_);  // Waits for a transmission in progress
         shutdown_();
         std::cout << "NormalSocket::~NormalSocket: DONE!\n";
     }
@@ -190,6 +206,37 @@ public:
         }, state_);
     }
 
+    using ExpectedView = tl::expected<PayloadSpans, SocketError>;
+
+    // Same as vRecv(), without copying: a view of all the data received so far, in the receive buffer itself (two
+    // spans if it wraps around the end of the buffer). The bytes stay valid until vConsume() frees them, and at
+    // most until the socket is closed. Meanwhile the window does not open for them.
+    ExpectedView vRecvView()
+    {
+        return std::visit(overload{
+            [&, this](const states::SynSent     &) -> ExpectedView { return tl::unexpected{SocketError::NYI}; },
+            [&, this](const states::SynReceived &) -> ExpectedView { return tl::unexpected{SocketError::NYI}; },
+            [&, this](const states::Established &) { return recvBuffer_.peek(); },
+            [&, this](const states::FinWait1    &) { return recvBuffer_.peek(); },
+            [&, this](const states::FinWait2    &) { return recvBuffer_.peek(); },
+            [&, this](const states::TimeWait    &) { return recvBuffer_.peek(); },
+            [&, this](const states::CloseWait   &) { return recvBuffer_.getSizeToRead()
+                                                            ? recvBuffer_.peek()
+                                                            : tl::unexpected{SocketError::CLOSING}; },
+            [](const states::Closed &) -> ExpectedView { return tl::unexpected{SocketError::CONN_NOT_EXIST}; },
+            [](const auto           &) -> ExpectedView { return tl::unexpected{SocketError::CLOSING}; }
+        }, state_);
+    }
+
+    // Free the first `n` bytes of the data received, once done with a view of them from vRecvView().
+    // Returns the number of bytes freed, at most the size of the view
+    ExpectedSize vConsume(std::size_t n)
+    {
+        if (std::holds_alternative<states::Closed>(state_))
+            return tl::unexpected{SocketError::CONN_NOT_EXIST};
+        return recvBuffer_.consume(n);
+    }
+
     tl::expected<void, SocketError> vClose()
     {
         using ReturnType = tl::expected<void, SocketError>;
@@ -199,6 +246,7 @@ public:
                 s.onError(SocketError::CLOSING);  // Notify caller of vConnect() that the connection is closing
                 shutdown_();                      // Shut down both send & recv buffers: Threads waiting on the buffers should exit
                 state_ = states::Closed{};        // Transition to CLOSED
+                tcpStackCallbacks_.onClosed();
                 return {};
             },
             [this](const states::SynReceived &s) -> ReturnType {
@@ -230,11 +278,48 @@ public:
             // TODO!: Flush retransmission queue
             shutdown_();
             state_ = states::Closed{};
+            tcpStackCallbacks_.onClosed();
         }
 
         return retval;
     }
 
+    // Congestion control of this connection. Changing it restarts from the initial window.
+    void setCongestionAlgorithm(CongestionAlgorithm algorithm) { sendBuffer_.setCongestionAlgorithm(algorithm); }
+    CongestionAlgorithm getCongestionAlgorithm() const { return sendBuffer_.getCongestionAlgorithm(); }
+
+    // Losses recovered by fast retransmits, and by retransmission timeouts
+    std::size_t getFastRetransmits() const { return sendBuffer_.getFastRetransmits(); }
+    std::size_t getRetransmitTimeouts() const { return sendBuffer_.getRetransmitTimeouts(); }
+
+    // Whether both ends agreed on selective acknowledgments in the handshake
+    bool isSackPermitted() const noexcept { return sackPermitted_; }
+
+    // Window scale shifts agreed in the handshake: of the windows the remote advertises, and of ours (0 if none)
+    std::uint8_t getSendWndShift() const noexcept { return sndWndShift_; }
+    std::uint8_t getRecvWndShift() const noexcept { return rcvWndShift_; }
+
+    // Whether both ends agreed on timestamps in the handshake, which then time every ACK
+    bool hasTimestamps() const noexcept { return timestamps_; }
+
+    // The smoothed round trip time and the retransmission timeout, backed off after timeouts
+    auto getSrtt() const { return sendBuffer_.retransmitQueue.rto.getSrtt(); }
+    auto getRto() const { return sendBuffer_.retransmitQueue.rto.get(); }
+
+    // Whether data received in order is acknowledged every second segment (on by default), or every segment
+    void setDelayedAck(bool enabled) noexcept { delayedAck_ = enabled; }
+    bool isDelayedAck() const noexcept { return delayedAck_; }
+
+    // Nagle's algorithm is on by default: small writes wait for the data in flight to be acknowledged, then go out
+    // together. With no delay (TCP_NODELAY), they are sent at once. While corked (TCP_CORK), only full segments are.
+    void setNoDelay(bool noDelay) { sendBuffer_.setNoDelay(noDelay); }
+    bool isNoDelay() const { return sendBuffer_.isNoDelay(); }
+    void setCork(bool cork) { sendBuffer_.setCork(cork); }
+    bool isCorked() const { return sendBuffer_.isCorked(); }
+
+    // Pure ACKs sent, i.e. not carried by a data segment
+    std::size_t getPureAcksSent() const noexcept { return pureAcksSent_; }
+
     // Getters
     int getID() const { return id_; }
     const SessionTuple & getSessionTuple() const { return tuple_; }
@@ -249,16 +334,31 @@ private:
     SendBuffer<SEND_BUFFER_SIZE> sendBuffer_;
     RecvBuffer<RECV_BUFFER_SIZE> recvBuffer_;
 
-    // Threads for sending and retransmitting packets
-    std::jthread senderThread_{&NS::senderFunction_, this};
-    std::jthread zwpThread_{&NS::zwpFunction_, this};
+    std::atomic<bool> sackPermitted_{false};  // Set by the handshake
+    std::atomic<std::uint8_t> sndWndShift_{0};  // Set by the handshake: SND.WND.SCALE
+    std::atomic<std::uint8_t> rcvWndShift_{0};  //                       RCV.WND.SCALE
+    std::atomic<bool> timestamps_{false};       // Set by the handshake
+    std::atomic<std::uint32_t> tsRecent_{0};    // TS.Recent: the timestamp to echo (RFC 7323, section 4.3)
+
+    std::atomic<bool> delayedAck_{true};
+    std::atomic<bool> ackPending_{false};         // An ACK waits for the next transmit turn
+    std::atomic<std::size_t> quickAcks_{QUICK_ACK_SEGMENTS};  // Segments left to acknowledge one by one
+    std::atomic<std::uint32_t> lastAckSent_;      // Last.ACK.sent: the RCV.NXT we acknowledged last
+    std::atomic<std::size_t> lastWndSent_{RECV_BUFFER_SIZE};  // The receive window we advertised last
+    std::atomic<std::size_t> pureAcksSent_{0};
 
-    tns::util::threading::PeriodicThread retransmitThread_{
-        RETRANSMIT_THREAD_PERIOD, &NS::retransmitFunction_, this};
-    
     // Callbacks to the TCP stack (sendPacket, etc.)
     const TcpStackCallbacks tcpStackCallbacks_;
 
+    // Retransmission timer, armed while packets wait for their ACK, zero-window probe timer, and delayed ACK timer
+    tns::util::Timer rtoTimer_;
+    tns::util::Timer zwpTimer_;
+    tns::util::Timer ackTimer_;
+
+    // Sends the ready data on the stack's transmit workers. Registered last: transmitReady_() uses the members above
+    TransmitScheduler &transmitScheduler_;
+    const TransmitScheduler::SourceId transmitId_;
+
     friend WriteInfo;
     friend class TcpStack;
 
@@ -266,12 +366,14 @@ private:
 
     void shutdownSend_()
     {
-        retransmitThread_.stop();
+        rtoTimer_.cancel();
+        zwpTimer_.cancel();
         sendBuffer_.shutdown();
     }
 
     void shutdownRecv_()
     {
+        ackTimer_.cancel();
         recvBuffer_.shutdown();
     }
 
@@ -281,40 +383,149 @@ private:
         shutdownRecv_();
     }
 
-    void sendFin_()
+    // Nothing more will be written: the FIN follows the data still in the send buffer, see sendFinIfDue_()
+    void queueFin_()
     {
-        const auto seq = sendBuffer_.getNxt();
-        const auto wnd = static_cast<std::uint16_t>(recvBuffer_.getSizeFree());
-
-        std::cout << "NormalSocket::sendFin_(): seq=" << seq << ", wnd=" << wnd << "\n";
-
-        sendBuffer_.writeAndSendOne();  // ugly hack to increment SND.NBW and SND.NXT by one
-        sendPacket_(Packet::makeFinPacket(tuple_, seq, wnd));
+        std::cout << "NormalSocket::queueFin_(): " << sendBuffer_.getSizeNotSent() << " bytes to send before the FIN\n";
+        sendBuffer_.queueFin();
     }
 
-    // Send FIN, then go to FIN_WAIT_1
+    // Queue a FIN, then go to FIN_WAIT_1
     void closeAsActive_()
     {
-        std::cout << "NormalSocket::closeAsActive_(): Sending FIN...\n";
+        std::cout << "NormalSocket::closeAsActive_(): Queueing FIN...\n";
         // SYN_RECV/ESTABLISHED => FIN_WAIT_1
-        sendFin_();
         state_ = states::FinWait1{};
+        queueFin_();
         std::cout << "NormalSocket::closeAsActive_(): Transitioned to FIN_WAIT_1\n";
     }
 
-    // Send FIN, then go to LAST_ACK
+    // Queue a FIN, then go to LAST_ACK
     void closeAsPassive_()
     {
-        std::cout << "NormalSocket::closeAsActive_(): Sending FIN...\n";
+        std::cout << "NormalSocket::closeAsPassive_(): Queueing FIN...\n";
         // CLOSE_WAIT => LAST_ACK
-        sendFin_();
         state_ = states::LastAck{};
-        std::cout << "NormalSocket::closeAsActive_(): Transitioned to LAST_ACK\n";
+        queueFin_();
+        std::cout << "NormalSocket::closeAsPassive_(): Transitioned to LAST_ACK\n";
+    }
+
+    // Options every segment carries: the timestamps, if agreed
+    TcpOptions segmentOptions_() const
+    {
+        TcpOptions options;
+        if (timestamps_)
+            options.timestamps = Timestamps{timestampNow(), tsRecent_};
+        return options;
+    }
+
+    // Payload bytes per segment: what the timestamps leave of a datagram
+    std::size_t segmentSize_() const noexcept { return MAX_TCP_PAYLOAD_SIZE - (timestamps_ ? TIMESTAMPS_SIZE : 0); }
+
+    // A segment is resent with the current timestamps, so that its ACK times the retransmission
+    void restamp_(Packet &packet) const
+    {
+        if (timestamps_)
+            packet.setTimestamps({timestampNow(), tsRecent_});
     }
 
+    // Handle an ACK segment: the timestamp to echo from now on, then the acknowledgment.
+    // Returns the in-flight data window as a pair of (SND.UNA, SND.NXT), see SendBuffer::onAck()
+    auto onAck_(const events::GetAck &getAck)
+    {
+        // Only a segment at or below Last.ACK.sent: while an ACK is delayed, it echoes the first segment it acknowledges,
+        // and one out of order does not say how long the data in between took
+        if (timestamps_ && getAck.options.timestamps && getAck.seqNum <= lastAckSent_)
+            tsRecent_ = getAck.options.timestamps->value;
+        return sendBuffer_.onAck(getAck.ackNum, peerWnd_(getAck.wndSize), getAck.payload.empty(), getAck.options);
+    }
+
+    // An ACK of the data received, with the blocks received out of order if SACK is permitted
+    Packet makeAckPacket_(std::uint32_t seq, std::uint32_t ack, std::size_t wnd) const
+    {
+        auto options = segmentOptions_();
+        if (sackPermitted_)
+            recvBuffer_.addSackBlocks(options);
+        return Packet::makeAckPacket(tuple_, seq, ack, advertisedWnd_(wnd), nullptr, options);
+    }
+
+    // Handle the data of a segment, then acknowledge it. At once if it arrived out of order, filled a hole or left
+    // one below other data (the sender counts the duplicate ACKs, RFC 5681 section 4.2), or if the window opened or
+    // nearly closed; the next QUICK_ACK_SEGMENTS in order too, as the first ones of the connection. Otherwise once
+    // two full segments are in: on the next transmit turn, so that the segments received meanwhile share the ACK,
+    // and a data segment sent by then carries it instead. A lone segment is acknowledged after DELAYED_ACK_TIMEOUT.
+    void onData_(const events::GetAck &getAck)
+    {
+        const auto rcvNxt = recvBuffer_.getNxt();
+        const auto &[ack, wnd] = recvBuffer_.onRecv(getAck.seqNum, getAck.payload);  // locks recvBuffer_
+
+        const auto inOrder = getAck.seqNum == rcvNxt && ack == rcvNxt + getAck.payload.size() && !recvBuffer_.hasEarlyArrivals();
+        if (!inOrder)
+            quickAcks_ = QUICK_ACK_SEGMENTS;  // A loss: the sender recovers faster with every ACK
+
+        const auto wndChanged = wnd >= lastWndSent_ + RECV_BUFFER_SIZE / 2 || wnd < DELAYED_ACK_SEGMENTS * segmentSize_();
+        if (!delayedAck_ || !inOrder || wndChanged || takeQuickAck_()) {
+            sendAck_();
+            return;
+        }
+
+        if (ack - lastAckSent_ >= DELAYED_ACK_SEGMENTS * segmentSize_()) {
+            ackPending_ = true;
+            transmitScheduler_.notify(transmitId_);
+        }
+        else if (!ackTimer_.isArmed())
+            ackTimer_.arm(DELAYED_ACK_TIMEOUT);
+    }
+
+    // Whether to acknowledge this segment alone: the first ones of the connection or after a loss
+    bool takeQuickAck_() noexcept
+    {
+        auto left = quickAcks_.load();
+        while (left > 0 && !quickAcks_.compare_exchange_weak(left, left - 1)) {}
+        return left > 0;
+    }
+
+    // Send a pure ACK of all the data received
+    void sendAck_()
+    {
+        const auto &[ack, wnd] = recvBuffer_.getAckWnd();
+        sendAck_(sendBuffer_.getNxt(), ack, wnd);
+    }
+
+    void sendAck_(std::uint32_t seq, std::uint32_t ack, std::size_t wnd)
+    {
+        onAckSent_(ack, wnd);
+        pureAcksSent_++;
+        sendPacketNoRetransmit_(makeAckPacket_(seq, ack, wnd));
+    }
+
+    // A segment acknowledges `ack` and advertises `wnd`: no delayed ACK is needed for the data below
+    void onAckSent_(std::uint32_t ack, std::size_t wnd) noexcept
+    {
+        lastAckSent_ = ack;
+        lastWndSent_ = wnd;
+    }
+
+    // The delayed ACK timer expired: acknowledge the data received since the last ACK, if any
+    void onAckTimeout_()
+    {
+        if (recvBuffer_.getNxt() != lastAckSent_)
+            sendAck_();
+    }
+
+    // The window field for `wnd` bytes: scaled down by `shift`, at most 16 bits. SYN and SYN-ACK are never scaled
+    static std::uint16_t windowField_(std::size_t wnd, std::uint8_t shift) noexcept
+    {
+        return static_cast<std::uint16_t>(std::min<std::size_t>(wnd >> shift, std::numeric_limits<std::uint16_t>::max()));
+    }
+    std::uint16_t advertisedWnd_(std::size_t wnd) const noexcept { return windowField_(wnd, rcvWndShift_); }
+
+    // The window in bytes advertised by the window field of a (non-SYN) segment from the remote
+    std::uint32_t peerWnd_(std::uint16_t wndField) const noexcept { return std::uint32_t{wndField} << sndWndShift_; }
+
     void sendPacketNoRetransmit_(const Packet &packet)
     {
-        tcpStackCallbacks_.sendPacket(packet, tuple_.remote);
+        tcpStackCallbacks_.sendPacket(packet, tuple_.remoteAddr);
     }
 
     void sendPacket_(Packet &&packet)
@@ -323,7 +534,11 @@ private:
         const auto &[lk, entry] = sendBuffer_.retransmitQueue.enqueue(std::move(packet));
         assert(lk.owns_lock() && "NormalSocket::sendPacket_(): Lock must be held until the packet is sent");
 
-        tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remote);
+        tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remoteAddr);
+
+        // Time the packet, unless the timer already runs for an earlier one
+        if (!rtoTimer_.isArmed())
+            armRtoTimer_(sendBuffer_.retransmitQueue.rto.get());
     }
 
     void sendZwpPacket_(Packet &&packet)
@@ -335,56 +550,117 @@ private:
         // Record the entry in the zwp struct
         // sendBuffer_.zwpRecordRetransmitEntry(entry.get());
 
-        tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remote);
+        tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remoteAddr);
+
+        if (!rtoTimer_.isArmed())
+            armRtoTimer_(sendBuffer_.retransmitQueue.rto.get());
     }
 
-    void zwpFunction_()
+    void armRtoTimer_(tns::util::Clock::duration delay)
     {
-        while (true) {
-            auto zwpByteViewMaybe = sendBuffer_.zwpGetProbeByte();
-            if (!zwpByteViewMaybe) break;  // Socket closed
+        // Entries expire once strictly older than the RTO: fire a millisecond after
+        rtoTimer_.arm(std::max(delay, tns::util::Clock::duration::zero()) + std::chrono::milliseconds{1});
+    }
 
-            auto &ldv = zwpByteViewMaybe.value();
-            if (ldv.empty()) continue;  // No probe data needed to send
+    // The zero window did not open within the timeout: send a probe
+    void onZwpTimeout_()
+    {
+        auto zwpByteViewMaybe = sendBuffer_.zwpOnTimeout();
+        if (!zwpByteViewMaybe) return;  // Socket closed
 
-            assert(ldv.size() == 1 && "NormalSocket::zwpFunction_(): Probe data should be one byte long");
-            assert(ldv.lock.owns_lock() && "NormalSocket::zwpFunction_(): Lock must be held until the ZWP packet is sent");
+        auto &ldv = zwpByteViewMaybe.value();
+        if (ldv.empty()) return;  // No probe data needed to send
 
-            // Send out probe data
-            const auto &[ack, wnd] = recvBuffer_.getAckWnd();  // Locks recvBuffer_.mutex_
-            sendZwpPacket_/*sendPacket_*/(Packet::makeAckPacket(
-                tuple_, ldv.seq, ack, static_cast<uint16_t>(wnd),
-                std::make_unique<Payload>(ldv.data.begin(), ldv.data.end())));
+        assert(ldv.size() == 1 && "NormalSocket::onZwpTimeout_(): Probe data should be one byte long");
+        assert(ldv.lock.owns_lock() && "NormalSocket::onZwpTimeout_(): Lock must be held until the ZWP packet is sent");
 
-            std::cout << "NormalSocket::zwpFunction_(): Sent ZWP. Waiting for ACK indefinitely...\n";
-            auto gotAck = sendBuffer_.zwpWaitAck(std::move(ldv));  // BLOCK on sendBuffer_.cvZwpAck_ (until ACK is received
-            if (!gotAck) break;  // Socket closed
+        // Send out probe data, retransmitted with an exponential backoff until ACKed
+        const auto &[ack, wnd] = recvBuffer_.getAckWnd();  // Locks recvBuffer_.mutex_
+        sendZwpPacket_(Packet::makeAckPacket(
+            tuple_, ldv.seq, ack, advertisedWnd_(wnd), PayloadSpans{ldv.data, {}}, segmentOptions_()));
 
-            std::cout << "Got ACK, going back to begining\n";
-        }
+        std::cout << "NormalSocket::onZwpTimeout_(): Sent ZWP. Waiting for ACK...\n";
+    }
+
+    // Send up to TRANSMIT_QUANTUM segments of ready data, then the pending ACK unless they carried it, on a transmit
+    // worker. Returns whether more data is ready, to get another turn after the other ready sockets.
+    bool transmitReady_()
+    {
+        const auto more = transmitData_();
+        if (!more)
+            sendFinIfDue_();
+        if (ackPending_.exchange(false) && recvBuffer_.getNxt() != lastAckSent_)
+            sendAck_();
+        return more;
     }
 
-    void senderFunction_()
+    bool transmitData_()
     {
-        std::array<std::byte, MAX_TCP_PAYLOAD_SIZE> data;
-        while (true) {
-            // std::cout << "NormalSocket::senderFunction_(): Waiting for data to send...\n";
-            const auto seqnMaybe = sendBuffer_.sendReadyData(data);  // BLOCK on sendBuffer.cvSender_
-            if (!seqnMaybe) break;  // Socket closed
+        // Duplicate or partial ACKs reported lost segments: resend them ahead of everything else
+        while (const auto una = sendBuffer_.takeFastRetransmit()) {
+            if (auto hole = sendBuffer_.retransmitQueue.retransmitNextHole(*una)) {
+                auto &packet = hole->second.get().packet;
+                restamp_(packet);
+                tcpStackCallbacks_.sendPacket(packet, tuple_.remoteAddr);
+            }
+        }
+
+        // Recovering from a timeout: first resend the timed out segments that the ACKs made room for
+        if (sendBuffer_.isInRtoRecovery() && !retransmitExpired_())
+            return false;
 
-            const auto &[seq, n] = *seqnMaybe;
-            // std::cout << "Got " << n << " new bytes to send\n";
+        for (std::size_t i = 0; i < TRANSMIT_QUANTUM; i++) {
+            auto segmentMaybe = sendBuffer_.takeReadyData(segmentSize_());
+            if (!segmentMaybe) return false;  // Nothing to send, closed window, or socket closed
+
+            const auto &[seq, payload] = *segmentMaybe;
+            // std::cout << "Got " << payload.size() << " new bytes to send\n";
             const auto &[ack, wnd] = recvBuffer_.getAckWnd();  // Locks recvBuffer_.mutex_
+            onAckSent_(ack, wnd);
 
             sendPacket_(Packet::makeAckPacket(
-                tuple_, seq, ack, static_cast<uint16_t>(wnd), 
-                std::make_unique<Payload>(data.begin(), data.begin() + n)));
+                tuple_, seq, ack, advertisedWnd_(wnd), payload, segmentOptions_()));
         }
+        return sendBuffer_.hasReadyData(segmentSize_());
     }
 
-    void retransmitFunction_()
+    // Send the FIN queued by vClose() once all the data before it is sent, on the same worker, so that it takes the
+    // sequence number right after the last data segment
+    void sendFinIfDue_()
     {
-        const auto sWndBound = sendBuffer_.getWndEndExclusive();
+        const auto seq = sendBuffer_.takeFin();
+        if (!seq)
+            return;
+
+        const auto &[ack, wnd] = recvBuffer_.getAckWnd();  // Locks recvBuffer_.mutex_
+        std::cout << "NormalSocket::sendFinIfDue_(): seq=" << *seq << ", wnd=" << wnd << "\n";
+        sendPacket_(Packet::makeFinPacket(tuple_, *seq, advertisedWnd_(wnd), segmentOptions_()));
+    }
+
+    void onRtoTimeout_()
+    {
+        if (sendBuffer_.isShutdown() || !retransmitFunction_())
+            return;
+
+        // Re-arm for the next packet to expire, if any is left
+        const auto next = sendBuffer_.retransmitQueue.nextExpiry(sendBuffer_.getSendWndEndExclusive());
+        if (next)
+            armRtoTimer_(*next - tns::util::Clock::now());
+    }
+
+    // The retransmission timer expired: back off the congestion window if data (not only a zero-window probe)
+    // timed out, then retransmit. Returns false if the socket was aborted instead
+    bool retransmitFunction_()
+    {
+        if (sendBuffer_.retransmitQueue.hasExpiredEntries(sendBuffer_.getWndEndExclusive()))
+            sendBuffer_.onRetransmitTimeout();
+        return retransmitExpired_();
+    }
+
+    // Retransmit the expired packets that fit in the congestion window. Returns false if the socket was aborted instead
+    bool retransmitExpired_()
+    {
+        const auto sWndBound = sendBuffer_.getSendWndEndExclusive();
         const auto maybeExpEntries = sendBuffer_.retransmitQueue.getExpiredEntries(sWndBound);
 
         if (maybeExpEntries) {
@@ -392,14 +668,17 @@ private:
             assert((expEntries.empty() || lk.owns_lock()) && 
                 "NormalSocket::retransmitFunction_(): Lock must be held until the packet is resent");
             
-            for (const auto &entry : expEntries)  // Retransmit expired packets
-                tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remote);
-        }
-        else {
-            // Max retransmits reached -> socket should be aborted
-            std::cerr << "NormalSocket::retransmitFunction_(): Max #retransmits reached! Aborting socket " << id_ << "\n";
-            vAbort();
+            for (const auto &entry : expEntries) {  // Retransmit expired packets
+                restamp_(entry.get().packet);
+                tcpStackCallbacks_.sendPacket(entry.get().packet, tuple_.remoteAddr);
+            }
+            return true;
         }
+
+        // Max retransmits reached -> socket should be aborted
+        std::cerr << "NormalSocket::retransmitFunction_(): Max #retransmits reached! Aborting socket " << id_ << "\n";
+        vAbort();
+        return false;
     }
 
 };
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "ip/address.hpp"
+#include "tcp/options.hpp"
 #include "tcp/session_tuple.hpp"
 #include "tcp/socket_error.hpp"
+#include "util/clock.hpp"
 #include "util/defines.hpp"
 #include "util/periodic_thread.hpp"
 #include "util/tl/expected.hpp"
@@ -169,14 +171,15 @@ struct LastAck {
 struct TimeWait {
     static constexpr std::string_view name{"TIME_WAIT"};
 
-    std::chrono::steady_clock::time_point time;
+    static constexpr auto TIMEOUT = std::chrono::seconds{10};
 
-    TimeWait() : time{std::chrono::steady_clock::now()} {}
+    tns::util::Clock::time_point time;
+
+    TimeWait() : time{tns::util::Clock::now()} {}
 
     bool isExpired() const noexcept
     {
-        using namespace std::chrono;
-        return steady_clock::now() - time > 10s;
+        return tns::util::Clock::now() - time > TIMEOUT;
     }
 };
 
@@ -195,30 +198,33 @@ struct GetSyn {
     SessionTuple session;  // Session tuple from swapping that of the SYN packet
     uint32_t clientISN;    // Initial sequence number, Host byte order
     uint16_t clientWND;    // Window size, Host byte order
+    TcpOptions options;
 };
 
 struct GetSynAck {
     uint32_t serverISN;    // Initial sequence number, Host byte order
     uint32_t ackNum;
     uint16_t serverWND;    // Window size, Host byte order
+    TcpOptions options;
 };
 
 struct GetAck {
     uint32_t seqNum;
     uint32_t ackNum;       // Host byte order
-    uint16_t wndSize;      // Host byte order
+    uint16_t wndSize;      // Window field, Host byte order: scaled by SND.WND.SCALE
     PayloadView payload;
+    TcpOptions options;
 };
 
 struct GetFin {
     uint32_t seqNum;
-    uint16_t wndSize;      // Host byte order
+    uint16_t wndSize;      // Window field, Host byte order: scaled by SND.WND.SCALE
 };
 
 struct GetFinAck {
     uint32_t seqNum;
     uint32_t ackNum;       // Host byte order
-    uint16_t wndSize;      // Host byte order
+    uint16_t wndSize;      // Window field, Host byte order: scaled by SND.WND.SCALE
 };
 
 using Variant = std::variant<Close, GetSyn, GetSynAck, GetAck, GetFin, GetFinAck>;
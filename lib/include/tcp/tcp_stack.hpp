@@ -1,17 +1,23 @@
 #pragma once
 
+#include "util/slab.hpp"
 #include "util/tl/expected.hpp"
+#include "util/timer_wheel.hpp"
 #include "ip/datagram.hpp"
 #include "ip/address.hpp"
+#include "tcp/flow_table.hpp"
 #include "tcp/sockets.hpp"
 #include "tcp/packet.hpp"
 #include "tcp/states.hpp"
+#include "tcp/transmit_scheduler.hpp"
 
-#include <set>
+#include <chrono>
+#include <deque>
+#include <functional>
 #include <shared_mutex>
 #include <algorithm>
 #include <random>
-#include <map>
+#include <vector>
 #include <iostream>
 #include <iomanip>
 #include <limits>
@@ -21,6 +27,9 @@ namespace tcp {
 
 class TcpStack {
 public:
+    // Socket timers (retransmissions, zero-window probes, reaping) run on the node's timer wheel
+    explicit TcpStack(tns::util::TimerWheel &timerWheel) : timerWheel_(timerWheel) {}
+
     using IpCallback = std::function<void(const ip::Ipv4Address &destIP, PayloadPtr payload)>;
     void registerIpCallback(IpCallback ipCallback) noexcept { sendIp_ = std::move(ipCallback); }
 
@@ -28,16 +37,20 @@ public:
     // BLOCKS until the connection is established or an error occurs
     // Params: local IP address, remote IP address and port
     tl::expected<NormalSocketRef, SocketError>
-    vConnect(const ip::Ipv4Address &local, const ip::Ipv4Address &remote)
+    vConnect(const ip::Ipv4Address &local, const Endpoint &remote)
     {
-        // Get a free port number for local address
-        const auto port = generatePortNumber_();
-
-        // Create a new normal socket in ESTABLISHED state, or error
-        return createActiveConnection_({
-            .local  = {local.getAddrNetwork(), tns::util::hton(port)}, 
-            .remote = remote
-        });
+        // Get a random port number for local address, and another one if it is taken for this remote
+        for (int attempt = 1; ; attempt++) {
+            const auto port = generatePortNumber_();
+
+            // Create a new normal socket in ESTABLISHED state, or error
+            auto sock = createActiveConnection_({
+                /*  local= */ {local, tns::util::hton(port)}, 
+                /* remote= */ remote
+            });
+            if (sock || sock.error() != SocketError::DUPLICATE_SOCKET || attempt == MAX_PORT_ATTEMPTS)
+                return sock;
+        }
     }
 
     // Create a listening socket bound to the given port (Passive Open)
@@ -58,39 +71,87 @@ public:
             << setw(12) << right << "Status" << "\n"; // Status
 
         std::shared_lock lock(socketTableMutex_);
-        for (const auto &[_, socket] : socketTable_) {
+        sockets_.forEach([&os](auto, const Socket &socket) {
             std::visit([&os](const auto &sock) {
                 WriteInfo{}(sock, os);
             }, socket);
-        }
+        });
+    }
+
+    // Congestion control of the sockets created from now on
+    void setCongestionAlgorithm(CongestionAlgorithm algorithm) noexcept { congestionAlgorithm_ = algorithm; }
+    CongestionAlgorithm getCongestionAlgorithm() const noexcept { return congestionAlgorithm_; }
+
+    // Whether new connections offer or accept selective acknowledgments (RFC 2018). On by default
+    void setSackEnabled(bool enabled) noexcept { sackEnabled_ = enabled; }
+    bool isSackEnabled() const noexcept { return sackEnabled_; }
+
+    // Whether new connections offer or accept window scaling (RFC 7323), to advertise windows over 64 KiB. On by default
+    void setWindowScalingEnabled(bool enabled) noexcept { windowScalingEnabled_ = enabled; }
+    bool isWindowScalingEnabled() const noexcept { return windowScalingEnabled_; }
+
+    // Whether new connections offer or accept timestamps (RFC 7323), for an RTT sample on every ACK. On by default
+    void setTimestampsEnabled(bool enabled) noexcept { timestampsEnabled_ = enabled; }
+    bool isTimestampsEnabled() const noexcept { return timestampsEnabled_; }
+
+    // Lower bound of the retransmission timeout of the sockets created from now on
+    void setMinRto(std::chrono::microseconds minRto) noexcept { minRto_ = minRto; }
+    std::chrono::microseconds getMinRto() const noexcept { return minRto_; }
+
+    // Whether the sockets created from now on delay their ACKs (RFC 1122), acknowledging every second segment. On by default
+    void setDelayedAckEnabled(bool enabled) noexcept { delayedAckEnabled_ = enabled; }
+    bool isDelayedAckEnabled() const noexcept { return delayedAckEnabled_; }
+
+    // Congestion control of a normal socket by its id
+    tl::expected<void, SocketError> setCongestionAlgorithm(int id, CongestionAlgorithm algorithm)
+    {
+        return withNormalSocket_(id, [&](NormalSocket &sock) { sock.setCongestionAlgorithm(algorithm); });
+    }
+
+    // Delayed ACKs of a normal socket by its id
+    tl::expected<void, SocketError> setDelayedAck(int id, bool enabled)
+    {
+        return withNormalSocket_(id, [&](NormalSocket &sock) { sock.setDelayedAck(enabled); });
+    }
+
+    // Nagle's algorithm (off with `noDelay`, as TCP_NODELAY) and cork (TCP_CORK) of a normal socket by its id
+    tl::expected<void, SocketError> setNoDelay(int id, bool noDelay)
+    {
+        return withNormalSocket_(id, [&](NormalSocket &sock) { sock.setNoDelay(noDelay); });
+    }
+    tl::expected<void, SocketError> setCork(int id, bool cork)
+    {
+        return withNormalSocket_(id, [&](NormalSocket &sock) { sock.setCork(cork); });
+    }
+
+    // Number of sockets in the socket table
+    std::size_t countSockets() const
+    {
+        std::shared_lock lock(socketTableMutex_);
+        return sockets_.size();
     }
 
     // Find a socket by its id
     tl::expected<SocketRef, SocketError> findSocketNoLock(int id) noexcept
     {
-        auto it = socketTable_.find(id);
-        if (it == socketTable_.end())
+        auto *socket = id > 0 ? sockets_.get(handleOf_(id)) : nullptr;
+        if (!socket)
             return tl::unexpected(SocketError::CONN_NOT_EXIST);
-        return it->second;
+        return *socket;
     }
-    auto findSocket(int id)
+    tl::expected<SocketRef, SocketError> findSocket(int id)
     {
         std::shared_lock lock(socketTableMutex_);
         return findSocketNoLock(id);
     }
 
-    // Find a (normal) socket by its session tuple
-    tl::expected<NormalSocketRef, SocketError> findNormalSocketNoLock(const SessionTuple &tuple) noexcept
+    // Find a (normal) socket by its session tuple. Takes no socket table lock (see FlowTable)
+    tl::expected<NormalSocketRef, SocketError> findNormalSocket(const SessionTuple &tuple) const noexcept
     {
-        auto it = sessionToSocket_.find(tuple);
-        if (it == sessionToSocket_.end())
+        auto *sock = sessionToSocket_.find(tuple);
+        if (!sock)
             return tl::unexpected(SocketError::CONN_NOT_EXIST);
-        return it->second;
-    }
-    auto findNormalSocket(const SessionTuple &tuple)
-    {
-        std::shared_lock lock(socketTableMutex_);
-        return findNormalSocketNoLock(tuple);
+        return *sock;
     }
 
     // Find a listen socket by port number
@@ -103,7 +164,7 @@ public:
     }
     auto findListenSocket(in_port_t port)
     {
-        std::shared_lock lock(socketTableMutex_);
+        std::shared_lock lock(listenMutex_);
         return findListenSocketNoLock(port);
     }
 
@@ -135,6 +196,31 @@ public:
         }, sockMaybe->get());
     }
 
+    // Read the data received by a socket in place, see NormalSocket::vRecvView() and NormalSocket::vConsume()
+    NormalSocket::ExpectedView vRecvView(int id)
+    {
+        const auto sockMaybe = findSocket(id);
+        if (!sockMaybe)
+            return tl::unexpected{sockMaybe.error()};
+
+        return std::visit(overload{
+            [ ](NormalSocket &sock) { return sock.vRecvView(); },
+            [ ](auto &) -> NormalSocket::ExpectedView { return tl::unexpected{SocketError::NYI}; }
+        }, sockMaybe->get());
+    }
+
+    ExpectedSize vConsume(int id, std::size_t n)
+    {
+        const auto sockMaybe = findSocket(id);
+        if (!sockMaybe)
+            return tl::unexpected{sockMaybe.error()};
+
+        return std::visit(overload{
+            [n](NormalSocket &sock)     { return sock.vConsume(n); },
+            [ ](auto &) -> ExpectedSize { return tl::unexpected{SocketError::NYI}; }
+        }, sockMaybe->get());
+    }
+
     // Close a socket by its id
     tl::expected<void, SocketError> vClose(int id)
     {
@@ -171,8 +257,8 @@ public:
 
         // Swap the session tuple
         const SessionTuple sess {
-            .local  = { datagram->getDstAddr().getAddrNetwork(), packet->getDstPortNetwork() },
-            .remote = { datagram->getSrcAddr().getAddrNetwork(), packet->getSrcPortNetwork() }
+            /*  local= */ { datagram->getDstAddr(), packet->getDstPortNetwork() },
+            /* remote= */ { datagram->getSrcAddr(), packet->getSrcPortNetwork() }
         };
 
         // Convert Packet to Event
@@ -191,7 +277,7 @@ public:
                 eventHandler_(sock, state, event);
             }, sock.state_, *eventMaybe);
         }
-        else if (auto ls = findListenSocket(sess.local.getPortHost()); ls) {
+        else if (auto ls = findListenSocket(sess.local().getPortHost()); ls) {
             // No existing connection found, but a listen socket is listening on the port
             // Invoke the appropriate handler on the listen socket
             auto &lSock = ls->get();
@@ -203,7 +289,7 @@ public:
             // No matching socket found
             std::stringstream ss;
             ss << "TcpStack::tcpProtocolHandler(): No matching socket found for TCP packet from " 
-               << sess.remote.toString() << " (remote) to " << sess.local.toString() << " (local)\n";
+               << sess.remote().toString() << " (remote) to " << sess.local().toString() << " (local)\n";
             std::cerr << ss.str();
         }
     }
@@ -216,68 +302,53 @@ public:
 private:
     IpCallback sendIp_ = [](const ip::Ipv4Address &, PayloadPtr) {};     // Default nop
 
-    std::map<int, Socket> socketTable_;
-    std::unordered_map<SessionTuple, NormalSocketRef> sessionToSocket_;  // Normal sockets (Pending or Established)
-    std::unordered_map<in_port_t, ListenSocketRef> portToListenSocket_;  // Listening sockets
+    // Sends the data of every normal socket. Declared before the socket table, which must go first
+    TransmitScheduler transmitScheduler_;
+
+    // Socket table: socket id = slab handle + 1. The free list of the slab allocates ids in O(1),
+    // and sockets never move, so the references below stay valid until the socket is reaped.
+    tns::util::Slab<Socket> sockets_{MAX_SOCKETS};
     mutable std::shared_mutex socketTableMutex_;
 
-    // TODO!: Reaper thread to purge closed/timed-wait sockets
-    tns::util::threading::PeriodicThread reaperThread_{SOCKET_REAPER_THREAD_PERIOD, [this]() {
-        using namespace std;
-        static constexpr auto reapable = [](const auto &state) {
-            if (holds_alternative<states::Closed>(state)) return true;
-            if (const auto *ps = get_if<states::TimeWait>(&state); ps && ps->isExpired()) return true;
-            return false;
-        };
+    // Demultiplexing of incoming segments, each with its own locks so that it never waits on the socket table.
+    // Lock order: socketTableMutex_, then a flow table shard or listenMutex_
+    FlowTable<NormalSocket> sessionToSocket_;  // Normal sockets (Pending or Established)
+    std::unordered_map<in_port_t, ListenSocketRef> portToListenSocket_;  // Listening sockets
+    mutable std::shared_mutex listenMutex_;
 
-        lock_guard lock(socketTableMutex_);
-        for (auto it = socketTable_.begin(); it != socketTable_.end(); ) {
-            visit(overload{
-                [&](NormalSocket &sock) {
-                    if (reapable(sock.state_)) {
-                        sessionToSocket_.erase(sock.tuple_);
-                        freeSocketId_(sock.id_);
-                        it = socketTable_.erase(it);
-                    } else {
-                        it++;
-                    }
-                },
-                [&](ListenSocket &lSock) {
-                    if (holds_alternative<states::Closed>(lSock.state_)) {
-                        portToListenSocket_.erase(lSock.port_);
-                        freeSocketId_(lSock.id_);
-                        it = socketTable_.erase(it);
-                    } else {
-                        it++;
-                    }
-                },
-            }, it->second);
-        }
-    }};
+    // Sockets waiting for the reaper: closed ones, and TIME_WAIT ones by entry time (FIFO, as they all wait as long)
+    std::vector<int> closedToReap_;
+    std::deque<std::pair<tns::util::Clock::time_point, int>> timeWaitToReap_;
+    std::mutex reapMutex_;
+
+    static constexpr int MAX_PORT_ATTEMPTS = 16;
 
-    static constexpr int MAX_SOCKET_FD = 128;
-    std::set<int> freeSocketIDs_ = []() {  // {1 .. MAX_SOCKET_FD}
-        std::set<int> s;
-        std::ranges::for_each(std::views::iota(1, MAX_SOCKET_FD + 1),
-                              [&, it=s.begin()](int id) mutable { it = s.insert(it, id); });
-        return s;
-    }();
-    mutable std::mutex freeSocketsMutex_;
+    std::atomic<CongestionAlgorithm> congestionAlgorithm_{CongestionAlgorithm::NEW_RENO};
+    std::atomic<bool> sackEnabled_{true};
+    std::atomic<bool> windowScalingEnabled_{true};
+    std::atomic<bool> timestampsEnabled_{true};
+    std::atomic<bool> delayedAckEnabled_{true};
+    std::atomic<std::chrono::microseconds> minRto_{RetransmissionQueue::RtoEstimator::DEFAULT_MIN_RTO};
 
     // std::mt19937 rng_{std::random_device{}()};
     mutable std::mt19937 rng_{0};  // set seed for debugging
     mutable std::uniform_int_distribution<uint32_t> isnDist_{0, std::numeric_limits<uint32_t>::max()};
     mutable std::uniform_int_distribution<in_port_t> portNumDist_{1024, std::numeric_limits<in_port_t>::max()};
 
+    tns::util::TimerWheel &timerWheel_;
+
+    // Purges closed sockets, and TIME_WAIT ones once expired. Declared last: its task uses the members above.
+    tns::util::PeriodicTimer reaper_{timerWheel_, SOCKET_REAPER_PERIOD, [this]() { reapSockets_(); }};
+
 private:
     // Create a passive connection (server side) due to a SYN request from a client
     tl::expected<NormalSocketRef, SocketError>
-    createPassiveConnection_(const SessionTuple &tuple, uint32_t clientISN, 
-                             uint32_t clientWND, ListenSocket &listener)  // clientISN, clientWND: host byte order
+    createPassiveConnection_(const SessionTuple &tuple, uint32_t clientISN, uint32_t clientWND,  // host byte order
+                             const TcpOptions &clientOptions, ListenSocket &listener)
     {
         std::cout << "TcpStack::createPassiveConnection_(): "
-                  << "(Local = "   << tuple.local.toString()
-                  << ", Remote = " << tuple.remote.toString()
+                  << "(Local = "   << tuple.local().toString()
+                  << ", Remote = " << tuple.remote().toString()
                   << ", clientISN = " << clientISN
                   << ", listen socket = " << listener.id_ << ")\n";
 
@@ -294,17 +365,32 @@ private:
         std::cout << "TcpStack::createPassiveConnection_(): Sending SYN-ACK ("
                   <<   "seq = " << seq << ", ack = " << ack << ", wnd = " << wnd << ") ...\n";
 
-        // Send SYN-ACK reply packet back to tuple.remote, ACK = clientISN + 1
-        sock.sendBuffer_.writeAndSendOne();  // ugly hack to increment SND.NBW and SND.NXT by one
-        sock.sendPacket_(Packet::makeSynAckPacket(tuple, seq, ack, static_cast<uint16_t>(wnd)));
-
         // Add socket to the pending connections list of the listener
-        if ( !listener.pendingSocks_.add(tuple, sock) )
+        if ( !listener.pendingSocks_.add(tuple, sock) ) {
+            queueReap_(sock.id_);  // Still CLOSED
             return tl::unexpected(SocketError::NO_RESOURCES);
+        }
 
-        // Then transition the socket state to SYN_RECEIVED (TODO: race condition?)
+        // Transition the socket state to SYN_RECEIVED before replying, so that it is ready for the client's ACK
         sock.state_ = states::SynReceived{listener};  // Record the listener that asked to create this socket
 
+        // Agree on SACK, window scaling and timestamps if the client offered them
+        TcpOptions options;
+        options.sackPermitted = sock.sackPermitted_ = clientOptions.sackPermitted && sackEnabled_;
+        if (clientOptions.windowShift && windowScalingEnabled_) {
+            options.windowShift = sock.rcvWndShift_ = RECV_WINDOW_SHIFT;
+            sock.sndWndShift_ = *clientOptions.windowShift;
+        }
+        if (clientOptions.timestamps && timestampsEnabled_) {
+            options.timestamps = Timestamps{timestampNow(), clientOptions.timestamps->value};
+            sock.timestamps_ = true;
+            sock.tsRecent_ = clientOptions.timestamps->value;
+        }
+
+        // Send SYN-ACK reply packet back to tuple.remote, ACK = clientISN + 1
+        sock.sendBuffer_.writeAndSendOne();  // ugly hack to increment SND.NBW and SND.NXT by one
+        sock.sendPacket_(Packet::makeSynAckPacket(tuple, seq, ack, NormalSocket::windowField_(wnd, 0), options));
+
         std::cout << "TcpStack::createPassiveConnection_(): SYN-ACK sent. Socket " << sock.id_ << " -> SYN_RECEIVED\n";
 
         return sock;
@@ -316,8 +402,8 @@ private:
     createActiveConnection_(const SessionTuple &tuple)
     {
         std::cout << "TcpStack::createActiveConnection_(): "
-                  << "(Local = "   << tuple.local.toString()
-                  << ", Remote = " << tuple.remote.toString() << ")\n";
+                  << "(Local = "   << tuple.local().toString()
+                  << ", Remote = " << tuple.remote().toString() << ")\n";
 
         // Create a new normal socket
         auto sockMaybe = createNormalSocket_(tuple);  // Closed initially, random ISN
@@ -326,19 +412,25 @@ private:
         auto &sock = sockMaybe->get();
 
         const auto seq = sock.sendBuffer_.getNxt();
-        const auto wnd = static_cast<uint16_t>(sock.recvBuffer_.getSizeFree());
+        const auto wnd = NormalSocket::windowField_(sock.recvBuffer_.getSizeFree(), 0);
         std::cout << "TcpStack::createActiveConnection_(): Sending SYN (seq = " << seq << ", wnd = " << wnd << ") ...\n";
 
-        // Send SYN packet to the remote
+        // Transition the socket state to SYN_SENT before sending, so that it is ready for the SYN-ACK
+        states::SynSent::SynAckResult result{};
+        sock.state_ = states::SynSent{result};
+
+        // Send SYN packet to the remote, offering SACK, window scaling and timestamps
+        TcpOptions options;
+        options.sackPermitted = sackEnabled_;
+        if (windowScalingEnabled_)
+            options.windowShift = RECV_WINDOW_SHIFT;
+        if (timestampsEnabled_)
+            options.timestamps = Timestamps{timestampNow(), 0};
         sock.sendBuffer_.writeAndSendOne();  // ugly hack to increment SND.NBW and SND.NXT by one
-        sock.sendPacket_(Packet::makeSynPacket(tuple, seq, wnd));
+        sock.sendPacket_(Packet::makeSynPacket(tuple, seq, wnd, options));
 
         std::cout << "TcpStack::createActiveConnection_(): Waiting for the SYN-ACK Reply...\n";
 
-        // Transition the socket state to SYN_SENT (TODO: race condition?)
-        states::SynSent::SynAckResult result{};
-        sock.state_ = states::SynSent{result};
-
         // Wait for SYN-ACK reply
         if (const auto err = result.waitForSynAck(); err) {
             std::cout << "\tTcpStack::createActiveConnection_(): Socket " << sock.id_ << " failed to connect: " << *err << "\n";
@@ -358,48 +450,45 @@ private:
         return sock;
     }
 
-    tl::expected<int, SocketError> getNextSocketIdNoLock_() noexcept 
-    {
-        if (freeSocketIDs_.empty())
-            return tl::unexpected(SocketError::NO_RESOURCES);
-        int id = *freeSocketIDs_.begin();  // Get the first free socket id
-        freeSocketIDs_.erase(freeSocketIDs_.begin());
-        return id;
-    }
-    auto getNextSocketId_()
+    // Apply `f` to a normal socket by its id
+    tl::expected<void, SocketError> withNormalSocket_(int id, const std::function<void(NormalSocket &)> &f)
     {
-        std::lock_guard lock(freeSocketsMutex_);
-        return getNextSocketIdNoLock_();
+        const auto sockMaybe = findSocket(id);
+        if (!sockMaybe)
+            return tl::unexpected{sockMaybe.error()};
+
+        return std::visit(overload{
+            [&](NormalSocket &sock) -> tl::expected<void, SocketError> { f(sock); return {}; },
+            [ ](ListenSocket &)     -> tl::expected<void, SocketError> { return tl::unexpected{SocketError::NYI}; }
+        }, sockMaybe->get());
     }
 
+    using SocketHandle = tns::util::Slab<Socket>::Handle;
+    static constexpr SocketHandle handleOf_(int id) noexcept { return static_cast<SocketHandle>(id - 1); }
+    static constexpr int idOf_(SocketHandle handle) noexcept { return static_cast<int>(handle) + 1; }
+
     // Create a new listen socket in the socket table
     tl::expected<ListenSocketRef, SocketError> createListenSocket_(in_port_t port)  // port: host byte order
     {
-        {
-            std::shared_lock lock(socketTableMutex_);
-            if (portToListenSocket_.contains(port))
-                return tl::unexpected(SocketError::DUPLICATE_SOCKET);
-        }
+        std::unique_lock lock(socketTableMutex_);
+        if (findListenSocket(port))
+            return tl::unexpected(SocketError::DUPLICATE_SOCKET);
 
-        auto id = getNextSocketId_();
-        if (!id) return tl::unexpected(id.error());
+        const auto handle = sockets_.acquire();
+        if (!handle)
+            return tl::unexpected(SocketError::NO_RESOURCES);
 
-        {
-            std::unique_lock lock(socketTableMutex_);
-            auto [sockTableIt, ok1] = socketTable_.try_emplace(  // Create a new listen socket
-                *id, 
-                std::in_place_type<ListenSocket>, 
-                *id, port, ListenSocket::CtorToken{}
-            );
-            assert(ok1);
-
-            // Update mapping (port, listenSocketRef)
-            auto [mappingIt, ok2] = portToListenSocket_.emplace(
-                port, std::get<ListenSocket>(sockTableIt->second));
-            assert(ok2);
-
-            return mappingIt->second;
-        }
+        // Create a new listen socket
+        const auto id = idOf_(*handle);
+        auto &socket = sockets_.construct(*handle, std::in_place_type<ListenSocket>, id, port,
+                                          [this, id]() { queueReap_(id); }, ListenSocket::CtorToken{});
+
+        // Update mapping (port, listenSocketRef)
+        std::unique_lock listenLock(listenMutex_);
+        auto [mappingIt, ok] = portToListenSocket_.emplace(port, std::get<ListenSocket>(socket));
+        assert(ok);
+
+        return mappingIt->second;
     }
 
     // Create a new normal socket in the socket table
@@ -407,100 +496,118 @@ private:
     createNormalSocket_(const SessionTuple &tuple, uint32_t rcvNxt = 0, 
                         uint32_t windowSize = std::numeric_limits<uint32_t>::max())
     {
+        std::unique_lock lock(socketTableMutex_);
+
         // Errors if there is already a socket with the same tuple
-        {
-            std::shared_lock lock(socketTableMutex_);
-            if (sessionToSocket_.contains(tuple))
-                return tl::unexpected(SocketError::DUPLICATE_SOCKET);
-        }
+        if (sessionToSocket_.contains(tuple))
+            return tl::unexpected(SocketError::DUPLICATE_SOCKET);
 
         // Get socket id
-        auto id = getNextSocketId_();
-        if (!id) return tl::unexpected(id.error());
+        const auto handle = sockets_.acquire();
+        if (!handle)
+            return tl::unexpected(SocketError::NO_RESOURCES);
+        const auto id = idOf_(*handle);
 
         // Callbacks for the normal socket
         NormalSocket::TcpStackCallbacks callbacks{
-            .sendPacket = [this](const Packet &packet, const ip::Ipv4Address &destAddr) { sendPacket(packet, destAddr); }
+            .sendPacket = [this](const Packet &packet, const ip::Ipv4Address &destAddr) { sendPacket(packet, destAddr); },
+            .onClosed = [this, id]() { queueReap_(id); },
         };
 
         // Create a new normal socket
-        std::unique_lock lock(socketTableMutex_);
-
-        auto [sockTableIt, sockTableSuccess] = socketTable_.try_emplace(
-            *id,
+        auto &socket = sockets_.construct(
+            *handle,
             std::in_place_type<NormalSocket>,
-            *id, tuple, 
-            generateISN_(), windowSize,  // sendBuffer_
+            id, tuple, 
+            generateISN_(), windowSize, congestionAlgorithm_.load(),  // sendBuffer_
             rcvNxt,                      // recvBuffer_
+            timerWheel_, transmitScheduler_,
             std::move(callbacks),
             NormalSocket::CtorToken{}
         );
-        assert(sockTableSuccess);
 
         // Update mapping (sessionTuple, normalSocketRef)
-        auto [it, success] = sessionToSocket_.emplace(tuple, std::get<NormalSocket>(sockTableIt->second));
+        auto &sock = std::get<NormalSocket>(socket);
+        sock.sendBuffer_.retransmitQueue.rto.setMinRto(minRto_);
+        sock.setDelayedAck(delayedAckEnabled_);
+        [[maybe_unused]] const auto success = sessionToSocket_.insert(tuple, sock);
         assert(success);
 
-        return it->second;
+        return sock;
+    }
+
+    // Queue a closed socket for the reaper
+    void queueReap_(int id)
+    {
+        std::lock_guard lock(reapMutex_);
+        closedToReap_.push_back(id);
+    }
+
+    // Queue a socket that just entered TIME_WAIT for the reaper, which removes it once the state expires
+    void queueTimeWaitReap_(int id)
+    {
+        std::lock_guard lock(reapMutex_);
+        timeWaitToReap_.emplace_back(tns::util::Clock::now(), id);
     }
 
-    // Takes in an iterator to a socket in the socket table and purges it.
-    // Returns the iterator to the next socket in the socket table.
-    // Assume the socket is in the socket table, i.e., it != socketTable_.end()
-    // auto purgeSocket_( decltype(socketTable_.begin()) it )
-    // {
-    //     assert(it != socketTable_.end() && "FATAL: Socket not found in socket table");
-
-    //     auto &sock = it->second;
-    //     std::visit([&](auto &sock) {
-    //         using T = std::decay_t<decltype(sock)>;
-    //         if constexpr (std::is_same_v<T, NormalSocket>) {
-    //             sessionToSocket_.erase(sock.tuple_);
-    //         }
-    //         else if constexpr (std::is_same_v<T, ListenSocket>) {
-    //             portToListenSocket_.erase(lSock.port_);
-    //         }
-    //         else {
-    //             static_assert(util::always_false_v<T>, "non-exhaustive visitor!");
-    //         }
-    //     }, sock);
-    // }
-
-    // // Assume sock IS in the socket table
-    // void purgeSocket_(NormalSocket &sock)
-    // {
-    //     assert(std::holds_alternative<states::Closed>(sock.state_) 
-    //            && "FATAL: Normal socket state should be Closed before purge");
-
-    //     const auto id = sock.id_;
-    //     {
-    //         // Remove the socket from the mapping and the socket table 
-    //         std::unique_lock lock(socketTableMutex_);
-    //         sessionToSocket_.erase(sock.tuple_);
-    //         socketTable_.erase(id);
-    //     }
-    //     freeSocketId_(id);
-    // }
-
-    // void purgeSocket_(ListenSocket &lSock)
-    // {
-    //     assert(std::holds_alternative<states::Closed>(lSock.state_) 
-    //            && "FATAL: Listen socket state should be Closed before purge");
-
-    //     const auto id = lSock.id_;
-    //     {
-    //         // Remove the socket from the mapping and the socket table 
-    //         std::unique_lock lock(socketTableMutex_);
-    //         portToListenSocket_.erase(lSock.port_);
-    //         socketTable_.erase(id);
-    //     }
-    //     freeSocketId_(id);
-    // }
-
-    void freeSocketId_(int id)
-    {
-        std::lock_guard lock(freeSocketsMutex_);
-        freeSocketIDs_.insert(id);
+    // Remove the queued sockets that are reapable from the socket table.
+    // Only the queued sockets are visited, so the cost is independent of the number of open connections.
+    void reapSockets_()
+    {
+        using namespace std;
+
+        vector<int> closed, expired;
+        {
+            lock_guard lock(reapMutex_);
+            closed.swap(closedToReap_);
+            const auto now = tns::util::Clock::now();
+            while (!timeWaitToReap_.empty() && now - timeWaitToReap_.front().first > states::TimeWait::TIMEOUT) {
+                expired.push_back(timeWaitToReap_.front().second);
+                timeWaitToReap_.pop_front();
+            }
+        }
+        if (closed.empty() && expired.empty())
+            return;
+
+        static constexpr auto isClosed = [](const auto &state) { return holds_alternative<states::Closed>(state); };
+        static constexpr auto isTimeWaitExpired = [](const auto &state) {
+            const auto *ps = get_if<states::TimeWait>(&state);
+            return ps && ps->isExpired();
+        };
+
+        lock_guard lock(socketTableMutex_);
+        for (const auto id : closed)
+            reapSocketNoLock_(id, isClosed);
+        for (const auto id : expired)
+            reapSocketNoLock_(id, isTimeWaitExpired);
+    }
+
+    // Remove a socket from the socket table if its state is reapable
+    void reapSocketNoLock_(int id, bool (*reapable)(const State &))
+    {
+        const auto handle = handleOf_(id);
+        auto *socket = sockets_.get(handle);
+        if (!socket)
+            return;
+
+        const bool reaped = std::visit(overload{
+            [&](NormalSocket &sock) {
+                if (!reapable(sock.state_))
+                    return false;
+                sessionToSocket_.erase(sock.tuple_);
+                return true;
+            },
+            [&](ListenSocket &lSock) {
+                if (!reapable(lSock.state_))
+                    return false;
+                std::unique_lock listenLock(listenMutex_);
+                portToListenSocket_.erase(lSock.port_);
+                return true;
+            },
+        }, *socket);
+
+        if (reaped)
+            sockets_.erase(handle);  // Frees the id
     }
 
     uint32_t generateISN_() const noexcept
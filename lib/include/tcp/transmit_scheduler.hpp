@@ -0,0 +1,81 @@
+#pragma once
+
+#include "tcp/constants.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+namespace tns {
+
+namespace util {
+    class Scheduler;
+} // namespace util
+
+namespace tcp {
+
+// Sends the data of all the sockets of a stack on a few worker threads.
+//
+// A socket registers a transmit function, then notifies the scheduler whenever it has data ready to send
+// (new data written, or the window opened). Ready sockets wait in one FIFO: a worker pops a socket, lets it
+// send at most a quantum of segments and puts it back at the end if it has more, so busy connections share
+// the workers round-robin. A socket is transmitted by one worker at a time, which keeps its segments in order.
+//
+// Constructed while a util::Scheduler is alive, it runs no workers: transmissions are scheduler events.
+class TransmitScheduler {
+public:
+    using SourceId = std::uint64_t;
+    // Sends at most a quantum of segments. Returns whether the source has more ready to send.
+    using Transmit = std::function<bool()>;
+
+    explicit TransmitScheduler(std::size_t nWorkers = TRANSMIT_WORKERS);
+    TransmitScheduler(const TransmitScheduler&) = delete;
+    TransmitScheduler& operator=(const TransmitScheduler&) = delete;
+    ~TransmitScheduler();
+
+    SourceId add(Transmit transmit);
+
+    // Unregister a source. If a worker is running its transmit function, wait for it to return first.
+    // Must not be called from the transmit function itself.
+    void remove(SourceId id);
+
+    // The source has data ready to send
+    void notify(SourceId id);
+
+    // Number of registered sources
+    std::size_t size() const;
+
+private:
+    enum class SourceState { IDLE, READY, RUNNING, RUNNING_NOTIFIED };
+    struct Source {
+        Transmit transmit;
+        SourceState state = SourceState::IDLE;
+    };
+
+    // Queue a source for a worker, or as a scheduler event in virtual time
+    void pushReadyNoLock_(SourceId id);
+    // Run the transmit function of the source at the front of the queue, then requeue it if it has more
+    void runNext_(std::unique_lock<std::mutex> &lock);
+    void workerLoop_(std::stop_token stop);
+
+    tns::util::Scheduler *const scheduler_;  // Non-null in virtual time
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any cvReady_;  // Wakes up a worker for a ready source
+    std::condition_variable cvDone_;       // Signals the end of a transmission to remove()
+    std::unordered_map<SourceId, Source> sources_;
+    std::deque<SourceId> ready_;
+    SourceId nextId_ = 1;
+    std::unordered_map<std::uint64_t, std::uint64_t> events_;  // Pending scheduler events, in virtual time
+    std::uint64_t nextEventKey_ = 0;
+    std::vector<std::jthread> workers_;  // Declared last: started after, and joined before, the state they use
+};
+
+} // namespace tcp
+} // namespace tns
@@ -4,11 +4,12 @@
 #include "util/tl/expected.hpp"
 #include "ip/protocols.hpp"
 #include "tcp/session_tuple.hpp"
-#include "tcp/util.hpp"
 
+#include <bit>
 #include <span>
 #include <string>
 #include <cstring>
+#include <algorithm>
 #include <netinet/tcp.h>
 
 namespace tns {
@@ -17,23 +18,111 @@ namespace util {
     tl::expected<tcphdr, std::string> makeTcpHeader(
         const SessionTuple &session, std::uint8_t flags, std::uint32_t seq, std::uint32_t ack, std::uint16_t windowSize);
 
+    // Running Internet checksum (RFC 1071) over any number of byte spans, fed in order.
+    // Odd-length spans are fine: the byte parity is carried over to the next call, so
+    // the pseudo header, TCP header and payload can be folded in without first copying
+    // them into one contiguous buffer.
+    class InetChecksum {
+    public:
+        InetChecksum() = default;
+
+        InetChecksum &add(const std::span<const std::byte> data) noexcept
+        {
+            accumulate_<false>(nullptr, data.data(), data.size());
+            return *this;
+        }
+
+        // Append a sum computed separately over the bytes that follow (e.g., a payload
+        // summed while it was being copied). Swaps the bytes if we sit at an odd offset.
+        InetChecksum &add(const InetChecksum &other) noexcept
+        {
+            std::uint64_t folded = other.fold();
+            if (odd_)
+                folded = ((folded & 0xFF) << 8) | (folded >> 8);
+            addWord_(folded);
+            odd_ ^= other.odd_;
+            return *this;
+        }
+
+        // Copy `src` into `dst` and sum the bytes in the same pass.
+        // Returns the number of bytes copied, i.e., min(dst.size(), src.size()).
+        std::size_t copyAndAdd(const std::span<std::byte> dst, const std::span<const std::byte> src) noexcept
+        {
+            const auto n = std::min(dst.size(), src.size());
+            accumulate_<true>(dst.data(), src.data(), n);
+            return n;
+        }
+
+        // The 16-bit one's complement sum, before complementing
+        std::uint16_t fold() const noexcept
+        {
+            auto s = sum_;
+            s = (s & 0xFFFFFFFF) + (s >> 32);
+            s = (s & 0xFFFFFFFF) + (s >> 32);
+            s = (s & 0xFFFF) + (s >> 16);
+            s = (s & 0xFFFF) + (s >> 16);
+            return static_cast<std::uint16_t>(s);
+        }
+
+        // The checksum to put on the wire (already in network byte order)
+        std::uint16_t finish() const noexcept { return static_cast<std::uint16_t>(~fold()); }
+
+    private:
+        void addWord_(std::uint64_t word) noexcept
+        {
+            sum_ += word;
+            sum_ += (sum_ < word);  // end-around carry
+        }
+
+        // Byte at an even offset is the first (high-order) byte of a 16-bit word in network order
+        static constexpr std::uint64_t placeByte_(std::byte b, bool oddOffset) noexcept
+        {
+            const auto v = static_cast<std::uint64_t>(b);
+            const bool high = (std::endian::native == std::endian::little) ? oddOffset : !oddOffset;
+            return high ? v << 8 : v;
+        }
+
+        template <bool Copy>
+        void accumulate_(std::byte *dst, const std::byte *src, std::size_t len) noexcept
+        {
+            if (len == 0)
+                return;
+
+            // Finish the 16-bit word left open by the previous span
+            if (odd_) {
+                if constexpr (Copy) *dst++ = *src;
+                addWord_(placeByte_(*src++, true));
+                --len;
+                odd_ = false;
+            }
+
+            // Native 64-bit loads: one's complement sums are byte-order independent (RFC 1071 2.B)
+            for (; len >= sizeof(std::uint64_t); len -= sizeof(std::uint64_t)) {
+                std::uint64_t word;
+                std::memcpy(&word, src, sizeof(word));
+                if constexpr (Copy) {
+                    std::memcpy(dst, &word, sizeof(word));
+                    dst += sizeof(word);
+                }
+                addWord_(word);
+                src += sizeof(word);
+            }
+
+            for (; len > 0; --len) {
+                if constexpr (Copy) *dst++ = *src;
+                addWord_(placeByte_(*src++, odd_));
+                odd_ = !odd_;
+            }
+        }
+
+        std::uint64_t sum_ = 0;
+        bool odd_ = false;  // Whether an odd number of bytes has been summed so far
+    };
+
     // Modified upon: https://github.com/brown-csci1680/lecture-examples/blob/main/tcp-checksum/tcpsum_example.c
     inline uint16_t inetChecksum(const std::span<const std::byte> buffer) noexcept 
     {
-        auto p = buffer.data();
-        auto len = buffer.size();
-
-        uint32_t sum = 0;
-        for (; len > 1; len -= 2, p += 2)
-            sum += ( (static_cast<uint32_t>(p[1]) << 8) | static_cast<uint32_t>(p[0]) );
-
-        if (len == 1)
-            sum += static_cast<uint32_t>(*p);
-
-        sum = (sum >> 16) + (sum & 0x0000FFFF);
-        sum += (sum >> 16);
-
-        return ~ static_cast<uint16_t>(sum);
+        return InetChecksum{}.add(buffer).finish();
     }
 
 
@@ -41,15 +130,14 @@ namespace util {
     // combines the (virtual) IP source and destination address, protocol value,
     // as well as the TCP header and payload
     //
-    // This is one example one way to combine all of this information
-    // and compute the checksum.  This is not a particularly fast way,
-    // as it involves copying all of the data into one buffer.
-    // Yet, it works, and you can use it.
+    // The pieces are folded into a running sum one after another, so nothing is copied.
+    // `payloadSum` is the sum over the `payloadSize` bytes of payload, which callers that
+    // copy the payload anyway can get for free from InetChecksum::copyAndAdd().
     //
     // For more details, see the "Checksum" component of RFC793 Section 3.1,
     // https://www.ietf.org/rfc/rfc793.txt (pages 14-15)
-    inline uint16_t tcpChecksum(in_addr_t srcIP, in_addr_t dstIP,
-                                const tcphdr &tcpHdr, const PayloadView payload) noexcept
+    inline uint16_t tcpChecksum(in_addr_t srcIP, in_addr_t dstIP, const tcphdr &tcpHdr, const PayloadView options,
+                                std::size_t payloadSize, const InetChecksum &payloadSum) noexcept
     {
         struct {  // pseudo header
             uint32_t ip_src;
@@ -70,23 +158,32 @@ namespace util {
         // of the pseudo header."
         ph.tcp_length = tns::util::hton(
             static_cast<decltype(ph.tcp_length)>(
-                sizeof(tcpHdr) + payload.size()
+                sizeof(tcpHdr) + options.size() + payloadSize
             )
         );
 
-        const auto total_len = sizeof(ph) + sizeof(tcpHdr) + payload.size();
-        std::vector<std::byte> buffer(total_len);
-        std::memcpy(buffer.data()                              , &ph, sizeof(ph));                  // copy pseudo header
-        std::memcpy(buffer.data() + sizeof(ph)                 , &tcpHdr, sizeof(tcpHdr));          // copy header
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wstringop-overflow="
-#pragma GCC diagnostic ignored "-Wrestrict"
-        std::memcpy(buffer.data() + sizeof(ph) + sizeof(tcpHdr), payload.data(), payload.size());   // copy payload
-#pragma GCC diagnostic pop
+        // The checksum field itself is summed as zero
+        auto hdr = tcpHdr;
+        hdr.th_sum = 0;
 
-        reinterpret_cast<tcphdr *>(buffer.data() + sizeof(ph))->th_sum = 0;
+        return InetChecksum{}
+            .add(std::as_bytes(std::span{&ph, 1}))
+            .add(std::as_bytes(std::span{&hdr, 1}))
+            .add(options)  // A multiple of 4 bytes: the payload sum stays aligned
+            .add(payloadSum)
+            .finish();
+    }
+
+    inline uint16_t tcpChecksum(in_addr_t srcIP, in_addr_t dstIP, const tcphdr &tcpHdr,
+                                std::size_t payloadSize, const InetChecksum &payloadSum) noexcept
+    {
+        return tcpChecksum(srcIP, dstIP, tcpHdr, {}, payloadSize, payloadSum);
+    }
 
-        return inetChecksum(std::span{buffer});
+    inline uint16_t tcpChecksum(in_addr_t srcIP, in_addr_t dstIP,
+                                const tcphdr &tcpHdr, const PayloadView payload) noexcept
+    {
+        return tcpChecksum(srcIP, dstIP, tcpHdr, payload.size(), InetChecksum{}.add(payload));
     }
 
 
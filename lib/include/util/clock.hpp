@@ -0,0 +1,28 @@
+#pragma once
+
+#include <chrono>
+
+
+namespace tns {
+namespace util {
+
+class Scheduler;
+
+// Time source of the whole stack: timers, RTOs, route ages and periodic threads all read it.
+// It follows std::chrono::steady_clock, unless a Scheduler is alive: then time is virtual and
+// only moves forward when the scheduler runs its events (see util/scheduler.hpp).
+struct Clock {
+    using duration   = std::chrono::steady_clock::duration;
+    using rep        = duration::rep;
+    using period     = duration::period;
+    using time_point = std::chrono::steady_clock::time_point;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept;
+
+    // The scheduler driving virtual time, or null when running in real time
+    static Scheduler *scheduler() noexcept;
+};
+
+} // namespace util
+} // namespace tns
@@ -15,6 +15,10 @@ namespace util::threading {
     class PeriodicThread;
 } // namespace util::threading
 
+namespace util {
+    class PeriodicTimer;
+} // namespace util
+
 namespace ip {
     class Datagram;
 } // namespace ip
@@ -29,6 +33,7 @@ using NetworkInterfaceIter = NetworkInterfaces::iterator;
 
 using PeriodicThreadPtr = std::unique_ptr<util::threading::PeriodicThread>;
 // using PeriodicThreadPtr = std::unique_ptr<util::threading::PeriodicThread, util::threading::PeriodicThreadDeleter>;
+using PeriodicTimerPtr = std::unique_ptr<util::PeriodicTimer>;
 
 using DatagramSharedPtr = std::shared_ptr<ip::Datagram>;
 using DatagramPtr = std::unique_ptr<ip::Datagram>;
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace tns {
+namespace util {
+
+// An open-addressing hash map with linear probing and one control byte per slot.
+//
+// Meant for small, hot lookup tables that are queried once per packet (interface addresses, TCP sessions).
+// Probes walk a dense byte array and compare 7 bits of the hash before touching a key, instead of chasing
+// one heap node per element as std::unordered_map does. Erased slots become tombstones, which are dropped
+// on the next rehash.
+//
+// NOTE: Elements move on rehash, so any insertion may invalidate iterators and references.
+//       The hash should mix well (see util::mix64): the low bits pick the slot.
+template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+    // Control bytes: EMPTY and DELETED have the top bit set, FULL slots store the low 7 bits of the hash
+    static constexpr std::uint8_t EMPTY   = 0x80;
+    static constexpr std::uint8_t DELETED = 0xFE;
+    static constexpr std::size_t  MIN_CAPACITY = 8;  // Must be a power of 2
+
+public:
+    using key_type    = Key;
+    using mapped_type = T;
+    using value_type  = std::pair<const Key, T>;
+    using size_type   = std::size_t;
+
+    template <bool Const>
+    class Iterator {
+        friend FlatHashMap;
+        friend Iterator<!Const>;
+        using Map = std::conditional_t<Const, const FlatHashMap, FlatHashMap>;
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = FlatHashMap::value_type;
+        using reference         = std::conditional_t<Const, const value_type&, value_type&>;
+        using pointer           = std::conditional_t<Const, const value_type*, value_type*>;
+
+        Iterator() = default;
+        operator Iterator<true>() const noexcept { return {map_, i_}; }
+
+        reference operator*()  const noexcept { return map_->slot_(i_); }
+        pointer   operator->() const noexcept { return &map_->slot_(i_); }
+
+        Iterator &operator++() noexcept { i_ = map_->nextFull_(i_ + 1); return *this; }
+        Iterator  operator++(int) noexcept { auto tmp = *this; ++*this; return tmp; }
+
+        bool operator==(const Iterator &other) const noexcept { return i_ == other.i_; }
+
+    private:
+        Iterator(Map *map, std::size_t i) noexcept : map_(map), i_(i) {}
+
+        Map *map_ = nullptr;
+        std::size_t i_ = 0;
+    };
+    using iterator       = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    FlatHashMap() = default;
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+
+    FlatHashMap(FlatHashMap &&other) noexcept { swap(other); }
+    FlatHashMap& operator=(FlatHashMap &&other) noexcept
+    {
+        FlatHashMap tmp{std::move(other)};
+        swap(tmp);
+        return *this;
+    }
+
+    ~FlatHashMap() { destroyAll_(); }
+
+    void swap(FlatHashMap &other) noexcept
+    {
+        std::swap(ctrl_, other.ctrl_);
+        std::swap(slots_, other.slots_);
+        std::swap(capacity_, other.capacity_);
+        std::swap(size_, other.size_);
+        std::swap(tombstones_, other.tombstones_);
+    }
+
+    iterator       begin()       noexcept { return {this, nextFull_(0)}; }
+    const_iterator begin() const noexcept { return {this, nextFull_(0)}; }
+    iterator       end()         noexcept { return {this, capacity_}; }
+    const_iterator end()   const noexcept { return {this, capacity_}; }
+
+    size_type size()     const noexcept { return size_; }
+    bool      empty()    const noexcept { return size_ == 0; }
+    size_type capacity() const noexcept { return capacity_; }
+
+    iterator       find(const Key &key)       noexcept { return {this, findIndex_(key)}; }
+    const_iterator find(const Key &key) const noexcept { return {this, findIndex_(key)}; }
+
+    bool contains(const Key &key) const noexcept { return findIndex_(key) != capacity_; }
+    size_type count(const Key &key) const noexcept { return contains(key) ? 1 : 0; }
+
+    // Inserts {key, T(args...)} if key is absent. Returns the element's position and whether it was inserted.
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key &key, Args&&... args)
+    {
+        if (const auto i = findIndex_(key); i != capacity_)
+            return {{this, i}, false};
+
+        growIfNeeded_();
+        const auto h = Hash{}(key);
+        const auto i = findInsertSlot_(h);
+        if (ctrl_[i] == DELETED)
+            --tombstones_;
+        ::new (static_cast<void*>(&slots_[i])) value_type(std::piecewise_construct,
+                                                          std::forward_as_tuple(key),
+                                                          std::forward_as_tuple(std::forward<Args>(args)...));
+        ctrl_[i] = h2_(h);
+        ++size_;
+        return {{this, i}, true};
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> emplace(const Key &key, V &&value) { return try_emplace(key, std::forward<V>(value)); }
+
+    size_type erase(const Key &key)
+    {
+        const auto i = findIndex_(key);
+        if (i == capacity_)
+            return 0;
+        eraseAt_(i);
+        return 1;
+    }
+
+    iterator erase(iterator pos)
+    {
+        eraseAt_(pos.i_);
+        return {this, nextFull_(pos.i_ + 1)};
+    }
+
+    void clear() noexcept
+    {
+        destroyAll_();
+        if (capacity_ > 0)
+            std::memset(ctrl_.get(), EMPTY, capacity_);
+        size_ = tombstones_ = 0;
+    }
+
+    // Make room for at least n elements without rehashing
+    void reserve(size_type n)
+    {
+        auto cap = MIN_CAPACITY;
+        while (n > maxLoad_(cap))
+            cap *= 2;
+        if (cap > capacity_)
+            rehash_(cap);
+    }
+
+private:
+    // Storage for one element, constructed only when the slot's control byte is FULL
+    struct Slot {
+        alignas(value_type) std::byte storage[sizeof(value_type)];
+    };
+
+    std::unique_ptr<std::uint8_t[]> ctrl_;
+    std::unique_ptr<Slot[]> slots_;
+    std::size_t capacity_   = 0;
+    std::size_t size_       = 0;
+    std::size_t tombstones_ = 0;
+
+    static constexpr std::uint8_t h2_(std::size_t h) noexcept { return static_cast<std::uint8_t>(h & 0x7F); }
+    static constexpr std::size_t  h1_(std::size_t h) noexcept { return h >> 7; }
+    static constexpr std::size_t  maxLoad_(std::size_t cap) noexcept { return cap - cap / 8; }  // 7/8
+
+    static constexpr bool isFull_(std::uint8_t c) noexcept { return (c & 0x80) == 0; }
+
+    value_type &slot_(std::size_t i) noexcept
+    {
+        return *std::launder(reinterpret_cast<value_type*>(slots_[i].storage));
+    }
+    const value_type &slot_(std::size_t i) const noexcept
+    {
+        return *std::launder(reinterpret_cast<const value_type*>(slots_[i].storage));
+    }
+
+    std::size_t nextFull_(std::size_t i) const noexcept
+    {
+        while (i < capacity_ && !isFull_(ctrl_[i]))
+            ++i;
+        return i;
+    }
+
+    // Returns capacity_ if not found. Terminates as the load factor keeps at least one EMPTY slot.
+    std::size_t findIndex_(const Key &key) const noexcept
+    {
+        if (size_ == 0)
+            return capacity_;
+
+        const auto h = Hash{}(key);
+        const auto tag = h2_(h);
+        const auto mask = capacity_ - 1;
+        for (auto i = h1_(h) & mask; ; i = (i + 1) & mask) {
+            const auto c = ctrl_[i];
+            if (c == EMPTY)
+                return capacity_;
+            if (c == tag && KeyEqual{}(slot_(i).first, key))
+                return i;
+        }
+    }
+
+    // First EMPTY or DELETED slot on the probe sequence of hash h
+    std::size_t findInsertSlot_(std::size_t h) const noexcept
+    {
+        const auto mask = capacity_ - 1;
+        auto i = h1_(h) & mask;
+        while (isFull_(ctrl_[i]))
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void eraseAt_(std::size_t i) noexcept
+    {
+        assert(isFull_(ctrl_[i]));
+        slot_(i).~value_type();
+        --size_;
+
+        // If the next slot is EMPTY no probe sequence runs through this one, so it can be EMPTY as well
+        if (ctrl_[(i + 1) & (capacity_ - 1)] == EMPTY) {
+            ctrl_[i] = EMPTY;
+        } else {
+            ctrl_[i] = DELETED;
+            ++tombstones_;
+        }
+    }
+
+    void growIfNeeded_()
+    {
+        if (capacity_ == 0) {
+            rehash_(MIN_CAPACITY);
+        }
+        else if (size_ + tombstones_ + 1 > maxLoad_(capacity_)) {
+            // Mostly tombstones: clean up in place (same capacity), otherwise double
+            rehash_(size_ + 1 > maxLoad_(capacity_) / 2 ? capacity_ * 2 : capacity_);
+        }
+    }
+
+    void rehash_(std::size_t newCapacity)
+    {
+        auto oldCtrl = std::move(ctrl_);
+        auto oldSlots = std::move(slots_);
+        const auto oldCapacity = capacity_;
+
+        ctrl_ = std::make_unique<std::uint8_t[]>(newCapacity);
+        std::memset(ctrl_.get(), EMPTY, newCapacity);
+        slots_ = std::make_unique<Slot[]>(newCapacity);
+        capacity_ = newCapacity;
+        tombstones_ = 0;
+
+        for (std::size_t j = 0; j < oldCapacity; ++j) {
+            if (!isFull_(oldCtrl[j]))
+                continue;
+            auto &elem = *std::launder(reinterpret_cast<value_type*>(oldSlots[j].storage));
+            const auto h = Hash{}(elem.first);
+            const auto i = findInsertSlot_(h);
+            ::new (static_cast<void*>(&slots_[i])) value_type(elem.first, std::move(elem.second));
+            ctrl_[i] = h2_(h);
+            elem.~value_type();
+        }
+    }
+
+    void destroyAll_() noexcept
+    {
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            for (std::size_t i = 0; i < capacity_; ++i)
+                if (isFull_(ctrl_[i]))
+                    slot_(i).~value_type();
+        }
+    }
+};
+
+} // namespace util
+} // namespace tns
@@ -5,12 +5,19 @@
 #include <mutex>
 #include <condition_variable>
 #include <functional>
+#include <cstdint>
 
 #include <iostream>
 
 namespace tns {
+namespace util {
+    class Scheduler;
+} // namespace util
+
 namespace util::threading {
 
+// Runs a task once per period on its own thread.
+// Constructed while a util::Scheduler is alive, it runs the task as events of the scheduler instead.
 class PeriodicThread {
     using nsec = std::chrono::nanoseconds;
 public:
@@ -47,10 +54,17 @@ public:
     void stop();
 
 private:
-    std::jthread thread;
+    // Schedule the next run of the task on scheduler
+    void scheduleNextNoLock();
+
     mutable std::mutex mutex;
     mutable std::condition_variable cv;
     bool stopped = false;
+    std::function<void()> task;
+    nsec period{};
+    Scheduler *scheduler = nullptr;  // Null when running on the thread
+    std::uint64_t event = 0;         // Pending event on scheduler
+    std::jthread thread;  // Declared last: started after, and joined before, the state it uses
 };
 
 
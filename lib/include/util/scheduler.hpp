@@ -0,0 +1,73 @@
+#pragma once
+
+#include "util/clock.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+
+namespace tns {
+namespace util {
+
+// Discrete-event scheduler driving a virtual clock.
+//
+// While a Scheduler is alive, Clock::now() returns its virtual time, PeriodicThreads run as its events
+// instead of spawning threads, and simulated links (sim::MemoryFabric) deliver datagrams through it.
+// Virtual time only advances when the owner runs events, jumping straight to the next one, so a
+// simulation runs as fast as the CPU allows and, with every event run on the same thread,
+// reproduces the same event order on every run.
+//
+// Events may be scheduled from any thread, but are run by the thread calling run*().
+// At most one scheduler may be alive at a time, and it must outlive everything scheduling on it.
+class Scheduler {
+public:
+    using Task = std::function<void()>;
+    using EventId = std::uint64_t;
+
+    // Starts virtual time at the current real time. Throws std::runtime_error if another scheduler is alive.
+    Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    // Drops the pending events and puts Clock back on real time
+    ~Scheduler();
+
+    Clock::time_point now() const noexcept { return Clock::time_point{Clock::duration{now_.load(std::memory_order_acquire)}}; }
+
+    // Schedule a task at the given virtual time (or now, if that is in the past). Returns its event id.
+    EventId schedule(Clock::time_point at, Task task);
+    EventId scheduleAfter(Clock::duration delay, Task task) { return schedule(now() + delay, std::move(task)); }
+
+    // Cancel a pending event. Returns false if it already ran or was cancelled.
+    bool cancel(EventId id);
+
+    // Run events in time order, ties in the order they were scheduled, advancing virtual time to each one.
+    // runUntil() stops at the first event later than `until` and leaves virtual time at `until`.
+    // Return the number of events run.
+    std::size_t runUntil(Clock::time_point until);
+    std::size_t runFor(Clock::duration duration) { return runUntil(now() + duration); }
+
+    // Run the earliest pending event only. Returns false if there is none.
+    bool runNext();
+
+    std::size_t pending() const;
+
+private:
+    using Key = std::pair<Clock::rep, EventId>;  // (time, id): ids grow, so ties run in FIFO order
+
+    // Pop the earliest event if it is due by `until` and move virtual time to it
+    bool popNext_(Clock::time_point until, Task &task);
+
+    mutable std::mutex mutex_;
+    std::map<Key, Task> events_;
+    std::unordered_map<EventId, Clock::rep> times_;  // Pending event id -> its time, for cancel()
+    EventId nextId_ = 1;
+    std::atomic<Clock::rep> now_;  // Read by Clock::now() from any thread
+};
+
+} // namespace util
+} // namespace tns
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace tns {
+namespace util {
+
+// A pool of T objects addressed by small integer handles.
+//
+// Objects live in fixed-size chunks that are allocated as the pool grows and never move, so pointers and
+// references stay valid until the object is erased. Handles come from a free list: acquiring and erasing
+// are O(1), and a freed handle is the next one reused, which keeps the live objects packed in few chunks.
+//
+// A handle is first acquired, then its object constructed, so the object may know its own handle.
+// Not thread-safe: the owner locks around it.
+template <typename T, std::size_t CHUNK_SIZE = 64>
+class Slab {
+public:
+    using Handle = std::uint32_t;
+
+    // At most `capacity` handles, 0 .. capacity-1
+    explicit Slab(std::size_t capacity) : capacity_(capacity) {}
+    Slab(const Slab&) = delete;
+    Slab& operator=(const Slab&) = delete;
+
+    // Reserve a handle, or nullopt if the slab is full
+    std::optional<Handle> acquire()
+    {
+        if (!free_.empty()) {
+            const auto handle = free_.back();
+            free_.pop_back();
+            return handle;
+        }
+        if (next_ == capacity_)
+            return std::nullopt;
+        if (next_ % CHUNK_SIZE == 0)
+            chunks_.push_back(std::make_unique<Chunk>());
+        return static_cast<Handle>(next_++);
+    }
+
+    // Construct the object of an acquired handle
+    template <typename... Args>
+    T& construct(Handle handle, Args&&... args)
+    {
+        auto &slot = slot_(handle);
+        assert(!slot && "Slab::construct(): Handle already holds an object");
+        slot.emplace(std::forward<Args>(args)...);
+        size_++;
+        return *slot;
+    }
+
+    // Destroy the object of a handle, if any, and give the handle back
+    void erase(Handle handle)
+    {
+        auto &slot = slot_(handle);
+        if (slot) {
+            slot.reset();
+            size_--;
+        }
+        free_.push_back(handle);
+    }
+
+    // The object of a handle, or null if it holds none
+    T* get(Handle handle) noexcept
+    {
+        if (handle >= next_)
+            return nullptr;
+        auto &slot = slot_(handle);
+        return slot ? &*slot : nullptr;
+    }
+    const T* get(Handle handle) const noexcept { return const_cast<Slab*>(this)->get(handle); }
+
+    // Call f(handle, object) for every object, by increasing handle
+    template <typename F>
+    void forEach(F &&f) const
+    {
+        for (std::size_t handle = 0; handle < next_; handle++) {
+            if (const auto &slot = slot_(static_cast<Handle>(handle)))
+                f(static_cast<Handle>(handle), *slot);
+        }
+    }
+
+    std::size_t size() const noexcept { return size_; }
+    std::size_t capacity() const noexcept { return capacity_; }
+
+    // Bytes held by the chunks and the free list (not by what the objects allocate themselves)
+    std::size_t memoryUsage() const noexcept
+    {
+        return chunks_.size() * sizeof(Chunk) + free_.capacity() * sizeof(Handle)
+             + chunks_.capacity() * sizeof(std::unique_ptr<Chunk>);
+    }
+
+private:
+    using Chunk = std::array<std::optional<T>, CHUNK_SIZE>;
+
+    std::optional<T>& slot_(Handle handle) const
+    {
+        assert(handle < next_ && "Slab: Handle never acquired");
+        return (*chunks_[handle / CHUNK_SIZE])[handle % CHUNK_SIZE];
+    }
+
+    std::size_t capacity_;
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    std::vector<Handle> free_;  // Handles given back, reused last-in first-out
+    std::size_t next_ = 0;      // Handles from next_ on were never acquired
+    std::size_t size_ = 0;
+};
+
+} // namespace util
+} // namespace tns
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "util/clock.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+
+namespace tns {
+namespace util {
+
+class Scheduler;
+class TimerWheel;
+
+namespace detail {
+    // Intrusive list hook of a timer: the wheel links timers in place, so arming never allocates
+    struct TimerLink {
+        TimerLink *prev = nullptr;
+        TimerLink *next = nullptr;
+    };
+} // namespace detail
+
+// A one-shot timer on a TimerWheel. Arming an armed timer moves it; arm() and cancel() are O(1).
+// The callback runs on the wheel's thread (or as a Scheduler event in virtual time), must be short,
+// and may re-arm its own timer. Timers are linked in place, hence neither copyable nor movable.
+class Timer : private detail::TimerLink {
+public:
+    using Callback = std::function<void()>;
+
+    Timer(TimerWheel &wheel, Callback callback);
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    ~Timer() { cancel(); }
+
+    // Fire the callback once, `delay` from now (rounded up to the wheel resolution)
+    void arm(Clock::duration delay);
+
+    // Disarm the timer. If its callback is running on another thread, wait for it to return first,
+    // so the objects it uses can be destroyed right after.
+    void cancel();
+
+    bool isArmed() const;
+
+private:
+    friend class TimerWheel;
+
+    TimerWheel &wheel_;
+    Callback callback_;
+    std::uint64_t expiry_ = 0;  // Tick the timer fires at
+    std::uint64_t event_ = 0;   // Pending scheduler event, in virtual time
+};
+
+// Hierarchical timing wheel (Varghese & Lauck) running the timers of a whole node on one thread.
+//
+// LEVELS wheels of SLOTS slots each: a timer due in less than SLOTS ticks sits in the slot of its
+// tick on level 0, later ones in coarser slots of the upper levels, which are cascaded down one level
+// each time the level below wraps around. Arming and cancelling are O(1) list operations, and the
+// thread only wakes up for the next non-empty level-0 slot or the next cascade, never per timer.
+// Timers up to 2^32 ticks (~49 days at 1 ms) ahead are exact; later ones are kept on the top level.
+//
+// Constructed while a util::Scheduler is alive, the wheel runs no thread: its timers are scheduler events.
+// Every timer must be destroyed before its wheel.
+class TimerWheel {
+public:
+    static constexpr auto DEFAULT_RESOLUTION = std::chrono::milliseconds(1);
+
+    explicit TimerWheel(Clock::duration resolution = DEFAULT_RESOLUTION);
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    ~TimerWheel();
+
+    Clock::duration getResolution() const noexcept { return resolution_; }
+
+    // Number of armed timers
+    std::size_t size() const;
+
+private:
+    friend class Timer;
+    using Link = detail::TimerLink;
+
+    static constexpr int LEVELS = 4;
+    static constexpr int SLOT_BITS = 8;
+    static constexpr std::uint64_t SLOTS = 1 << SLOT_BITS;
+    static constexpr std::uint64_t SLOT_MASK = SLOTS - 1;
+    static constexpr std::uint64_t MAX_SPAN = std::uint64_t{1} << (LEVELS * SLOT_BITS);
+
+    void arm_(Timer &timer, Clock::duration delay);
+    void cancel_(Timer &timer);
+    bool isArmed_(const Timer &timer) const;
+
+    static bool isEmpty_(const Link &list) noexcept { return list.next == &list; }
+    static void pushBack_(Link &list, Link &link) noexcept;
+    static void unlink_(Link &link) noexcept;
+
+    // Link an armed timer into the slot its expiry falls in, relative to now_
+    void insertNoLock_(Timer &timer);
+    // Process the ticks up to `tick`: cascade the upper levels and move the timers due to due_
+    void advanceNoLock_(std::uint64_t tick);
+    // The next tick worth waking up for: a non-empty level-0 slot or the next cascade
+    std::uint64_t nextWakeNoLock_() const;
+    std::uint64_t currentTick_() const;
+
+    // Run a timer's callback, with running_ set so that cancel() can wait for it
+    void fire_(std::unique_lock<std::mutex> &lock, Timer &timer);
+    void run_(std::stop_token stop);
+
+    const Clock::duration resolution_;
+    const Clock::time_point start_;
+    Scheduler *const scheduler_;  // Non-null in virtual time
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any cv_;          // Wakes the thread up for an earlier timer
+    std::condition_variable_any cvRunning_;   // Signals the end of a callback to cancel()
+    std::uint64_t now_ = 0;                   // Last tick processed
+    std::uint64_t wakeTick_ = 0;              // Tick the thread sleeps until
+    std::size_t armed_ = 0;
+    std::array<std::array<Link, SLOTS>, LEVELS> slots_;
+    Link due_;                                // Timers whose tick has come, waiting for their callback
+    const Timer *running_ = nullptr;          // Timer whose callback is running
+    std::thread::id runningThread_;
+    std::jthread thread_;  // Declared last: started after, and joined before, the state it uses
+};
+
+// Runs a task once per period on a TimerWheel: the timer counterpart of threading::PeriodicThread.
+class PeriodicTimer {
+public:
+    PeriodicTimer(TimerWheel &wheel, Clock::duration period, std::function<void()> task);
+    ~PeriodicTimer() { stop(); }
+
+    // Stop running the task. Waits for a running task to return, unless called from it.
+    void stop();
+
+private:
+    std::function<void()> task_;
+    Clock::duration period_;
+    std::atomic<bool> stopped_{false};
+    Timer timer_;  // Declared last: its callback uses the members above
+};
+
+} // namespace util
+} // namespace tns
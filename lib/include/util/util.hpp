@@ -1,7 +1,8 @@
 #pragma once
 
 #include <endian.h>   // __BYTE_ORDER __LITTLE_ENDIAN
-#include <algorithm>  // std::reverse()
+#include <cstdint>
+#include <type_traits>
 
 namespace tns {
 namespace util {
@@ -14,14 +15,34 @@ inline void hash_combine(std::size_t &seed, const T &v)
     seed ^= hasher(v) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
 }
 
+// Finalizer of MurmurHash3 (fmix64): a cheap full-avalanche mix of a 64-bit key.
+// Use it on keys that are already small integers (addresses, flow keys) instead of std::hash's identity.
+inline constexpr std::uint64_t mix64(std::uint64_t k) noexcept
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
 template <typename T>
 inline constexpr T hton(T value) noexcept
 {
+    static_assert(std::is_integral_v<T>, "hton: integral types only");
 #if __BYTE_ORDER == __LITTLE_ENDIAN
-    auto ptr = reinterpret_cast<char *>(&value);
-    std::reverse(ptr, ptr + sizeof(T));
-#endif
+    if constexpr (sizeof(T) == 2)
+        return static_cast<T>(__builtin_bswap16(static_cast<std::uint16_t>(value)));
+    else if constexpr (sizeof(T) == 4)
+        return static_cast<T>(__builtin_bswap32(static_cast<std::uint32_t>(value)));
+    else if constexpr (sizeof(T) == 8)
+        return static_cast<T>(__builtin_bswap64(static_cast<std::uint64_t>(value)));
+    else
+        return value;
+#else
     return value;
+#endif
 }
 
 template <typename T>
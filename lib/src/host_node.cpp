@@ -16,10 +16,12 @@ namespace tns {
  * @param lnxFile The path to a .lnx file that describes the host config.
  */
 HostNode::HostNode(const std::string_view lnxFile)
+    : HostNode(util::lnx::parseLnx(lnxFile.data()), nullptr) {}
+
+HostNode::HostNode(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric)
 {
-    // Parse lnx file and initialize base fields
-    const auto nodeData = util::lnx::parseLnx(lnxFile.data());
-    NetworkNode::initialize_(nodeData);
+    // Initialize base fields
+    NetworkNode::initialize_(nodeData, fabric);
 
     // Only host node does static routing
     for (const auto &route : nodeData.routes)
@@ -35,6 +37,9 @@ HostNode::HostNode(const std::string_view lnxFile)
             { sendIp_(destIP, std::move(payload), ip::Protocol::TCP); }
     );
 
+    // Fully set up: start taking datagrams off the interfaces
+    startReceiving_();
+
     std::stringstream ss;
     ss << "/********* HostNode created with " << interfaces_.size() << " interfaces. *********/\n";
     std::cout << ss.str();
@@ -0,0 +1,701 @@
+#include "ip/link_state.hpp"
+#include "ip/util.hpp"
+#include "util/util.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <queue>
+#include <sstream>
+
+
+namespace tns {
+namespace ip {
+
+namespace {
+
+// Wire format, network byte order:
+//   header: type (1), reserved (1), count (2), sender router ID (4)
+//   HELLO:  count x router ID heard from (4)
+//   LSA:    sequence number (4), number of links (2), number of prefixes (2),
+//           links x (neighbor router ID (4), cost (4)), prefixes x (address (4), mask (4))
+//           The header's count is unused (0) and its sender is the LSA's originator.
+enum class MessageType : std::uint8_t {
+    HELLO = 1,
+    LSA   = 2,
+};
+
+constexpr std::size_t HEADER_SIZE     = 8;
+constexpr std::size_t LSA_HEADER_SIZE = 8;
+constexpr std::size_t PAIR_SIZE       = 8;  // A link or a prefix
+
+template <typename T>
+T loadNetwork(const std::byte *p) noexcept
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return tns::util::ntoh(value);
+}
+
+template <typename T>
+std::byte *storeNetwork(std::byte *p, T value) noexcept
+{
+    value = tns::util::hton(value);
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+}
+
+std::byte *storeHeader(std::byte *p, MessageType type, std::uint16_t count, RouterId sender) noexcept
+{
+    p = storeNetwork(p, static_cast<std::uint8_t>(type));
+    p = storeNetwork(p, std::uint8_t{0});
+    p = storeNetwork(p, count);
+    return storeNetwork(p, sender);
+}
+
+PayloadPtr encodeLsa(const Lsa &lsa)
+{
+    auto payload = std::make_unique<Payload>(HEADER_SIZE + LSA_HEADER_SIZE +
+                                             (lsa.links.size() + lsa.prefixes.size()) * PAIR_SIZE);
+    auto p = storeHeader(payload->data(), MessageType::LSA, 0, lsa.originator);
+    p = storeNetwork(p, lsa.seq);
+    p = storeNetwork(p, static_cast<std::uint16_t>(lsa.links.size()));
+    p = storeNetwork(p, static_cast<std::uint16_t>(lsa.prefixes.size()));
+    for (const auto &link : lsa.links) {
+        p = storeNetwork(p, link.neighbor);
+        p = storeNetwork(p, link.cost);
+    }
+    for (const auto &prefix : lsa.prefixes) {
+        p = storeNetwork(p, prefix.address);
+        p = storeNetwork(p, prefix.mask);
+    }
+    return payload;
+}
+
+tl::expected<Lsa, std::string> decodeLsa(PayloadView body, RouterId originator)
+{
+    if (body.size() < LSA_HEADER_SIZE)
+        return tl::unexpected("LSA too short");
+
+    Lsa lsa{originator, loadNetwork<std::uint32_t>(body.data()), {}, {}};
+    const auto numLinks = loadNetwork<std::uint16_t>(body.data() + 4);
+    const auto numPrefixes = loadNetwork<std::uint16_t>(body.data() + 6);
+    if (body.size() < LSA_HEADER_SIZE + (numLinks + numPrefixes) * PAIR_SIZE) {
+        std::stringstream ss;
+        ss << "LSA announces " << numLinks << " links and " << numPrefixes
+           << " prefixes but only carries " << (body.size() - LSA_HEADER_SIZE) / PAIR_SIZE;
+        return tl::unexpected(ss.str());
+    }
+
+    auto p = body.data() + LSA_HEADER_SIZE;
+    lsa.links.reserve(numLinks);
+    for (std::size_t i = 0; i < numLinks; i++, p += PAIR_SIZE)
+        lsa.links.push_back({loadNetwork<std::uint32_t>(p), loadNetwork<std::uint32_t>(p + 4)});
+    lsa.prefixes.reserve(numPrefixes);
+    for (std::size_t i = 0; i < numPrefixes; i++, p += PAIR_SIZE)
+        lsa.prefixes.push_back({loadNetwork<std::uint32_t>(p), loadNetwork<std::uint32_t>(p + 4)});
+    return lsa;
+}
+
+std::string routerIdToString(RouterId id)
+{
+    return Ipv4Address{tns::util::hton(id)}.toStringAddr();
+}
+
+} // namespace
+
+
+/************************* LinkStateDatabase *************************/
+
+bool LinkStateDatabase::install(Lsa lsa, RouteChanges &changes)
+{
+    auto &node = nodes_[lsa.originator];
+    if (node.lsa && lsa.seq <= node.lsa->seq)
+        return false;
+    stats_.lsasInstalled++;
+
+    // Sorted links allow binary search in edgeCost_(); one link per neighbor
+    std::sort(lsa.links.begin(), lsa.links.end(),
+              [](const auto &a, const auto &b) { return a.neighbor < b.neighbor; });
+    lsa.links.erase(std::unique(lsa.links.begin(), lsa.links.end(),
+                                [](const auto &a, const auto &b) { return a.neighbor == b.neighbor; }),
+                    lsa.links.end());
+    std::sort(lsa.prefixes.begin(), lsa.prefixes.end());
+
+    std::vector<LsaLink> oldLinks;
+    std::set<LsaPrefix> prefixes;  // Prefixes whose route may change
+    if (node.lsa) {
+        oldLinks = std::move(node.lsa->links);
+        for (const auto &prefix : node.lsa->prefixes) {
+            prefixes.insert(prefix);
+            advertisers_[prefix].erase(lsa.originator);
+        }
+    }
+    for (const auto &prefix : lsa.prefixes) {
+        prefixes.insert(prefix);
+        advertisers_[prefix].insert(lsa.originator);
+    }
+
+    const auto originator = lsa.originator;
+    const bool topologyChanged = oldLinks != lsa.links;
+    node.lsa = std::move(lsa);
+
+    std::set<RouterId> touched;
+    if (topologyChanged)
+        updateTree_(originator, oldLinks, touched);
+    else
+        stats_.prefixOnlyUpdates++;
+
+    for (const auto id : touched) {
+        if (const auto &touchedLsa = nodes_[id].lsa)
+            prefixes.insert(touchedLsa->prefixes.begin(), touchedLsa->prefixes.end());
+    }
+    updateRoutes_(prefixes, changes);
+    return true;
+}
+
+void LinkStateDatabase::remove(RouterId originator, RouteChanges &changes)
+{
+    const auto it = nodes_.find(originator);
+    if (it == nodes_.end() || !it->second.lsa || originator == self_)
+        return;
+
+    std::set<LsaPrefix> prefixes;
+    for (const auto &prefix : it->second.lsa->prefixes) {
+        prefixes.insert(prefix);
+        if (auto adv = advertisers_.find(prefix); adv != advertisers_.end()) {
+            adv->second.erase(originator);
+            if (adv->second.empty())
+                advertisers_.erase(adv);
+        }
+    }
+    const auto oldLinks = std::move(it->second.lsa->links);
+    it->second.lsa.reset();
+
+    std::set<RouterId> touched;
+    updateTree_(originator, oldLinks, touched);
+    for (const auto id : touched) {
+        if (const auto &touchedLsa = nodes_[id].lsa)
+            prefixes.insert(touchedLsa->prefixes.begin(), touchedLsa->prefixes.end());
+    }
+    updateRoutes_(prefixes, changes);
+}
+
+const Lsa *LinkStateDatabase::find(RouterId originator) const
+{
+    const auto it = nodes_.find(originator);
+    return it == nodes_.end() || !it->second.lsa ? nullptr : &*it->second.lsa;
+}
+
+std::vector<const Lsa*> LinkStateDatabase::getLsas() const
+{
+    std::vector<const Lsa*> lsas;
+    for (const auto &[_, node] : nodes_) {
+        if (node.lsa)
+            lsas.push_back(&*node.lsa);
+    }
+    std::sort(lsas.begin(), lsas.end(),
+              [](const auto *a, const auto *b) { return a->originator < b->originator; });
+    return lsas;
+}
+
+std::uint32_t LinkStateDatabase::getDistance(RouterId router) const
+{
+    const auto it = nodes_.find(router);
+    return it == nodes_.end() ? UNREACHABLE : it->second.dist;
+}
+
+std::uint32_t LinkStateDatabase::edgeCost_(RouterId u, RouterId v) const
+{
+    const auto uIt = nodes_.find(u);
+    const auto vIt = nodes_.find(v);
+    if (uIt == nodes_.end() || vIt == nodes_.end() || !uIt->second.lsa || !vIt->second.lsa)
+        return UNREACHABLE;
+
+    const auto byNeighbor = [](const LsaLink &link, RouterId id) { return link.neighbor < id; };
+    const auto &uLinks = uIt->second.lsa->links;
+    const auto &vLinks = vIt->second.lsa->links;
+    const auto uv = std::lower_bound(uLinks.begin(), uLinks.end(), v, byNeighbor);
+    const auto vu = std::lower_bound(vLinks.begin(), vLinks.end(), u, byNeighbor);
+    if (uv == uLinks.end() || uv->neighbor != v || vu == vLinks.end() || vu->neighbor != u)
+        return UNREACHABLE;
+    return std::clamp(uv->cost, 1u, MAX_COST);
+}
+
+/**
+ * Incremental SPF. Only the edges between `originator` and the routers in its old or new links can have changed.
+ *  1. A tree edge that got more expensive or disappeared invalidates the subtree below it. Each invalidated
+ *     router is re-seeded with its best distance through a router outside of the invalidated set.
+ *  2. An edge that got cheaper seeds its head with the lower distance.
+ * Dijkstra then continues from the seeds; routers away from the change are never visited.
+ */
+void LinkStateDatabase::updateTree_(RouterId originator, const std::vector<LsaLink> &oldLinks,
+                                    std::set<RouterId> &touched)
+{
+    stats_.incrementalRuns++;
+
+    std::set<RouterId> ends;
+    for (const auto &link : oldLinks)
+        ends.insert(link.neighbor);
+    if (const auto &lsa = nodes_[originator].lsa) {
+        for (const auto &link : lsa->links)
+            ends.insert(link.neighbor);
+    }
+
+    std::vector<std::pair<RouterId, RouterId>> edges;
+    for (const auto end : ends) {
+        nodes_[end];  // Make sure both ends exist, so references below stay valid
+        edges.emplace_back(originator, end);
+        edges.emplace_back(end, originator);
+    }
+
+    // 1. Invalidate subtrees hanging off broken tree edges
+    std::unordered_map<RouterId, std::vector<RouterId>> children;
+    std::set<RouterId> invalid;
+    for (const auto &[u, v] : edges) {
+        const auto &nodeV = nodes_[v];
+        if (v == self_ || nodeV.parent != u || invalid.contains(v))
+            continue;
+        const auto cost = edgeCost_(u, v);
+        if (cost != UNREACHABLE && nodes_[u].dist + cost == nodeV.dist)
+            continue;
+
+        if (children.empty()) {
+            for (const auto &[id, node] : nodes_) {
+                if (node.parent)
+                    children[*node.parent].push_back(id);
+            }
+        }
+        std::vector<RouterId> stack{v};
+        while (!stack.empty()) {
+            const auto w = stack.back();
+            stack.pop_back();
+            if (!invalid.insert(w).second)
+                continue;
+            for (const auto child : children[w])
+                stack.push_back(child);
+        }
+    }
+
+    for (const auto w : invalid) {
+        auto &node = nodes_[w];
+        node.dist = UNREACHABLE;
+        node.parent.reset();
+        touched.insert(w);
+    }
+
+    std::vector<HeapItem> heap;
+    for (const auto w : invalid) {
+        auto &node = nodes_[w];
+        if (!node.lsa)
+            continue;
+        for (const auto &link : node.lsa->links) {  // Edges into w come from the routers w lists
+            const auto u = link.neighbor;
+            if (invalid.contains(u))
+                continue;
+            const auto du = getDistance(u);
+            const auto cost = edgeCost_(u, w);
+            if (du == UNREACHABLE || cost == UNREACHABLE)
+                continue;
+            if (du + cost < node.dist) {
+                node.dist = du + cost;
+                node.parent = u;
+            }
+        }
+        if (node.dist != UNREACHABLE)
+            heap.emplace_back(node.dist, w);
+    }
+
+    // 2. Seed the heads of edges that got cheaper (or appeared)
+    for (const auto &[u, v] : edges) {
+        const auto du = nodes_[u].dist;
+        const auto cost = edgeCost_(u, v);
+        auto &nodeV = nodes_[v];
+        if (du == UNREACHABLE || cost == UNREACHABLE || du + cost >= nodeV.dist)
+            continue;
+        nodeV.dist = du + cost;
+        nodeV.parent = u;
+        heap.emplace_back(nodeV.dist, v);
+    }
+
+    relax_(std::move(heap), touched);
+}
+
+void LinkStateDatabase::relax_(std::vector<HeapItem> heap, std::set<RouterId> &touched)
+{
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<>> queue{std::greater<>{}, std::move(heap)};
+
+    while (!queue.empty()) {
+        const auto [d, v] = queue.top();
+        queue.pop();
+        auto &node = nodes_[v];
+        if (d != node.dist)
+            continue;  // Stale entry
+
+        stats_.nodesRelaxed++;
+        touched.insert(v);
+        node.firstHop = *node.parent == self_ ? v : nodes_[*node.parent].firstHop;
+
+        if (!node.lsa)
+            continue;
+        for (const auto &link : node.lsa->links) {
+            const auto cost = edgeCost_(v, link.neighbor);
+            if (cost == UNREACHABLE)
+                continue;
+            auto &next = nodes_[link.neighbor];
+            if (d + cost < next.dist) {
+                next.dist = d + cost;
+                next.parent = v;
+                queue.emplace(next.dist, link.neighbor);
+            }
+        }
+    }
+}
+
+void LinkStateDatabase::updateRoutes_(const std::set<LsaPrefix> &prefixes, RouteChanges &changes)
+{
+    for (const auto &prefix : prefixes) {
+        std::optional<Route> best;
+
+        const auto adv = advertisers_.find(prefix);
+        if (adv != advertisers_.end() && !adv->second.contains(self_)) {  // Our own subnets are local routes
+            for (const auto id : adv->second) {  // Ascending, so ties go to the lowest router ID
+                const auto &node = nodes_[id];
+                if (node.dist != UNREACHABLE && (!best || node.dist < best->cost))
+                    best = Route{node.firstHop, node.dist};
+            }
+        }
+
+        const auto it = routes_.find(prefix);
+        if (best) {
+            if (it != routes_.end() && it->second == *best)
+                continue;
+            routes_.insert_or_assign(prefix, *best);
+        } else {
+            if (it == routes_.end())
+                continue;
+            routes_.erase(it);
+        }
+        changes.push_back({prefix, best});
+    }
+}
+
+LinkStateDatabase::Routes LinkStateDatabase::computeRoutesFromScratch() const
+{
+    struct State {
+        std::uint32_t dist = UNREACHABLE;
+        RouterId firstHop = 0;
+    };
+    std::unordered_map<RouterId, State> state;
+    state[self_].dist = 0;
+
+    std::priority_queue<HeapItem, std::vector<HeapItem>, std::greater<>> queue;
+    queue.emplace(0, self_);
+    while (!queue.empty()) {
+        const auto [d, v] = queue.top();
+        queue.pop();
+        if (d != state[v].dist)
+            continue;
+        const auto *lsa = find(v);
+        if (!lsa)
+            continue;
+        for (const auto &link : lsa->links) {
+            const auto cost = edgeCost_(v, link.neighbor);
+            if (cost == UNREACHABLE)
+                continue;
+            auto &next = state[link.neighbor];
+            if (d + cost < next.dist) {
+                next.dist = d + cost;
+                next.firstHop = v == self_ ? link.neighbor : state[v].firstHop;
+                queue.emplace(next.dist, link.neighbor);
+            }
+        }
+    }
+
+    Routes routes;
+    for (const auto &[prefix, routers] : advertisers_) {
+        if (routers.contains(self_))
+            continue;
+        for (const auto id : routers) {
+            const auto it = state.find(id);
+            if (it == state.end() || it->second.dist == UNREACHABLE)
+                continue;
+            const auto [route, inserted] = routes.try_emplace(prefix, Route{it->second.firstHop, it->second.dist});
+            if (!inserted && it->second.dist < route->second.cost)
+                route->second = Route{it->second.firstHop, it->second.dist};
+        }
+    }
+    return routes;
+}
+
+
+/************************* LinkStateRouting *************************/
+
+LinkStateRouting::LinkStateRouting(RouterId self, std::vector<Ipv4Address> neighbors, Callbacks callbacks)
+    : self_(self), callbacks_(std::move(callbacks)), lsdb_(self)
+{
+    for (const auto &neighbor : neighbors)
+        neighbors_.try_emplace(neighbor);
+}
+
+void LinkStateRouting::handleMessage(PayloadView payload, const Ipv4Address &src)
+{
+    if (payload.size() < HEADER_SIZE) {
+        std::cerr << "LinkStateRouting::handleMessage(): Discarding message: too short\n";
+        return;
+    }
+
+    const auto type = MessageType{ loadNetwork<std::uint8_t>(payload.data()) };
+    const auto count = loadNetwork<std::uint16_t>(payload.data() + 2);
+    const auto sender = loadNetwork<std::uint32_t>(payload.data() + 4);
+    const auto body = payload.subspan(HEADER_SIZE);
+    const auto now = Clock::now();
+
+    std::lock_guard lock(mutex_);
+    if (!neighbors_.contains(src))
+        return;  // Not one of our configured neighbors
+
+    switch (type) {
+    case MessageType::HELLO :
+        if (body.size() < count * sizeof(RouterId)) {
+            std::cerr << "LinkStateRouting::handleMessage(): Discarding hello: truncated\n";
+            return;
+        }
+        handleHello_(body.first(count * sizeof(RouterId)), sender, src, now);
+        break;
+    case MessageType::LSA : {
+        auto lsa = decodeLsa(body, sender);
+        if (!lsa) {
+            std::stringstream ss;
+            ss << "LinkStateRouting::handleMessage(): Discarding LSA: " << lsa.error() << "\n";
+            std::cerr << ss.str();
+            return;
+        }
+        handleLsa_(std::move(*lsa), src, now);
+        break;
+    }
+    default:
+        std::stringstream ss;
+        ss << "LinkStateRouting::handleMessage(): Unknown message type: " << static_cast<int>(type) << "\n";
+        std::cerr << ss.str();
+        break;
+    }
+}
+
+void LinkStateRouting::tick()
+{
+    const auto now = Clock::now();
+    std::lock_guard lock(mutex_);
+
+    // Expire neighbors we have not heard from
+    for (auto &[addr, neighbor] : neighbors_) {
+        if (neighbor.routerId && now - neighbor.lastHeard > DEAD_INTERVAL)
+            neighbor = Neighbor{};
+    }
+
+    for (const auto &[addr, _] : neighbors_)
+        sendHello_(addr);
+
+    // Age out LSAs of routers that stopped refreshing them
+    LinkStateDatabase::RouteChanges changes;
+    for (auto it = lsaInstalled_.begin(); it != lsaInstalled_.end(); ) {
+        if (now - it->second > LSA_MAX_AGE) {
+            lsdb_.remove(it->first, changes);
+            it = lsaInstalled_.erase(it);
+        } else {
+            it++;
+        }
+    }
+    installRoutes_(changes);
+
+    originateLsa_(now, now - lastOriginated_ >= LSA_REFRESH);
+}
+
+void LinkStateRouting::onInterfaceChange()
+{
+    const auto now = Clock::now();
+    std::lock_guard lock(mutex_);
+
+    // Neighbors behind an interface that went down are gone right away
+    const auto prefixes = callbacks_.localPrefixes();
+    for (auto &[addr, neighbor] : neighbors_) {
+        const bool reachable = std::any_of(prefixes.begin(), prefixes.end(), [&addr](const auto &prefix) {
+            return (addr.getAddrHost() & prefix.mask) == prefix.address;
+        });
+        if (!reachable)
+            neighbor = Neighbor{};
+    }
+
+    originateLsa_(now, false);
+}
+
+void LinkStateRouting::handleHello_(PayloadView ids, RouterId sender, const Ipv4Address &src,
+                                    Clock::time_point now)
+{
+    bool heardUs = false;
+    for (std::size_t off = 0; off < ids.size(); off += sizeof(RouterId))
+        heardUs |= loadNetwork<RouterId>(ids.data() + off) == self_;
+
+    auto &neighbor = neighbors_[src];
+    const bool changed = neighbor.routerId != sender || neighbor.twoWay != heardUs;
+    const bool becameTwoWay = heardUs && !neighbor.twoWay;
+    neighbor.routerId = sender;
+    neighbor.twoWay = heardUs;
+    neighbor.lastHeard = now;
+
+    if (!changed)
+        return;
+
+    // Answer right away so that the neighbor does not wait a hello interval to see us (two-way)
+    sendHello_(src);
+    originateLsa_(now, false);
+
+    // Synchronize the new adjacency with the whole database
+    if (becameTwoWay) {
+        for (const auto *lsa : lsdb_.getLsas())
+            sendLsa_(*lsa, src);
+    }
+}
+
+void LinkStateRouting::handleLsa_(Lsa lsa, const Ipv4Address &src, Clock::time_point now)
+{
+    // An old LSA of ours is still around (e.g. we restarted): continue after its sequence number
+    if (lsa.originator == self_) {
+        if (lsa.seq >= seq_) {
+            seq_ = lsa.seq;
+            originateLsa_(now, true);
+        }
+        return;
+    }
+
+    const auto *existing = lsdb_.find(lsa.originator);
+    if (existing && existing->seq >= lsa.seq) {
+        if (existing->seq > lsa.seq)
+            sendLsa_(*existing, src);  // The sender is behind: send it our copy
+        return;
+    }
+
+    floodLsa_(lsa, src);
+    installLsa_(std::move(lsa), now);
+}
+
+void LinkStateRouting::originateLsa_(Clock::time_point now, bool refresh)
+{
+    Lsa lsa{self_, seq_ + 1, {}, callbacks_.localPrefixes()};
+    for (const auto &[addr, neighbor] : neighbors_) {
+        if (neighbor.twoWay && neighbor.routerId)
+            lsa.links.push_back({*neighbor.routerId, 1});  // Unit cost, i.e. hop count as in RIP
+    }
+    std::sort(lsa.links.begin(), lsa.links.end(),
+              [](const auto &a, const auto &b) { return a.neighbor < b.neighbor; });
+    lsa.links.erase(std::unique(lsa.links.begin(), lsa.links.end()), lsa.links.end());
+    std::sort(lsa.prefixes.begin(), lsa.prefixes.end());
+
+    const auto *current = lsdb_.find(self_);
+    if (!refresh && current && current->links == lsa.links && current->prefixes == lsa.prefixes)
+        return;
+
+    seq_++;
+    lastOriginated_ = now;
+    floodLsa_(lsa, std::nullopt);
+    installLsa_(std::move(lsa), now);
+
+    // Neighbors may have moved to other interfaces: resolve all routes again
+    LinkStateDatabase::RouteChanges all;
+    for (const auto &[prefix, route] : lsdb_.getRoutes())
+        all.push_back({prefix, route});
+    installRoutes_(all);
+}
+
+void LinkStateRouting::installLsa_(Lsa lsa, Clock::time_point now)
+{
+    if (lsa.originator != self_)
+        lsaInstalled_[lsa.originator] = now;
+
+    LinkStateDatabase::RouteChanges changes;
+    lsdb_.install(std::move(lsa), changes);
+    installRoutes_(changes);
+}
+
+void LinkStateRouting::installRoutes_(const LinkStateDatabase::RouteChanges &changes)
+{
+    if (changes.empty())
+        return;
+
+    std::vector<InstalledRoute> routes;
+    routes.reserve(changes.size());
+    for (const auto &[prefix, route] : changes) {
+        if (const auto gateway = route ? neighborAddress_(route->firstHop) : std::nullopt)
+            routes.push_back({prefix, gateway, route->cost});
+        else
+            routes.push_back({prefix, std::nullopt, 0});
+    }
+    callbacks_.installRoutes(routes);
+}
+
+void LinkStateRouting::sendHello_(const Ipv4Address &dest)
+{
+    std::vector<RouterId> heard;
+    for (const auto &[addr, neighbor] : neighbors_) {
+        if (neighbor.routerId)
+            heard.push_back(*neighbor.routerId);
+    }
+
+    auto payload = std::make_unique<Payload>(HEADER_SIZE + heard.size() * sizeof(RouterId));
+    auto p = storeHeader(payload->data(), MessageType::HELLO, static_cast<std::uint16_t>(heard.size()), self_);
+    for (const auto id : heard)
+        p = storeNetwork(p, id);
+    callbacks_.send(dest, std::move(payload));
+}
+
+void LinkStateRouting::sendLsa_(const Lsa &lsa, const Ipv4Address &dest)
+{
+    callbacks_.send(dest, encodeLsa(lsa));
+}
+
+void LinkStateRouting::floodLsa_(const Lsa &lsa, const std::optional<Ipv4Address> &except)
+{
+    for (const auto &[addr, neighbor] : neighbors_) {
+        if (neighbor.twoWay && addr != except)
+            sendLsa_(lsa, addr);
+    }
+}
+
+std::optional<Ipv4Address> LinkStateRouting::neighborAddress_(RouterId routerId) const
+{
+    for (const auto &[addr, neighbor] : neighbors_) {
+        if (neighbor.twoWay && neighbor.routerId == routerId)
+            return addr;
+    }
+    return std::nullopt;
+}
+
+void LinkStateRouting::listDatabase(std::ostream &os) const
+{
+    using namespace std;
+    std::lock_guard lock(mutex_);
+
+    os << setw(15) << left  << "Router"   << " "
+       << setw(6)  << right << "Seq"      << " "
+       << setw(5)  << right << "Cost"     << "  "
+       << left << "Neighbors" << "\n";
+    for (const auto *lsa : lsdb_.getLsas()) {
+        const auto dist = lsdb_.getDistance(lsa->originator);
+        std::stringstream links;
+        for (const auto &link : lsa->links)
+            links << routerIdToString(link.neighbor) << " ";
+        os << setw(15) << left  << routerIdToString(lsa->originator) << " "
+           << setw(6)  << right << lsa->seq << " "
+           << setw(5)  << right << (dist == LinkStateDatabase::UNREACHABLE ? "-" : to_string(dist)) << "  "
+           << left << links.str() << "\n";
+    }
+
+    const auto &stats = lsdb_.getStats();
+    os << "LSAs installed: " << stats.lsasInstalled
+       << ", prefix-only: " << stats.prefixOnlyUpdates
+       << ", SPF runs: " << stats.incrementalRuns
+       << ", routers relaxed: " << stats.nodesRelaxed << "\n";
+}
+
+} // namespace ip
+} // namespace tns
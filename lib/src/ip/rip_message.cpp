@@ -3,64 +3,126 @@
 #include "ip/address.hpp"
 #include "util/util.hpp"
 
+#include <algorithm>
+#include <cstring>
 #include <limits>
+#include <sstream>
 
 
 namespace tns {
 namespace ip {
 
+namespace {
+
+constexpr std::size_t HEADER_SIZE = 2 * sizeof(std::uint16_t);  // command, number of entries
+constexpr std::size_t ENTRY_SIZE  = 3 * sizeof(std::uint32_t);  // cost, address, mask
+
+static_assert(HEADER_SIZE + RipMessage::MAX_ENTRIES_PER_MESSAGE * ENTRY_SIZE <= Datagram::MAX_DATAGRAM_SIZE - 20,
+              "A RIP message must fit in a single datagram");
+
+template <typename T>
+T loadNetwork(const std::byte *p) noexcept
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return tns::util::ntoh(value);
+}
+
+template <typename T>
+std::byte *storeNetwork(std::byte *p, T value) noexcept
+{
+    value = tns::util::hton(value);
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+}
+
+} // namespace
+
+
 RipMessage::RipMessage(Command command, RipMessage::Entries entries, OptionalAddresses learnedFrom)
-    : command_(command), learnedFrom_(std::move(learnedFrom))
+    : command_(command), entries_(std::move(entries)), learnedFrom_(std::move(learnedFrom))
 {
-    // Check if the number of entries is less than limit of uint16_t
-    if (entries.size() > std::numeric_limits<std::uint16_t>::max()) {
+    if (entries_.size() != learnedFrom_.size()) {
         throw std::invalid_argument("RipMessage::RipMessage() : "
-                                    "Number of entries is greater than limit of uint16_t");
+                                    "entries.size() != learnedFrom.size()");
     }
+}
 
-    if (entries.size() != learnedFrom_.size()) {
-        throw std::invalid_argument("RipMessage::RipMessage() : "
-                                    "entries.size() != learnedFrom.size()");
+
+tl::expected<RipMessageView, std::string> RipMessageView::parse(PayloadView payload)
+{
+    if (payload.size() < HEADER_SIZE)
+        return tl::unexpected("RIP message too short");
+
+    const auto command = RipMessage::Command{ loadNetwork<std::uint16_t>(payload.data()) };
+    const auto numEntries = loadNetwork<std::uint16_t>(payload.data() + sizeof(std::uint16_t));
+
+    const auto entries = payload.subspan(HEADER_SIZE);
+    if (entries.size() < numEntries * ENTRY_SIZE) {
+        std::stringstream ss;
+        ss << "RIP message announces " << numEntries << " entries but only carries "
+           << entries.size() / ENTRY_SIZE;
+        return tl::unexpected(ss.str());
     }
 
-    numEntries_ = static_cast<std::uint16_t>(entries.size());
-    entries_ = std::move(entries);
+    return RipMessageView{entries.first(numEntries * ENTRY_SIZE), command, numEntries};
+}
+
+RipMessage::Entry RipMessageView::getEntry(std::size_t i) const noexcept
+{
+    const auto p = entries_.data() + i * ENTRY_SIZE;
+    return {
+        .cost    = loadNetwork<std::uint32_t>(p),
+        .address = loadNetwork<std::uint32_t>(p + sizeof(std::uint32_t) * 1),
+        .mask    = loadNetwork<std::uint32_t>(p + sizeof(std::uint32_t) * 2),
+    };
+}
+
+
+RipEncoding::RipEncoding(const RipMessage &ripMessage)
+    : numEntries_(ripMessage.getNumEntries())
+{
+    const auto &entries = ripMessage.getEntries();
+    const auto &learnedFrom = ripMessage.getLearnedFrom();
+
+    // Always at least one message, so that requests (no entries) are encoded too
+    std::size_t first = 0;
+    do {
+        const auto n = std::min(entries.size() - first, RipMessage::MAX_ENTRIES_PER_MESSAGE);
+
+        Message &message = messages_.emplace_back();
+        message.payload.resize(HEADER_SIZE + n * ENTRY_SIZE);
+
+        auto p = message.payload.data();
+        p = storeNetwork(p, static_cast<std::uint16_t>(ripMessage.getCommand()));
+        p = storeNetwork(p, static_cast<std::uint16_t>(n));
+
+        for (auto i = first; i < first + n; i++) {
+            if (learnedFrom[i])
+                message.learnedFrom.emplace_back(static_cast<std::size_t>(p - message.payload.data()), *learnedFrom[i]);
+            p = storeNetwork(p, entries[i].cost);
+            p = storeNetwork(p, entries[i].address);
+            p = storeNetwork(p, entries[i].mask);
+        }
+
+        first += n;
+    } while (first < entries.size());
 }
 
-RipMessage::RipMessage(PayloadView payload)  // TODO: This most certainly has memory leak hazards haha
+std::vector<PayloadPtr> RipEncoding::makePayloads(const Ipv4Address &neighbor) const
 {
-    using tns::util::ntoh;
-
-    auto p = payload.data();
-
-    // The first 2 bytes are the command
-    command_ = Command{ ntoh(*reinterpret_cast<const std::uint16_t *>(p)) };
-    p += sizeof(std::uint16_t);
-
-    // The next 2 bytes are the number of entries
-    numEntries_ = ntoh(*reinterpret_cast<const std::uint16_t *>(p));
-    p += sizeof(std::uint16_t);
-
-    // std::cout << "++++++++++++++++++++++++++++\n";
-    // std::cout << "RipMessage: Command = " << static_cast<uint16_t>(command_) << ", numEntries = " << numEntries_ << "\n";
-
-    // The rest are the entries
-    for (std::uint16_t i = 0; i < numEntries_; i++, p += sizeof(RipMessage::Entry)) {
-        auto newCost = ntoh(*reinterpret_cast<const std::uint32_t *>(p)) + 1;
-        entries_.emplace_back(
-            std::min(newCost, INFINITY),  // cost
-            ntoh(*reinterpret_cast<const std::uint32_t *>(p + sizeof(std::uint32_t) * 1)),  // address
-            ntoh(*reinterpret_cast<const std::uint32_t *>(p + sizeof(std::uint32_t) * 2))   // mask
-        );
-
-        // auto et = entries_.back();
-        // std::cout << "RipMessage: Entry " << i 
-        //           << ": cost = " << et.cost 
-        //           << ", address = " << Ipv4Address(util::hton<std::uint32_t>(et.address)) 
-        //           << ", mask len = " << util::ip::subnetMaskLength(et.mask) << "\n";
+    std::vector<PayloadPtr> payloads;
+    payloads.reserve(messages_.size());
+
+    for (const auto &message : messages_) {
+        auto &payload = payloads.emplace_back(std::make_unique<Payload>(message.payload));
+        for (const auto &[costOffset, learnedFrom] : message.learnedFrom) {
+            if (learnedFrom == neighbor)
+                storeNetwork(payload->data() + costOffset, RipMessage::INFINITY);  // Poisoned reverse
+        }
     }
 
-    // std::cout << "++++++++++  RipMessage constructed!  +++++++++++\n";
+    return payloads;
 }
 
 } // namespace ip
@@ -0,0 +1,172 @@
+#include "ip/route_file.hpp"
+#include "util/util.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace tns {
+namespace ip {
+
+namespace {
+
+// A read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+    explicit MappedFile(const std::string &path)
+    {
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0)
+            return;
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0)
+            return;
+        size_ = static_cast<std::size_t>(st.st_size);
+        if (size_ == 0) {
+            ok_ = true;
+            return;
+        }
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            return;
+        }
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+        ok_ = true;
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile()
+    {
+        if (data_)
+            ::munmap(data_, size_);
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    explicit operator bool() const noexcept { return ok_; }
+
+    std::span<const std::byte> bytes() const noexcept { return {static_cast<const std::byte*>(data_), data_ ? size_ : 0}; }
+    std::string_view text() const noexcept { return {static_cast<const char*>(data_), data_ ? size_ : 0}; }
+
+private:
+    int fd_ = -1;
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool ok_ = false;
+};
+
+// Cursor over one line of the text form
+struct Cursor {
+    const char *p;
+    const char *end;
+
+    bool atEnd() const noexcept { return p == end || *p == '\n' || *p == '#'; }
+
+    void skipBlanks() noexcept
+    {
+        while (p != end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            p++;
+    }
+
+    bool parseNumber(std::uint32_t &value, std::uint32_t max) noexcept
+    {
+        const auto start = p;
+        value = 0;
+        while (p != end && *p >= '0' && *p <= '9' && p - start < 3) {
+            value = value * 10 + static_cast<std::uint32_t>(*p - '0');
+            p++;
+        }
+        return p != start && value <= max;
+    }
+
+    // Dotted quad, host byte order
+    bool parseAddress(std::uint32_t &addr) noexcept
+    {
+        addr = 0;
+        for (int i = 0; i < 4; i++) {
+            std::uint32_t octet;
+            if (!parseNumber(octet, 255))
+                return false;
+            addr = (addr << 8) | octet;
+            if (i < 3 && (p == end || *p++ != '.'))
+                return false;
+        }
+        return true;
+    }
+
+    bool consume(std::string_view word) noexcept
+    {
+        if (static_cast<std::size_t>(end - p) < word.size() || std::string_view{p, word.size()} != word)
+            return false;
+        p += word.size();
+        return true;
+    }
+};
+
+} // namespace
+
+
+tl::expected<std::vector<SnapshotRoute>, std::string> parseRouteText(std::string_view text, const std::string &name)
+{
+    std::vector<SnapshotRoute> routes;
+    routes.reserve(text.size() / 32);  // About 30 bytes per line
+
+    const auto error = [&name](std::size_t lineNo, std::string_view what) {
+        std::stringstream ss;
+        ss << name << ":" << lineNo << ": " << what;
+        return tl::unexpected(ss.str());
+    };
+
+    Cursor cur{text.data(), text.data() + text.size()};
+    for (std::size_t lineNo = 1; cur.p != cur.end; lineNo++) {
+        cur.skipBlanks();
+        if (!cur.atEnd()) {
+            std::uint32_t address, length, gateway;
+            if (!cur.parseAddress(address) || !cur.consume("/") || !cur.parseNumber(length, 32))
+                return error(lineNo, "expected <address>/<prefix-length>");
+            cur.skipBlanks();
+            if (cur.consume("via"))
+                cur.skipBlanks();
+            if (!cur.parseAddress(gateway))
+                return error(lineNo, "expected a gateway address");
+            cur.skipBlanks();
+            if (!cur.atEnd())
+                return error(lineNo, "unexpected trailing characters");
+
+            const std::uint32_t mask = length == 0 ? 0 : ~std::uint32_t{0} << (32 - length);
+            routes.push_back({address & mask, mask, Ipv4Address{ tns::util::hton(gateway) }, 0});
+        }
+
+        // Skip the rest of the line (comment) and the newline
+        const auto newline = static_cast<const char*>(std::memchr(cur.p, '\n', static_cast<std::size_t>(cur.end - cur.p)));
+        cur.p = newline ? newline + 1 : cur.end;
+    }
+
+    return routes;
+}
+
+tl::expected<std::vector<SnapshotRoute>, std::string> loadRouteFile(const std::string &path)
+{
+    const MappedFile file{path};
+    if (!file) {
+        std::stringstream ss;
+        ss << "Cannot map " << path << ": " << std::strerror(errno);
+        return tl::unexpected(ss.str());
+    }
+
+    if (isRouteSnapshot(file.bytes()))
+        return decodeRouteSnapshot(file.bytes(), path);
+    return parseRouteText(file.text(), path);
+}
+
+} // namespace ip
+} // namespace tns
@@ -0,0 +1,127 @@
+#include "ip/route_snapshot.hpp"
+#include "util/util.hpp"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+
+namespace tns {
+namespace ip {
+
+namespace {
+
+constexpr std::uint32_t MAGIC   = 0x544E5352;  // "TNSR"
+constexpr std::uint16_t VERSION = 1;
+
+constexpr std::size_t HEADER_SIZE = 12;  // magic (4), version (2), reserved (2), count (4)
+constexpr std::size_t ROUTE_SIZE  = 16;  // address (4), mask (4), gateway (4), metric (4)
+
+template <typename T>
+T loadNetwork(const std::byte *p) noexcept
+{
+    T value;
+    std::memcpy(&value, p, sizeof(T));
+    return tns::util::ntoh(value);
+}
+
+template <typename T>
+std::byte *storeNetwork(std::byte *p, T value) noexcept
+{
+    value = tns::util::hton(value);
+    std::memcpy(p, &value, sizeof(T));
+    return p + sizeof(T);
+}
+
+std::string errnoMessage(std::string_view what, const std::string &path)
+{
+    std::stringstream ss;
+    ss << what << " " << path << ": " << std::strerror(errno);
+    return ss.str();
+}
+
+} // namespace
+
+
+tl::expected<void, std::string> saveRouteSnapshot(const std::string &path, const std::vector<SnapshotRoute> &routes)
+{
+    std::vector<std::byte> buffer(HEADER_SIZE + routes.size() * ROUTE_SIZE);
+    auto p = storeNetwork(buffer.data(), MAGIC);
+    p = storeNetwork(p, VERSION);
+    p = storeNetwork(p, std::uint16_t{0});
+    p = storeNetwork(p, static_cast<std::uint32_t>(routes.size()));
+    for (const auto &route : routes) {
+        p = storeNetwork(p, route.address);
+        p = storeNetwork(p, route.mask);
+        p = storeNetwork(p, route.gateway.getAddrHost());
+        p = storeNetwork(p, route.metric);
+    }
+
+    const auto tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return tl::unexpected(errnoMessage("Cannot open", tmpPath));
+        file.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        file.flush();
+        if (!file)
+            return tl::unexpected(errnoMessage("Cannot write", tmpPath));
+    }
+
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0)
+        return tl::unexpected(errnoMessage("Cannot rename snapshot to", path));
+    return {};
+}
+
+tl::expected<std::vector<SnapshotRoute>, std::string> loadRouteSnapshot(const std::string &path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return tl::unexpected(errnoMessage("Cannot open", path));
+
+    std::vector<char> chars{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+    return decodeRouteSnapshot(std::as_bytes(std::span{chars}), path);
+}
+
+bool isRouteSnapshot(std::span<const std::byte> data) noexcept
+{
+    return data.size() >= HEADER_SIZE && loadNetwork<std::uint32_t>(data.data()) == MAGIC;
+}
+
+tl::expected<std::vector<SnapshotRoute>, std::string> decodeRouteSnapshot(std::span<const std::byte> data,
+                                                                          const std::string &name)
+{
+    if (!isRouteSnapshot(data))
+        return tl::unexpected(name + " is not a route snapshot");
+    if (const auto version = loadNetwork<std::uint16_t>(data.data() + 4); version != VERSION) {
+        std::stringstream ss;
+        ss << name << ": unsupported snapshot version " << version;
+        return tl::unexpected(ss.str());
+    }
+
+    const auto count = loadNetwork<std::uint32_t>(data.data() + 8);
+    if (data.size() != HEADER_SIZE + count * ROUTE_SIZE) {
+        std::stringstream ss;
+        ss << name << ": snapshot announces " << count << " routes but holds "
+           << (data.size() - HEADER_SIZE) / ROUTE_SIZE;
+        return tl::unexpected(ss.str());
+    }
+
+    std::vector<SnapshotRoute> routes;
+    routes.reserve(count);
+    for (auto p = data.data() + HEADER_SIZE; p != data.data() + data.size(); p += ROUTE_SIZE) {
+        routes.push_back({
+            .address = loadNetwork<std::uint32_t>(p),
+            .mask    = loadNetwork<std::uint32_t>(p + 4),
+            .gateway = Ipv4Address{ tns::util::hton(loadNetwork<std::uint32_t>(p + 8)) },
+            .metric  = loadNetwork<std::uint32_t>(p + 12),
+        });
+    }
+    return routes;
+}
+
+} // namespace ip
+} // namespace tns
@@ -1,17 +1,21 @@
 #include "ip/routing_table.hpp"
 #include "ip/util.hpp"   // sameSubnet()
 #include "util/util.hpp"
+#include "util/clock.hpp"
 #include "network_interface.hpp"
 
 #include <algorithm>     // find_if
 #include <bitset>
 #include <iomanip>
+#include <cassert>
+#include <iterator>
+#include <sstream>
 
 
 namespace tns {
 namespace ip {
 
-using std::chrono::steady_clock;
+using tns::util::Clock;
 
 const RoutingTable::Entry*
 RoutingTable::query_(const Ipv4Address &addr, const QueryStrategy &strategy) const
@@ -75,11 +79,35 @@ RoutingTable::findEntry_(const Ipv4Address &addr, in_addr_t maskHost)
 RoutingTable::Entries::iterator
 RoutingTable::findEntryNoLock_(const Ipv4Address &addr, in_addr_t maskHost)
 {
-    return std::find_if(entries_.begin(), entries_.end(),
-        [&addr, maskHost](auto &entry) {
-            return (entry.addr.getAddrHost() & entry.mask) 
-                      == (addr.getAddrHost() & maskHost);
-        });
+    const auto it = indexByPrefix_.find(prefixKey_(addr, maskHost));
+    return it == indexByPrefix_.end() ? entries_.end() : entries_.begin() + it->second;
+}
+
+void RoutingTable::pushEntryNoLock_(Entry entry)
+{
+    [[maybe_unused]] const auto [_, inserted] = 
+        indexByPrefix_.try_emplace(prefixKey_(entry.addr, entry.mask), entries_.size());
+    assert(inserted && "RoutingTable::pushEntryNoLock_(): Duplicate prefix");
+    entries_.push_back(std::move(entry));
+    generation_++;
+    modifications_++;
+}
+
+RoutingTable::Entries::iterator
+RoutingTable::eraseEntryNoLock_(Entries::iterator it)
+{
+    const auto pos = it - entries_.begin();
+    indexByPrefix_.erase(prefixKey_(it->addr, it->mask));
+
+    if (it != std::prev(entries_.end())) {
+        *it = std::move(entries_.back());
+        indexByPrefix_.find(prefixKey_(it->addr, it->mask))->second = static_cast<std::size_t>(pos);
+    }
+    entries_.pop_back();
+    generation_++;
+    modifications_++;
+
+    return entries_.begin() + pos;
 }
 
 
@@ -96,10 +124,88 @@ void RoutingTable::addEntry_(EntryType type, const std::string &cidr,
     } else {
         auto [addr, mask, _] = subnet.value();
         std::unique_lock lock(mutex_);
-        entries_.emplace_back(type, addr, mask, gateway, interfaceIt, metric, steady_clock::now());
+        if (findEntryNoLock_(addr, mask) != entries_.end()) {
+            std::stringstream ss;
+            ss << "RoutingTable::addEntry_(): Route to " << cidr << " already exists, ignored\n";
+            std::cerr << ss.str();
+            return;
+        }
+        pushEntryNoLock_({type, addr, mask, gateway, interfaceIt, metric, Clock::now()});
     }
 }
 
+std::size_t RoutingTable::bulkLoadStaticRoutes_(const std::vector<SnapshotRoute> &routes)
+{
+    const auto now = Clock::now();
+
+    for (std::size_t attempt = 0; attempt < BULK_LOAD_ATTEMPTS; attempt++) {
+        // Copy the current table
+        Entries entries;
+        std::uint64_t modifications;
+        {
+            std::shared_lock lock(mutex_);
+            modifications = modifications_;
+            entries = entries_;
+        }
+
+        // Build the new table and its index without holding the lock
+        PrefixIndex index;
+        index.reserve(entries.size() + routes.size());
+        for (std::size_t i = 0; i < entries.size(); i++)
+            index.try_emplace(prefixKey_(entries[i].addr, entries[i].mask), i);
+        const auto added = mergeStaticRoutes_(entries, index, routes, now);
+
+        // Swap it in, unless the table was written meanwhile (then start over from the new table)
+        {
+            std::unique_lock lock(mutex_);
+            if (modifications_ != modifications)
+                continue;
+            entries_.swap(entries);
+            indexByPrefix_ = std::move(index);
+            generation_++;
+            modifications_++;
+        }
+        return added;  // The old table is freed here, outside the lock
+    }
+
+    // The table keeps being written (e.g. refreshed by RIP): add the routes in place, blocking queries meanwhile
+    std::unique_lock lock(mutex_);
+    const auto added = mergeStaticRoutes_(entries_, indexByPrefix_, routes, now);
+    generation_++;
+    modifications_++;
+    return added;
+}
+
+std::size_t RoutingTable::mergeStaticRoutes_(Entries &entries, PrefixIndex &index,
+                                             const std::vector<SnapshotRoute> &routes, Clock::time_point now) const
+{
+    // The gateway must be a neighbor on one of our subnets, as it is resolved with a single lookup
+    std::vector<std::pair<Ipv4Address, in_addr_t>> localSubnets;
+    for (const auto &entry : entries) {
+        if (entry.type == EntryType::LOCAL)
+            localSubnets.emplace_back(entry.addr, entry.mask);
+    }
+    const auto isOnLink = [&localSubnets](const Ipv4Address &gateway) {
+        return std::any_of(localSubnets.cbegin(), localSubnets.cend(), [&gateway](const auto &subnet) {
+            return util::sameSubnet(gateway, subnet.first, subnet.second);
+        });
+    };
+
+    const auto oldSize = entries.size();
+    entries.reserve(oldSize + routes.size());
+    index.reserve(oldSize + routes.size());
+    for (const auto &route : routes) {
+        const Ipv4Address addr{ tns::util::hton(route.address) };
+        if (!isOnLink(route.gateway))
+            continue;
+        if (!index.try_emplace(prefixKey_(addr, route.mask), entries.size()).second)
+            continue;
+        entries.push_back({EntryType::STATIC, addr, route.mask, route.gateway, node_.interfaces_.end(),
+                           std::nullopt, now});
+    }
+    return entries.size() - oldSize;
+}
+
 void RoutingTable::listEntries_(std::ostream &os) const
 {
     std::shared_lock lock(mutex_);
@@ -124,6 +230,31 @@ void RoutingTable::listEntriesNoLock_(std::ostream &os) const
     }
 }
 
+void RoutingTable::listEntriesJson_(std::ostream &os) const
+{
+    std::shared_lock lock(mutex_);
+
+    os << "[";
+    for (auto it = entries_.begin(); it != entries_.end(); it++) {
+        const Ipv4Address prefix{ tns::util::hton(it->addr.getAddrHost() & it->mask) };
+        os << (it == entries_.begin() ? "" : ",")
+           << "{\"type\":\"" << it->type << "\""
+           << ",\"prefix\":\"" << prefix.toStringAddr() << "/" << util::subnetMaskLength(it->mask) << "\""
+           << ",\"next_hop\":";
+        if (it->gateway)
+            os << "\"" << it->gateway->toStringAddr() << "\"";
+        else
+            os << "null";
+        os << ",\"cost\":";
+        if (it->metric)
+            os << *it->metric;
+        else
+            os << "null";
+        os << "}";
+    }
+    os << "]";
+}
+
 RipMessage RoutingTable::enableLocalRoute_(NetworkInterfaceIter interfaceIt)
 {
     std::unique_lock lock(mutex_);
@@ -138,6 +269,9 @@ RipMessage RoutingTable::enableLocalRouteNoLock_(NetworkInterfaceIter interfaceI
     for (auto it = entries_.begin(); it != entries_.end(); ) {
         if (it->type == EntryType::LOCAL && it->interfaceIt == interfaceIt) {
             // it->metric = 0;
+            it->changed = true;
+            generation_++;
+            modifications_++;
             updatedEntry.emplace_back(0, it->addr.getAddrHost(), it->mask);
             learnedFrom.push_back(it->gateway);  //  nullopt
             break;  // At most one local route per interface
@@ -163,6 +297,9 @@ RipMessage RoutingTable::disableLocalRouteNoLock_(NetworkInterfaceIter interface
     for (auto it = entries_.begin(); it != entries_.end(); ) {
         if (it->type == EntryType::LOCAL && it->interfaceIt == interfaceIt) {
             // it->metric = RipMessage::INFINITY;
+            it->changed = true;
+            generation_++;
+            modifications_++;
             updatedEntry.emplace_back(RipMessage::INFINITY, it->addr.getAddrHost(), it->mask);
             learnedFrom.push_back(it->gateway);  //  nullopt
             break;  // At most one local route per interface
@@ -182,6 +319,8 @@ RipMessage RoutingTable::generateRipEntries_() const
 
     std::shared_lock lock(mutex_);
     for (const auto &entry : entries_) {
+        if (entry.provisional || !entry.metric)
+            continue;  // Static routes have no metric and are not advertised
         ripEntries.emplace_back(
             entry.metric.value(),        // metric
             entry.addr.getAddrHost(),  // addr
@@ -193,15 +332,43 @@ RipMessage RoutingTable::generateRipEntries_() const
     return RipMessage::makeResponse(std::move(ripEntries), std::move(learnedFrom));
 }
 
+RipMessage RoutingTable::generatePeriodicRipEntries_(bool full)
+{
+    RipMessage::Entries ripEntries;
+    RipMessage::OptionalAddresses learnedFrom;
+
+    std::unique_lock lock(mutex_);
+    for (auto &entry : entries_) {
+        if (entry.provisional)
+            continue;  // Keep its changed flag: it is advertised once confirmed
+        if (!entry.metric)
+            continue;  // Static route
+        if (full || entry.changed) {
+            ripEntries.emplace_back(entry.metric.value(), entry.addr.getAddrHost(), entry.mask);
+            learnedFrom.push_back(entry.gateway);
+        }
+        if (entry.changed) {
+            entry.changed = false;
+            modifications_++;
+        }
+    }
+
+    return RipMessage::makeResponse(std::move(ripEntries), std::move(learnedFrom));
+}
+
 // This is called when a router node receives a RIP response
-RipMessage RoutingTable::handleRipEntries_(const RipMessage::Entries &ripEntries, 
+RipMessage RoutingTable::handleRipEntries_(const RipMessageView &ripMessage, 
                                            const Ipv4Address &learnedFrom)
 {
     RipMessage::Entries updatedEntries;
     RipMessage::OptionalAddresses learnedFroms;
 
     std::unique_lock lock(mutex_);
-    for (const auto &ripEntry : ripEntries) {
+    modifications_++;  // Refreshes entries even when nothing is advertised
+    for (auto ripEntry : ripMessage) {
+        // One more hop to reach the subnet through the neighbor
+        ripEntry.cost = std::min(ripEntry.cost, RipMessage::INFINITY - 1) + 1;
+
         // Find an existing entry with the same subnet
         Ipv4Address ripEntryAddr{ tns::util::hton(ripEntry.address) };
         auto it = findEntryNoLock_(ripEntryAddr, ripEntry.mask);  // Mutex already locked by handleRipEntries_()
@@ -211,22 +378,35 @@ RipMessage RoutingTable::handleRipEntries_(const RipMessage::Entries &ripEntries
             if (it->type == EntryType::LOCAL)
                 continue;
 
+            // A preloaded route takes the first word from the network for its prefix:
+            // confirmed (same gateway), moved (other gateway) or withdrawn (gateway poisons it)
+            if (it->provisional) {
+                if (ripEntry.cost >= RipMessage::INFINITY && it->gateway != learnedFrom)
+                    continue;
+                it->provisional = false;
+                it->lastRefresh = Clock::now();
+                it->metric = ripEntry.cost;
+                it->gateway = learnedFrom;
+                it->changed = true;
+            }
             // Update the existing entry if the new metric is smaller, or,
             // if the new metric is greater but the entry is learned from the same neighbor
-            if (ripEntry.cost < it->metric) {
-                it->lastRefresh = steady_clock::now();
+            else if (ripEntry.cost < it->metric) {
+                it->lastRefresh = Clock::now();
                 it->metric = ripEntry.cost;
                 it->gateway = learnedFrom;
+                it->changed = true;
                 std::cout << "existing entry, update to smaller metric\n";
             }
             else if (it->gateway == learnedFrom) {
                 // Refresh the entry regardless of the metric
-                it->lastRefresh = steady_clock::now();
+                it->lastRefresh = Clock::now();
                 // If same cost, don't send triggered update
                 if (ripEntry.cost == it->metric)
                     continue;
                 // Update to greater metric
                 it->metric = ripEntry.cost;
+                it->changed = true;
                 std::cout << "existing entry, update to greater metric\n";
             }
             else {
@@ -235,14 +415,15 @@ RipMessage RoutingTable::handleRipEntries_(const RipMessage::Entries &ripEntries
         }
         else if (ripEntry.cost < RipMessage::INFINITY) {
             std::cout << "new non-poison entry\n";
-            entries_.emplace_back(EntryType::RIP, ripEntryAddr, ripEntry.mask, learnedFrom, 
-                                  node_.interfaces_.end(), ripEntry.cost, steady_clock::now());
+            pushEntryNoLock_({EntryType::RIP, ripEntryAddr, ripEntry.mask, learnedFrom, 
+                              node_.interfaces_.end(), ripEntry.cost, Clock::now()});
         }
         else {
             continue;
         }
 
         // Collect triggered update
+        generation_++;
         updatedEntries.emplace_back(ripEntry.cost, ripEntry.address, ripEntry.mask);
         learnedFroms.push_back(learnedFrom);
     }
@@ -250,5 +431,75 @@ RipMessage RoutingTable::handleRipEntries_(const RipMessage::Entries &ripEntries
     return RipMessage::makeResponse(std::move(updatedEntries), std::move(learnedFroms));
 }
 
+/*********************** Snapshots ***********************/
+std::vector<SnapshotRoute> RoutingTable::snapshotRipRoutes_() const
+{
+    std::vector<SnapshotRoute> routes;
+
+    std::shared_lock lock(mutex_);
+    for (const auto &entry : entries_) {
+        if (entry.type != EntryType::RIP || entry.provisional || !entry.gateway ||
+            entry.metric >= RipMessage::INFINITY)
+            continue;
+        routes.push_back({entry.addr.getAddrHost(), entry.mask, *entry.gateway,
+                          static_cast<std::uint32_t>(entry.metric.value())});
+    }
+    return routes;
+}
+
+std::size_t RoutingTable::loadProvisionalRoutes_(const std::vector<SnapshotRoute> &routes)
+{
+    std::size_t loaded = 0;
+    const auto now = Clock::now();
+
+    std::unique_lock lock(mutex_);
+    for (const auto &route : routes) {
+        const Ipv4Address addr{ tns::util::hton(route.address) };
+        if (route.metric >= RipMessage::INFINITY || findEntryNoLock_(addr, route.mask) != entries_.end())
+            continue;
+
+        // The gateway must still be a neighbor on one of our subnets
+        const auto *viaEntry = queryLongestPrefixMatchNoLock_(route.gateway);
+        if (!viaEntry || viaEntry->type != EntryType::LOCAL)
+            continue;
+
+        Entry entry{EntryType::RIP, addr, route.mask, route.gateway, node_.interfaces_.end(), route.metric, now};
+        entry.provisional = true;
+        pushEntryNoLock_(std::move(entry));
+        loaded++;
+    }
+    return loaded;
+}
+
+/******************** Link-State Related ********************/
+void RoutingTable::applyLinkStateRoutes_(const std::vector<LinkStateRouting::InstalledRoute> &routes)
+{
+    std::unique_lock lock(mutex_);
+    for (const auto &route : routes) {
+        const Ipv4Address addr{ tns::util::hton(route.prefix.address) };
+        auto it = findEntryNoLock_(addr, route.prefix.mask);
+
+        if (it != entries_.end() && it->type != EntryType::LINK_STATE)
+            continue;
+
+        if (!route.gateway) {
+            if (it != entries_.end())
+                eraseEntryNoLock_(it);
+        }
+        else if (it == entries_.end()) {
+            pushEntryNoLock_({EntryType::LINK_STATE, addr, route.prefix.mask, route.gateway,
+                              node_.interfaces_.end(), route.metric, Clock::now()});
+        }
+        else if (it->gateway != route.gateway || it->metric != route.metric) {
+            it->gateway = route.gateway;
+            it->metric = route.metric;
+            it->lastRefresh = Clock::now();
+            it->changed = true;
+            generation_++;
+            modifications_++;
+        }
+    }
+}
+
 } // namespace ip
 } // namespace tns
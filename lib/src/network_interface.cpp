@@ -1,6 +1,8 @@
 #include "network_interface.hpp"
 #include "ip/datagram.hpp"
 #include "ip/util.hpp"
+#include "sim/memory_link.hpp"
+#include "sim/impairment.hpp"
 #include "src/util/util.hpp"
 #include "util/util.hpp"
 
@@ -20,8 +22,10 @@ NetworkInterface::NetworkInterface(NodeDatagramSubmitter submitter,
                                    const std::vector<std::string> &neighborIpAddrs,
                                    const std::vector<in_port_t> &neighborUdpPorts,  // host byte order
                                    const std::vector<std::string> &neighborUdpAddrs,
+                                   const std::string &udpAddr,
                                    in_port_t udpPort,  // host byte order
-                                   std::string name)
+                                   std::string name,
+                                   const sim::MemoryFabric *fabric)
     : name_(std::move(name))
 {
     {
@@ -72,16 +76,33 @@ NetworkInterface::NetworkInterface(NodeDatagramSubmitter submitter,
         }
     );
 
-    // Create udp_sock_ for receiving datagrams
-    if ((udp_sock_ = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
-        throw std::system_error(errno, std::generic_category(), 
-            "NetworkInterface::NetworkInterface(): socket()");
+    if (fabric) {
+        // Simulated link: receive from our port in the fabric and send straight to the neighbors' ports
+        if (inet_aton(udpAddr.c_str(), &addr.sin_addr) == 0)
+            throw std::system_error(errno, std::generic_category(), 
+                "NetworkInterface::NetworkInterface(): inet_aton()");
+        addr.sin_port = util::hton(udpPort);
+        if ((memoryPort_ = fabric->find(addr)) == nullptr) {
+            std::stringstream ss;
+            ss << "NetworkInterface::NetworkInterface(): No memory port for " << udpAddr << ":" << udpPort;
+            throw std::runtime_error(ss.str());
+        }
+        for (auto &neighbor : neighborInterfaces_)
+            neighbor.memoryPort_ = fabric->find(neighbor.udpSockAddr_);
+    } else {
+        // Create udp_sock_ for receiving datagrams
+        if ((udp_sock_ = socket(AF_INET, SOCK_DGRAM, 0)) == -1)
+            throw std::system_error(errno, std::generic_category(), 
+                "NetworkInterface::NetworkInterface(): socket()");
 
-    // Bind the socket to localhost:udpPort
-    addr.sin_port = util::hton(udpPort);
-    if (bind(udp_sock_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1)
-        throw std::system_error(errno, std::generic_category(), 
-            "NetworkInterface::NetworkInterface(): bind()");
+        // Bind the socket to localhost:udpPort
+        addr.sin_port = util::hton(udpPort);
+        if (bind(udp_sock_, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == -1)
+            throw std::system_error(errno, std::generic_category(), 
+                "NetworkInterface::NetworkInterface(): bind()");
+    }
+
+    impairment_ = makeImpairment_();
 
     // Set up datagram submitter to submit datagrams to the network node
     datagramSubmitter_ = [addr = this->ipAddress_, s = std::move(submitter)](DatagramPtr d) {
@@ -91,6 +112,9 @@ NetworkInterface::NetworkInterface(NodeDatagramSubmitter submitter,
 
 NetworkInterface::~NetworkInterface() noexcept
 {
+    // Stop sending delayed datagrams first
+    impairment_.reset();
+
     // Close read socket
     if (udp_sock_ != -1) {
         std::cout << "\tNetworkInterface::~NetworkInterface(): Shutting down read socket " << udp_sock_ << "\n";
@@ -99,6 +123,10 @@ NetworkInterface::~NetworkInterface() noexcept
         std::cout << "\tNetworkInterface::~NetworkInterface(): Read socket successfully shut down\n";
     }
 
+    // Or close the memory port, which wakes up recvThread_ the same way
+    if (memoryPort_)
+        memoryPort_->close();
+
     // Join recvThread_
     if (recvThread_.joinable()) {
         std::cout << "\tNetworkInterface::~NetworkInterface(): Joining recvThread_ ...\n";
@@ -117,11 +145,18 @@ NetworkInterface::NetworkInterface(NetworkInterface&& other) noexcept :
     subnetMaskLength_(other.subnetMaskLength_),
     neighborInterfaces_(std::move(other.neighborInterfaces_)),
     udp_sock_(std::exchange(other.udp_sock_, -1)),
+    memoryPort_(std::exchange(other.memoryPort_, nullptr)),
     recvThread_(std::move(other.recvThread_)),
     name_(std::move(other.name_)),
     isUp_(other.isUp_),
     datagramSubmitter_(other.datagramSubmitter_)
 {
+    // The impairment's transmit function is bound to `other`. Interfaces only move while the node is
+    // being built, before anything is sent, so a fresh one loses nothing.
+    if (other.impairment_)
+        impairment_ = makeImpairment_();
+    other.impairment_.reset();
+
     // other.name_ = "[MOVED]";
 }
 
@@ -130,6 +165,15 @@ bool NetworkInterface::operator!=(const ip::Ipv4Address& addr) const { return ip
 
 void NetworkInterface::startListening()
 {
+    if (memoryPort_ && memoryPort_->isScheduled()) {
+        memoryPort_->setReceiver([this](DatagramPtr datagram) {
+            auto aged = ageOnLink_(std::move(datagram));
+            if (aged && isOn())
+                datagramSubmitter_(std::move(aged.value()));
+        });
+        return;
+    }
+
     recvThread_ = std::thread([this]{
         try {
             while (true)
@@ -140,11 +184,22 @@ void NetworkInterface::startListening()
     });
 }
 
+void NetworkInterface::stopListening()
+{
+    if (memoryPort_)
+        memoryPort_->close();
+    else if (udp_sock_ != -1 && shutdown(udp_sock_, SHUT_RD) == -1 && errno != ENOTCONN)  // Unconnected UDP: still wakes recv()
+        std::cerr << "\tNetworkInterface::stopListening(): shutdown() failed: " << strerror(errno) << "\n";
+
+    if (recvThread_.joinable())
+        recvThread_.join();
+}
+
 // Receive a single datagram from udp_sock_ and submit it to the network node
 void NetworkInterface::recvDatagram() const
 {
-    // Receive a datagram from udp_sock_
-    auto datagram = ip::Datagram::recvDatagram(udp_sock_);
+    // Receive a datagram from udp_sock_ (or the memory port of a simulated link)
+    auto datagram = memoryPort_ ? recvFromMemoryPort_() : ip::Datagram::recvDatagram(udp_sock_);
 
     if (!datagram) {
         std::cerr << "\tNetworkInterface::recvDatagram(): Datagram::recvDatagram() failed: " 
@@ -154,6 +209,23 @@ void NetworkInterface::recvDatagram() const
     }
 }
 
+tl::expected<DatagramPtr, std::string> NetworkInterface::recvFromMemoryPort_() const
+{
+    auto datagram = memoryPort_->pop();
+    if (!datagram)
+        throw std::runtime_error("Memory port closed");
+    return ageOnLink_(std::move(datagram));
+}
+
+tl::expected<DatagramPtr, std::string> NetworkInterface::ageOnLink_(DatagramPtr datagram)
+{
+    if (datagram->ipHeader_.ttl-- == 0) {
+        std::cerr << "NetworkInterface::ageOnLink_(): TTL expired\n";
+        return tl::unexpected("TTL expired");
+    }
+    return datagram;
+}
+
 /**
  * This method is called when a datagram is presented to this interface from 
  * the router node, i.e., the router will call interface.sendDatagram(datagram).
@@ -163,6 +235,27 @@ void NetworkInterface::sendDatagram(const ip::Datagram &datagram, const ip::Ipv4
 {
     if (isOff()) return;
 
+    if (impairment_ && impairment_->isActive()) {
+        // The impairment may hold the datagram back, so it gets a copy
+        impairment_->send(std::make_unique<ip::Datagram>(datagram.ipHeader_, std::make_unique<Payload>(*datagram.payload_)),
+                          nextHopAddr);
+        return;
+    }
+    transmit_(datagram, nextHopAddr);
+}
+
+void NetworkInterface::setImpairment(const sim::Impairment &impairment) { impairment_->configure(impairment); }
+
+std::unique_ptr<sim::LinkImpairment> NetworkInterface::makeImpairment_()
+{
+    return std::make_unique<sim::LinkImpairment>([this](const ip::Datagram &datagram, const ip::Ipv4Address &nextHopAddr) {
+        if (isOn())  // The link may have gone down while the datagram was held back
+            transmit_(datagram, nextHopAddr);
+    });
+}
+
+void NetworkInterface::transmit_(const ip::Datagram &datagram, const ip::Ipv4Address &nextHopAddr) const
+{
     // Find the next-hop interface on the same link
     auto nextHopInterface = findNextHopInterface(nextHopAddr);
     if (nextHopInterface == neighborInterfaces_.cend()) {
@@ -170,6 +263,12 @@ void NetworkInterface::sendDatagram(const ip::Datagram &datagram, const ip::Ipv4
         ss << "\tNetworkInterface::sendDatagram(): No next-hop interface " 
            << nextHopAddr.toStringAddr() << " found in neighbors\n";
         std::cerr << ss.str();
+    } else if (memoryPort_) {
+        // Simulated link: hand a copy to the neighbor's port (dropped, like UDP, if nobody is there)
+        if (nextHopInterface->memoryPort_) {
+            nextHopInterface->memoryPort_->push(
+                std::make_unique<ip::Datagram>(datagram.ipHeader_, std::make_unique<Payload>(*datagram.payload_)));
+        }
     } else {
         // Emulate the link layer with UDP communication
         // Send the IP header and payload in a single sendmsg() call
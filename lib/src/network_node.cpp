@@ -10,7 +10,10 @@
 #include "ip/util.hpp"                       // parseCidr()
 #include "ip/datagram.hpp"
 #include "ip/protocols.hpp"
+#include "ip/route_file.hpp"
 #include "network_interface.hpp"
+#include "sim/impairment.hpp"
+#include "util/clock.hpp"
 #include "src/util/thread_pool.hpp"
 #include "src/util/lnx_parser/parse_lnx.hpp"
 
@@ -24,6 +27,7 @@ NetworkNode::NetworkNode(const std::string_view lnxFile)
 {
     std::cout << "NetworkNode::NetworkNode(): Constructing ...\n";
     initialize_( util::lnx::parseLnx(lnxFile.data()) );
+    startReceiving_();
     std::cout << "NetworkNode::NetworkNode(): DONE\n";
 }
 
@@ -72,6 +76,15 @@ void NetworkNode::disableInterface(const std::string &name)
     }
 }
 
+tl::expected<void, std::string> NetworkNode::setImpairment(const std::string &interfaceName, const sim::Impairment &impairment)
+{
+    const auto iface = findInterface_(interfaceName);
+    if (iface == interfaces_.end())
+        return tl::unexpected("Interface named " + interfaceName + " not found");
+    iface->setImpairment(impairment);
+    return {};
+}
+
 void NetworkNode::listInterfaces(std::ostream &os) const
 {
     using namespace std;
@@ -89,6 +102,28 @@ void NetworkNode::listInterfaces(std::ostream &os) const
     }
 }
 
+void NetworkNode::listImpairments(std::ostream &os) const
+{
+    using namespace std;
+    os << setw(10) << left  << "Name"    << " "
+       << setw(10) << right << "Passed"  << " "
+       << setw(10) << right << "Dropped" << " "
+       << setw(10) << right << "Dup"     << " "
+       << setw(10) << right << "Reorder" << " "
+       << setw(10) << right << "OverLim" << "  Settings\n";
+
+    for (const auto &iface : interfaces_) {
+        const auto &impairment = iface.getImpairment();
+        const auto &stats = impairment.getStats();
+        os << setw(10) << left  << iface.name_ << " "
+           << setw(10) << right << stats.passed << " "
+           << setw(10) << right << stats.dropped << " "
+           << setw(10) << right << stats.duplicated << " "
+           << setw(10) << right << stats.reordered << " "
+           << setw(10) << right << stats.overLimit << "  " << impairment.getConfig() << "\n";
+    }
+}
+
 void NetworkNode::listNeighbors(std::ostream &os) const
 {
     using namespace std;
@@ -115,10 +150,26 @@ void NetworkNode::listRoutes(std::ostream &os) const
     routingTable_->listEntries_(os);
 }
 
+tl::expected<std::size_t, std::string> NetworkNode::loadStaticRoutes(const std::string &routeFile)
+{
+    const auto routes = ip::loadRouteFile(routeFile);
+    if (!routes)
+        return tl::unexpected(routes.error());
+
+    const auto added = routingTable_->bulkLoadStaticRoutes_(*routes);
+    if (added < routes->size()) {
+        std::stringstream ss;
+        ss << "NetworkNode::loadStaticRoutes(): Skipped " << routes->size() - added
+           << " routes to prefixes already in the table or through gateways off the local subnets\n";
+        std::cerr << ss.str();
+    }
+    return added;
+}
+
 void NetworkNode::registerRecvHandler(ip::Protocol protocol, DatagramHandler handler)
 {
-    if (protocol == ip::Protocol::RIP) {
-        std::cerr << "NetworkNode::registerRecvHandler(): ERROR: Cannot register handler for RIP protocol (200)\n";
+    if (protocol == ip::Protocol::RIP || protocol == ip::Protocol::LINK_STATE) {
+        std::cerr << "NetworkNode::registerRecvHandler(): ERROR: Cannot register handler for routing protocols (200, 201)\n";
         return;
     }
     protocolHandlers_[protocol] = handler;
@@ -128,10 +179,11 @@ void NetworkNode::registerRecvHandler(ip::Protocol protocol, DatagramHandler han
 /***** Protected & Private *****/
 
 // Initialize the network node with the given parsed nodeData returned by util::lnx::parseLnx().
-void NetworkNode::initialize_(const util::lnx::NetworkNodeData &nodeData)
+void NetworkNode::initialize_(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric)
 {
-    // Create thread pool
-    threadPool_ = std::make_unique<util::threading::ThreadPool>(8);
+    // Create thread pool, unless a scheduler runs everything in virtual time
+    if (!util::Clock::scheduler())
+        threadPool_ = std::make_unique<util::threading::ThreadPool>(8);
 
     // Create routing table
     routingTable_ = RoutingTable::makeRoutingTable(*this);
@@ -147,11 +199,11 @@ void NetworkNode::initialize_(const util::lnx::NetworkNodeData &nodeData)
                 submitDatagram_(std::move(datagram), infaceAddr);
             },
             ifaceData.cidr, ifaceData.ip_addrs, ifaceData.udp_ports,
-            ifaceData.udp_addrs, ifaceData.udp_port, ifaceData.name
+            ifaceData.udp_addrs, ifaceData.udp_addr, ifaceData.udp_port, ifaceData.name,
+            fabric
         };
 
         interfaces_.emplace_back(std::move(iface));
-        ifaceIt->startListening();  // Start listening on the interface
 
         // Add interface address
         if ((interfacesByAddr_.emplace(ifaceIt->ipAddress_, ifaceIt)).second == false) {
@@ -177,6 +229,19 @@ void NetworkNode::initialize_(const util::lnx::NetworkNodeData &nodeData)
     protocolHandlers_[ip::Protocol::TEST] = ip::testProtocolHandler;
 }
 
+void NetworkNode::startReceiving_()
+{
+    for (auto &iface : interfaces_)
+        iface.startListening();
+}
+
+void NetworkNode::stopReceiving_()
+{
+    for (auto &iface : interfaces_)
+        iface.stopListening();
+    threadPool_.reset();  // Joins the workers
+}
+
 void NetworkNode::invokeProtocolHandler_(DatagramPtr datagram) const
 {
     const auto &protocol = datagram->getProtocol();
@@ -272,6 +337,11 @@ NetworkNode::queryRoutingTable_(const Ipv4Address &destIP, const RoutingTable::Q
 
 void NetworkNode::submitDatagram_(DatagramPtr datagram, const ip::Ipv4Address &infaceAddr) const
 {
+    if (!threadPool_) {
+        datagramHandler_(std::move(datagram), infaceAddr);
+        return;
+    }
+
     std::packaged_task<void()> task{
         [this, d = std::move(datagram), &infaceAddr]() mutable {
             datagramHandler_(std::move(d), infaceAddr);
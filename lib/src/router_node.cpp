@@ -2,15 +2,17 @@
 
 #include "ip/datagram.hpp"
 #include "ip/rip_message.hpp"
+#include "ip/route_snapshot.hpp"
 #include "network_interface.hpp"
 #include "util/util.hpp"
-#include "util/periodic_thread.hpp"
+#include "util/timer_wheel.hpp"
 
 #include "src/util/lnx_parser/parse_lnx.hpp"
 #include "src/util/util.hpp"
 
 #include <sstream>
 #include <iostream>
+#include <iomanip>
 
 
 namespace tns {
@@ -22,17 +24,25 @@ using ip::Datagram, ip::Ipv4Address, ip::RipMessage;
  * @param lnxFile The path to a .lnx file that describes the router config.
  */
 RouterNode::RouterNode(const std::string_view lnxFile)
+    : RouterNode(util::lnx::parseLnx(lnxFile.data()), nullptr) {}
+
+RouterNode::RouterNode(const util::lnx::NetworkNodeData &nodeData, const sim::MemoryFabric *fabric)
 {
-    // Parse lnx file and initialize base fields
-    const auto nodeData = util::lnx::parseLnx(lnxFile.data());
-    NetworkNode::initialize_(nodeData);
+    // Initialize base fields
+    NetworkNode::initialize_(nodeData, fabric);
 
     // Record router's ripNeighbors_
     for (const auto &ripNeighbor : nodeData.ripNeighbors)
         ripNeighbors_.emplace_back(ripNeighbor);
 
-    // Register RIP handler and start RIP threads
-    initializeRip_();
+    // Register the routing protocol handler and arm its timers
+    if (nodeData.routingMode == ROUTING_MODE_LINK_STATE)
+        initializeLinkState_();
+    else
+        initializeRip_();
+
+    // Fully set up: start taking datagrams off the interfaces
+    startReceiving_();
 
     std::stringstream ss;
     ss << "/********* RouterNode created with " << interfaces_.size() << " interfaces. *********/\n";
@@ -41,7 +51,15 @@ RouterNode::RouterNode(const std::string_view lnxFile)
 
 RouterNode::RouterNode() = default;
 RouterNode::RouterNode(const std::string &lnxFile) : RouterNode(std::string_view(lnxFile)) {}
-RouterNode::~RouterNode() { std::cout << "RouterNode::~RouterNode() : DONE!\n"; }
+RouterNode::~RouterNode()
+{
+    stopReceiving_();
+    if (snapshotTimer_) {
+        snapshotTimer_->stop();
+        saveRouteSnapshot_();  // Latest routes for the next start
+    }
+    std::cout << "RouterNode::~RouterNode() : DONE!\n";
+}
 
 
 void RouterNode::enableInterface(const std::string &name)
@@ -52,6 +70,11 @@ void RouterNode::enableInterface(const std::string &name)
         ss << "RouterNode::enableInterface(): Interface named " << name << " not found\n";
         std::cerr << ss.str();
     }
+    else if (iface->isOff() && linkState_) {
+        iface->turnOn();
+        routingTable_->enableLocalRoute_(iface);
+        linkState_->onInterfaceChange();  // Originate and flood a new LSA
+    }
     else if (iface->isOff()) {
         /**
          * NOTE: MIND THE ORDER of the following two blocks of code:
@@ -73,6 +96,11 @@ void RouterNode::disableInterface(const std::string &name)
         ss << "RouterNode::disableInterface(): Interface named " << name << " not found\n";
         std::cerr << ss.str();
     }
+    else if (iface->isOn() && linkState_) {
+        iface->turnOff();
+        routingTable_->disableLocalRoute_(iface);
+        linkState_->onInterfaceChange();  // Drop neighbors behind it, originate and flood a new LSA
+    }
     else if (iface->isOn()) {
         /**
          * NOTE: MIND THE ORDER of the following two blocks of code:
@@ -125,46 +153,132 @@ void RouterNode::forwardDatagram_(const Datagram &datagram) const
 
 void RouterNode::initializeRip_()
 {
-    using util::threading::PeriodicThread;
+    using util::PeriodicTimer;
 
     // Register RIP callback
     protocolHandlers_[ip::Protocol::RIP] = 
         [this](DatagramPtr datagram) {ripProtocolHandler_(std::move(datagram));};
 
-    // Spin up the RIP thread to periodically send RIP packets
-    ripThread_ = std::make_unique<PeriodicThread>(RIP_INTERVAL, [this]() {
-        auto ripResponse = routingTable_->generateRipEntries_();
-        if (!ripResponse.getEntries().empty()) {
-            // auto ripResponse = RipMessage::makeResponse(std::move(ripEntries));
-            broadcastRipMessage_(ripResponse);  // Broadcast rip response to rip neighbors
+    // Arm the RIP timer to periodically send RIP packets.
+    // Only every RIP_FULL_REFRESH_ROUNDS-th round carries the whole table, the others carry changed routes only.
+    ripTimer_ = std::make_unique<PeriodicTimer>(timerWheel_, RIP_INTERVAL, [this]() {
+        const bool full = ripRound_++ % RIP_FULL_REFRESH_ROUNDS == 0;
+        (full ? ripStats_.periodicFull : ripStats_.periodicIncremental)++;
+
+        // Nothing was advertised differently since the last full update: resend its encoding as is
+        if (full && fullTableEncoding_ && fullTableGeneration_ == routingTable_->getGeneration_()) {
+            ripStats_.encodingsReused++;
+            broadcastRipEncoding_(*fullTableEncoding_);
+            return;
+        }
+
+        const auto generation = routingTable_->getGeneration_();  // Read before the table, so a racing change invalidates the cache
+        auto ripResponse = routingTable_->generatePeriodicRipEntries_(full);
+        if (ripResponse.getEntries().empty())
+            return;
+
+        ip::RipEncoding encoding{ripResponse};
+        broadcastRipEncoding_(encoding);  // Broadcast rip response to rip neighbors
+        if (full) {
+            fullTableEncoding_ = std::move(encoding);
+            fullTableGeneration_ = generation;
         }
     });
 
-    // Spin up the RIP cleaner thread to periodically check and remove expired RIP routes
-    ripCleanerThread_ = std::make_unique<PeriodicThread>(RIP_INTERVAL, [this]() {
-        auto ripResponse = routingTable_->removeStaleRipEntries_(RIP_EXPIRATION_TIME);
+    // Arm the timer that sends queued route changes as a triggered update once per damping window
+    ripTriggerTimer_ = std::make_unique<PeriodicTimer>(timerWheel_, RIP_TRIGGER_DAMPING, [this]() {
+        flushTriggeredUpdate_();
+    });
+
+    // Arm the RIP cleaner timer to periodically check and remove expired RIP routes
+    ripCleanerTimer_ = std::make_unique<PeriodicTimer>(timerWheel_, RIP_INTERVAL, [this]() {
+        auto ripResponse = routingTable_->removeStaleRipEntries_(RIP_EXPIRATION_TIME, RIP_PROVISIONAL_TIME);
         if (!ripResponse.getEntries().empty()) {
             // auto ripResponse = RipMessage::makeResponse(std::move(expiredRipEntries));
-            std::cout << "Sending triggered RIP response due to EXPIRED entries\n";
-            broadcastRipMessage_(ripResponse);  // Send triggered response due to expired routes
+            std::cout << "Queueing triggered RIP response due to EXPIRED entries\n";
+            queueTriggeredUpdate_(ripResponse);  // Send triggered response due to expired routes
         }
     });
 
     // Broadcast RIP request to neighbors
-    std::thread([this]() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    ripRequestTimer_ = std::make_unique<util::Timer>(timerWheel_, [this]() {
         broadcastRipMessage_( RipMessage::makeRequest() );
-    }).detach();
+    });
+    ripRequestTimer_->arm(std::chrono::milliseconds(200));
+}
+
+void RouterNode::initializeLinkState_()
+{
+    using util::PeriodicTimer;
+
+    if (interfaces_.empty())
+        throw std::runtime_error("RouterNode::initializeLinkState_(): A link-state router needs an interface");
+
+    ip::LinkStateRouting::Callbacks callbacks{
+        .send = [this](const Ipv4Address &dest, PayloadPtr payload) {
+            try {
+                sendIp_(dest, std::move(payload), ip::Protocol::LINK_STATE);
+            } catch (const std::exception &e) {
+                std::cerr << "RouterNode::initializeLinkState_(): " << e.what() << "\n";
+            }
+        },
+        .installRoutes = [this](const std::vector<ip::LinkStateRouting::InstalledRoute> &routes) {
+            routingTable_->applyLinkStateRoutes_(routes);
+        },
+        .localPrefixes = [this]() { return upLocalPrefixes_(); },
+    };
+    linkState_ = std::make_unique<ip::LinkStateRouting>(
+        interfaces_.front().ipAddress_.getAddrHost(), ripNeighbors_, std::move(callbacks)
+    );
+
+    // Register link-state callback
+    protocolHandlers_[ip::Protocol::LINK_STATE] = [this](DatagramPtr datagram) {
+        linkState_->handleMessage(datagram->getPayloadView(), datagram->getSrcAddr());
+    };
+
+    // Hellos, neighbor and LSA aging
+    linkStateTimer_ = std::make_unique<PeriodicTimer>(timerWheel_, ip::LinkStateRouting::HELLO_INTERVAL, [this]() {
+        linkState_->tick();
+    });
+}
+
+std::vector<ip::LsaPrefix> RouterNode::upLocalPrefixes_() const
+{
+    std::vector<ip::LsaPrefix> prefixes;
+    for (const auto &iface : interfaces_) {
+        if (iface.isOn())
+            prefixes.push_back({iface.ipAddress_.getAddrHost() & iface.subnetMask_, iface.subnetMask_});
+    }
+    return prefixes;
+}
+
+void RouterNode::listLinkState(std::ostream &os) const
+{
+    if (linkState_)
+        linkState_->listDatabase(os);
+    else
+        os << "Link-state routing is not enabled on this router (routing rip)\n";
 }
 
 void RouterNode::ripProtocolHandler_(DatagramPtr datagram)
 {
     // std::cout << "RouterNode::ripProtocolHandler_(): Received RIP packet!\n";
 
-    // Incoming RIP packet
-    const RipMessage ripMessage{ datagram->getPayloadView() };
+    // Incoming RIP packet, decoded in place
+    const auto ripMessageMaybe = ip::RipMessageView::parse(datagram->getPayloadView());
+    if (!ripMessageMaybe) {
+        ripStats_.malformedRecv++;
+        std::stringstream ss;
+        ss << "RouterNode::ripProtocolHandler_(): Discarding RIP packet: " << ripMessageMaybe.error() << "\n";
+        std::cerr << ss.str();
+        return;
+    }
+    const auto &ripMessage = *ripMessageMaybe;
     const auto &srcAddr = datagram->getSrcAddr();
 
+    ripStats_.messagesRecv++;
+    ripStats_.entriesRecv += ripMessage.getNumEntries();
+
     switch (ripMessage.getCommand()) {
     case RipMessage::Command::REQUEST : {
         const auto ripResponse = routingTable_->generateRipEntries_();
@@ -178,11 +292,11 @@ void RouterNode::ripProtocolHandler_(DatagramPtr datagram)
     case RipMessage::Command::RESPONSE : {
         // Learn new routes, and send triggered response to neighbors if necessary
         const auto ripResponse = 
-            routingTable_->handleRipEntries_(ripMessage.getEntries(), srcAddr);
+            routingTable_->handleRipEntries_(ripMessage, srcAddr);
         if (!ripResponse.getEntries().empty()) {
-            // Send triggered response of updatedEntries to ripNeighbors_
-            std::cout << "Sending triggered RIP response due to UPDATED entries\n";
-            broadcastRipMessage_(ripResponse);
+            // Send triggered response of updatedEntries to ripNeighbors_, batched with other changes
+            std::cout << "Queueing triggered RIP response due to UPDATED entries\n";
+            queueTriggeredUpdate_(ripResponse);
         }
         break;
     }
@@ -195,46 +309,157 @@ void RouterNode::ripProtocolHandler_(DatagramPtr datagram)
     }
 }
 
-void RouterNode::broadcastRipMessage_(const RipMessage &ripMessage) const
+void RouterNode::queueTriggeredUpdate_(const RipMessage &ripMessage)
 {
-    // MAYBE: Use worker threads with synchronization on ripMessage
-    for (const auto &neighbor : ripNeighbors_) {
-        // std::cout << "RouterNode::RouterNode(): Sending RIP packets to neighbor " << neighbor << "\n";
-        sendRipMessage_(ripMessage, neighbor);
+    std::lock_guard lock(pendingRoutesMutex_);
+
+    auto entryIt = ripMessage.getEntries().cbegin();
+    auto learnedFromIt = ripMessage.getLearnedFrom().cbegin();
+    for (; entryIt != ripMessage.getEntries().end(); entryIt++, learnedFromIt++) {
+        const auto [_, inserted] = pendingRoutes_.insert_or_assign(
+            {entryIt->address, entryIt->mask}, PendingRoute{*entryIt, *learnedFromIt}
+        );
+        ripStats_.routesTriggered++;
+        if (!inserted)
+            ripStats_.routesCoalesced++;
     }
 }
 
-void RouterNode::sendRipMessage_(const RipMessage &ripMessage, const Ipv4Address &destIP) const
+void RouterNode::flushTriggeredUpdate_()
+{
+    decltype(pendingRoutes_) pending;
+    {
+        std::lock_guard lock(pendingRoutesMutex_);
+        if (pendingRoutes_.empty())
+            return;
+        pending.swap(pendingRoutes_);
+    }
+
+    RipMessage::Entries entries;
+    RipMessage::OptionalAddresses learnedFrom;
+    entries.reserve(pending.size());
+    learnedFrom.reserve(pending.size());
+    for (auto &[_, route] : pending) {
+        entries.push_back(route.entry);
+        learnedFrom.push_back(route.learnedFrom);
+    }
+
+    ripStats_.triggeredUpdates++;
+    broadcastRipMessage_(RipMessage::makeResponse(std::move(entries), std::move(learnedFrom)));
+}
+
+void RouterNode::enableRouteSnapshots(const std::string &path)
 {
-    PayloadPtr payload = std::make_unique<Payload>(ripMessage.payloadSize());
+    using util::PeriodicTimer;
+
+    snapshotPath_ = path;
+
+    if (linkState_) {
+        std::cerr << "RouterNode::enableRouteSnapshots(): Warm start only applies to RIP routes, "
+                     "snapshot not loaded\n";
+    } else if (auto routes = ip::loadRouteSnapshot(path); !routes) {
+        std::stringstream ss;
+        ss << "RouterNode::enableRouteSnapshots(): No routes preloaded: " << routes.error() << "\n";
+        std::cerr << ss.str();
+    } else {
+        const auto loaded = routingTable_->loadProvisionalRoutes_(*routes);
+        std::stringstream ss;
+        ss << "RouterNode::enableRouteSnapshots(): Preloaded " << loaded << " of " << routes->size()
+           << " routes from " << path << "\n";
+        std::cout << ss.str();
+    }
 
-    // Construct payload
-    auto it = payload->begin();
+    snapshotTimer_ = std::make_unique<PeriodicTimer>(timerWheel_, SNAPSHOT_INTERVAL, [this]() {
+        saveRouteSnapshot_();
+    });
+}
 
-    const auto command = util::hton(static_cast<std::uint16_t>(ripMessage.getCommand()));
-    it = util::insertData(it, command);
+void RouterNode::saveRouteSnapshot_()
+{
+    std::lock_guard lock(snapshotMutex_);
 
-    const auto numEntries = util::hton(ripMessage.getNumEntries());
-    it = util::insertData(it, numEntries);
+    const auto generation = routingTable_->getGeneration_();
+    if (snapshotGeneration_ == generation)
+        return;
 
-    auto entryIt = ripMessage.getEntries().cbegin();
-    auto learnedFromIt = ripMessage.getLearnedFrom().cbegin();
-    for (; entryIt != ripMessage.getEntries().end(); entryIt++, learnedFromIt++) {
-        auto cost = *learnedFromIt && destIP == (*learnedFromIt).value()
-                  ? RipMessage::INFINITY  // Poisoned reverse
-                  : entryIt->cost;
-        RipMessage::Entry entryNetwork = {
-            .cost    = util::hton(cost),
-            .address = util::hton(entryIt->address),
-            .mask    = util::hton(entryIt->mask)
-        };
-        it = util::insertData(it, entryNetwork);
+    if (const auto saved = ip::saveRouteSnapshot(snapshotPath_, routingTable_->snapshotRipRoutes_()); !saved) {
+        std::stringstream ss;
+        ss << "RouterNode::saveRouteSnapshot_(): " << saved.error() << "\n";
+        std::cerr << ss.str();
+        return;
+    }
+    snapshotGeneration_ = generation;
+}
+
+void RouterNode::listRipStats(std::ostream &os) const
+{
+    using namespace std;
+    const auto row = [&os](string_view name, const atomic<uint64_t> &counter) {
+        os << setw(22) << left << name << " " << counter.load(memory_order_relaxed) << "\n";
+    };
+    row("Messages sent",          ripStats_.messagesSent);
+    row("Entries sent",           ripStats_.entriesSent);
+    row("Messages received",      ripStats_.messagesRecv);
+    row("Entries received",       ripStats_.entriesRecv);
+    row("Triggered updates",      ripStats_.triggeredUpdates);
+    row("Routes triggered",       ripStats_.routesTriggered);
+    row("Routes coalesced",       ripStats_.routesCoalesced);
+    row("Periodic (full)",        ripStats_.periodicFull);
+    row("Periodic (incremental)", ripStats_.periodicIncremental);
+    row("Encodings reused",       ripStats_.encodingsReused);
+    row("Malformed received",     ripStats_.malformedRecv);
+}
+
+void RouterNode::dumpJson(std::ostream &os) const
+{
+    using namespace std;
+    std::stringstream ss;  // Written at once so that other threads' output cannot split the line
+    const auto field = [&ss](string_view name, const atomic<uint64_t> &counter, bool last = false) {
+        ss << "\"" << name << "\":" << counter.load(memory_order_relaxed) << (last ? "" : ",");
+    };
+
+    ss << "{\"routes\":";
+    routingTable_->listEntriesJson_(ss);
+    ss << ",\"rip\":{";
+    field("messages_sent",        ripStats_.messagesSent);
+    field("entries_sent",         ripStats_.entriesSent);
+    field("messages_recv",        ripStats_.messagesRecv);
+    field("entries_recv",         ripStats_.entriesRecv);
+    field("triggered_updates",    ripStats_.triggeredUpdates);
+    field("periodic_full",        ripStats_.periodicFull);
+    field("periodic_incremental", ripStats_.periodicIncremental, true);
+    ss << "}}\n";
+    os << ss.str() << std::flush;
+}
+
+void RouterNode::broadcastRipMessage_(const RipMessage &ripMessage) const
+{
+    broadcastRipEncoding_(ip::RipEncoding{ripMessage});
+}
+
+void RouterNode::sendRipMessage_(const RipMessage &ripMessage, const Ipv4Address &destIP) const
+{
+    sendRipEncoding_(ip::RipEncoding{ripMessage}, destIP);
+}
+
+void RouterNode::broadcastRipEncoding_(const ip::RipEncoding &encoding) const
+{
+    // MAYBE: Use worker threads with synchronization on ripMessage
+    for (const auto &neighbor : ripNeighbors_) {
+        // std::cout << "RouterNode::RouterNode(): Sending RIP packets to neighbor " << neighbor << "\n";
+        sendRipEncoding_(encoding, neighbor);
     }
+}
 
+void RouterNode::sendRipEncoding_(const ip::RipEncoding &encoding, const Ipv4Address &destIP) const
+{
     try {
-        sendIp_(destIP, std::move(payload), ip::Protocol::RIP);
+        for (auto &payload : encoding.makePayloads(destIP))  // Routes learned from destIP are poisoned
+            sendIp_(destIP, std::move(payload), ip::Protocol::RIP);
+        ripStats_.messagesSent += encoding.getNumMessages();
+        ripStats_.entriesSent += encoding.getNumEntries();
     } catch (const std::exception &e) {
-        std::cerr << "RouterNode::sendRipMessage_(): " << e.what() << "\n";
+        std::cerr << "RouterNode::sendRipEncoding_(): " << e.what() << "\n";
     }
 }
 
@@ -0,0 +1,331 @@
+#include "sim/impairment.hpp"
+#include "ip/datagram.hpp"
+#include "util/scheduler.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <iterator>
+#include <iostream>
+#include <sstream>
+
+
+namespace tns {
+namespace sim {
+
+using util::Clock;
+
+namespace {
+
+// Split "<number><unit>" into the number and its unit suffix
+tl::expected<std::pair<double, std::string_view>, std::string> parseQuantity(std::string_view text)
+{
+    double value;
+    const auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (ec != std::errc{} || value < 0)
+        return tl::unexpected("Invalid number: " + std::string(text));
+    return std::pair{value, text.substr(static_cast<std::size_t>(end - text.data()))};
+}
+
+tl::expected<double, std::string> parseProbability(std::string_view text)
+{
+    auto quantity = parseQuantity(text);
+    if (!quantity)
+        return tl::unexpected(quantity.error());
+    auto [value, unit] = *quantity;
+    if (unit == "%")
+        value /= 100;
+    else if (!unit.empty())
+        return tl::unexpected("Invalid probability: " + std::string(text));
+    if (value > 1)
+        return tl::unexpected("Probability above 100%: " + std::string(text));
+    return value;
+}
+
+tl::expected<Clock::duration, std::string> parseDuration(std::string_view text)
+{
+    const auto quantity = parseQuantity(text);
+    if (!quantity)
+        return tl::unexpected(quantity.error());
+    const auto [value, unit] = *quantity;
+
+    double seconds;
+    if (unit == "s")
+        seconds = value;
+    else if (unit == "ms")
+        seconds = value / 1e3;
+    else if (unit == "us")
+        seconds = value / 1e6;
+    else
+        return tl::unexpected("Invalid duration (expected us, ms or s): " + std::string(text));
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+// Rate in bytes per second
+tl::expected<std::uint64_t, std::string> parseRate(std::string_view text)
+{
+    const auto quantity = parseQuantity(text);
+    if (!quantity)
+        return tl::unexpected(quantity.error());
+    const auto [value, unit] = *quantity;
+
+    static constexpr std::pair<std::string_view, double> UNITS[] = {
+        {"bit", 1.0 / 8}, {"kbit", 1e3 / 8}, {"mbit", 1e6 / 8}, {"gbit", 1e9 / 8},
+        {"bps", 1},       {"kbps", 1e3},     {"mbps", 1e6},     {"gbps", 1e9},
+    };
+    const auto it = std::find_if(std::begin(UNITS), std::end(UNITS), [unit](const auto &u) { return u.first == unit; });
+    if (it == std::end(UNITS))
+        return tl::unexpected("Invalid rate (expected bit, kbit, mbit, gbit or bps, kbps, ...): " + std::string(text));
+    return static_cast<std::uint64_t>(value * it->second);
+}
+
+} // namespace
+
+
+tl::expected<Impairment, std::string> parseImpairment(std::string_view settings)
+{
+    std::istringstream is{std::string(settings)};
+    std::vector<std::string> tokens{std::istream_iterator<std::string>{is}, std::istream_iterator<std::string>{}};
+
+    Impairment impairment;
+    if (tokens.size() == 1 && tokens[0] == "off")
+        return impairment;
+    if (tokens.empty() || tokens.size() % 2 != 0)
+        return tl::unexpected("Expected <key> <value> pairs, or off");
+
+    for (std::size_t i = 0; i < tokens.size(); i += 2) {
+        const auto &key = tokens[i];
+        const std::string_view value = tokens[i + 1];
+        tl::expected<void, std::string> parsed;
+
+        const auto assign = [&parsed](auto &field, auto result) {
+            if (result)
+                field = *result;
+            else
+                parsed = tl::unexpected(result.error());
+        };
+
+        if (key == "loss")
+            assign(impairment.loss, parseProbability(value));
+        else if (key == "reorder")
+            assign(impairment.reorder, parseProbability(value));
+        else if (key == "duplicate")
+            assign(impairment.duplicate, parseProbability(value));
+        else if (key == "delay")
+            assign(impairment.delay, parseDuration(value));
+        else if (key == "jitter")
+            assign(impairment.jitter, parseDuration(value));
+        else if (key == "rate")
+            assign(impairment.rate, parseRate(value));
+        else if (key == "burst" || key == "limit" || key == "seed") {
+            const auto number = parseQuantity(value);
+            if (!number || !number->second.empty())
+                parsed = tl::unexpected("Invalid " + key + ": " + std::string(value));
+            else if (key == "burst")
+                impairment.burst = std::max(1.0, number->first);
+            else if (key == "limit")
+                impairment.limit = static_cast<std::size_t>(number->first);
+            else
+                impairment.seed = static_cast<std::uint64_t>(number->first);
+        }
+        else
+            parsed = tl::unexpected("Unknown setting: " + key);
+
+        if (!parsed)
+            return tl::unexpected(parsed.error());
+    }
+    return impairment;
+}
+
+std::ostream& operator<<(std::ostream &os, const Impairment &impairment)
+{
+    using std::chrono::duration_cast, std::chrono::microseconds;
+
+    if (!impairment.isActive())
+        return os << "off";
+
+    const auto usec = [](Clock::duration d) { return duration_cast<microseconds>(d).count(); };
+    os << "loss " << impairment.loss * 100 << "% burst " << impairment.burst
+       << " delay " << usec(impairment.delay) << "us jitter " << usec(impairment.jitter) << "us"
+       << " reorder " << impairment.reorder * 100 << "% duplicate " << impairment.duplicate * 100 << "%"
+       << " rate " << impairment.rate << "bps limit " << impairment.limit << " seed " << impairment.seed;
+    return os;
+}
+
+
+LinkImpairment::LinkImpairment(Transmit transmit) : transmit_(std::move(transmit)) {}
+
+LinkImpairment::~LinkImpairment()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto *scheduler = Clock::scheduler(); scheduler && timerEvent_)
+        scheduler->cancel(timerEvent_);
+}
+
+void LinkImpairment::configure(const Impairment &impairment)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = impairment;
+    rng_.seed(impairment.seed);
+    lossBurst_ = false;
+    linkFree_ = {};
+    active_.store(impairment.isActive(), std::memory_order_release);
+}
+
+Impairment LinkImpairment::getConfig() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+}
+
+void LinkImpairment::send(DatagramPtr datagram, const ip::Ipv4Address &nextHop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (loseNoLock_()) {
+        stats_.dropped++;
+        return;
+    }
+
+    const int copies = chanceNoLock_(config_.duplicate) ? 2 : 1;
+    if (copies == 2)
+        stats_.duplicated++;
+
+    auto linkFree = linkFree_;
+    const auto departure = departureNoLock_(datagram->getTotalLength() * static_cast<std::size_t>(copies), Clock::now(), linkFree);
+    if (departure) {
+        // Dropped datagrams never make it to the link, so they do not take any of its time
+        if (heldBack_.size() >= config_.limit) {
+            stats_.overLimit++;
+            return;
+        }
+        linkFree_ = linkFree;
+        heldBack_.emplace(*departure, HeldBack{std::move(datagram), nextHop, copies});
+        armTimerNoLock_();
+        return;
+    }
+
+    linkFree_ = linkFree;
+    lock.unlock();
+    Batch batch;
+    batch.push_back({std::move(datagram), nextHop, copies});
+    transmitBatch_(batch);
+}
+
+std::optional<Clock::time_point> LinkImpairment::departureNoLock_(std::size_t size, Clock::time_point now,
+                                                                 Clock::time_point &linkFree)
+{
+    auto departure = now;
+
+    // Rate limit: datagrams leave one after the other, each taking size / rate on the link
+    if (config_.rate > 0) {
+        const auto serialization = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(static_cast<double>(size) / static_cast<double>(config_.rate)));
+        linkFree = std::max(linkFree, now) + serialization;
+        departure = linkFree;
+    }
+
+    if (config_.delay.count() > 0 || config_.jitter.count() > 0) {
+        if (chanceNoLock_(config_.reorder)) {
+            stats_.reordered++;
+        } else {
+            const auto jitter = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, Clock::period>(static_cast<double>(config_.jitter.count()) * (2 * uniform_(rng_) - 1)));
+            departure += std::max(Clock::duration::zero(), config_.delay + jitter);
+        }
+    }
+
+    if (departure <= now)
+        return std::nullopt;
+    return departure;
+}
+
+bool LinkImpairment::loseNoLock_()
+{
+    if (config_.loss <= 0)
+        return false;
+    if (config_.burst <= 1 || config_.loss >= 1)
+        return chanceNoLock_(config_.loss);
+
+    // Gilbert model: every datagram is lost in the bad state, which lasts `burst` datagrams on average.
+    // The good -> bad probability is chosen so that the long-run loss rate is still `loss`.
+    const auto toGood = 1 / config_.burst;
+    const auto toBad = config_.loss * toGood / (1 - config_.loss);
+    lossBurst_ = lossBurst_ ? !chanceNoLock_(toGood) : chanceNoLock_(toBad);
+    return lossBurst_;
+}
+
+void LinkImpairment::armTimerNoLock_()
+{
+    if (heldBack_.empty())
+        return;
+
+    auto *scheduler = Clock::scheduler();
+    if (!scheduler) {
+        if (!timerThread_.joinable())
+            timerThread_ = std::jthread{[this](std::stop_token stop) { timerLoop_(stop); }};
+        cv_.notify_one();
+        return;
+    }
+
+    const auto due = heldBack_.begin()->first;
+    if (timerEvent_ && timerAt_ <= due)
+        return;
+    if (timerEvent_)
+        scheduler->cancel(timerEvent_);
+    timerAt_ = due;
+    timerEvent_ = scheduler->schedule(due, [this] { onTimerEvent_(); });
+}
+
+LinkImpairment::Batch LinkImpairment::takeDueNoLock_(Clock::time_point now)
+{
+    Batch batch;
+    const auto end = heldBack_.upper_bound(now);
+    for (auto it = heldBack_.begin(); it != end; it++)
+        batch.push_back(std::move(it->second));
+    heldBack_.erase(heldBack_.begin(), end);
+    return batch;
+}
+
+void LinkImpairment::transmitBatch_(const Batch &batch)
+{
+    for (const auto &[datagram, nextHop, copies] : batch) {
+        for (int i = 0; i < copies; i++)
+            transmit_(*datagram, nextHop);
+        stats_.passed += static_cast<std::uint64_t>(copies);
+    }
+}
+
+void LinkImpairment::onTimerEvent_()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    timerEvent_ = 0;
+    const auto batch = takeDueNoLock_(Clock::now());
+    armTimerNoLock_();
+    lock.unlock();
+    transmitBatch_(batch);
+}
+
+void LinkImpairment::timerLoop_(std::stop_token stop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop.stop_requested()) {
+        if (heldBack_.empty()) {
+            cv_.wait(lock, stop, [this] { return !heldBack_.empty(); });
+        } else {
+            // Sleep until the earliest departure, or until an earlier one is queued
+            const auto due = heldBack_.begin()->first;
+            cv_.wait_until(lock, stop, due, [this, due] { return heldBack_.empty() || heldBack_.begin()->first < due; });
+        }
+        if (stop.stop_requested())
+            break;
+
+        const auto batch = takeDueNoLock_(Clock::now());
+        if (batch.empty())
+            continue;
+        lock.unlock();
+        transmitBatch_(batch);
+        lock.lock();
+    }
+}
+
+} // namespace sim
+} // namespace tns
@@ -0,0 +1,113 @@
+#include "sim/memory_link.hpp"
+#include "ip/datagram.hpp"
+#include "util/scheduler.hpp"
+
+#include <thread>
+#include <sstream>
+#include <stdexcept>
+
+
+namespace tns {
+namespace sim {
+
+MemoryPort::MemoryPort() : head_(new Node), tail_(head_.load()) {}
+
+MemoryPort::MemoryPort(util::Scheduler *scheduler) : MemoryPort() { scheduler_ = scheduler; }
+
+MemoryPort::~MemoryPort()
+{
+    for (Node *node = tail_; node != nullptr; ) {
+        Node *next = node->next.load(std::memory_order_relaxed);
+        delete node;
+        node = next;
+    }
+}
+
+bool MemoryPort::push(DatagramPtr datagram)
+{
+    if (isClosed())
+        return false;
+
+    if (scheduler_) {
+        // Arrives right away in virtual time, after the events already due now.
+        // std::function needs a copyable task, hence the shared holder.
+        auto holder = std::make_shared<DatagramPtr>(std::move(datagram));
+        scheduler_->scheduleAfter({}, [port = weak_from_this(), holder] {
+            if (const auto self = port.lock())
+                self->deliver_(std::move(*holder));
+        });
+        return true;
+    }
+
+    auto node = new Node;
+    node->datagram = std::move(datagram);
+
+    // Claim the head, then link the previous head to us. A consumer reaching the previous head
+    // before the link is published spins for that short window.
+    Node *prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+
+    pending_.fetch_add(1, std::memory_order_release);
+    pending_.notify_one();
+    return true;
+}
+
+DatagramPtr MemoryPort::pop()
+{
+    while (pending_.load(std::memory_order_acquire) == 0) {
+        if (isClosed())
+            return nullptr;
+        pending_.wait(0, std::memory_order_acquire);
+    }
+    if (isClosed())
+        return nullptr;
+
+    Node *next;
+    while ((next = tail_->next.load(std::memory_order_acquire)) == nullptr)
+        std::this_thread::yield();  // A producer is between claiming the head and linking it
+
+    pending_.fetch_sub(1, std::memory_order_relaxed);
+    delete tail_;
+    tail_ = next;  // The popped node becomes the new stub
+    return std::move(next->datagram);
+}
+
+void MemoryPort::close() noexcept
+{
+    closed_.store(true, std::memory_order_release);
+    pending_.fetch_add(1, std::memory_order_release);  // Wake up a consumer blocked on an empty queue
+    pending_.notify_all();
+}
+
+void MemoryPort::deliver_(DatagramPtr datagram) const
+{
+    if (!isClosed() && receiver_)
+        receiver_(std::move(datagram));
+}
+
+
+MemoryFabric::MemoryFabric(const std::vector<sockaddr_in> &endpoints, util::Scheduler *scheduler)
+{
+    ports_.reserve(endpoints.size());
+    for (const auto &endpoint : endpoints) {
+        if (!ports_.emplace(key_(endpoint), std::make_shared<MemoryPort>(scheduler)).second) {
+            std::stringstream ss;
+            ss << "MemoryFabric::MemoryFabric(): Duplicate endpoint port " << ntohs(endpoint.sin_port);
+            throw std::invalid_argument(ss.str());
+        }
+    }
+}
+
+MemoryPort *MemoryFabric::find(const sockaddr_in &endpoint) const noexcept
+{
+    const auto it = ports_.find(key_(endpoint));
+    return it == ports_.end() ? nullptr : it->second.get();
+}
+
+std::uint64_t MemoryFabric::key_(const sockaddr_in &endpoint) noexcept
+{
+    return (std::uint64_t{endpoint.sin_addr.s_addr} << 16) | endpoint.sin_port;
+}
+
+} // namespace sim
+} // namespace tns
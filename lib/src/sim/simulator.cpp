@@ -0,0 +1,396 @@
+#include "sim/simulator.hpp"
+#include "sim/memory_link.hpp"
+#include "host_node.hpp"
+#include "router_node.hpp"
+#include "util/util.hpp"
+
+#include "src/util/lnx_parser/parse_lnx.hpp"
+
+#include <cctype>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <arpa/inet.h>
+
+
+namespace tns {
+namespace sim {
+
+namespace {
+
+constexpr in_port_t UDP_PORT_START = 5000;           // Same as util/vnet_generate
+constexpr std::size_t PORTS_PER_UDP_ADDR = 60000;    // Beyond that, move on to 127.0.0.2, ...
+constexpr std::size_t MAX_HOSTS_PER_NETWORK = 254;   // A /24
+
+// Just enough JSON for topology files: values are kept as a tree, numbers and literals as text
+struct Json {
+    enum class Kind { LITERAL, STRING, ARRAY, OBJECT };
+
+    Kind kind = Kind::LITERAL;
+    std::string text;  // STRING: the unescaped string, LITERAL: the token
+    std::vector<Json> items;
+    std::vector<std::pair<std::string, Json>> members;
+
+    const Json *get(std::string_view key) const
+    {
+        for (const auto &[k, v] : members)
+            if (k == key)
+                return &v;
+        return nullptr;
+    }
+};
+
+class JsonParser {
+public:
+    explicit JsonParser(std::string_view text) : p_(text.data()), begin_(text.data()), end_(text.data() + text.size()) {}
+
+    tl::expected<Json, std::string> parse()
+    {
+        Json root;
+        if (!parseValue_(root, 0))
+            return tl::unexpected(error_);
+        skipBlanks_();
+        if (p_ != end_)
+            return tl::unexpected(fail_("trailing characters"));
+        return root;
+    }
+
+private:
+    static constexpr int MAX_DEPTH = 64;
+
+    std::string fail_(std::string_view what)
+    {
+        std::stringstream ss;
+        ss << "JSON offset " << (p_ - begin_) << ": " << what;
+        error_ = ss.str();
+        return error_;
+    }
+
+    void skipBlanks_() noexcept
+    {
+        while (p_ != end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\n' || *p_ == '\r'))
+            p_++;
+    }
+
+    bool consume_(char c) noexcept
+    {
+        skipBlanks_();
+        if (p_ == end_ || *p_ != c)
+            return false;
+        p_++;
+        return true;
+    }
+
+    bool parseValue_(Json &out, int depth)
+    {
+        if (depth > MAX_DEPTH)
+            return fail_("nested too deeply"), false;
+        skipBlanks_();
+        if (p_ == end_)
+            return fail_("unexpected end"), false;
+
+        switch (*p_) {
+        case '{': return parseObject_(out, depth);
+        case '[': return parseArray_(out, depth);
+        case '"': out.kind = Json::Kind::STRING; return parseString_(out.text);
+        default:  break;
+        }
+
+        const auto start = p_;
+        while (p_ != end_ && (std::isalnum(static_cast<unsigned char>(*p_)) || *p_ == '-' || *p_ == '+' || *p_ == '.'))
+            p_++;
+        if (p_ == start)
+            return fail_("unexpected character"), false;
+        out.kind = Json::Kind::LITERAL;
+        out.text.assign(start, p_);
+        return true;
+    }
+
+    bool parseString_(std::string &out)
+    {
+        p_++;  // Opening quote
+        while (p_ != end_ && *p_ != '"') {
+            if (*p_ != '\\') {
+                out.push_back(*p_++);
+                continue;
+            }
+            if (++p_ == end_)
+                break;
+            switch (const char c = *p_++) {
+            case 'n': out.push_back('\n'); break;
+            case 't': out.push_back('\t'); break;
+            case 'r': out.push_back('\r'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'u':  // Names are ASCII; anything else is kept as a placeholder
+                if (end_ - p_ < 4)
+                    return fail_("truncated \\u escape"), false;
+                p_ += 4;
+                out.push_back('?');
+                break;
+            default: out.push_back(c); break;  // \" \\ \/
+            }
+        }
+        if (p_ == end_)
+            return fail_("unterminated string"), false;
+        p_++;  // Closing quote
+        return true;
+    }
+
+    bool parseArray_(Json &out, int depth)
+    {
+        out.kind = Json::Kind::ARRAY;
+        p_++;
+        if (consume_(']'))
+            return true;
+        do {
+            if (!parseValue_(out.items.emplace_back(), depth + 1))
+                return false;
+        } while (consume_(','));
+        return consume_(']') || (fail_("expected ',' or ']'"), false);
+    }
+
+    bool parseObject_(Json &out, int depth)
+    {
+        out.kind = Json::Kind::OBJECT;
+        p_++;
+        if (consume_('}'))
+            return true;
+        do {
+            skipBlanks_();
+            if (p_ == end_ || *p_ != '"')
+                return fail_("expected a key"), false;
+            auto &[key, value] = out.members.emplace_back();
+            if (!parseString_(key))
+                return false;
+            if (!consume_(':'))
+                return fail_("expected ':'"), false;
+            if (!parseValue_(value, depth + 1))
+                return false;
+        } while (consume_(','));
+        return consume_('}') || (fail_("expected ',' or '}'"), false);
+    }
+
+    const char *p_;
+    const char *begin_;
+    const char *end_;
+    std::string error_;
+};
+
+sockaddr_in makeEndpoint(const std::string &udpAddr, in_port_t udpPort)
+{
+    sockaddr_in addr = {.sin_family = AF_INET};
+    inet_aton(udpAddr.c_str(), &addr.sin_addr);
+    addr.sin_port = tns::util::hton(udpPort);
+    return addr;
+}
+
+} // namespace
+
+
+tl::expected<Topology, std::string> parseTopology(std::string_view json)
+{
+    const auto root = JsonParser{json}.parse();
+    if (!root)
+        return tl::unexpected(root.error());
+
+    const auto arrayOf = [](const Json &object, std::string_view key) -> const Json * {
+        const auto value = object.get(key);
+        return value && value->kind == Json::Kind::ARRAY ? value : nullptr;
+    };
+    const auto stringOf = [](const Json &object, std::string_view key) -> const std::string * {
+        const auto value = object.get(key);
+        return value && value->kind == Json::Kind::STRING ? &value->text : nullptr;
+    };
+
+    const auto nodes = arrayOf(*root, "nodes");
+    const auto networks = arrayOf(*root, "networks");
+    if (!nodes || !networks)
+        return tl::unexpected("Topology needs \"nodes\" and \"networks\" arrays");
+
+    Topology topology;
+    std::unordered_set<std::string> names;
+    for (const auto &item : nodes->items) {
+        const auto name = stringOf(item, "name");
+        const auto type = stringOf(item, "type");
+        if (!name || !type)
+            return tl::unexpected("Every node needs a \"name\" and a \"type\"");
+        if (*type != "host" && *type != "router")
+            return tl::unexpected("Node " + *name + " has unknown type " + *type);
+        if (!names.insert(*name).second)
+            return tl::unexpected("Duplicate node " + *name);
+        topology.nodes.push_back({*name, *type == "router"});
+    }
+
+    for (const auto &item : networks->items) {
+        const auto name = stringOf(item, "name");
+        const auto links = arrayOf(item, "links");
+        if (!name || !links)
+            return tl::unexpected("Every network needs a \"name\" and \"links\"");
+
+        auto &network = topology.networks.emplace_back(Topology::Network{*name, {}});
+        for (const auto &link : links->items) {
+            if (link.kind != Json::Kind::STRING || !names.contains(link.text))
+                return tl::unexpected("Network " + *name + " links an undeclared node");
+            network.links.push_back(link.text);
+        }
+    }
+
+    return topology;
+}
+
+tl::expected<Topology, std::string> loadTopology(const std::string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        return tl::unexpected("Cannot open " + path);
+    const std::string text{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+
+    auto topology = parseTopology(text);
+    if (!topology)
+        return tl::unexpected(path + ": " + topology.error());
+    return topology;
+}
+
+
+Simulator::Simulator(const Topology &topology)
+{
+    // Interface of a node on one network, as vnet_generate would write it in the node's .lnx file
+    struct Attachment {
+        std::size_t network;
+        std::string address;  // Virtual IP
+        std::string udpAddr;
+        in_port_t udpPort;
+    };
+
+    std::unordered_map<std::string, std::vector<Attachment>> attachments;  // By node name, in interface order
+    std::unordered_map<std::string, bool> isRouter;
+    std::vector<std::vector<std::pair<std::string, std::size_t>>> members(topology.networks.size());  // (node, interface index)
+    std::vector<sockaddr_in> endpoints;
+
+    for (const auto &node : topology.nodes) {
+        attachments[node.name];
+        isRouter[node.name] = node.isRouter;
+    }
+
+    // Assign addresses and (simulated) UDP endpoints in the order vnet_generate does
+    for (std::size_t i = 0; i < topology.networks.size(); i++) {
+        const auto &network = topology.networks[i];
+        if (network.links.size() > MAX_HOSTS_PER_NETWORK)
+            throw std::runtime_error("Simulator::Simulator(): Too many nodes on network " + network.name);
+
+        for (std::size_t j = 0; j < network.links.size(); j++) {
+            const auto &name = network.links[j];
+            if (!attachments.contains(name))
+                throw std::runtime_error("Simulator::Simulator(): Network " + network.name + " links unknown node " + name);
+
+            std::stringstream address, udpAddr;
+            address << "10." << i % 256 << "." << i / 256 << "." << j + 1;
+            udpAddr << "127.0.0." << 1 + endpoints.size() / PORTS_PER_UDP_ADDR;
+            const auto udpPort = static_cast<in_port_t>(UDP_PORT_START + endpoints.size() % PORTS_PER_UDP_ADDR);
+
+            auto &nodeAttachments = attachments[name];
+            members[i].emplace_back(name, nodeAttachments.size());
+            nodeAttachments.push_back({i, address.str(), udpAddr.str(), udpPort});
+            endpoints.push_back(makeEndpoint(udpAddr.str(), udpPort));
+        }
+    }
+
+    fabric_ = std::make_unique<MemoryFabric>(endpoints, util::Clock::scheduler());
+
+    // Build and start every node
+    for (const auto &node : topology.nodes) {
+        const auto &ownAttachments = attachments[node.name];
+        util::lnx::NetworkNodeData nodeData;
+        nodeData.routingMode = node.isRouter ? ROUTING_MODE_RIP : ROUTING_MODE_STATIC;
+
+        for (std::size_t k = 0; k < ownAttachments.size(); k++) {
+            const auto &own = ownAttachments[k];
+            auto &iface = nodeData.interfaces.emplace_back();
+            iface.name = "if" + std::to_string(k);
+            iface.cidr = own.address + "/24";
+            iface.udp_addr = own.udpAddr;
+            iface.udp_port = own.udpPort;
+
+            for (const auto &[neighbor, index] : members[own.network]) {
+                if (neighbor == node.name)
+                    continue;
+                const auto &theirs = attachments[neighbor][index];
+                iface.ip_addrs.push_back(theirs.address);
+                iface.udp_addrs.push_back(theirs.udpAddr);
+                iface.udp_ports.push_back(theirs.udpPort);
+
+                if (!isRouter[neighbor])
+                    continue;
+                if (node.isRouter)
+                    nodeData.ripNeighbors.push_back(theirs.address);
+                else if (nodeData.routes.empty())
+                    nodeData.routes.push_back({"0.0.0.0/0", theirs.address});  // Default route
+            }
+        }
+
+        if (!node.isRouter && nodeData.routes.empty())
+            throw std::runtime_error("Simulator::Simulator(): No neighboring router found for host " + node.name);
+
+        SimNode simNode;
+        for (const auto &own : ownAttachments)
+            simNode.addresses.emplace_back(own.address);
+        if (node.isRouter) {
+            auto router = std::make_unique<RouterNode>(nodeData, fabric_.get());
+            simNode.router = router.get();
+            simNode.node = std::move(router);
+        } else {
+            auto host = std::make_unique<HostNode>(nodeData, fabric_.get());
+            simNode.host = host.get();
+            simNode.node = std::move(host);
+        }
+        nodes_.emplace(node.name, std::move(simNode));
+    }
+
+    std::stringstream ss;
+    ss << "/********* Simulator running " << nodes_.size() << " nodes on "
+       << topology.networks.size() << " in-memory networks. *********/\n";
+    std::cout << ss.str();
+}
+
+Simulator::~Simulator()
+{
+    nodes_.clear();  // Stop all nodes before the links they send on go away
+}
+
+const Simulator::SimNode &Simulator::find_(const std::string &name) const
+{
+    const auto it = nodes_.find(name);
+    if (it == nodes_.end())
+        throw std::out_of_range("Simulator: No node named " + name);
+    return it->second;
+}
+
+NetworkNode &Simulator::node(const std::string &name) { return *find_(name).node; }
+
+HostNode &Simulator::host(const std::string &name)
+{
+    const auto host = find_(name).host;
+    if (!host)
+        throw std::out_of_range("Simulator: " + name + " is not a host");
+    return *host;
+}
+
+RouterNode &Simulator::router(const std::string &name)
+{
+    const auto router = find_(name).router;
+    if (!router)
+        throw std::out_of_range("Simulator: " + name + " is not a router");
+    return *router;
+}
+
+ip::Ipv4Address Simulator::address(const std::string &name, std::size_t index) const
+{
+    return find_(name).addresses.at(index);
+}
+
+} // namespace sim
+} // namespace tns
@@ -0,0 +1,150 @@
+#include "tcp/congestion_control.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+
+
+namespace tns {
+namespace tcp {
+
+tl::expected<CongestionAlgorithm, std::string> parseCongestionAlgorithm(std::string_view name)
+{
+    if (name == "reno" || name == "newreno")
+        return CongestionAlgorithm::NEW_RENO;
+    if (name == "cubic")
+        return CongestionAlgorithm::CUBIC;
+    return tl::unexpected("Unknown congestion control algorithm \"" + std::string(name) + "\" (reno, cubic)");
+}
+
+std::ostream& operator<<(std::ostream &os, CongestionAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case CongestionAlgorithm::NEW_RENO: return os << "reno";
+    case CongestionAlgorithm::CUBIC:    return os << "cubic";
+    }
+    return os << "unknown";
+}
+
+std::unique_ptr<CongestionControl> makeCongestionControl(CongestionAlgorithm algorithm, std::size_t mss)
+{
+    switch (algorithm) {
+    case CongestionAlgorithm::CUBIC:
+        return std::make_unique<Cubic>(mss);
+    case CongestionAlgorithm::NEW_RENO:
+    default:
+        return std::make_unique<NewReno>(mss);
+    }
+}
+
+
+/*********************************************** NewReno ***********************************************/
+
+void NewReno::onAck(std::size_t bytesAcked, Clock::duration)
+{
+    if (inSlowStart()) {
+        slowStart_(bytesAcked);
+        return;
+    }
+
+    // Congestion avoidance: one segment per window acknowledged
+    bytesAckedInAvoidance_ += bytesAcked;
+    if (bytesAckedInAvoidance_ >= cwnd_) {
+        bytesAckedInAvoidance_ -= cwnd_;
+        cwnd_ += mss_;
+    }
+}
+
+void NewReno::onLoss(std::size_t bytesInFlight)
+{
+    ssthresh_ = std::max(bytesInFlight / 2, 2 * mss_);
+    cwnd_ = ssthresh_;
+    bytesAckedInAvoidance_ = 0;
+}
+
+void NewReno::onRetransmitTimeout(std::size_t bytesInFlight, bool repeated)
+{
+    if (!repeated)
+        ssthresh_ = std::max(bytesInFlight / 2, 2 * mss_);
+    cwnd_ = mss_;  // Loss window
+    bytesAckedInAvoidance_ = 0;
+}
+
+
+/************************************************ CUBIC ************************************************/
+
+void Cubic::onAck(std::size_t bytesAcked, Clock::duration srtt)
+{
+    if (inSlowStart()) {
+        slowStart_(bytesAcked);
+        return;
+    }
+
+    using Seconds = std::chrono::duration<double>;
+    const auto mss = static_cast<double>(mss_);
+    const auto cwnd = static_cast<double>(cwnd_) / mss;
+    const auto now = Clock::now();
+
+    if (!epochStarted_) {
+        epochStarted_ = true;
+        epochStart_ = now;
+        if (cwnd < wMax_) {
+            k_ = std::cbrt((wMax_ - cwnd) / C);
+        } else {
+            k_ = 0;
+            wMax_ = cwnd;
+        }
+        wEst_ = cwnd;
+    }
+
+    const auto t = Seconds(now - epochStart_).count();
+    const auto rtt = std::max(Seconds(srtt).count(), 1e-3);
+    const auto wCubic = [this](double at) { return C * std::pow(at - k_, 3) + wMax_; };
+
+    // Reno-friendly region: grow at least as fast as Reno with the same multiplicative decrease would
+    static constexpr double ALPHA = 3 * (1 - BETA) / (1 + BETA);
+    wEst_ += ALPHA * (static_cast<double>(bytesAcked) / mss) / cwnd;
+    if (wCubic(t) < wEst_) {
+        cwnd_ = std::max(cwnd_, static_cast<std::size_t>(wEst_ * mss));
+        return;
+    }
+
+    // Concave or convex region: close the gap to where the cubic function is one RTT from now,
+    // by at most half the window per RTT
+    const auto target = std::clamp(wCubic(t + rtt), cwnd, 1.5 * cwnd);
+    growth_ += (target - cwnd) / cwnd * static_cast<double>(bytesAcked);
+    if (growth_ >= 1) {
+        const auto bytes = static_cast<std::size_t>(growth_);
+        cwnd_ += bytes;
+        growth_ -= static_cast<double>(bytes);
+    }
+}
+
+void Cubic::reduce_()
+{
+    const auto cwnd = static_cast<double>(cwnd_) / static_cast<double>(mss_);
+
+    // Fast convergence: if the window did not grow back to the last maximum, leave room for new flows
+    wMax_ = cwnd < wMax_ ? cwnd * (1 + BETA) / 2 : cwnd;
+    ssthresh_ = std::max(static_cast<std::size_t>(static_cast<double>(cwnd_) * BETA), 2 * mss_);
+    epochStarted_ = false;
+    growth_ = 0;
+}
+
+void Cubic::onLoss(std::size_t)
+{
+    reduce_();
+    cwnd_ = ssthresh_;
+}
+
+void Cubic::onRetransmitTimeout(std::size_t, bool repeated)
+{
+    if (!repeated)
+        reduce_();
+    cwnd_ = mss_;  // Loss window
+    epochStarted_ = false;
+}
+
+} // namespace tcp
+} // namespace tns
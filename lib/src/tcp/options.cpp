@@ -0,0 +1,166 @@
+#include "tcp/options.hpp"
+#include "util/clock.hpp"
+#include "util/util.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+namespace tns {
+namespace tcp {
+
+namespace {
+
+std::uint32_t readU32(PayloadView bytes) noexcept
+{
+    std::uint32_t value;
+    std::memcpy(&value, bytes.data(), sizeof(value));
+    return tns::util::ntoh(value);
+}
+
+// Appends bytes to an OptionBytes, which has room for them
+class OptionWriter {
+public:
+    explicit OptionWriter(OptionBytes &out) noexcept : out_(out) {}
+
+    std::size_t room() const noexcept { return MAX_OPTIONS_SIZE - out_.size; }
+
+    void put(std::uint8_t byte) noexcept { out_.data[out_.size++] = static_cast<std::byte>(byte); }
+    void put(OptionKind kind) noexcept { put(static_cast<std::uint8_t>(kind)); }
+    void put32(std::uint32_t value) noexcept
+    {
+        value = tns::util::hton(value);
+        std::memcpy(&out_.data[out_.size], &value, sizeof(value));
+        out_.size += sizeof(value);
+    }
+
+private:
+    OptionBytes &out_;
+};
+
+} // namespace
+
+tl::expected<TcpOptions, std::string> parseOptions(PayloadView bytes)
+{
+    TcpOptions options;
+    while (!bytes.empty()) {
+        const auto kind = static_cast<OptionKind>(bytes[0]);
+        if (kind == OptionKind::END_OF_LIST)
+            break;
+        if (kind == OptionKind::NOP) {
+            bytes = bytes.subspan(1);
+            continue;
+        }
+
+        // Every other option is kind, length, data
+        if (bytes.size() < 2)
+            return tl::unexpected("TCP option without a length");
+        const auto length = std::to_integer<std::size_t>(bytes[1]);
+        if (length < 2 || length > bytes.size())
+            return tl::unexpected("Invalid TCP option length " + std::to_string(length));
+        const auto data = bytes.subspan(2, length - 2);
+
+        switch (kind) {
+        case OptionKind::WINDOW_SCALE:
+            if (data.size() != 1)
+                return tl::unexpected("Invalid window scale option length");
+            // A larger shift is taken as the largest one (RFC 7323, section 2.3)
+            options.windowShift = std::min(std::to_integer<std::uint8_t>(data[0]), MAX_WINDOW_SHIFT);
+            break;
+        case OptionKind::SACK_PERMITTED:
+            if (!data.empty())
+                return tl::unexpected("Invalid SACK-permitted option length");
+            options.sackPermitted = true;
+            break;
+        case OptionKind::TIMESTAMPS:
+            if (data.size() != 8)
+                return tl::unexpected("Invalid timestamps option length");
+            options.timestamps = Timestamps{readU32(data), readU32(data.subspan(4))};
+            break;
+        case OptionKind::SACK:
+            if (data.empty() || data.size() % 8 != 0 || data.size() / 8 > MAX_SACK_BLOCKS)
+                return tl::unexpected("Invalid SACK option length");
+            for (auto block = data; !block.empty(); block = block.subspan(8))
+                options.addSack({readU32(block), readU32(block.subspan(4))});
+            break;
+        default:
+            break;  // Not understood: skip it (RFC 9293, section 3.1)
+        }
+        bytes = bytes.subspan(length);
+    }
+    return options;
+}
+
+OptionBytes serializeOptions(const TcpOptions &options) noexcept
+{
+    OptionBytes out;
+    OptionWriter writer{out};
+
+    if (options.windowShift) {
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::WINDOW_SCALE);
+        writer.put(3);
+        writer.put(*options.windowShift);
+    }
+
+    if (options.sackPermitted) {
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::SACK_PERMITTED);
+        writer.put(2);
+    }
+
+    if (options.timestamps) {
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::TIMESTAMPS);
+        writer.put(10);
+        writer.put32(options.timestamps->value);
+        writer.put32(options.timestamps->echoReply);
+    }
+
+    // NOP, NOP, SACK, length, then as many blocks as there is room for
+    const auto nBlocks = std::min(options.numSackBlocks, writer.room() >= 4 ? (writer.room() - 4) / 8 : 0);
+    if (nBlocks > 0) {
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::NOP);
+        writer.put(OptionKind::SACK);
+        writer.put(static_cast<std::uint8_t>(2 + 8 * nBlocks));
+        for (const auto &block : options.sack().first(nBlocks)) {
+            writer.put32(block.left);
+            writer.put32(block.right);
+        }
+    }
+
+    return out;
+}
+
+std::optional<std::size_t> findOption(PayloadView bytes, OptionKind kind) noexcept
+{
+    for (std::size_t at = 0; at < bytes.size(); ) {
+        const auto k = static_cast<OptionKind>(bytes[at]);
+        if (k == kind)
+            return at;
+        if (k == OptionKind::END_OF_LIST)
+            break;
+        if (k == OptionKind::NOP) {
+            at++;
+            continue;
+        }
+        if (at + 1 >= bytes.size() || std::to_integer<std::size_t>(bytes[at + 1]) < 2)
+            break;
+        at += std::to_integer<std::size_t>(bytes[at + 1]);
+    }
+    return std::nullopt;
+}
+
+std::uint32_t timestampNow() noexcept
+{
+    using namespace std::chrono;
+    const auto ms = duration_cast<milliseconds>(tns::util::Clock::now().time_since_epoch()).count();
+    return static_cast<std::uint32_t>(ms);  // Wraps around, as sequence numbers do
+}
+
+} // namespace tcp
+} // namespace tns
@@ -14,10 +14,10 @@ void WriteInfo::operator()(const NormalSocket &sock, std::ostream &os) const
     using namespace std;
     const auto &sess = sock.tuple_;
     os  << setw(3)  << left  << sock.id_                   << " "   // SID
-        << setw(15) << right << sess.local.toStringAddr()  << " "   // LAddr
-        << setw(5)  << left  << sess.local.getPortHost()   << " "   // LPort
-        << setw(15) << right << sess.remote.toStringAddr() << " "   // RAddr
-        << setw(5)  << left  << sess.remote.getPortHost()  << " "   // RPort
+        << setw(15) << right << sess.localAddr.toStringAddr() << " "   // LAddr
+        << setw(5)  << left  << sess.local().getPortHost()  << " "   // LPort
+        << setw(15) << right << sess.remoteAddr.toStringAddr() << " "   // RAddr
+        << setw(5)  << left  << sess.remote().getPortHost() << " "   // RPort
         << setw(12) << right << sock.state_                << "\n"; // Status
 }
 
@@ -13,12 +13,12 @@ events::fromPacket(const Packet &packet, const SessionTuple &session)
     const auto wnd = packet.getWndSizeHost();
     switch (packet.getFlags()) {
         case TH_SYN:
-            return GetSyn{ session, seq, packet.getWndSizeHost() };
+            return GetSyn{ session, seq, packet.getWndSizeHost(), packet.getOptions() };
         case TH_SYN | TH_ACK:
-            return GetSynAck{ seq, packet.getAckNumHost(), wnd };
+            return GetSynAck{ seq, packet.getAckNumHost(), wnd, packet.getOptions() };
         case TH_ACK:
             return GetAck{ seq, packet.getAckNumHost(),
-                           wnd, packet.getPayloadView() };
+                           wnd, packet.getPayloadView(), packet.getOptions() };
         case TH_FIN:
             return GetFin{ seq, wnd };
         case TH_FIN | TH_ACK:
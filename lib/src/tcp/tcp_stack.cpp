@@ -14,10 +14,10 @@ void TcpStack::eventHandler_(
               << " (SYN_SENT): Got SYN-ACK (seq=" << synAck.serverISN 
               << ", ack=" << synAck.ackNum
               << ", wnd=" << synAck.serverWND
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
 
     // Check validity of ACK number
-    const auto &[una, nxt] = sock.sendBuffer_.onAck(synAck.ackNum, synAck.serverWND);
+    const auto &[una, nxt] = sock.sendBuffer_.onAck(synAck.ackNum, synAck.serverWND, false, synAck.options);
     if (una != nxt) {
         // Unacceptable ACK, should send RST but we don't care about it for now
         std::stringstream ss;
@@ -27,15 +27,22 @@ void TcpStack::eventHandler_(
         return;
     }
 
-    // Sleep for a little while so the other side is less likely to miss the ACK packet
-    std::this_thread::sleep_for(std::chrono::milliseconds(50));
-
     const auto ack = synAck.serverISN + 1;    // will be RCV.NXT
     sock.recvBuffer_.setPointersNoLock(ack);
+    sock.sackPermitted_ = synAck.options.sackPermitted;  // Only offered if enabled on this end
+    if (synAck.options.windowShift) {
+        // Window scaling applies in both directions, from the next segment on (RFC 7323, section 2.2)
+        sock.sndWndShift_ = *synAck.options.windowShift;
+        sock.rcvWndShift_ = RECV_WINDOW_SHIFT;
+    }
+    if (synAck.options.timestamps) {
+        sock.timestamps_ = true;
+        sock.tsRecent_ = synAck.options.timestamps->value;
+    }
 
     // Send ACK packet to the remote
-    const auto wnd = static_cast<std::uint16_t>(sock.recvBuffer_.getSizeFree());
-    sendPacket(Packet::makeAckPacket(sock.tuple_, nxt, ack, wnd), sock.tuple_.remote);
+    const auto wnd = sock.recvBuffer_.getSizeFree();
+    sock.sendAck_(nxt, ack, wnd);
 
     // Wake up the caller of connect()
     // Note that the caller will get a socket in state *SynSent*, not Established
@@ -56,7 +63,7 @@ void TcpStack::eventHandler_(
     }
 
     // Check validity of ACK number
-    if (const auto &[una, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize); una != nxt) {
+    if (const auto &[una, nxt] = sock.onAck_(getAck); una != nxt) {
         // Unacceptable ACK, should send RST but we don't care about it for now
         std::stringstream ss;
         ss << "Normal socket " << sock.id_ << " (SYN_RECEIVED): Got ACK with wrong ACK number. Expected " 
@@ -70,7 +77,7 @@ void TcpStack::eventHandler_(
 
     std::cout << "Normal socket " << sock.id_ 
               << " (SYN_RECEIVED): Got ACK (seq=" << getAck.seqNum << ", ack=" << getAck.ackNum
-              << ") from " << sock.tuple_.remote.toString() << ", connection established!\n";
+              << ") from " << sock.tuple_.remote().toString() << ", connection established!\n";
 
     assert(sock.sendBuffer_.sanityCheckAtStart() && "FATAL: sendBuffer_ failed sanity check");
     assert(sock.recvBuffer_.sanityCheckAtStart() && "FATAL: recvBuffer_ failed sanity check");
@@ -89,15 +96,14 @@ void TcpStack::eventHandler_(
 {
     // std::cout << "Normal socket " << sock.id_ 
     //           << ": Got ACK (seq=" << getAck.seqNum << ", ack=" << getAck.ackNum << ", data=" << getAck.payload.size()
-    //           << ") from " << sock.tuple_.remote.toString() << "\n";
+    //           << ") from " << sock.tuple_.remote().toString() << "\n";
 
     // Potentially: increment SND.UNA, remove ack'd segments from retransmission queue
-    const auto &[_, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize);  // locks sendBuffer_
+    sock.onAck_(getAck);  // locks sendBuffer_
 
     if (getAck.payload.size() > 0) {
-        // If there's data, reply ACK (no retransmission)
-        const auto &[ack, wnd] = sock.recvBuffer_.onRecv(getAck.seqNum, getAck.payload);  // locks recvBuffer_
-        sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+        // If there's data, ACK it (no retransmission), possibly with the next segment
+        sock.onData_(getAck);  // locks recvBuffer_
     }
 }
 
@@ -114,12 +120,12 @@ void TcpStack::eventHandler_(
               << " (ESTABLISHED): Got retransmitted SYN-ACK (seq=" << synAck.serverISN 
               << ", ack=" << synAck.ackNum
               << ", wnd=" << synAck.serverWND
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
               << ", wnd=" << wnd
-              << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ") to " << sock.tuple_.remote().toString() << "\n";
 
-    sendPacket(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)), sock.tuple_.remote);
+    sock.sendAck_(nxt, ack, wnd);
 }
 
 // ESTBALISHED ----FIN/ACK----> CLOSE_WAIT
@@ -127,17 +133,17 @@ void TcpStack::eventHandler_(
     NormalSocket &sock, const states::Established &, const events::GetFin &getFin)
 {
     // const auto seq = sock.sendBuffer_.getNxt();
-    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, getFin.wndSize);  // ACK nothing, just update window size
+    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, sock.peerWnd_(getFin.wndSize));  // ACK nothing, just update window size
     const auto &[ack, wnd] = sock.recvBuffer_.onCtrl(getFin.seqNum);
 
     std::cout << "Normal socket " << sock.id_ 
               << " (ESTABLISHED): Got FIN (seq=" << getFin.seqNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
-              << ", wnd=" << wnd << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ", wnd=" << wnd << ") to " << sock.tuple_.remote().toString() << "\n";
 
     // Send ACK packet to the remote (No retransmission)
-    sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+    sock.sendAck_(nxt, ack, wnd);
 
     // Transition the socket state to CLOSE_WAIT, if the FIN is not an early arrival
     if (ack == getFin.seqNum + 1) {
@@ -154,17 +160,17 @@ void TcpStack::eventHandler_(
 void TcpStack::eventHandler_(
     NormalSocket &sock, const states::Established &, const events::GetFinAck &finAck)
 {
-    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, finAck.wndSize);  // ACK nothing, just update window size
+    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, sock.peerWnd_(finAck.wndSize));  // ACK nothing, just update window size
     const auto &[ack, wnd] = sock.recvBuffer_.onCtrl(finAck.seqNum);
 
     std::cout << "Normal socket " << sock.id_ 
               << " (ESTABLISHED): Got FIN-ACK (seq=" << finAck.seqNum << ", ack=" << finAck.ackNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
-              << ", wnd=" << wnd << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ", wnd=" << wnd << ") to " << sock.tuple_.remote().toString() << "\n";
 
     // Send ACK packet to the remote (No retransmission)
-    sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+    sock.sendAck_(nxt, ack, wnd);
 
     // Transition the socket state to CLOSE_WAIT, if the FIN is not an early arrival
     if (ack == finAck.seqNum + 1) {
@@ -185,14 +191,13 @@ void TcpStack::eventHandler_(
     std::cout << "Normal socket " << sock.id_
               << " (CLOSE_WAIT): Got ACK (seq=" << getAck.seqNum << ", ack=" << getAck.ackNum 
               << ", data=" << getAck.payload.size()
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
 
-    const auto &[_, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize);  // locks sendBuffer_
+    sock.onAck_(getAck);  // locks sendBuffer_
 
     if (getAck.payload.size() > 0) {
-        // If there's data, reply ACK (no retransmission)
-        const auto &[ack, wnd] = sock.recvBuffer_.onRecv(getAck.seqNum, getAck.payload);  // locks recvBuffer_
-        sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+        // If there's data, ACK it (no retransmission), possibly with the next segment
+        sock.onData_(getAck);  // locks recvBuffer_
     }
 }
 
@@ -201,17 +206,17 @@ void TcpStack::eventHandler_(
     NormalSocket &sock, const states::CloseWait &, const events::GetFin &getFin)
 {
     // const auto seq = sock.sendBuffer_.getNxt();
-    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, getFin.wndSize);  // ACK nothing, just update window size
+    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, sock.peerWnd_(getFin.wndSize));  // ACK nothing, just update window size
     const auto &[ack, wnd] = sock.recvBuffer_.onCtrl(getFin.seqNum);
 
     std::cout << "Normal socket " << sock.id_ 
               << " (CLOSE_WAIT): Got retransmitted FIN (seq=" << getFin.seqNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
-              << ", wnd=" << wnd << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ", wnd=" << wnd << ") to " << sock.tuple_.remote().toString() << "\n";
 
     // Send ACK packet to the remote (No retransmission)
-    sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+    sock.sendAck_(nxt, ack, wnd);
 }
 
 
@@ -221,16 +226,22 @@ void TcpStack::eventHandler_(
 void TcpStack::eventHandler_(
     NormalSocket &sock, const states::FinWait1 &, const events::GetAck &getAck)
 {
+    // The FIN waits for the data before it: until it is sent, SND.NXT acknowledged does not cover it.
+    // Read before the ACK is handled, so that SND.NXT is past the FIN if it was sent
+    const auto finSent = sock.sendBuffer_.isFinSent();
+
     // Potentially: increment SND.UNA, remove ack'd segments from retransmission queue
-    const auto &[una, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize);  // locks sendBuffer_
+    const auto &[una, nxt] = sock.onAck_(getAck);  // locks sendBuffer_
 
     if (getAck.payload.size() > 0) {
-        // If there's data, reply ACK (no retransmission)
-        const auto &[ack, wnd] = sock.recvBuffer_.onRecv(getAck.seqNum, getAck.payload);  // locks recvBuffer_
-        sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+        // If there's data, ACK it (no retransmission), possibly with the next segment
+        sock.onData_(getAck);  // locks recvBuffer_
         return;
     }
 
+    if (!finSent)
+        return;  // An ACK of the data before the FIN
+
     // Check validity of SEQ number
     if (const auto recvNxt = sock.recvBuffer_.getNxt(); getAck.seqNum != recvNxt) {
         std::stringstream ss;
@@ -252,7 +263,7 @@ void TcpStack::eventHandler_(
 
     std::cout << "Normal socket " << sock.id_ 
               << " (FIN_WAIT_1): Got ACK (seq=" << getAck.seqNum << ", ack=" << getAck.ackNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     
     // Transition the socket state to FIN_WAIT_2
     sock.state_ = states::FinWait2{};
@@ -264,21 +275,22 @@ void TcpStack::eventHandler_(
 void TcpStack::eventHandler_(
     NormalSocket &sock, const states::FinWait2 &, const events::GetFin &getFin)
 {
-    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, getFin.wndSize);  // ACK nothing, just update window size
+    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, sock.peerWnd_(getFin.wndSize));  // ACK nothing, just update window size
     const auto &[ack, wnd] = sock.recvBuffer_.onCtrl(getFin.seqNum);
 
     std::cout << "Normal socket " << sock.id_
               << " (FIN_WAIT_2): Got FIN (seq=" << getFin.seqNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
-              << ", wnd=" << wnd << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ", wnd=" << wnd << ") to " << sock.tuple_.remote().toString() << "\n";
 
     // Send ACK packet to the remote (No retransmission)
-    sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+    sock.sendAck_(nxt, ack, wnd);
 
     // Transition the socket state to TIME_WAIT, if the FIN is not an early arrival
     if (ack == getFin.seqNum + 1) {
         sock.state_ = states::TimeWait{};
+        queueTimeWaitReap_(sock.id_);
         std::cout << "Normal socket " << sock.id_ << ": Transitioned to TIME_WAIT\n";
     }
 }
@@ -290,14 +302,13 @@ void TcpStack::eventHandler_(
     // Potentially: increment SND.UNA, remove ack'd segments from retransmission queue
     // std::cout << "Got ACK (seq=" << getAck.seqNum << ", ack=" << getAck.ackNum 
     //           << ", data=" << getAck.payload.size()
-    //           << ") from " << sock.tuple_.remote.toString() << "\n";
+    //           << ") from " << sock.tuple_.remote().toString() << "\n";
 
-    const auto &[_, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize);  // locks sendBuffer_
+    sock.onAck_(getAck);  // locks sendBuffer_
 
     if (getAck.payload.size() > 0) {
-        // If there's data, reply ACK (no retransmission)
-        const auto &[ack, wnd] = sock.recvBuffer_.onRecv(getAck.seqNum, getAck.payload);  // locks recvBuffer_
-        sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+        // If there's data, ACK it (no retransmission), possibly with the next segment
+        sock.onData_(getAck);  // locks recvBuffer_
     }
 }
 
@@ -306,17 +317,17 @@ void TcpStack::eventHandler_(
     NormalSocket &sock, const states::TimeWait &, const events::GetFin &getFin)
 {
     // const auto nxt = sock.sendBuffer_.getNxt();
-    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, getFin.wndSize);  // ACK nothing, just update window size
+    const auto &[___, nxt] = sock.sendBuffer_.onAck(0, sock.peerWnd_(getFin.wndSize));  // ACK nothing, just update window size
     const auto &[ack, wnd] = sock.recvBuffer_.onCtrl(getFin.seqNum);
 
     std::cout << "Normal socket " << sock.id_ 
               << " (TIME_WAIT): Got retransmitted FIN (seq=" << getFin.seqNum
-              << ") from " << sock.tuple_.remote.toString() << "\n";
+              << ") from " << sock.tuple_.remote().toString() << "\n";
     std::cout << "Replying ACK (seq=" << nxt << ", ack=" << ack
-              << ", wnd=" << wnd << ") to " << sock.tuple_.remote.toString() << "\n";
+              << ", wnd=" << wnd << ") to " << sock.tuple_.remote().toString() << "\n";
 
     // Send ACK packet to the remote (No retransmission)
-    sock.sendPacketNoRetransmit_(Packet::makeAckPacket(sock.tuple_, nxt, ack, static_cast<uint16_t>(wnd)));
+    sock.sendAck_(nxt, ack, wnd);
 }
 
 
@@ -325,9 +336,11 @@ void TcpStack::eventHandler_(
 void TcpStack::eventHandler_(
     NormalSocket &sock, const states::LastAck &, const events::GetAck &getAck)
 {
+    const auto finSent = sock.sendBuffer_.isFinSent();  // See FIN_WAIT_1
+
     // Check validity of ACK number
-    if (const auto &[una, nxt] = sock.sendBuffer_.onAck(getAck.ackNum, getAck.wndSize); una != nxt) {
-        // Unacceptable ACK, should send RST but we don't care about it for now
+    if (const auto &[una, nxt] = sock.onAck_(getAck); una != nxt || !finSent) {
+        // Unacceptable ACK (should send RST but we don't care about it for now), or one of the data only
         std::stringstream ss;
         ss << "Normal socket " << sock.id_ << " (LAST_ACK): Got ACK with wrong ACK number. Expected " 
            << nxt << ", got " << getAck.ackNum << " instead\n";
@@ -337,6 +350,7 @@ void TcpStack::eventHandler_(
 
     sock.shutdown_();
     sock.state_ = states::Closed{};
+    queueReap_(sock.id_);
 
     std::cout << "Normal socket " << sock.id_ << ": Transitioned to CLOSED\n";
 }
@@ -351,10 +365,10 @@ void TcpStack::eventHandler_(
     // Create a new normal socket.
     // This call will send a SYN-ACK and put the socket in SYN-RECEIVED state.
     // It then puts the socket in the pending connection list of the listener.
-    auto sock = createPassiveConnection_(getSyn.session, getSyn.clientISN, getSyn.clientWND, lSock);
+    auto sock = createPassiveConnection_(getSyn.session, getSyn.clientISN, getSyn.clientWND, getSyn.options, lSock);
 
     if (sock) {
-        std::cout << "Listener " << lSock.id_ << ": SYN request from " << getSyn.session.remote.toString() 
+        std::cout << "Listener " << lSock.id_ << ": SYN request from " << getSyn.session.remote().toString() 
                   << " results in a new normal socket " << sock->get().id_ << "\n";
     } else {
         std::stringstream ss;
@@ -0,0 +1,123 @@
+#include "tcp/transmit_scheduler.hpp"
+#include "util/clock.hpp"
+#include "util/scheduler.hpp"
+
+
+namespace tns {
+namespace tcp {
+
+TransmitScheduler::TransmitScheduler(std::size_t nWorkers) : scheduler_(tns::util::Clock::scheduler())
+{
+    if (scheduler_)
+        return;
+
+    workers_.reserve(nWorkers);
+    for (std::size_t i = 0; i < nWorkers; i++)
+        workers_.emplace_back([this](std::stop_token stop) { workerLoop_(stop); });
+}
+
+TransmitScheduler::~TransmitScheduler()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto &[_, event] : events_)
+        scheduler_->cancel(event);
+    // The workers are stopped and joined by their jthread destructors
+}
+
+auto TransmitScheduler::add(Transmit transmit) -> SourceId
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto id = nextId_++;
+    sources_.emplace(id, Source{std::move(transmit)});
+    return id;
+}
+
+void TransmitScheduler::remove(SourceId id)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cvDone_.wait(lock, [this, id] {
+        const auto it = sources_.find(id);
+        return it == sources_.end()
+            || (it->second.state != SourceState::RUNNING && it->second.state != SourceState::RUNNING_NOTIFIED);
+    });
+    sources_.erase(id);  // Its id may still be queued: runNext_() skips it
+}
+
+void TransmitScheduler::notify(SourceId id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = sources_.find(id);
+    if (it == sources_.end())
+        return;
+
+    switch (it->second.state) {
+    case SourceState::IDLE:
+        it->second.state = SourceState::READY;
+        pushReadyNoLock_(id);
+        break;
+    case SourceState::RUNNING:
+        it->second.state = SourceState::RUNNING_NOTIFIED;  // Requeued once the running transmission returns
+        break;
+    default:
+        break;
+    }
+}
+
+std::size_t TransmitScheduler::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return sources_.size();
+}
+
+void TransmitScheduler::pushReadyNoLock_(SourceId id)
+{
+    ready_.push_back(id);
+
+    if (!scheduler_) {
+        cvReady_.notify_one();
+        return;
+    }
+
+    const auto key = nextEventKey_++;
+    events_[key] = scheduler_->scheduleAfter(tns::util::Clock::duration::zero(), [this, key]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        events_.erase(key);
+        runNext_(lock);
+    });
+}
+
+void TransmitScheduler::runNext_(std::unique_lock<std::mutex> &lock)
+{
+    const auto id = ready_.front();
+    ready_.pop_front();
+
+    const auto it = sources_.find(id);
+    if (it == sources_.end())
+        return;  // Removed while queued
+
+    // Nodes of an unordered_map stay put, and remove() waits for RUNNING sources
+    auto &source = it->second;
+    source.state = SourceState::RUNNING;
+    lock.unlock();
+
+    const bool more = source.transmit();
+
+    lock.lock();
+    if (more || source.state == SourceState::RUNNING_NOTIFIED) {
+        source.state = SourceState::READY;
+        pushReadyNoLock_(id);  // Back of the queue: the other ready sources go first
+    } else {
+        source.state = SourceState::IDLE;
+    }
+    cvDone_.notify_all();
+}
+
+void TransmitScheduler::workerLoop_(std::stop_token stop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (cvReady_.wait(lock, stop, [this] { return !ready_.empty(); }))
+        runNext_(lock);
+}
+
+} // namespace tcp
+} // namespace tns
@@ -148,6 +148,8 @@ lnxconfig_t *lnxconfig_parse(const char *config_file) {
 		config->routing_mode = ROUTING_MODE_RIP;
 	    } else if (strncmp(mode_str, "static", TOKEN_MAX_NAME) == 0) {
 		config->routing_mode = ROUTING_MODE_STATIC;
+	    } else if (strncmp(mode_str, "link-state", TOKEN_MAX_NAME) == 0) {
+		config->routing_mode = ROUTING_MODE_LINK_STATE;
 	    } else {
 		do_parse_error("Unrecognized routing mode");
 	    }
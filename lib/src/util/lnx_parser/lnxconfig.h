@@ -23,6 +23,7 @@ typedef enum {
     ROUTING_MODE_NONE   = 0,   // Unspecified
     ROUTING_MODE_STATIC = 1,   // Static routes only (no RIP, used for hosts)
     ROUTING_MODE_RIP    = 2,   // Use RIP (default for routers)
+    ROUTING_MODE_LINK_STATE = 3,  // Use the link-state protocol (rip advertise-to lists its neighbors)
 } routing_mode_t;
 
 
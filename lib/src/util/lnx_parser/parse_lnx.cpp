@@ -62,6 +62,8 @@ namespace util::lnx {
             networkNodeData.ripNeighbors.emplace_back(neighbor);
         } list_iterate_end();
 
+        networkNodeData.routingMode = config->routing_mode;
+
         lnxconfig_destroy(config);
         return networkNodeData;
     }
@@ -124,6 +126,7 @@ namespace util::lnx {
         data.udp_ports = ifaceNameToUdpPorts[interfaceName];
         data.udp_addrs = ifaceNameToUdpAddrs[interfaceName];
         data.udp_port = udpPort;
+        data.udp_addr = string(udpAddr);
 
         return data;
     }
@@ -14,6 +14,7 @@ namespace util::lnx {
         std::vector<in_port_t> udp_ports;
         std::vector<std::string> udp_addrs;
         uint16_t udp_port;
+        std::string udp_addr;
     };
 
     struct RoutingData {
@@ -25,6 +26,7 @@ namespace util::lnx {
         std::vector<ParsedIfaceData> interfaces;
         std::vector<RoutingData> routes;
         std::vector<std::string> ripNeighbors;
+        routing_mode_t routingMode = ROUTING_MODE_STATIC;
     };
 
     NetworkNodeData parseLnx(const char *filePath);
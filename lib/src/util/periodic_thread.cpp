@@ -1,4 +1,6 @@
 #include "util/periodic_thread.hpp"
+#include "util/clock.hpp"
+#include "util/scheduler.hpp"
 
 #include <chrono>
 
@@ -6,22 +8,29 @@ namespace tns {
 namespace util::threading {
 
 PeriodicThread::PeriodicThread(const nsec &period, std::function<void()>&& task)
-    : thread{[this, task = std::move(task), period] {
-        using SC = std::chrono::steady_clock;
-        auto prev = SC::now();
+    : task{std::move(task)}, period{period}, scheduler{Clock::scheduler()}
+{
+    if (scheduler) {
+        std::lock_guard<std::mutex> lock(mutex);
+        scheduleNextNoLock();
+        return;
+    }
+
+    thread = std::jthread{[this] {
+        auto prev = Clock::now();
         while (!stopped) {
             {
                 std::unique_lock<std::mutex> lock(mutex);
-                const auto waitTime = period - (SC::now() - prev);
+                const auto waitTime = this->period - (Clock::now() - prev);
                 cv.wait_for(lock, waitTime, [this] { return stopped; });
-                prev = SC::now();
+                prev = Clock::now();
                 if (stopped)
                     return;
             }
-            task();
+            this->task();
         }
-    }}
-{}
+    }};
+}
 
 PeriodicThread::~PeriodicThread() { stop(); std::cout << "PeriodicThread: DESTRUCTED\n";}
 
@@ -31,10 +40,22 @@ void PeriodicThread::stop()
         std::lock_guard<std::mutex> lock(mutex);
         if (stopped) return;
         stopped = true;
+        if (scheduler)
+            scheduler->cancel(event);
     }
     cv.notify_one();
 }
 
+void PeriodicThread::scheduleNextNoLock()
+{
+    event = scheduler->scheduleAfter(period, [this] {
+        task();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!stopped)
+            scheduleNextNoLock();
+    });
+}
+
 
 } // namespace util::threading
 } // namespace tns
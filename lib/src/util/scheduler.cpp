@@ -0,0 +1,101 @@
+#include "util/scheduler.hpp"
+
+#include <algorithm>  // std::max
+#include <stdexcept>
+
+
+namespace tns {
+namespace util {
+
+namespace {
+
+std::atomic<Scheduler*> activeScheduler{nullptr};  // The live scheduler, if any
+
+} // namespace
+
+
+Clock::time_point Clock::now() noexcept
+{
+    if (const auto *scheduler = activeScheduler.load(std::memory_order_acquire))
+        return scheduler->now();
+    return std::chrono::steady_clock::now();
+}
+
+Scheduler *Clock::scheduler() noexcept { return activeScheduler.load(std::memory_order_acquire); }
+
+
+Scheduler::Scheduler() : now_(std::chrono::steady_clock::now().time_since_epoch().count())
+{
+    Scheduler *expected = nullptr;
+    if (!activeScheduler.compare_exchange_strong(expected, this, std::memory_order_acq_rel))
+        throw std::runtime_error("Scheduler::Scheduler(): Another scheduler is already driving the clock");
+}
+
+Scheduler::~Scheduler() { activeScheduler.store(nullptr, std::memory_order_release); }
+
+Scheduler::EventId Scheduler::schedule(Clock::time_point at, Task task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto time = std::max(at.time_since_epoch().count(), now_.load(std::memory_order_relaxed));
+    const auto id = nextId_++;
+    events_.emplace(Key{time, id}, std::move(task));
+    times_.emplace(id, time);
+    return id;
+}
+
+bool Scheduler::cancel(EventId id)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const auto it = times_.find(id);
+    if (it == times_.end())
+        return false;
+    events_.erase(Key{it->second, id});
+    times_.erase(it);
+    return true;
+}
+
+std::size_t Scheduler::runUntil(Clock::time_point until)
+{
+    std::size_t count = 0;
+    for (Task task; popNext_(until, task); count++)
+        task();
+
+    // Nothing else is due: jump to the end of the interval
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (until.time_since_epoch().count() > now_.load(std::memory_order_relaxed))
+        now_.store(until.time_since_epoch().count(), std::memory_order_release);
+    return count;
+}
+
+bool Scheduler::runNext()
+{
+    Task task;
+    if (!popNext_(Clock::time_point::max(), task))
+        return false;
+    task();
+    return true;
+}
+
+std::size_t Scheduler::pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return events_.size();
+}
+
+bool Scheduler::popNext_(Clock::time_point until, Task &task)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (events_.empty() || events_.begin()->first.first > until.time_since_epoch().count())
+        return false;
+
+    auto node = events_.extract(events_.begin());
+    const auto &[time, id] = node.key();
+    times_.erase(id);
+    if (time > now_.load(std::memory_order_relaxed))
+        now_.store(time, std::memory_order_release);
+    task = std::move(node.mapped());
+    return true;
+}
+
+} // namespace util
+} // namespace tns
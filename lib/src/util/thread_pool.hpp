@@ -20,12 +20,12 @@ namespace util::threading {
         void enqueueTask(std::packaged_task<void()> task);
 
     private:
-        // std::vector<std::thread> workers;
-        std::vector<std::jthread> workers;
         std::queue<std::packaged_task<void()>> tasks;
         std::mutex tasksMutex;
         std::condition_variable cv;
         bool stop = false;
+        // std::vector<std::thread> workers;
+        std::vector<std::jthread> workers;  // Declared last: joined before the queue and its mutex are destroyed
         void workerFunction();
     };
 } // namespace util::threading
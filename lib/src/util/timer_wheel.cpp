@@ -0,0 +1,243 @@
+#include "util/timer_wheel.hpp"
+#include "util/scheduler.hpp"
+
+#include <limits>
+
+
+namespace tns {
+namespace util {
+
+/***** Timer *****/
+
+Timer::Timer(TimerWheel &wheel, Callback callback) : wheel_(wheel), callback_(std::move(callback)) {}
+
+void Timer::arm(Clock::duration delay) { wheel_.arm_(*this, delay); }
+void Timer::cancel() { wheel_.cancel_(*this); }
+bool Timer::isArmed() const { return wheel_.isArmed_(*this); }
+
+
+/***** TimerWheel *****/
+
+TimerWheel::TimerWheel(Clock::duration resolution)
+    : resolution_(resolution), start_(Clock::now()), scheduler_(Clock::scheduler())
+{
+    for (auto &level : slots_)
+        for (auto &slot : level)
+            slot.prev = slot.next = &slot;
+    due_.prev = due_.next = &due_;
+    wakeTick_ = std::numeric_limits<std::uint64_t>::max();
+
+    if (!scheduler_)
+        thread_ = std::jthread{[this](std::stop_token stop) { run_(stop); }};
+}
+
+TimerWheel::~TimerWheel()
+{
+    thread_.request_stop();
+    cv_.notify_all();
+}
+
+std::size_t TimerWheel::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return armed_;
+}
+
+void TimerWheel::arm_(Timer &timer, Clock::duration delay)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    if (scheduler_) {
+        if (timer.event_)
+            scheduler_->cancel(timer.event_);
+        else
+            armed_++;
+        timer.event_ = scheduler_->scheduleAfter(delay, [this, &timer] {
+            std::unique_lock<std::mutex> lock(mutex_);
+            timer.event_ = 0;
+            armed_--;
+            fire_(lock, timer);
+        });
+        return;
+    }
+
+    if (timer.prev)
+        unlink_(timer);
+    else
+        armed_++;
+
+    // Round up, so the timer never fires early; the tick being processed has passed already
+    const auto ticks = (std::max(delay, Clock::duration::zero()) + resolution_ - Clock::duration{1}) / resolution_;
+    timer.expiry_ = std::max(currentTick_() + static_cast<std::uint64_t>(ticks), now_ + 1);
+    insertNoLock_(timer);
+
+    if (timer.expiry_ < wakeTick_) {
+        wakeTick_ = timer.expiry_;
+        cv_.notify_one();
+    }
+}
+
+void TimerWheel::cancel_(Timer &timer)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cvRunning_.wait(lock, [this, &timer] {
+        return running_ != &timer || runningThread_ == std::this_thread::get_id();
+    });
+
+    if (scheduler_) {
+        if (timer.event_) {
+            scheduler_->cancel(timer.event_);
+            timer.event_ = 0;
+            armed_--;
+        }
+    } else if (timer.prev) {
+        unlink_(timer);
+        armed_--;
+    }
+}
+
+bool TimerWheel::isArmed_(const Timer &timer) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return scheduler_ ? timer.event_ != 0 : timer.prev != nullptr;
+}
+
+void TimerWheel::pushBack_(Link &list, Link &link) noexcept
+{
+    link.prev = list.prev;
+    link.next = &list;
+    list.prev->next = &link;
+    list.prev = &link;
+}
+
+void TimerWheel::unlink_(Link &link) noexcept
+{
+    link.prev->next = link.next;
+    link.next->prev = link.prev;
+    link.prev = link.next = nullptr;
+}
+
+void TimerWheel::insertNoLock_(Timer &timer)
+{
+    // Timers beyond the span of the wheel wait on the top level, and are re-inserted when cascaded
+    const auto expiry = std::min(timer.expiry_, now_ + MAX_SPAN - 1);
+    const auto delta = expiry - now_;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (std::uint64_t{1} << ((level + 1) * SLOT_BITS)))
+        level++;
+    pushBack_(slots_[static_cast<std::size_t>(level)][(expiry >> (level * SLOT_BITS)) & SLOT_MASK], timer);
+}
+
+void TimerWheel::advanceNoLock_(std::uint64_t tick)
+{
+    if (armed_ == 0) {
+        now_ = std::max(now_, tick);
+        return;
+    }
+
+    while (now_ < tick) {
+        now_++;
+
+        // Level 0 wrapped around: move the timers of the next coarser slot(s) down
+        if ((now_ & SLOT_MASK) == 0) {
+            for (int level = 1; level < LEVELS; level++) {
+                const auto index = (now_ >> (level * SLOT_BITS)) & SLOT_MASK;
+                auto &slot = slots_[static_cast<std::size_t>(level)][index];
+                while (!isEmpty_(slot)) {
+                    auto &timer = static_cast<Timer&>(*slot.next);
+                    unlink_(timer);
+                    insertNoLock_(timer);
+                }
+                if (index != 0)
+                    break;
+            }
+        }
+
+        auto &slot = slots_[0][now_ & SLOT_MASK];
+        while (!isEmpty_(slot)) {
+            auto &link = *slot.next;
+            unlink_(link);
+            pushBack_(due_, link);
+        }
+    }
+}
+
+std::uint64_t TimerWheel::nextWakeNoLock_() const
+{
+    if (armed_ == 0)
+        return std::numeric_limits<std::uint64_t>::max();
+
+    for (auto tick = now_ + 1; ; tick++) {
+        if (!isEmpty_(slots_[0][tick & SLOT_MASK]) || (tick & SLOT_MASK) == 0)
+            return tick;
+    }
+}
+
+std::uint64_t TimerWheel::currentTick_() const
+{
+    return static_cast<std::uint64_t>((Clock::now() - start_) / resolution_);
+}
+
+void TimerWheel::fire_(std::unique_lock<std::mutex> &lock, Timer &timer)
+{
+    running_ = &timer;
+    runningThread_ = std::this_thread::get_id();
+    lock.unlock();
+
+    timer.callback_();
+
+    lock.lock();
+    running_ = nullptr;
+    runningThread_ = {};
+    cvRunning_.notify_all();
+}
+
+void TimerWheel::run_(std::stop_token stop)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop.stop_requested()) {
+        advanceNoLock_(currentTick_());
+
+        // Fire the due timers one at a time: a callback may cancel or re-arm the others
+        while (!isEmpty_(due_)) {
+            auto &timer = static_cast<Timer&>(*due_.next);
+            unlink_(timer);
+            armed_--;
+            fire_(lock, timer);
+        }
+        if (currentTick_() > now_)
+            continue;  // The callbacks took a while
+
+        const auto wake = wakeTick_ = nextWakeNoLock_();
+        const auto earlierTimer = [this, wake] { return wakeTick_ < wake; };
+        if (wake == std::numeric_limits<std::uint64_t>::max())
+            cv_.wait(lock, stop, earlierTimer);
+        else
+            cv_.wait_until(lock, stop, start_ + resolution_ * static_cast<Clock::rep>(wake), earlierTimer);
+    }
+}
+
+
+/***** PeriodicTimer *****/
+
+PeriodicTimer::PeriodicTimer(TimerWheel &wheel, Clock::duration period, std::function<void()> task)
+    : task_(std::move(task))
+    , period_(period)
+    , timer_(wheel, [this] {
+        task_();
+        if (!stopped_.load(std::memory_order_acquire))
+            timer_.arm(period_);
+    })
+{
+    timer_.arm(period_);
+}
+
+void PeriodicTimer::stop()
+{
+    stopped_.store(true, std::memory_order_release);
+    timer_.cancel();
+}
+
+} // namespace util
+} // namespace tns